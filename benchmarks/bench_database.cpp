@@ -0,0 +1,70 @@
+// SqlDataBase 各方法：对复制出来的种子库直接调用（不经网络和队列）
+#include "benchharness.h"
+#include "benchfixtures.h"
+#include "sqldatabase.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+
+using namespace BenchFixtures;
+
+// 包一层：没有种子库时跳过
+#define DB_BENCH(name, body)                                         \
+    BENCH("db/" name) {                                              \
+        SqlDataBase *db = database();                                \
+        if (!db) { state.skip("seed database not found"); return; } \
+        while (state.keepRunning()) { body; }                        \
+    }
+
+DB_BENCH("loginPatient",            benchKeep(db->loginPatient("w1", "123456", "patient")))
+DB_BENCH("doctorSignIn",            benchKeep(db->doctorSignIn("dr_zhang", "123456", "doctor")))
+DB_BENCH("getUserInfo",             benchKeep(db->getUserInfo(kPatientUserId)))
+DB_BENCH("listAppointments",        benchKeep(db->listAppointments(kPatientUserId)))
+DB_BENCH("listAppointments_archive", benchKeep(db->listAppointments(kPatientUserId, true)))
+DB_BENCH("listRecords",             benchKeep(db->listRecords(kPatientUserId, 1)))
+DB_BENCH("listUserRecords",         benchKeep(db->listUserRecords(kPatientUserId)))
+DB_BENCH("getHealth",               benchKeep(db->getHealth(kPatientUserId)))
+DB_BENCH("inbox",                   benchKeep(db->inbox(kPatientUserId)))
+DB_BENCH("listDepartments",         benchKeep(db->listDepartments()))
+DB_BENCH("listDoctorsByDepartment", benchKeep(db->listDoctorsByDepartment(kDepartment)))
+DB_BENCH("getDoctorConsole",        benchKeep(db->getDoctorConsole(kDoctorUserId)))
+DB_BENCH("doctorAppoinment",        benchKeep(db->doctorAppoinment(kDoctorUserId)))
+DB_BENCH("checkWork",               benchKeep(db->checkWork(kDoctorUserId, 30)))
+DB_BENCH("statisticDraw",           benchKeep(db->statisticDraw(kDoctorUserId, kDisease)))
+DB_BENCH("search",                  benchKeep(db->search(kAdminUserId, "头痛", "all", 1, 20)))
+DB_BENCH("isAdmin",                 benchKeep(db->isAdmin(kAdminUserId)))
+
+// 写路径：成对执行，库的规模基本不变
+BENCH("db/createAppointment+cancelAppointment")
+{
+    SqlDataBase *db = database();
+    if (!db) { state.skip("seed database not found"); return; }
+    const QString start = QDateTime::currentDateTime().addDays(7).toString(Qt::ISODate);
+    while (state.keepRunning()) {
+        const QJsonObject res = db->createAppointment(kPatientUserId, kDoctorId, start, 30, "170", "60", "bench");
+        const qint64 apptId = res.value("payload").toObject().value("appt_id").toVariant().toLongLong();
+        if (apptId > 0) benchKeep(db->cancelAppointment(apptId));
+    }
+}
+
+DB_BENCH("sendMessage",             benchKeep(db->sendMessage(kPatientUserId, kDoctorUserId, "bench")))
+DB_BENCH("doctorSendMessage",       benchKeep(db->doctorSendMessage(kDoctorUserId, 1, "bench")))
+DB_BENCH("doctorOrder",             benchKeep(db->doctorOrder(kDoctorUserId, 1, "bench")))
+DB_BENCH("submitHealth",            benchKeep(db->submitHealth(kPatientUserId, "2025-09-01 10:00", "低",
+                                                               QJsonArray{"多喝水", "早睡"})))
+DB_BENCH("goWork",                  benchKeep(db->goWork(kDoctorUserId, QString())))
+DB_BENCH("offWork",                 benchKeep(db->offWork(kDoctorUserId, QString())))
+DB_BENCH("changeUserInfo",          benchKeep(db->changeUserInfo(kPatientUserId, "w1", "13800000000",
+                                                                 "110101199001011234", "北京")))
+
+BENCH("db/registerPatient")
+{
+    SqlDataBase *db = database();
+    if (!db) { state.skip("seed database not found"); return; }
+    qint64 n = QDateTime::currentMSecsSinceEpoch();
+    while (state.keepRunning()) {
+        const QString user = "bench_" + QString::number(++n);
+        benchKeep(db->registerPatient(user, "123456", "压测", "男", "13800000000",
+                                      "110101199001011234", "北京", "patient"));
+    }
+}
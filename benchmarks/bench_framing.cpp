@@ -0,0 +1,104 @@
+// 帧收发：经本机回环连接驱动 JsonTcpServer 的接收（processReceiveBuffer）和发送（sendJsonToSocket）
+#include "benchharness.h"
+#include "jsontcpserver.h"
+
+#include <QCoreApplication>
+#include <QTcpSocket>
+#include <QJsonDocument>
+#include <QtEndian>
+
+namespace {
+
+// 一对已连接的回环套接字：client 是压测端，serverSide 是服务器接受的那一端
+struct Loopback
+{
+    JsonTcpServer server;
+    QTcpSocket client;
+    ConnectionId serverSide = 0;
+    qint64 received = 0;     // 服务器解析出的 JSON 数
+
+    bool open()
+    {
+        QObject::connect(&server, &JsonTcpServer::clientConnected,
+                         [this](ConnectionId id) { serverSide = id; });
+        QObject::connect(&server, &JsonTcpServer::jsonDocumentReceived, [this]() { ++received; });
+        if (!server.start(QHostAddress::LocalHost, 0)) return false;
+        client.connectToHost(QHostAddress::LocalHost, server.serverPort());
+        if (!client.waitForConnected(3000)) return false;
+        while (!serverSide) QCoreApplication::processEvents();
+        return true;
+    }
+};
+
+// body 大约 size 字节的一帧
+QByteArray makeFrame(int size, int seq)
+{
+    QJsonObject o{{"type", "bench"}, {"seq", seq}, {"user_id", 3}};
+    const int base = QJsonDocument(o).toJson(QJsonDocument::Compact).size() + 10;
+    o["pad"] = QString(qMax(0, size - base), QLatin1Char('x'));
+    const QByteArray body = QJsonDocument(o).toJson(QJsonDocument::Compact);
+    QByteArray frame(4, Qt::Uninitialized);
+    qToBigEndian<quint32>(static_cast<quint32>(body.size()), reinterpret_cast<uchar *>(frame.data()));
+    return frame + body;
+}
+
+// 一次写入 depth 帧（流水线），等服务器全部解析完
+void receive(BenchState &state, int frameSize, int depth)
+{
+    Loopback lb;
+    if (!lb.open()) { state.skip("loopback connection failed"); return; }
+
+    QByteArray chunk;
+    for (int i = 0; i < depth; ++i) chunk += makeFrame(frameSize, i);
+    state.setBytesPerIteration(chunk.size());
+    state.setItemsPerIteration(depth);
+
+    while (state.keepRunning()) {
+        const qint64 target = lb.received + depth;
+        lb.client.write(chunk);
+        lb.client.flush();
+        while (lb.received < target) QCoreApplication::processEvents();
+    }
+}
+
+// 服务器连续发 depth 个应答，等客户端全部收到
+void send(BenchState &state, int frameSize, int depth)
+{
+    Loopback lb;
+    if (!lb.open()) { state.skip("loopback connection failed"); return; }
+
+    const QByteArray frame = makeFrame(frameSize, 1);
+    const QJsonDocument doc = QJsonDocument::fromJson(frame.mid(4));
+    const qint64 bytes = static_cast<qint64>(frame.size()) * depth;
+    state.setBytesPerIteration(bytes);
+    state.setItemsPerIteration(depth);
+
+    while (state.keepRunning()) {
+        for (int i = 0; i < depth; ++i) lb.server.sendToClient(lb.serverSide, doc);
+        qint64 got = 0;
+        while (got < bytes) {
+            QCoreApplication::processEvents();
+            got += lb.client.readAll().size();
+        }
+    }
+}
+
+}
+
+BENCH("framing/receive/64B_x1")      { receive(state, 64, 1); }
+BENCH("framing/receive/64B_x16")     { receive(state, 64, 16); }
+BENCH("framing/receive/64B_x256")    { receive(state, 64, 256); }
+BENCH("framing/receive/1KB_x1")      { receive(state, 1024, 1); }
+BENCH("framing/receive/1KB_x16")     { receive(state, 1024, 16); }
+BENCH("framing/receive/1KB_x256")    { receive(state, 1024, 256); }
+BENCH("framing/receive/16KB_x1")     { receive(state, 16 * 1024, 1); }
+BENCH("framing/receive/16KB_x16")    { receive(state, 16 * 1024, 16); }
+BENCH("framing/receive/256KB_x1")    { receive(state, 256 * 1024, 1); }
+BENCH("framing/receive/256KB_x4")    { receive(state, 256 * 1024, 4); }
+
+BENCH("framing/send/64B_x1")         { send(state, 64, 1); }
+BENCH("framing/send/64B_x64")        { send(state, 64, 64); }
+BENCH("framing/send/1KB_x1")         { send(state, 1024, 1); }
+BENCH("framing/send/1KB_x64")        { send(state, 1024, 64); }
+BENCH("framing/send/16KB_x16")       { send(state, 16 * 1024, 16); }
+BENCH("framing/send/256KB_x1")       { send(state, 256 * 1024, 1); }
@@ -0,0 +1,68 @@
+// JsonHandle 分发：构造 + query()，应答在工作线程序列化，与线上一致；不经队列和网络
+#include "benchharness.h"
+#include "benchfixtures.h"
+#include "jsonhandle.h"
+
+#include <QJsonDocument>
+
+using namespace BenchFixtures;
+
+static void dispatch(BenchState &state, const QJsonObject &request)
+{
+    SqlDataBase *db = database();
+    if (!db) { state.skip("seed database not found"); return; }
+    const QJsonDocument doc(request);
+    qint64 bytes = 0;
+    while (state.keepRunning()) {
+        JsonHandle handle(doc, 0, db);
+        QObject::connect(&handle, &JsonHandle::frameReady,
+                         [&bytes](ConnectionId, const QByteArray &body) { bytes += body.size(); });
+        handle.query();
+    }
+    benchKeep(bytes);
+}
+
+BENCH("handle/login")
+{
+    dispatch(state, loginRequest(1));
+}
+BENCH("handle/appt.list")
+{
+    dispatch(state, QJsonObject{{"type", "appt.list"}, {"seq", 1}, {"user_id", kPatientUserId}});
+}
+BENCH("handle/department_list")
+{
+    dispatch(state, QJsonObject{{"type", "department_list"}, {"seq", 1}});
+}
+BENCH("handle/doctor_list")
+{
+    dispatch(state, QJsonObject{{"type", "doctor_list"}, {"seq", 1}, {"department_name", kDepartment}});
+}
+BENCH("handle/everysecond")
+{
+    dispatch(state, QJsonObject{{"type", "everysecond"}, {"user_id", kDoctorUserId}});
+}
+BENCH("handle/userinfo")
+{
+    dispatch(state, QJsonObject{{"type", "userinfo"}, {"seq", 1}, {"user_id", kPatientUserId}});
+}
+BENCH("handle/record.list")
+{
+    dispatch(state, QJsonObject{{"type", "record.list"}, {"seq", 1}, {"user_id", kPatientUserId}});
+}
+BENCH("handle/health.get")
+{
+    dispatch(state, QJsonObject{{"type", "health.get"}, {"seq", 1}, {"user_id", kPatientUserId}});
+}
+BENCH("handle/kaoqin")
+{
+    dispatch(state, QJsonObject{{"type", "kaoqin"}, {"user_id", kDoctorUserId}, {"limit", 30}});
+}
+BENCH("handle/shuju")
+{
+    dispatch(state, QJsonObject{{"type", "shuju"}, {"user_id", kDoctorUserId}, {"bing", kDisease}});
+}
+BENCH("handle/unknown_type")
+{
+    dispatch(state, QJsonObject{{"type", "bench.noop"}, {"seq", 1}});
+}
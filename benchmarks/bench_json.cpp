@@ -0,0 +1,53 @@
+// QJsonDocument 解析 / 序列化：请求、列表应答、仪表盘刷新、统计图
+#include "benchharness.h"
+#include "benchfixtures.h"
+
+#include <QJsonDocument>
+#include "singleflight.h"
+
+static void serialize(BenchState &state, const QJsonObject &object)
+{
+    const QJsonDocument doc(object);
+    state.setBytesPerIteration(doc.toJson(QJsonDocument::Compact).size());
+    while (state.keepRunning()) {
+        const QByteArray out = doc.toJson(QJsonDocument::Compact);
+        benchKeep(out);
+    }
+}
+
+static void parse(BenchState &state, const QJsonObject &object)
+{
+    const QByteArray bytes = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    state.setBytesPerIteration(bytes.size());
+    while (state.keepRunning()) {
+        const QJsonDocument doc = QJsonDocument::fromJson(bytes);
+        // 和服务器一样取一次 type，确保真的解析到了对象
+        const QString type = doc.object().value("type").toString();
+        benchKeep(type);
+    }
+}
+
+BENCH("json/parse/login_request")          { parse(state, BenchFixtures::loginRequest(1)); }
+BENCH("json/serialize/login_request")      { serialize(state, BenchFixtures::loginRequest(1)); }
+BENCH("json/parse/appt_list_10")           { parse(state, BenchFixtures::apptListResponse(10)); }
+BENCH("json/serialize/appt_list_10")       { serialize(state, BenchFixtures::apptListResponse(10)); }
+BENCH("json/parse/appt_list_200")          { parse(state, BenchFixtures::apptListResponse(200)); }
+BENCH("json/serialize/appt_list_200")      { serialize(state, BenchFixtures::apptListResponse(200)); }
+BENCH("json/parse/everysecond_30")         { parse(state, BenchFixtures::everysecondResponse(30)); }
+BENCH("json/serialize/everysecond_30")     { serialize(state, BenchFixtures::everysecondResponse(30)); }
+BENCH("json/parse/shuju")                  { parse(state, BenchFixtures::statsResponse(8)); }
+BENCH("json/serialize/shuju")              { serialize(state, BenchFixtures::statsResponse(8)); }
+
+// 应答经 single-flight 分发时不重新序列化，只拼 seq
+BENCH("json/splice_seq/appt_list_200")
+{
+    QJsonObject object = BenchFixtures::apptListResponse(200);
+    object.remove("seq");
+    const QByteArray body = QJsonDocument(object).toJson(QJsonDocument::Compact);
+    state.setBytesPerIteration(body.size());
+    qint64 seq = 0;
+    while (state.keepRunning()) {
+        const QByteArray out = SingleFlight::withSeq(body, QJsonValue(++seq));
+        benchKeep(out);
+    }
+}
@@ -0,0 +1,97 @@
+#include "benchfixtures.h"
+#include "sqldatabase.h"
+
+#include <QFile>
+#include <QDir>
+#include <QTemporaryDir>
+#include <QJsonArray>
+#include <QDateTime>
+
+namespace BenchFixtures {
+
+const char *const kDepartment = "内科";
+const char *const kDisease = "高血压";
+
+static QString s_sourcePath;
+
+void setSourceDatabase(const QString &path)
+{
+    s_sourcePath = path;
+}
+
+SqlDataBase *database()
+{
+    static QTemporaryDir dir;
+    static SqlDataBase *db = nullptr;
+    static bool tried = false;
+    if (tried) return db;
+    tried = true;
+
+    if (!dir.isValid() || !QFile::exists(s_sourcePath)) return nullptr;
+    const QString copy = dir.filePath("bench.db");
+    if (!QFile::copy(s_sourcePath, copy)) return nullptr;
+    QFile::setPermissions(copy, QFile::ReadOwner | QFile::WriteOwner);
+    db = new SqlDataBase(copy);
+    return db;
+}
+
+QJsonObject loginRequest(qint64 seq)
+{
+    return QJsonObject{
+        {"type", "login"}, {"seq", seq}, {"user", "w1"}, {"pswd", "123456"}, {"role", "patient"}
+    };
+}
+
+QJsonObject apptListResponse(int items)
+{
+    QJsonArray list;
+    for (int i = 0; i < items; ++i) {
+        list.append(QJsonObject{
+            {"appt_id", 1000 + i},
+            {"doctor_name", "张医生"},
+            {"department", "内科"},
+            {"start_time", QDateTime(QDate(2025, 9, 1), QTime(9, 0)).addSecs(i * 1800).toString(Qt::ISODate)},
+            {"status", i % 3 == 0 ? "completed" : "booked"},
+            {"symptom", "头痛，发热两天，伴有轻微咳嗽"},
+            {"fee", 30.0},
+        });
+    }
+    return QJsonObject{
+        {"ok", true}, {"seq", 42}, {"type", "appt.list"},
+        {"payload", QJsonObject{{"appointments", list}}}
+    };
+}
+
+QJsonObject everysecondResponse(int patients)
+{
+    QJsonArray list;
+    for (int i = 0; i < patients; ++i) {
+        list.append(QJsonObject{
+            {"patient_id", i + 1}, {"name", "患者" + QString::number(i + 1)}, {"age", 20 + i % 50},
+            {"height", "170"}, {"weight", "60"}, {"symptom", "头痛"}, {"appt_id", 500 + i},
+        });
+    }
+    return QJsonObject{
+        {"ok", true}, {"type", "everysecond"}, {"online", true},
+        {"today_total", patients}, {"waiting", patients / 2}, {"done", patients - patients / 2},
+        {"patient", list}
+    };
+}
+
+QJsonObject statsResponse(int groups)
+{
+    QJsonArray ages, weights, heights, years;
+    for (int i = 0; i < groups; ++i) {
+        ages.append(QJsonObject{{"group", QString("%1-%2").arg(i * 10).arg(i * 10 + 9)}, {"count", 10 * i + 3}});
+        weights.append(QJsonObject{{"group", QString("%1-%2kg").arg(40 + i * 10).arg(49 + i * 10)}, {"count", 7 * i + 1}});
+        heights.append(QJsonObject{{"group", QString("%1-%2cm").arg(140 + i * 10).arg(149 + i * 10)}, {"count", 5 * i + 2}});
+        years.append(QJsonObject{{"group", QString::number(2015 + i)}, {"count", 11 * i + 4}});
+    }
+    return QJsonObject{
+        {"ok", true}, {"type", "shuju"},
+        {"payload", QJsonObject{{"disease", "高血压"}, {"age", ages}, {"weight", weights},
+                                {"height", heights}, {"year", years}}}
+    };
+}
+
+}
@@ -0,0 +1,34 @@
+#ifndef BENCHFIXTURES_H
+#define BENCHFIXTURES_H
+
+#include <QString>
+#include <QJsonObject>
+
+class SqlDataBase;
+
+// 基准共用的数据：已有数据的库（复制到临时目录后使用，不改动原文件）和代表性的报文
+namespace BenchFixtures {
+
+// 由 main 根据 --db 设置
+void setSourceDatabase(const QString &path);
+
+// 首次调用时复制源库并打开；源库不存在时返回 nullptr
+SqlDataBase *database();
+
+// 种子库里确实存在的 id（MedicalData.db / sever0-datagen 生成的库都满足）
+const qint64 kPatientUserId = 3;
+const qint64 kDoctorUserId = 6;
+const qint64 kDoctorId = 1;
+const qint64 kAdminUserId = 9;
+extern const char *const kDepartment;
+extern const char *const kDisease;
+
+// 代表性报文
+QJsonObject loginRequest(qint64 seq);
+QJsonObject apptListResponse(int items);
+QJsonObject everysecondResponse(int patients);
+QJsonObject statsResponse(int groups);
+
+}
+
+#endif // BENCHFIXTURES_H
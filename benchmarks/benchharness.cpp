@@ -0,0 +1,101 @@
+#include "benchharness.h"
+
+#include <QJsonArray>
+#include <algorithm>
+#include <cmath>
+
+// 每批的目标时长 = minTime / kTargetBatches
+static const int kTargetBatches = 30;
+
+BenchState::BenchState(qint64 minTimeNs)
+    : m_minTimeNs(minTimeNs)
+    , m_batchSize(1)
+    , m_left(0)
+    , m_iterations(0)
+    , m_totalNs(0)
+    , m_pausedNs(0)
+    , m_pauseStart(0)
+    , m_started(false)
+    , m_done(false)
+    , m_bytesPerIteration(0)
+    , m_itemsPerIteration(0)
+{
+}
+
+void BenchState::pauseTiming()
+{
+    m_pauseStart = m_timer.nsecsElapsed();
+}
+
+void BenchState::resumeTiming()
+{
+    m_pausedNs += m_timer.nsecsElapsed() - m_pauseStart;
+}
+
+bool BenchState::nextBatch()
+{
+    if (m_done) return false;
+
+    if (m_started) {
+        const qint64 ns = qMax<qint64>(0, m_timer.nsecsElapsed() - m_pausedNs);
+        m_samples.append(double(ns) / m_batchSize);
+        m_iterations += m_batchSize;
+        m_totalNs += ns;
+        if (m_totalNs >= m_minTimeNs) {
+            m_done = true;
+            return false;
+        }
+        // 按目前的单次耗时估算下一批的次数，每批最多放大 10 倍
+        const double perIteration = qMax(1.0, double(ns) / m_batchSize);
+        const qint64 want = static_cast<qint64>(m_minTimeNs / kTargetBatches / perIteration);
+        m_batchSize = qBound<qint64>(1, want, m_batchSize * 10);
+    }
+
+    m_started = true;
+    m_left = m_batchSize - 1;
+    m_pausedNs = 0;
+    m_timer.start();
+    return true;
+}
+
+QJsonObject BenchState::result() const
+{
+    QJsonObject o;
+    if (!m_skipReason.isEmpty()) {
+        o["skipped"] = m_skipReason;
+        return o;
+    }
+
+    QList<double> sorted = m_samples;
+    std::sort(sorted.begin(), sorted.end());
+    const double mean = m_iterations ? double(m_totalNs) / m_iterations : 0.0;
+    double var = 0;
+    for (double s : m_samples) var += (s - mean) * (s - mean);
+    const double stddev = m_samples.size() > 1 ? std::sqrt(var / (m_samples.size() - 1)) : 0.0;
+
+    QJsonObject ns;
+    ns["mean"]   = mean;
+    ns["median"] = sorted.isEmpty() ? 0.0 : sorted.at(sorted.size() / 2);
+    ns["min"]    = sorted.isEmpty() ? 0.0 : sorted.first();
+    ns["max"]    = sorted.isEmpty() ? 0.0 : sorted.last();
+    ns["stddev"] = stddev;
+
+    o["iterations"]  = m_iterations;
+    o["batches"]     = m_samples.size();
+    o["ns_per_iter"] = ns;
+    if (mean > 0 && m_bytesPerIteration > 0) o["bytes_per_second"] = m_bytesPerIteration * 1e9 / mean;
+    if (mean > 0 && m_itemsPerIteration > 0) o["items_per_second"] = m_itemsPerIteration * 1e9 / mean;
+    return o;
+}
+
+QList<BenchRegistry::Entry> &BenchRegistry::entries()
+{
+    static QList<Entry> list;
+    return list;
+}
+
+int BenchRegistry::add(const QString &name, Function function)
+{
+    entries().append(Entry{name, function});
+    return entries().size();
+}
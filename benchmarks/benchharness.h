@@ -0,0 +1,94 @@
+#ifndef BENCHHARNESS_H
+#define BENCHHARNESS_H
+
+#include <QString>
+#include <QList>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <functional>
+
+// 极简基准框架：自动确定每批迭代次数，按批采样“每次迭代耗时”，结果输出为 JSON，
+// 可与上一次的结果文件对比，变慢超过阈值时返回非 0。
+//
+//   BENCH("json/parse/login") {
+//       while (state.keepRunning()) { ... }
+//   }
+class BenchState
+{
+public:
+    explicit BenchState(qint64 minTimeNs);
+
+    // 每次循环调用一次；测够 minTime 后返回 false
+    bool keepRunning()
+    {
+        if (m_left > 0) { --m_left; return true; }
+        return nextBatch();
+    }
+
+    // 循环体内做准备工作时暂停计时
+    void pauseTiming();
+    void resumeTiming();
+
+    // 每次迭代处理的字节数 / 条数，用来算吞吐
+    void setBytesPerIteration(qint64 bytes) { m_bytesPerIteration = bytes; }
+    void setItemsPerIteration(qint64 items) { m_itemsPerIteration = items; }
+
+    // 基准本身无法运行（缺少数据库等）时调用，结果里记为 skipped
+    void skip(const QString &reason) { m_skipReason = reason; m_left = 0; m_done = true; }
+
+    QJsonObject result() const;
+
+private:
+    bool nextBatch();
+
+    qint64 m_minTimeNs;
+    qint64 m_batchSize;
+    qint64 m_left;
+    qint64 m_iterations;
+    qint64 m_totalNs;
+    qint64 m_pausedNs;
+    qint64 m_pauseStart;
+    bool m_started;
+    bool m_done;
+    QElapsedTimer m_timer;
+    QList<double> m_samples;          // 各批的 ns/次
+    qint64 m_bytesPerIteration;
+    qint64 m_itemsPerIteration;
+    QString m_skipReason;
+};
+
+class BenchRegistry
+{
+public:
+    typedef std::function<void(BenchState &)> Function;
+
+    struct Entry {
+        QString name;
+        Function function;
+    };
+
+    static QList<Entry> &entries();
+    static int add(const QString &name, Function function);
+};
+
+// 防止编译器把结果优化掉
+template <typename T>
+inline void benchKeep(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static const void *volatile sink;
+    sink = &value;
+#endif
+}
+
+#define BENCH_CONCAT2(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT2(a, b)
+#define BENCH(name) \
+    static void BENCH_CONCAT(bench_fn_, __LINE__)(BenchState &state); \
+    static const int BENCH_CONCAT(bench_reg_, __LINE__) = \
+        BenchRegistry::add(QStringLiteral(name), BENCH_CONCAT(bench_fn_, __LINE__)); \
+    static void BENCH_CONCAT(bench_fn_, __LINE__)(BenchState &state)
+
+#endif // BENCHHARNESS_H
@@ -0,0 +1,150 @@
+#include "benchharness.h"
+#include "benchfixtures.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QRegularExpression>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QDateTime>
+#include <QSysInfo>
+#include <QThread>
+#include <QFile>
+#include <QDir>
+#include <QTextStream>
+
+// 服务器代码里的 qDebug 量很大：格式化照常发生（属于被测开销），只是不输出
+static void quietHandler(QtMsgType type, const QMessageLogContext &, const QString &msg)
+{
+    if (type == QtDebugMsg || type == QtInfoMsg) return;
+    QTextStream(stderr) << msg << "\n";
+}
+
+static QJsonObject context()
+{
+    QJsonObject o;
+    o["date"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    o["host"] = QSysInfo::machineHostName();
+    o["os"] = QSysInfo::prettyProductName();
+    o["cpu"] = QSysInfo::currentCpuArchitecture();
+    o["cpus"] = QThread::idealThreadCount();
+    o["qt"] = QString::fromLatin1(qVersion());
+#ifdef QT_NO_DEBUG
+    o["build"] = "release";
+#else
+    o["build"] = "debug";
+#endif
+    return o;
+}
+
+// 与基线对比中位数；变慢超过 threshold（百分比）的列出来
+static int compare(const QJsonObject &current, const QString &baselinePath, double threshold)
+{
+    QFile f(baselinePath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        QTextStream(stderr) << "cannot read baseline " << baselinePath << "\n";
+        return 2;
+    }
+    QHash<QString, double> base;
+    for (const QJsonValue &v : QJsonDocument::fromJson(f.readAll()).object().value("benchmarks").toArray()) {
+        const QJsonObject b = v.toObject();
+        const double median = b.value("ns_per_iter").toObject().value("median").toDouble();
+        if (median > 0) base.insert(b.value("name").toString(), median);
+    }
+
+    QTextStream err(stderr);
+    int regressions = 0;
+    for (const QJsonValue &v : current.value("benchmarks").toArray()) {
+        const QJsonObject b = v.toObject();
+        const QString name = b.value("name").toString();
+        const double median = b.value("ns_per_iter").toObject().value("median").toDouble();
+        if (!base.contains(name) || median <= 0) continue;
+        const double change = (median / base.value(name) - 1.0) * 100.0;
+        if (change > threshold) {
+            ++regressions;
+            err << QString("REGRESSION %1: %2 ns -> %3 ns (+%4%)\n")
+                       .arg(name).arg(base.value(name), 0, 'f', 0).arg(median, 0, 'f', 0).arg(change, 0, 'f', 1);
+        }
+    }
+    err << QString("%1 regression(s) over %2% against %3\n").arg(regressions).arg(threshold).arg(baselinePath);
+    return regressions > 0 ? 1 : 0;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sever0-bench");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Microbenchmarks for sever0 framing, JSON, request dispatch and database paths");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"filter", "Only run benchmarks whose name matches this regular expression.", "regex"},
+        {"list", "List benchmark names and exit."},
+        {"min-time", "Minimum measured time per benchmark in milliseconds.", "ms", "500"},
+        {"db", "Seed database (copied before use).", "path",
+         QDir(QCoreApplication::applicationDirPath()).filePath("../MedicalData.db")},
+        {"out", "Write the JSON results to this file instead of stdout.", "file"},
+        {"baseline", "Compare medians against a previous results file.", "file"},
+        {"threshold", "Regression threshold in percent for --baseline.", "percent", "10"},
+    });
+    parser.process(app);
+
+    const QRegularExpression filter(parser.value("filter"));
+    if (!filter.isValid()) {
+        QTextStream(stderr) << "bad --filter: " << filter.errorString() << "\n";
+        return 2;
+    }
+
+    if (parser.isSet("list")) {
+        for (const BenchRegistry::Entry &e : BenchRegistry::entries()) QTextStream(stdout) << e.name << "\n";
+        return 0;
+    }
+
+    BenchFixtures::setSourceDatabase(parser.value("db"));
+    qInstallMessageHandler(quietHandler);
+
+    const qint64 minTimeNs = qMax<qint64>(1, parser.value("min-time").toLongLong()) * 1000000;
+    QTextStream err(stderr);
+    QJsonArray results;
+    for (const BenchRegistry::Entry &e : BenchRegistry::entries()) {
+        if (!parser.value("filter").isEmpty() && !filter.match(e.name).hasMatch()) continue;
+
+        BenchState state(minTimeNs);
+        e.function(state);
+        QJsonObject r = state.result();
+        r["name"] = e.name;
+        results.append(r);
+
+        if (r.contains("skipped")) {
+            err << QString("%1 skipped: %2\n").arg(e.name, -48).arg(r.value("skipped").toString());
+        } else {
+            err << QString("%1 %2 ns/iter  (%3 iterations)\n")
+                       .arg(e.name, -48)
+                       .arg(r.value("ns_per_iter").toObject().value("median").toDouble(), 12, 'f', 0)
+                       .arg(r.value("iterations").toVariant().toLongLong());
+        }
+        err.flush();
+    }
+
+    QJsonObject out;
+    out["context"] = context();
+    out["benchmarks"] = results;
+    const QByteArray json = QJsonDocument(out).toJson();
+
+    if (parser.isSet("out")) {
+        QFile f(parser.value("out"));
+        if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            err << "cannot write " << f.fileName() << "\n";
+            return 2;
+        }
+        f.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+
+    if (parser.isSet("baseline")) {
+        return compare(out, parser.value("baseline"), parser.value("threshold").toDouble());
+    }
+    return 0;
+}
@@ -0,0 +1,66 @@
+QT       += core network sql concurrent
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = sever0-bench
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# 直接编译服务器的源码，测的就是线上的代码路径
+SRC = ../
+INCLUDEPATH += $$SRC
+
+SOURCES += \
+    $$SRC/dataarchiver.cpp \
+    $$SRC/diseasestatscube.cpp \
+    $$SRC/doctorconsolecounters.cpp \
+    $$SRC/framecompressor.cpp \
+    $$SRC/fulltextsearch.cpp \
+    $$SRC/idletracker.cpp \
+    $$SRC/jsonhandle.cpp \
+    $$SRC/jsontcpserver.cpp \
+    $$SRC/latencyhistogram.cpp \
+    $$SRC/metrics.cpp \
+    $$SRC/onlinebackup.cpp \
+    $$SRC/requesttrace.cpp \
+    $$SRC/reuseportlistener.cpp \
+    $$SRC/singleflight.cpp \
+    $$SRC/sqldatabase.cpp \
+    $$SRC/sqlprofiler.cpp \
+    $$SRC/trafficcapture.cpp \
+    $$SRC/websocketcodec.cpp \
+    bench_database.cpp \
+    bench_framing.cpp \
+    bench_handle.cpp \
+    bench_json.cpp \
+    benchfixtures.cpp \
+    benchharness.cpp \
+    main.cpp
+
+HEADERS += \
+    $$SRC/connectiontable.h \
+    $$SRC/dataarchiver.h \
+    $$SRC/diseasestatscube.h \
+    $$SRC/doctorconsolecounters.h \
+    $$SRC/framecompressor.h \
+    $$SRC/fulltextsearch.h \
+    $$SRC/idletracker.h \
+    $$SRC/jsonhandle.h \
+    $$SRC/jsontcpserver.h \
+    $$SRC/latencyhistogram.h \
+    $$SRC/metrics.h \
+    $$SRC/onlinebackup.h \
+    $$SRC/requesttrace.h \
+    $$SRC/reuseportlistener.h \
+    $$SRC/singleflight.h \
+    $$SRC/sqldatabase.h \
+    $$SRC/sqlprofiler.h \
+    $$SRC/trafficcapture.h \
+    $$SRC/websocketcodec.h \
+    benchfixtures.h \
+    benchharness.h
+
+LIBS += -lz
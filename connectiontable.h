@@ -0,0 +1,148 @@
+#ifndef CONNECTIONTABLE_H
+#define CONNECTIONTABLE_H
+
+#include <QtGlobal>
+#include <QVector>
+#include <QList>
+
+// 连接号：高 8 位是表的标签（分片号，见 JsonTcpServer::setAcceptThreads，主表为 0），
+// 接着 24 位是槽的代数，低 32 位是槽号。槽被回收后代数加一，
+// 旧连接号（例如连接断开后才执行完的请求带回来的）自然失效，不会误投给复用该槽的新连接。
+// 0 不是合法连接号，表示“没有连接”（JsonHandle 里即广播）。
+typedef quint64 ConnectionId;
+
+// 按连接号寻址的连接表：槽放在一个连续数组里，查找是一次下标访问加一次代数比较，
+// 遍历（广播、统计）是顺序扫数组。空槽放进空闲栈，后进先出地复用，表只增不缩。
+// 不加锁，只在所属的网络线程使用（分片时每个 I/O 线程各有一张表）。
+template <typename T>
+class ConnectionTable
+{
+public:
+    ConnectionTable() : m_tag(0), m_size(0) {}
+
+    static const quint32 kGenerationMask = 0xffffffu;
+    static const quint32 kMaxTag = 0xffu;
+
+    static quint32 slotOf(ConnectionId id) { return static_cast<quint32>(id & 0xffffffffu); }
+    static quint32 generationOf(ConnectionId id) { return static_cast<quint32>(id >> 32) & kGenerationMask; }
+    static quint32 tagOf(ConnectionId id) { return static_cast<quint32>(id >> 56); }
+
+    // 本表发出的连接号都带上 tag（不超过 kMaxTag）；只在表为空时设置
+    void setTag(quint32 tag) { m_tag = tag & kMaxTag; }
+    quint32 tag() const { return m_tag; }
+
+    // 占一个槽，值为默认构造；返回的指针在下一次 insert 前有效
+    ConnectionId insert(T **entry = nullptr)
+    {
+        quint32 index;
+        if (!m_free.isEmpty()) {
+            index = m_free.takeLast();
+        } else {
+            index = static_cast<quint32>(m_slots.size());
+            m_slots.append(Slot());
+        }
+        Slot &s = m_slots[static_cast<int>(index)];
+        s.live = true;
+        ++m_size;
+        if (entry) *entry = &s.value;
+        return makeId(s.generation, index);
+    }
+
+    // 连接号已失效时返回空
+    T *find(ConnectionId id)
+    {
+        if (tagOf(id) != m_tag) return nullptr;
+        const quint32 index = slotOf(id);
+        if (index >= static_cast<quint32>(m_slots.size())) return nullptr;
+        Slot &s = m_slots[static_cast<int>(index)];
+        return s.live && s.generation == generationOf(id) ? &s.value : nullptr;
+    }
+
+    const T *find(ConnectionId id) const
+    {
+        if (tagOf(id) != m_tag) return nullptr;
+        const quint32 index = slotOf(id);
+        if (index >= static_cast<quint32>(m_slots.size())) return nullptr;
+        const Slot &s = m_slots.at(static_cast<int>(index));
+        return s.live && s.generation == generationOf(id) ? &s.value : nullptr;
+    }
+
+    bool contains(ConnectionId id) const { return find(id) != nullptr; }
+
+    // 释放槽：值重置为默认（缓冲区等随之释放），槽号留待复用
+    bool remove(ConnectionId id)
+    {
+        if (!find(id)) return false;
+        const quint32 index = slotOf(id);
+        Slot &s = m_slots[static_cast<int>(index)];
+        s.live = false;
+        s.value = T();
+        if (++s.generation > kGenerationMask) s.generation = 1;     // 保证连接号不为 0
+        m_free.append(index);
+        --m_size;
+        return true;
+    }
+
+    void clear()
+    {
+        for (int i = 0; i < m_slots.size(); ++i) {
+            if (m_slots.at(i).live) remove(idAt(i));
+        }
+    }
+
+    int size() const { return m_size; }
+    bool isEmpty() const { return m_size == 0; }
+
+    // 按槽号顺序访问每个在用的槽：f(ConnectionId, T&)。
+    // f 里可以 remove（包括当前槽），但不能 insert
+    template <typename F>
+    void forEach(F f)
+    {
+        for (int i = 0; i < m_slots.size(); ++i) {
+            if (m_slots.at(i).live) f(idAt(i), m_slots[i].value);
+        }
+    }
+
+    template <typename F>
+    void forEach(F f) const
+    {
+        for (int i = 0; i < m_slots.size(); ++i) {
+            const Slot &s = m_slots.at(i);
+            if (s.live) f(idAt(i), s.value);
+        }
+    }
+
+    QList<ConnectionId> ids() const
+    {
+        QList<ConnectionId> out;
+        out.reserve(m_size);
+        for (int i = 0; i < m_slots.size(); ++i) {
+            if (m_slots.at(i).live) out.append(idAt(i));
+        }
+        return out;
+    }
+
+private:
+    struct Slot {
+        quint32 generation = 1;
+        bool live = false;
+        T value;
+    };
+
+    ConnectionId makeId(quint32 generation, quint32 index) const
+    {
+        return (static_cast<ConnectionId>(m_tag) << 56) | (static_cast<ConnectionId>(generation) << 32) | index;
+    }
+
+    ConnectionId idAt(int index) const
+    {
+        return makeId(m_slots.at(index).generation, static_cast<quint32>(index));
+    }
+
+    QVector<Slot> m_slots;
+    QVector<quint32> m_free;
+    quint32 m_tag;
+    int m_size;
+};
+
+#endif // CONNECTIONTABLE_H
@@ -0,0 +1,194 @@
+#include "dashboardpanel.h"
+#include "latencyhistogram.h"
+
+#include <QLabel>
+#include <QTimer>
+#include <QGridLayout>
+#include <QVBoxLayout>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QPainter>
+#include <QPainterPath>
+
+// 折线保留的点数：默认 4 次/秒刷新，约 30 秒
+static const int kHistoryPoints = 120;
+
+Sparkline::Sparkline(QWidget *parent)
+    : QWidget(parent)
+    , m_capacity(kHistoryPoints)
+{
+    setMinimumHeight(24);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+}
+
+void Sparkline::setCapacity(int capacity)
+{
+    m_capacity = qMax(2, capacity);
+    while (m_values.size() > m_capacity) m_values.removeFirst();
+    update();
+}
+
+void Sparkline::append(double value)
+{
+    m_values.append(value);
+    if (m_values.size() > m_capacity) m_values.removeFirst();
+    update();
+}
+
+QSize Sparkline::sizeHint() const
+{
+    return QSize(160, 28);
+}
+
+void Sparkline::paintEvent(QPaintEvent *event)
+{
+    Q_UNUSED(event);
+    if (m_values.size() < 2) return;
+
+    double top = 0;
+    for (double v : m_values) top = qMax(top, v);
+    if (top <= 0) top = 1;
+
+    const QRectF r = QRectF(rect()).adjusted(1, 2, -1, -2);
+    const double step = r.width() / (m_capacity - 1);
+    // 右对齐：最新的点在最右边
+    const double x0 = r.right() - step * (m_values.size() - 1);
+
+    QPainterPath path;
+    for (int i = 0; i < m_values.size(); ++i) {
+        const QPointF p(x0 + step * i, r.bottom() - r.height() * m_values.at(i) / top);
+        if (i == 0) path.moveTo(p);
+        else path.lineTo(p);
+    }
+
+    QPainter painter(this);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(palette().color(QPalette::Highlight), 1.5));
+    painter.drawPath(path);
+}
+
+DashboardPanel::DashboardPanel(MetricsServer *metrics, QWidget *parent)
+    : QWidget(parent)
+    , m_metrics(metrics)
+    , m_hasLast(false)
+{
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    QGridLayout *grid = new QGridLayout;
+    m_connections = addTile(grid, 0, "连接数");
+    m_requests    = addTile(grid, 1, "请求/秒");
+    m_queue       = addTile(grid, 2, "队列深度");
+    m_handler     = addTile(grid, 3, "处理忙碌");
+    layout->addLayout(grid);
+
+    m_types = new QTableWidget(0, 5, this);
+    m_types->setHorizontalHeaderLabels({"请求类型", "p50 (ms)", "p99 (ms)", "p50 趋势", "p99 趋势"});
+    m_types->verticalHeader()->setVisible(false);
+    m_types->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    m_types->setSelectionMode(QAbstractItemView::NoSelection);
+    m_types->horizontalHeader()->setSectionResizeMode(3, QHeaderView::Stretch);
+    m_types->horizontalHeader()->setSectionResizeMode(4, QHeaderView::Stretch);
+    m_types->setMaximumHeight(180);
+    layout->addWidget(m_types);
+
+    m_timer = new QTimer(this);
+    connect(m_timer, &QTimer::timeout, this, &DashboardPanel::refresh);
+    m_timer->start(250);
+}
+
+void DashboardPanel::setRefreshInterval(int ms)
+{
+    m_timer->start(qMax(50, ms));
+}
+
+DashboardPanel::Tile DashboardPanel::addTile(QGridLayout *grid, int column, const QString &title)
+{
+    Tile tile;
+    QLabel *caption = new QLabel(title, this);
+    tile.value = new QLabel("-", this);
+    QFont font = tile.value->font();
+    font.setPointSizeF(font.pointSizeF() * 1.4);
+    font.setBold(true);
+    tile.value->setFont(font);
+    tile.line = new Sparkline(this);
+
+    grid->addWidget(caption, 0, column);
+    grid->addWidget(tile.value, 1, column);
+    grid->addWidget(tile.line, 2, column);
+    return tile;
+}
+
+DashboardPanel::TypeRow &DashboardPanel::typeRow(const QString &type)
+{
+    auto it = m_rows.find(type);
+    if (it != m_rows.end()) return it.value();
+
+    TypeRow row;
+    row.row = m_types->rowCount();
+    m_types->insertRow(row.row);
+    m_types->setItem(row.row, 0, new QTableWidgetItem(type));
+    m_types->setItem(row.row, 1, new QTableWidgetItem("-"));
+    m_types->setItem(row.row, 2, new QTableWidgetItem("-"));
+    row.p50 = new Sparkline(m_types);
+    row.p99 = new Sparkline(m_types);
+    m_types->setCellWidget(row.row, 3, row.p50);
+    m_types->setCellWidget(row.row, 4, row.p99);
+    return m_rows.insert(type, row).value();
+}
+
+void DashboardPanel::refresh()
+{
+    // 窗口不可见时不取快照
+    if (!m_metrics || !isVisible()) return;
+
+    MetricsSnapshot s = m_metrics->snapshot();
+    if (!m_hasLast) {
+        for (const MetricsSnapshot::TypeLatency &t : s.types) typeRow(t.type).lastBuckets = t.buckets;
+        s.types.clear();
+        m_last = s;
+        m_hasLast = true;
+        return;
+    }
+
+    const double dt = (s.atMs - m_last.atMs) / 1000.0;
+    if (dt <= 0) return;
+
+    const double rps = (s.requestsExecuted - m_last.requestsExecuted) / dt;
+    // 所有工作线程在处理函数阶段的时间之和 / 墙钟时间，100% 相当于一个线程一直在处理请求
+    const double handlerBusy = (s.handlerBusyUs - m_last.handlerBusyUs) / (dt * 1e6) * 100.0;
+
+    m_connections.value->setText(QString::number(s.connections));
+    m_connections.line->append(s.connections);
+    m_requests.value->setText(QString::number(rps, 'f', 1));
+    m_requests.line->append(rps);
+    m_queue.value->setText(QString::number(s.queueDepth));
+    m_queue.line->append(s.queueDepth);
+    m_handler.value->setText(QString::number(handlerBusy, 'f', 0) + "%");
+    m_handler.line->append(handlerBusy);
+
+    // 各类型这段时间内的分布 = 本次桶计数 - 上次桶计数；没有新请求时沿用上一个值
+    QVector<quint64> delta(LatencyHistogram::kBucketCount);
+    for (const MetricsSnapshot::TypeLatency &t : s.types) {
+        TypeRow &row = typeRow(t.type);
+        quint64 n = 0;
+        for (int i = 0; i < delta.size(); ++i) {
+            const quint64 prev = row.lastBuckets.isEmpty() ? 0 : row.lastBuckets.at(i);
+            delta[i] = t.buckets.at(i) - prev;
+            n += delta[i];
+        }
+        row.lastBuckets = t.buckets;
+        if (n == 0) continue;
+
+        const double p50 = LatencyHistogram::percentileOf(delta.constData(), 0.50) / 1000.0;
+        const double p99 = LatencyHistogram::percentileOf(delta.constData(), 0.99) / 1000.0;
+        m_types->item(row.row, 1)->setText(QString::number(p50, 'f', 2));
+        m_types->item(row.row, 2)->setText(QString::number(p99, 'f', 2));
+        row.p50->append(p50);
+        row.p99->append(p99);
+    }
+
+    // 桶计数已存在各行里，不再留一份
+    s.types.clear();
+    m_last = s;
+}
@@ -0,0 +1,77 @@
+#ifndef DASHBOARDPANEL_H
+#define DASHBOARDPANEL_H
+
+#include <QWidget>
+#include <QVector>
+#include <QHash>
+#include "metricsserver.h"
+
+class QLabel;
+class QTimer;
+class QGridLayout;
+class QTableWidget;
+
+// 迷你折线图：保留最近 capacity 个点，纵轴从 0 到窗口内最大值
+class Sparkline : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit Sparkline(QWidget *parent = nullptr);
+
+    void setCapacity(int capacity);
+    void append(double value);
+
+    QSize sizeHint() const override;
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    QVector<double> m_values;
+    int m_capacity;
+};
+
+// 性能面板：连接数、请求/秒、队列深度、处理函数忙碌度，以及各请求类型的 p50/p99。
+// 定时读取 MetricsServer::snapshot()（分片计数器 + 无锁直方图），不拿请求路径上的任何锁；
+// 速率和分位数都由相邻两次快照求差得到。
+class DashboardPanel : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit DashboardPanel(MetricsServer *metrics, QWidget *parent = nullptr);
+
+    void setRefreshInterval(int ms);
+
+private slots:
+    void refresh();
+
+private:
+    struct Tile {
+        QLabel *value;
+        Sparkline *line;
+    };
+    Tile addTile(QGridLayout *grid, int column, const QString &title);
+
+    struct TypeRow {
+        int row;
+        Sparkline *p50;
+        Sparkline *p99;
+        QVector<quint64> lastBuckets;
+    };
+    TypeRow &typeRow(const QString &type);
+
+    MetricsServer *m_metrics;
+    QTimer *m_timer;
+
+    Tile m_connections;
+    Tile m_requests;
+    Tile m_queue;
+    Tile m_handler;
+    QTableWidget *m_types;
+    QHash<QString, TypeRow> m_rows;
+
+    MetricsSnapshot m_last;
+    bool m_hasLast;
+};
+
+#endif // DASHBOARDPANEL_H
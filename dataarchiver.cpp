@@ -0,0 +1,248 @@
+#include "dataarchiver.h"
+#include "sqlprofiler.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QFileInfo>
+#include <QDir>
+#include <QRegularExpression>
+#include <QVariant>
+#include <QDebug>
+#include <algorithm>
+
+// 同时挂载的归档库上限（SQLite 默认最多 10 个附加库，给其他用途留余量）
+static const int kMaxAttachedArchives = 8;
+
+DataArchiver::DataArchiver(const QString &mainDbPath)
+    : m_profiler(nullptr)
+{
+    QFileInfo fi(mainDbPath);
+    m_dir = fi.absolutePath();
+    m_baseName = fi.completeBaseName();
+}
+
+QStringList DataArchiver::tables()
+{
+    // messages 不归档：全文检索的 messages_fts 是主库 messages 上的外部内容索引，
+    // 搬走的消息会从检索里消失，而消息没有别的读取路径
+    return QStringList{"appointments", "attendance", "health_assessments"};
+}
+
+DataArchiver::TableSpec DataArchiver::spec(const QString &table)
+{
+    TableSpec s;
+    if (table == "appointments") {
+        s.olderThan = "date(start_time) < date('now','-%1 days')";
+        s.yearExpr  = "strftime('%Y', start_time)";
+        s.pk        = "appt_id";
+        s.indexCols = "patient_id, start_time";
+        // 就诊记录（及其病历、处方）不归档，仍按 appt_id 关联预约；被引用的预约留在主库
+        s.keep      = "EXISTS (SELECT 1 FROM main.encounters e WHERE e.appt_id = appointments.appt_id)";
+    } else if (table == "attendance") {
+        s.olderThan = "day < date('now','-%1 days')";
+        s.yearExpr  = "strftime('%Y', day)";
+        s.pk        = "att_id";
+        s.indexCols = "doctor_id, day";
+    } else if (table == "health_assessments") {
+        s.olderThan = "submitted_at < CAST(strftime('%s','now','-%1 days') AS INTEGER)";
+        s.yearExpr  = "strftime('%Y', submitted_at, 'unixepoch')";
+        s.pk        = "assess_id";
+        s.indexCols = "patient_id, submitted_at";
+    }
+    return s;
+}
+
+QString DataArchiver::archivePath(int year) const
+{
+    return QString("%1/%2_archive_%3.db").arg(m_dir, m_baseName).arg(year);
+}
+
+QStringList DataArchiver::existingYears() const
+{
+    const QRegularExpression re(QString("^%1_archive_(\\d{4})\\.db$")
+                                    .arg(QRegularExpression::escape(m_baseName)));
+    QStringList years;
+    const QStringList files = QDir(m_dir).entryList(QStringList{m_baseName + "_archive_*.db"}, QDir::Files);
+    for (const QString &f : files) {
+        QRegularExpressionMatch m = re.match(f);
+        if (m.hasMatch()) years << m.captured(1);
+    }
+    std::sort(years.begin(), years.end());
+    return years;
+}
+
+QStringList DataArchiver::columns(QSqlDatabase &db, const QString &schema, const QString &table)
+{
+    QStringList cols;
+    QSqlQuery q(db);
+    if (q.exec(QString("PRAGMA %1.table_info(%2)").arg(schema, table))) {
+        while (q.next()) cols << q.value(1).toString();
+    }
+    return cols;
+}
+
+bool DataArchiver::attachYear(QSqlDatabase &db, int year, QString *schema, QString *error)
+{
+    *schema = QString("arc_%1").arg(year);
+
+    QMutexLocker locker(&m_mutex);
+    QSet<QString> &attached = m_attached[db.connectionName()];
+    if (attached.contains(*schema)) return true;
+
+    QSqlQuery q(db);
+    q.prepare(QString("ATTACH DATABASE ? AS %1").arg(*schema));
+    q.addBindValue(archivePath(year));
+    if (!q.exec()) {
+        if (error) *error = q.lastError().text();
+        return false;
+    }
+    attached.insert(*schema);
+    return true;
+}
+
+bool DataArchiver::ensureArchiveTable(QSqlDatabase &db, const QString &schema, const QString &table,
+                                      QString *error)
+{
+    const TableSpec s = spec(table);
+    const QStringList mainCols = columns(db, "main", table);
+    QStringList arcCols = columns(db, schema, table);
+
+    QSqlQuery q(db);
+    if (arcCols.isEmpty()) {
+        // 只复制列，不带主库的外键/检查约束；主键用唯一索引代替
+        if (!q.exec(QString("CREATE TABLE %1.%2 AS SELECT * FROM main.%2 WHERE 0").arg(schema, table))
+            || !q.exec(QString("CREATE UNIQUE INDEX IF NOT EXISTS %1.ux_%2_pk ON %2(%3)").arg(schema, table, s.pk))
+            || !q.exec(QString("CREATE INDEX IF NOT EXISTS %1.ix_%2 ON %2(%3)").arg(schema, table, s.indexCols))) {
+            if (error) *error = q.lastError().text();
+            return false;
+        }
+        return true;
+    }
+
+    // 主库后来加了列：归档表补上
+    for (const QString &c : mainCols) {
+        if (arcCols.contains(c)) continue;
+        if (!q.exec(QString("ALTER TABLE %1.%2 ADD COLUMN %3").arg(schema, table, c))) {
+            if (error) *error = q.lastError().text();
+            return false;
+        }
+        arcCols << c;
+    }
+    return true;
+}
+
+bool DataArchiver::archiveBatch(QSqlDatabase &db, const QString &table, int horizonDays,
+                                int batchSize, int *moved, QString *error)
+{
+    *moved = 0;
+    const TableSpec s = spec(table);
+    if (s.pk.isEmpty()) {
+        if (error) *error = "table not archivable: " + table;
+        return false;
+    }
+    QString cond = s.olderThan.arg(horizonDays);
+    if (!s.keep.isEmpty()) cond += QString(" AND NOT %1").arg(s.keep);
+    // 时间解析不出年份的行不知道该进哪个归档库，留在主库，不挡住后面的行
+    cond += QString(" AND CAST(%1 AS INTEGER) > 0").arg(s.yearExpr);
+
+    // 1) 最旧一条待归档数据所在年份；一批只搬同一年的
+    int year = 0;
+    {
+        QSqlQuery q(db);
+        const QString sql = QString("SELECT %1 FROM main.%2 WHERE %3 ORDER BY rowid LIMIT 1")
+                                .arg(s.yearExpr, table, cond);
+        if (!profiledExec(m_profiler, q, &sql)) {
+            if (error) *error = q.lastError().text();
+            return false;
+        }
+        if (!q.next()) return true;     // 没有要搬的
+        year = q.value(0).toInt();
+    }
+
+    // 2) 挂上该年份的归档库（ATTACH 不能在事务里做）
+    QString schema;
+    if (!attachYear(db, year, &schema, error)) return false;
+
+    // 3) 同一事务内复制 + 删除；按 rowid 取同一批
+    if (!db.transaction()) {
+        if (error) *error = db.lastError().text();
+        return false;
+    }
+
+    if (!ensureArchiveTable(db, schema, table, error)) {
+        db.rollback();
+        return false;
+    }
+
+    const QString cols = columns(db, "main", table).join(", ");
+    const QString pick = QString("SELECT rowid FROM main.%1 WHERE %2 AND %3 = '%4' ORDER BY rowid LIMIT %5")
+                             .arg(table, cond, s.yearExpr).arg(year).arg(batchSize);
+
+    QSqlQuery ins(db);
+    const QString insSql = QString("INSERT OR IGNORE INTO %1.%2(%3) SELECT %3 FROM main.%2 WHERE rowid IN (%4)")
+                               .arg(schema, table, cols, pick);
+    if (!profiledExec(m_profiler, ins, &insSql)) {
+        if (error) *error = ins.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    QSqlQuery del(db);
+    const QString delSql = QString("DELETE FROM main.%1 WHERE rowid IN (%2)").arg(table, pick);
+    if (!profiledExec(m_profiler, del, &delSql)) {
+        if (error) *error = del.lastError().text();
+        db.rollback();
+        return false;
+    }
+    *moved = del.numRowsAffected();
+
+    if (!db.commit()) {
+        if (error) *error = db.lastError().text();
+        db.rollback();
+        *moved = 0;
+        return false;
+    }
+    return true;
+}
+
+QStringList DataArchiver::attach(QSqlDatabase &db)
+{
+    QStringList years = existingYears();
+    if (years.size() > kMaxAttachedArchives) {
+        qWarning() << "[Archive]" << years.size() << "archive files, only the newest"
+                   << kMaxAttachedArchives << "are queried";
+        years = years.mid(years.size() - kMaxAttachedArchives);
+    }
+
+    QStringList schemas;
+    for (const QString &y : years) {
+        QString schema, err;
+        if (attachYear(db, y.toInt(), &schema, &err)) {
+            schemas << schema;
+        } else {
+            qWarning() << "[Archive] attach" << y << "failed:" << err;
+        }
+    }
+    return schemas;
+}
+
+QString DataArchiver::source(QSqlDatabase &db, const QString &table, const QStringList &schemas)
+{
+    if (schemas.isEmpty()) return table;
+
+    const QStringList mainCols = columns(db, "main", table);
+    const QString cols = mainCols.join(", ");
+
+    QStringList parts;
+    parts << QString("SELECT %1 FROM main.%2").arg(cols, table);
+    for (const QString &schema : schemas) {
+        const QStringList arcCols = columns(db, schema, table);
+        if (arcCols.isEmpty()) continue;           // 该年份没有这张表
+        bool complete = true;
+        for (const QString &c : mainCols) complete = complete && arcCols.contains(c);
+        if (!complete) continue;                   // 旧归档缺列，下次归档时会补齐
+        parts << QString("SELECT %1 FROM %2.%3").arg(cols, schema, table);
+    }
+    if (parts.size() == 1) return table;
+    return "(" + parts.join(" UNION ALL ") + ")";
+}
@@ -0,0 +1,64 @@
+#ifndef DATAARCHIVER_H
+#define DATAARCHIVER_H
+
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+
+class SqlProfiler;
+
+// 历史数据归档：把超过保留期的行按年份搬到同目录下的
+// <库名>_archive_<年份>.db，主库只保留热数据。
+// 需要旧数据的查询通过 attach() + source() 把主库与归档库 UNION ALL 起来。
+class DataArchiver
+{
+public:
+    explicit DataArchiver(const QString &mainDbPath);
+
+    // 挑批、复制、删除三条语句经 profiler 执行（见 SqlProfiler），可为空
+    void setProfiler(SqlProfiler *profiler) { m_profiler = profiler; }
+
+    // 参与归档的表
+    static QStringList tables();
+
+    // 搬一批（最多 batchSize 行）超过 horizonDays 的数据；
+    // moved 返回本批搬走的行数，返回 false 表示出错。调用方持有数据库锁
+    bool archiveBatch(QSqlDatabase &db, const QString &table, int horizonDays,
+                      int batchSize, int *moved, QString *error);
+
+    // 把已有归档库挂到该连接上（最新的若干年），返回 schema 名
+    QStringList attach(QSqlDatabase &db);
+
+    // 主库 + 已挂归档库的同名表合成一个子查询；schemas 为空时原样返回表名
+    QString source(QSqlDatabase &db, const QString &table, const QStringList &schemas);
+
+private:
+    struct TableSpec {
+        QString olderThan;   // 超过保留期的条件，参数 %1 为天数
+        QString yearExpr;    // 行所属年份
+        QString pk;          // 主键列，归档表上建唯一索引，重复搬运时忽略
+        QString indexCols;   // 归档表上建的索引列
+        QString keep;        // 满足此条件的行即使过期也留在主库（仍被热数据引用），可为空
+    };
+    static TableSpec spec(const QString &table);
+
+    QString archivePath(int year) const;
+    QStringList existingYears() const;
+    bool attachYear(QSqlDatabase &db, int year, QString *schema, QString *error);
+    bool ensureArchiveTable(QSqlDatabase &db, const QString &schema, const QString &table,
+                            QString *error);
+    static QStringList columns(QSqlDatabase &db, const QString &schema, const QString &table);
+
+    QString m_dir;
+    QString m_baseName;
+    SqlProfiler *m_profiler;
+
+    // 每个连接已挂的 schema（ATTACH 是按连接生效的）
+    QHash<QString, QSet<QString> > m_attached;
+    QMutex m_mutex;
+};
+
+#endif // DATAARCHIVER_H
@@ -0,0 +1,243 @@
+#include "diseasestatscube.h"
+#include "sqlprofiler.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QDebug>
+#include <algorithm>
+
+namespace {
+
+// 连续区间求和 / 按元素累加：内层循环无分支，-O2 下会被向量化
+inline quint64 sumRange(const quint32 *p, int n)
+{
+    quint64 s = 0;
+    for (int i = 0; i < n; ++i) s += p[i];
+    return s;
+}
+
+inline void addInto(quint64 *acc, const quint32 *p, int n)
+{
+    for (int i = 0; i < n; ++i) acc[i] += p[i];
+}
+
+inline bool anySet(const quint8 *p, int n)
+{
+    quint8 any = 0;
+    for (int i = 0; i < n; ++i) any |= p[i];
+    return any != 0;
+}
+
+struct RawRow {
+    QString disease, age, weight, height;
+    int year;
+    quint32 count;
+};
+
+} // namespace
+
+DiseaseStatsCube::DiseaseStatsCube()
+    : m_loaded(false)
+    , m_profiler(nullptr)
+{
+}
+
+DiseaseStatsCube::Axis DiseaseStatsCube::makeAxis(const QStringList &canonical)
+{
+    Axis axis;
+    axis.labels = canonical;
+    axis.labels << "ALL";
+    axis.allIndex = axis.labels.size() - 1;
+    return axis;
+}
+
+int DiseaseStatsCube::axisIndex(Axis &axis, const QString &label)
+{
+    int idx = axis.labels.indexOf(label);
+    if (idx < 0) {
+        // 未知分组插到 ALL 前面，保持 ALL 为最后一格
+        axis.labels.insert(axis.allIndex, label);
+        idx = axis.allIndex;
+        ++axis.allIndex;
+    }
+    return idx;
+}
+
+int DiseaseStatsCube::cellIndex(int d, int y, int a, int w, int h) const
+{
+    return (((d * m_years.size() + y) * m_age.size() + a) * m_weight.size() + w) * m_height.size() + h;
+}
+
+bool DiseaseStatsCube::load(QSqlDatabase &db, QString *error)
+{
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    const QString sql = "SELECT disease, age_group, weight_group, height_group, year, count "
+                        "FROM disease_stats";
+    if (!profiledExec(m_profiler, q, &sql)) {
+        if (error) *error = q.lastError().text();
+        qWarning() << "[StatsCube] load failed:" << q.lastError().text();
+        return false;
+    }
+
+    // 1) 先收集行，确定各轴
+    QVector<RawRow> rows;
+    Axis age    = makeAxis({"0-18","19-40","41-65","65+"});
+    Axis weight = makeAxis({"<50kg","50-70kg","70-90kg","90kg+"});
+    Axis height = makeAxis({"<160cm","160-170cm","170-180cm","180cm+"});
+    QStringList diseases;
+    QVector<int> years;
+
+    while (q.next()) {
+        RawRow r;
+        r.disease = q.value(0).toString();
+        r.age     = q.value(1).toString();
+        r.weight  = q.value(2).toString();
+        r.height  = q.value(3).toString();
+        r.year    = q.value(4).toInt();
+        r.count   = static_cast<quint32>(qMax(0, q.value(5).toInt()));
+
+        if (!diseases.contains(r.disease)) diseases << r.disease;
+        if (!years.contains(r.year))       years << r.year;
+        axisIndex(age, r.age);
+        axisIndex(weight, r.weight);
+        axisIndex(height, r.height);
+        rows.push_back(r);
+    }
+    std::sort(years.begin(), years.end());
+
+    // 2) 分配稠密数组并填充（同一组合多行时累加，与 SUM(count) 一致）
+    QWriteLocker locker(&m_lock);
+    m_diseases = diseases;
+    m_years    = years;
+    m_age      = age;
+    m_weight   = weight;
+    m_height   = height;
+
+    const size_t cells = size_t(m_diseases.size()) * m_years.size()
+                         * m_age.size() * m_weight.size() * m_height.size();
+    m_counts.assign(cells, 0);
+    m_present.assign(cells, 0);
+
+    for (const RawRow &r : rows) {
+        const int idx = cellIndex(m_diseases.indexOf(r.disease),
+                                  m_years.indexOf(r.year),
+                                  m_age.labels.indexOf(r.age),
+                                  m_weight.labels.indexOf(r.weight),
+                                  m_height.labels.indexOf(r.height));
+        m_counts[idx] += r.count;
+        m_present[idx] = 1;
+    }
+
+    m_cache.clear();
+    m_loaded = true;
+
+    qDebug() << "[StatsCube] loaded" << rows.size() << "rows," << m_diseases.size()
+             << "diseases," << cells << "cells";
+    return true;
+}
+
+bool DiseaseStatsCube::isLoaded() const
+{
+    QReadLocker locker(&m_lock);
+    return m_loaded;
+}
+
+QJsonObject DiseaseStatsCube::diseaseStats(const QString &disease)
+{
+    {
+        QReadLocker locker(&m_lock);
+        auto it = m_cache.constFind(disease);
+        if (it != m_cache.constEnd()) return it.value();
+    }
+
+    QWriteLocker locker(&m_lock);
+    auto it = m_cache.constFind(disease);          // 可能已被其他线程算好
+    if (it != m_cache.constEnd()) return it.value();
+
+    QJsonObject dObj;
+    const int d = m_diseases.indexOf(disease);
+    if (d >= 0) {
+        dObj = buildDisease(d);
+    } else {
+        dObj["age_stats"]    = QJsonArray{};
+        dObj["weight_stats"] = QJsonArray{};
+        dObj["height_stats"] = QJsonArray{};
+        dObj["year_stats"]   = QJsonArray{};
+    }
+    dObj["disease"] = disease;
+
+    m_cache.insert(disease, dObj);
+    return dObj;
+}
+
+QJsonObject DiseaseStatsCube::buildDisease(int d) const
+{
+    const int Y = m_years.size();
+    const int A = m_age.size(), W = m_weight.size(), H = m_height.size();
+
+    std::vector<quint64> ageSum(A, 0), wgtSum(W, 0), hgtSum(H, 0);
+    std::vector<quint8>  ageHas(A, 0), wgtHas(W, 0), hgtHas(H, 0);
+
+    for (int y = 0; y < Y; ++y) {
+        for (int a = 0; a < A; ++a) {
+            const int base = cellIndex(d, y, a, 0, 0);
+            const quint32 *blk = &m_counts[base];
+            const quint8  *has = &m_present[base];
+
+            // 年龄：整块 W×H 连续求和
+            if (a != m_age.allIndex) {
+                ageSum[a] += sumRange(blk, W * H);
+                ageHas[a] |= anySet(has, W * H) ? 1 : 0;
+            }
+
+            for (int w = 0; w < W; ++w) {
+                const quint32 *row = blk + w * H;
+                const quint8  *rowHas = has + w * H;
+
+                // 体重：每行 H 连续求和
+                if (w != m_weight.allIndex) {
+                    wgtSum[w] += sumRange(row, H);
+                    wgtHas[w] |= anySet(rowHas, H) ? 1 : 0;
+                }
+
+                // 身高：整行逐元素累加
+                addInto(hgtSum.data(), row, H);
+                for (int h = 0; h < H; ++h) hgtHas[h] |= rowHas[h];
+            }
+        }
+    }
+
+    auto toArray = [](const Axis &axis, const std::vector<quint64> &sum,
+                      const std::vector<quint8> &has, const char *key) -> QJsonArray {
+        QJsonArray arr;
+        for (int i = 0; i < axis.size(); ++i) {
+            if (i == axis.allIndex || !has[i]) continue;
+            arr.push_back(QJsonObject{
+                {key,     axis.labels.at(i)},
+                {"count", static_cast<int>(sum[i])}
+            });
+        }
+        return arr;
+    };
+
+    // 年份：ALL/ALL/ALL 汇总格
+    QJsonArray yearStats;
+    for (int y = 0; y < Y; ++y) {
+        const int idx = cellIndex(d, y, m_age.allIndex, m_weight.allIndex, m_height.allIndex);
+        if (!m_present[idx]) continue;
+        yearStats.push_back(QJsonObject{
+            {"year",  m_years.at(y)},
+            {"count", static_cast<int>(m_counts[idx])}
+        });
+    }
+
+    QJsonObject dObj;
+    dObj["age_stats"]    = toArray(m_age, ageSum, ageHas, "age");
+    dObj["weight_stats"] = toArray(m_weight, wgtSum, wgtHas, "weight");
+    dObj["height_stats"] = toArray(m_height, hgtSum, hgtHas, "height");
+    dObj["year_stats"]   = yearStats;
+    return dObj;
+}
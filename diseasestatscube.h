@@ -0,0 +1,64 @@
+#ifndef DISEASESTATSCUBE_H
+#define DISEASESTATSCUBE_H
+
+#include <QSqlDatabase>
+#include <QReadWriteLock>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <vector>
+
+class SqlProfiler;
+
+// disease_stats 的内存立方体：
+// 病种 × 年份 × 年龄组 × 体重组 × 身高组 的人数放在一块连续数组里，
+// 各分组边际和由连续内存上的累加得到（编译器可自动向量化），
+// 每个病种的结果 JSON 缓存到下次 load() 为止。
+class DiseaseStatsCube
+{
+public:
+    DiseaseStatsCube();
+
+    // 重建时的查询经 profiler 执行（见 SqlProfiler），可为空
+    void setProfiler(SqlProfiler *profiler) { m_profiler = profiler; }
+
+    // 从 disease_stats 全量重建（调用方负责持有数据库锁）
+    bool load(QSqlDatabase &db, QString *error = nullptr);
+
+    bool isLoaded() const;
+
+    // 返回单个病种的 {disease, age_stats, weight_stats, height_stats, year_stats}
+    // 病种不存在时四个数组均为空
+    QJsonObject diseaseStats(const QString &disease);
+
+private:
+    // 轴：已知分组按固定顺序在前，表里出现的未知分组追加在后，最后一格是 "ALL"
+    struct Axis {
+        QStringList labels;
+        int allIndex = -1;
+        int size() const { return labels.size(); }
+    };
+
+    static Axis makeAxis(const QStringList &canonical);
+    static int axisIndex(Axis &axis, const QString &label);
+
+    QJsonObject buildDisease(int d) const;
+    int cellIndex(int d, int y, int a, int w, int h) const;
+
+    mutable QReadWriteLock m_lock;
+    bool m_loaded;
+
+    QStringList m_diseases;
+    QVector<int> m_years;                  // 升序
+    Axis m_age, m_weight, m_height;
+
+    std::vector<quint32> m_counts;         // [disease][year][age][weight][height]
+    std::vector<quint8>  m_present;        // 同形状：该组合在表里至少有一行
+
+    QHash<QString, QJsonObject> m_cache;   // 病种 -> 已组装结果
+    SqlProfiler *m_profiler;
+};
+
+#endif // DISEASESTATSCUBE_H
@@ -0,0 +1,204 @@
+#include "doctorconsolecounters.h"
+#include "sqlprofiler.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QDebug>
+
+DoctorConsoleCounters::Entry::Entry()
+    : dirty(false)
+{
+    for (int i = 0; i < CounterCount; ++i)
+        values[i].store(0, std::memory_order_relaxed);
+}
+
+DoctorConsoleCounters::Chunk::Chunk()
+{
+    for (int i = 0; i < kChunkSize; ++i)
+        slots[i].store(nullptr, std::memory_order_relaxed);
+}
+
+DoctorConsoleCounters::DoctorConsoleCounters()
+    : m_profiler(nullptr)
+{
+    for (int i = 0; i < kChunkCount; ++i)
+        m_chunks[i].store(nullptr, std::memory_order_relaxed);
+}
+
+DoctorConsoleCounters::~DoctorConsoleCounters()
+{
+    for (int i = 0; i < kChunkCount; ++i) {
+        Chunk *chunk = m_chunks[i].load();
+        if (!chunk) continue;
+        for (int j = 0; j < kChunkSize; ++j) delete chunk->slots[j].load();
+        delete chunk;
+    }
+    qDeleteAll(m_overflow);
+}
+
+bool DoctorConsoleCounters::load(QSqlDatabase &db)
+{
+    QSqlQuery q(db);
+    if (!q.exec("CREATE TABLE IF NOT EXISTS doctor_console ("
+                "  doctor_id           INTEGER PRIMARY KEY,"
+                "  appointment_number  INTEGER NOT NULL DEFAULT 0,"
+                "  encounter_number    INTEGER NOT NULL DEFAULT 0,"
+                "  message_number      INTEGER NOT NULL DEFAULT 0,"
+                "  prescription_number INTEGER NOT NULL DEFAULT 0,"
+                "  updated_at          INTEGER"
+                ")")) {
+        qWarning() << "[Console] create doctor_console failed:" << q.lastError().text();
+        return false;
+    }
+
+    // 旧表只有一行（de_id=1），实际只对 1 号医生成立；迁移一次，已存在则不覆盖
+    QSqlQuery qm(db);
+    qm.exec("INSERT OR IGNORE INTO doctor_console("
+            "  doctor_id, appointment_number, encounter_number, message_number, prescription_number) "
+            "SELECT 1, COALESCE(appointment_number,0), COALESCE(encounter_number,0), "
+            "       COALESCE(message_number,0), COALESCE(prescription_number,0) "
+            "FROM DoctorConsole WHERE de_id=1");
+
+    QSqlQuery qs(db);
+    if (!qs.exec("SELECT doctor_id, appointment_number, encounter_number, message_number, prescription_number "
+                 "FROM doctor_console")) {
+        qWarning() << "[Console] load doctor_console failed:" << qs.lastError().text();
+        return false;
+    }
+
+    int rows = 0;
+    while (qs.next()) {
+        Entry *e = findOrCreate(qs.value(0).toLongLong());
+        for (int i = 0; i < CounterCount; ++i)
+            e->values[i].store(qs.value(i + 1).toInt(), std::memory_order_relaxed);
+        ++rows;
+    }
+    qDebug() << "[Console] loaded counters for" << rows << "doctors";
+    return true;
+}
+
+static bool directlyAddressed(qint64 doctorId, qint64 limit)
+{
+    return doctorId >= 0 && doctorId < limit;
+}
+
+DoctorConsoleCounters::Entry *DoctorConsoleCounters::find(qint64 doctorId) const
+{
+    if (!directlyAddressed(doctorId, qint64(kChunkSize) * kChunkCount)) {
+        QMutexLocker locker(&m_createMutex);
+        return m_overflow.value(doctorId, nullptr);
+    }
+    const Chunk *chunk = m_chunks[doctorId >> kChunkBits].load(std::memory_order_acquire);
+    return chunk ? chunk->slots[doctorId & (kChunkSize - 1)].load(std::memory_order_acquire) : nullptr;
+}
+
+DoctorConsoleCounters::Entry *DoctorConsoleCounters::findOrCreate(qint64 doctorId)
+{
+    Entry *e = find(doctorId);
+    if (e) return e;
+
+    QMutexLocker locker(&m_createMutex);
+    if (!directlyAddressed(doctorId, qint64(kChunkSize) * kChunkCount)) {
+        e = m_overflow.value(doctorId, nullptr);
+        if (!e) {
+            e = new Entry();
+            m_overflow.insert(doctorId, e);
+        }
+        return e;
+    }
+
+    std::atomic<Chunk*> &slotChunk = m_chunks[doctorId >> kChunkBits];
+    Chunk *chunk = slotChunk.load(std::memory_order_acquire);
+    if (!chunk) {
+        chunk = new Chunk();
+        slotChunk.store(chunk, std::memory_order_release);
+    }
+    std::atomic<Entry*> &slot = chunk->slots[doctorId & (kChunkSize - 1)];
+    e = slot.load(std::memory_order_acquire);
+    if (!e) {
+        e = new Entry();
+        slot.store(e, std::memory_order_release);
+    }
+    return e;
+}
+
+QVector<QPair<qint64, DoctorConsoleCounters::Entry*> > DoctorConsoleCounters::entries() const
+{
+    QVector<QPair<qint64, Entry*> > list;
+    for (int i = 0; i < kChunkCount; ++i) {
+        const Chunk *chunk = m_chunks[i].load(std::memory_order_acquire);
+        if (!chunk) continue;
+        for (int j = 0; j < kChunkSize; ++j) {
+            if (Entry *e = chunk->slots[j].load(std::memory_order_acquire))
+                list.append(qMakePair(qint64(i) * kChunkSize + j, e));
+        }
+    }
+    QMutexLocker locker(&m_createMutex);
+    for (auto it = m_overflow.constBegin(); it != m_overflow.constEnd(); ++it)
+        list.append(qMakePair(it.key(), it.value()));
+    return list;
+}
+
+void DoctorConsoleCounters::add(qint64 doctorId, Counter counter, int delta)
+{
+    if (doctorId <= 0 || counter < 0 || counter >= CounterCount) return;
+
+    Entry *e = findOrCreate(doctorId);
+    e->values[counter].fetch_add(delta, std::memory_order_relaxed);
+    e->dirty.store(true, std::memory_order_release);
+}
+
+QJsonArray DoctorConsoleCounters::daiban(qint64 doctorId) const
+{
+    QJsonArray arr;
+    const Entry *e = find(doctorId);
+    for (int i = 0; i < CounterCount; ++i)
+        arr.append(e ? e->values[i].load(std::memory_order_relaxed) : 0);
+    return arr;
+}
+
+int DoctorConsoleCounters::flush(QSqlDatabase &db)
+{
+    const QVector<QPair<qint64, Entry*> > all = entries();
+
+    QSqlQuery q(db);
+    q.prepare("INSERT INTO doctor_console("
+              "  doctor_id, appointment_number, encounter_number, message_number, prescription_number, updated_at"
+              ") VALUES(?,?,?,?,?, strftime('%s','now')) "
+              "ON CONFLICT(doctor_id) DO UPDATE SET "
+              "  appointment_number=excluded.appointment_number,"
+              "  encounter_number=excluded.encounter_number,"
+              "  message_number=excluded.message_number,"
+              "  prescription_number=excluded.prescription_number,"
+              "  updated_at=excluded.updated_at");
+
+    QList<Entry*> flushed;
+    bool inTx = false;
+    for (const QPair<qint64, Entry*> &item : all) {
+        Entry *e = item.second;
+        // 先清脏标记再读值：读之后的并发累加会重新置脏，下一轮再写
+        if (!e->dirty.exchange(false, std::memory_order_acq_rel)) continue;
+
+        if (!inTx) inTx = db.transaction();
+
+        q.addBindValue(item.first);
+        for (int i = 0; i < CounterCount; ++i)
+            q.addBindValue(e->values[i].load(std::memory_order_relaxed));
+        if (!profiledExec(m_profiler, q)) {
+            qWarning() << "[Console] flush doctor" << item.first << "failed:" << q.lastError().text();
+            e->dirty.store(true, std::memory_order_release);
+            continue;
+        }
+        flushed.append(e);
+    }
+
+    if (inTx && !db.commit()) {
+        qWarning() << "[Console] flush commit failed:" << db.lastError().text();
+        db.rollback();
+        for (Entry *e : flushed)
+            e->dirty.store(true, std::memory_order_release);
+        return 0;
+    }
+    return flushed.size();
+}
@@ -0,0 +1,75 @@
+#ifndef DOCTORCONSOLECOUNTERS_H
+#define DOCTORCONSOLECOUNTERS_H
+
+#include <QSqlDatabase>
+#include <QMutex>
+#include <QHash>
+#include <QJsonArray>
+#include <QList>
+#include <QVector>
+#include <QPair>
+#include <atomic>
+
+class SqlProfiler;
+
+// 医生仪表盘"待办"计数（预约/就诊/消息/处方），按医生分别维护在内存里：
+// 写路径原子加一，读路径无锁（doctor_id 超出直接寻址范围的少数医生走加锁的散列表），
+// 定时把有变化的医生写回 doctor_console 表
+class DoctorConsoleCounters
+{
+public:
+    enum Counter {
+        Appointments = 0,
+        Encounters,
+        Messages,
+        Prescriptions,
+        CounterCount
+    };
+
+    DoctorConsoleCounters();
+    ~DoctorConsoleCounters();
+
+    // 写回语句经 profiler 执行（见 SqlProfiler），可为空
+    void setProfiler(SqlProfiler *profiler) { m_profiler = profiler; }
+
+    // 建表（如不存在）、从旧 DoctorConsole 迁移、载入全部计数；调用方持有数据库锁
+    bool load(QSqlDatabase &db);
+
+    // 原子累加；首次出现的医生会新建条目
+    void add(qint64 doctorId, Counter counter, int delta = 1);
+
+    // [appointment, encounter, message, prescription]，无锁读
+    QJsonArray daiban(qint64 doctorId) const;
+
+    // 把脏条目 UPSERT 回 doctor_console，返回写回的医生数；调用方持有数据库锁
+    int flush(QSqlDatabase &db);
+
+private:
+    struct Entry {
+        std::atomic<int> values[CounterCount];
+        std::atomic<bool> dirty;
+        Entry();
+    };
+
+    // doctor_id 直接寻址：两级表，块按需分配、分配后不再移动或释放，
+    // 读者 acquire 块指针和槽位即可，新增医生不复制任何已有结构
+    static const int kChunkBits = 10;
+    static const int kChunkSize = 1 << kChunkBits;
+    static const int kChunkCount = 1024;          // 直接寻址范围 [0, kChunkSize * kChunkCount)
+    struct Chunk {
+        std::atomic<Entry*> slots[kChunkSize];
+        Chunk();
+    };
+
+    Entry *find(qint64 doctorId) const;
+    Entry *findOrCreate(qint64 doctorId);
+    // 当前全部条目 (doctor_id, entry)
+    QVector<QPair<qint64, Entry*> > entries() const;
+
+    std::atomic<Chunk*> m_chunks[kChunkCount];
+    QHash<qint64, Entry*> m_overflow;   // 超出直接寻址范围的 doctor_id，读写都在 m_createMutex 下
+    mutable QMutex m_createMutex;
+    SqlProfiler *m_profiler;
+};
+
+#endif // DOCTORCONSOLECOUNTERS_H
@@ -0,0 +1,132 @@
+#include "framecompressor.h"
+
+#include <string.h>
+#include <zlib.h>
+
+const char *const FrameCompressor::kAlgorithm = "deflate";
+const char *const FrameCompressor::kDictionaryId = "s0d1";
+
+FrameCompressor::FrameCompressor()
+    : m_deflate(new z_stream)
+    , m_inflate(new z_stream)
+    , m_lastOk(false)
+    , m_frames(0)
+    , m_bytesIn(0)
+    , m_bytesOut(0)
+{
+    memset(m_deflate, 0, sizeof(z_stream));
+    memset(m_inflate, 0, sizeof(z_stream));
+    // windowBits 取负值即 raw deflate：不带 zlib 头和 adler32，每帧省 6 字节
+    deflateInit2(m_deflate, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    inflateInit2(m_inflate, -15);
+}
+
+FrameCompressor::~FrameCompressor()
+{
+    deflateEnd(m_deflate);
+    inflateEnd(m_inflate);
+    delete m_deflate;
+    delete m_inflate;
+}
+
+// deflate 从字典末尾往前找匹配，越常见的片段放得越靠后
+QByteArray FrameCompressor::dictionary()
+{
+    static const QByteArray dict(
+        // 诊疗内容
+        "上呼吸道感染发热、咳嗽、咽痛对症支持治疗，多饮水头晕、头痛低盐饮食，规律服用降压药"
+        "2型糖尿病口渴、多尿、乏力控制饮食，监测血糖胸闷、胸痛抗血小板、调脂治疗慢性胃炎上腹痛、反酸"
+        "失眠入睡困难睡眠卫生指导青光眼冠心病手术治疗抗感染治疗抗过敏治疗"
+        // 药品与用法
+        "阿托伐他汀钙片氯雷他定片连花清瘟胶囊苯磺酸氨氯地平片阿司匹林肠溶片阿莫西林胶囊阿莫西林颗粒"
+        "双氯芬酸钠凝胶塞来昔布胶囊甲钴胺片甲硝唑片糠酸莫米松鼻喷雾剂右佐匹克隆片缬沙坦胶囊二甲双胍片"
+        "阿卡波糖片奥美拉唑肠溶胶囊铝碳酸镁咀嚼片氨溴索片奥司他韦胶囊头孢呋辛酯片熊去氧胆酸胶囊"
+        "氨溴索口服液蒙脱石散口服补液盐氨基葡萄糖胶囊叶酸片噻吗洛尔滴眼液左氧氟沙星滴眼液"
+        "丁酸氢化可的松乳膏阿达帕林凝胶布洛芬片0.5g*20片"
+        "口服，每次1粒，一日2次口服，每次2片，一日3次口服，每次1片，一日3次口服，每日1片"
+        // 科室
+        "内科外科儿科骨科妇产科眼科耳鼻喉科口腔科皮肤科神经内科心血管内科呼吸内科消化内科内分泌科"
+        "急诊科康复科中医科"
+        // 统计与值班
+        "\"year_stats\":{\"age_stats\":{\"weight_stats\":{\"height_stats\":{\"duty_start\":\"daily_quota\":"
+        "\"reg_fee\":\"last_backup\":\"running\":\"report\":\"daiban\":\"year\":\"count\":"
+        // 档案与消息
+        "\"from_user\":\"to_user\":\"msg_id\":\"created_at\":\"role\":\"bio\":\"phone\":\"id_number\":"
+        "\"full_name\":\"gender\":\"男\",\"女\",\"adress\":\"北京市\",\"user\":{\"patient\":{\"patient_id\":"
+        "\"prescription\":\"disease\":\"risk_level\":\"symptom\":\"advice\":\"note\":"
+        "\"checkInTime\":\"checkOutTime\":\"diseases\":[{\"weight\":\"height\":\"age\":"
+        // 预约列表
+        "\"num_pending\":\"num_confirmed\":\"num_cancelled\":\"status\":\"pending\",\"confirmed\","
+        "\"cancelled\",\"date\":\"doctor_id\":\"user_id\":\"name\":\"time\":\"doctor_name\":"
+        "\"department_name\":\"appointment\":{\"appt_id\":\"appointments\":[{\"appt_id\":"
+        // 应答外壳
+        "{\"ok\":false,\"error\":\"seq\":\"type\":\"everysecond\"{\"ok\":true,\"payload\":{");
+    return dict;
+}
+
+bool FrameCompressor::compress(const QByteArray &in, QByteArray *out)
+{
+    if (!in.isEmpty() && in.constData() == m_lastIn.constData() && in.size() == m_lastIn.size()) {
+        if (!m_lastOk) return false;
+        *out = m_lastOut;
+        ++m_frames;
+        m_bytesIn += static_cast<quint64>(in.size());
+        m_bytesOut += static_cast<quint64>(m_lastOut.size());
+        return true;
+    }
+
+    const QByteArray &dict = dictionary();
+    deflateReset(m_deflate);
+    deflateSetDictionary(m_deflate, reinterpret_cast<const Bytef *>(dict.constData()),
+                         static_cast<uInt>(dict.size()));
+
+    QByteArray buf(static_cast<int>(deflateBound(m_deflate, static_cast<uLong>(in.size()))), Qt::Uninitialized);
+    m_deflate->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.constData()));
+    m_deflate->avail_in = static_cast<uInt>(in.size());
+    m_deflate->next_out = reinterpret_cast<Bytef *>(buf.data());
+    m_deflate->avail_out = static_cast<uInt>(buf.size());
+    const int rc = deflate(m_deflate, Z_FINISH);
+
+    m_lastIn = in;
+    m_lastOk = rc == Z_STREAM_END && m_deflate->total_out < static_cast<uLong>(in.size());
+    if (!m_lastOk) {
+        m_lastOut.clear();
+        return false;
+    }
+    buf.resize(static_cast<int>(m_deflate->total_out));
+    m_lastOut = buf;
+    *out = buf;
+    ++m_frames;
+    m_bytesIn += static_cast<quint64>(in.size());
+    m_bytesOut += static_cast<quint64>(buf.size());
+    return true;
+}
+
+bool FrameCompressor::decompress(const QByteArray &in, QByteArray *out, int maxSize)
+{
+    const QByteArray &dict = dictionary();
+    inflateReset(m_inflate);
+    inflateSetDictionary(m_inflate, reinterpret_cast<const Bytef *>(dict.constData()),
+                         static_cast<uInt>(dict.size()));
+
+    QByteArray buf(qMin(maxSize, qMax(256, in.size() * 4)), Qt::Uninitialized);
+    m_inflate->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.constData()));
+    m_inflate->avail_in = static_cast<uInt>(in.size());
+    m_inflate->next_out = reinterpret_cast<Bytef *>(buf.data());
+    m_inflate->avail_out = static_cast<uInt>(buf.size());
+
+    for (;;) {
+        const int rc = inflate(m_inflate, Z_NO_FLUSH);
+        if (rc == Z_STREAM_END) break;
+        if (rc != Z_OK && rc != Z_BUF_ERROR) return false;
+        if (m_inflate->avail_out > 0) return false;     // 输入已用完却没有结束：数据被截断
+        if (buf.size() >= maxSize) return false;        // 解压炸弹
+        const int used = buf.size();
+        buf.resize(qMin(maxSize, used * 2));
+        m_inflate->next_out = reinterpret_cast<Bytef *>(buf.data() + used);
+        m_inflate->avail_out = static_cast<uInt>(buf.size() - used);
+    }
+    buf.resize(static_cast<int>(m_inflate->total_out));
+    *out = buf;
+    return true;
+}
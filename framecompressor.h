@@ -0,0 +1,51 @@
+#ifndef FRAMECOMPRESSOR_H
+#define FRAMECOMPRESSOR_H
+
+#include <QByteArray>
+
+struct z_stream_s;
+
+// 帧压缩：raw deflate + 预置字典（常见的 JSON 键、科室、药名、诊断等中文片段）。
+// 每帧独立压缩，不跨帧共享滑动窗口——出站队列会丢弃、合并帧，
+// 带上下文的流式压缩在这种情况下无法解压。字典改动后必须换 kDictionaryId，
+// 客户端按协商应答里的 dictionary 选用对应的字典。
+// 不加锁，只在网络线程使用。
+class FrameCompressor
+{
+public:
+    static const char *const kAlgorithm;        // "deflate"
+    static const char *const kDictionaryId;     // 当前字典版本
+
+    // 长度头最高位：置位表示正文是压缩过的，低 31 位是压缩后的长度
+    static const quint32 kCompressedFlag = 0x80000000u;
+
+    FrameCompressor();
+    ~FrameCompressor();
+
+    static QByteArray dictionary();
+
+    // 压缩 in；压缩后不比原文小时返回 false，调用方照原样发送。
+    // 广播时同一份正文连续压缩多次，直接复用上一次的结果
+    bool compress(const QByteArray &in, QByteArray *out);
+
+    // 解压不超过 maxSize 字节；数据损坏或超限返回 false
+    bool decompress(const QByteArray &in, QByteArray *out, int maxSize);
+
+    quint64 framesCompressed() const { return m_frames; }
+    quint64 bytesIn() const { return m_bytesIn; }
+    quint64 bytesOut() const { return m_bytesOut; }
+
+private:
+    Q_DISABLE_COPY(FrameCompressor)
+
+    z_stream_s *m_deflate;      // 复用同一个流，每帧 deflateReset，省掉窗口的反复分配
+    z_stream_s *m_inflate;
+    QByteArray m_lastIn;        // 持有一份引用，保证地址不会被复用
+    QByteArray m_lastOut;
+    bool m_lastOk;
+    quint64 m_frames;
+    quint64 m_bytesIn;
+    quint64 m_bytesOut;
+};
+
+#endif // FRAMECOMPRESSOR_H
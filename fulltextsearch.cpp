@@ -0,0 +1,467 @@
+#include "fulltextsearch.h"
+#include "sqlprofiler.h"
+
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QVariant>
+#include <QHash>
+#include <QDebug>
+#include <algorithm>
+
+FullTextSearch::FullTextSearch()
+    : m_ready(false)
+    , m_trigram(false)
+    , m_profiler(nullptr)
+{
+}
+
+QList<FullTextSearch::Source> FullTextSearch::sources()
+{
+    QList<Source> list;
+
+    Source rec;
+    rec.kind       = "record";
+    rec.fts        = "records_fts";
+    rec.uni        = "records_uni";
+    rec.from       = "medical_records r JOIN encounters e ON e.encounter_id = r.encounter_id";
+    rec.idCol      = "r.record_id";
+    rec.keyA       = "e.patient_id";  rec.nameA = "patient_id";
+    rec.keyB       = "e.doctor_id";   rec.nameB = "doctor_id";
+    rec.timeCol    = "r.created_at";
+    rec.textCols   = QStringList{"r.diagnosis", "r.symptoms", "r.treatment"};
+    rec.patientCol = "e.patient_id";
+    rec.doctorCol  = "e.doctor_id";
+    list << rec;
+
+    Source enc;
+    enc.kind       = "encounter";
+    enc.fts        = "encounters_fts";
+    enc.uni        = "encounters_uni";
+    enc.from       = "encounters e";
+    enc.idCol      = "e.encounter_id";
+    enc.keyA       = "e.patient_id";  enc.nameA = "patient_id";
+    enc.keyB       = "e.doctor_id";   enc.nameB = "doctor_id";
+    enc.timeCol    = "e.visit_time";
+    enc.textCols   = QStringList{"e.notes"};
+    enc.patientCol = "e.patient_id";
+    enc.doctorCol  = "e.doctor_id";
+    list << enc;
+
+    Source msg;
+    msg.kind       = "message";
+    msg.fts        = "messages_fts";
+    msg.uni        = "messages_uni";
+    msg.from       = "messages m";
+    msg.idCol      = "m.msg_id";
+    msg.keyA       = "m.from_user";   msg.nameA = "from_user";
+    msg.keyB       = "m.to_user";     msg.nameB = "to_user";
+    msg.timeCol    = "m.created_at";
+    msg.textCols   = QStringList{"m.content"};
+    msg.userCols   = QStringList{"m.from_user", "m.to_user"};
+    list << msg;
+
+    return list;
+}
+
+QList<FullTextSearch::IndexDef> FullTextSearch::indexDefs()
+{
+    return {
+        {"records_fts",    "records_uni",    "medical_records", "record_id",
+         QStringList{"diagnosis", "symptoms", "treatment"}},
+        {"encounters_fts", "encounters_uni", "encounters",      "encounter_id", QStringList{"notes"}},
+        {"messages_fts",   "messages_uni",   "messages",        "msg_id",       QStringList{"content"}},
+    };
+}
+
+// =============== 建索引 ===============
+bool FullTextSearch::setup(QSqlDatabase &db)
+{
+    const QList<IndexDef> defs = indexDefs();
+
+    // 探测 trigram 支持（临时表，不落盘）
+    {
+        QSqlQuery probe(db);
+        m_trigram = probe.exec("CREATE VIRTUAL TABLE IF NOT EXISTS temp.fts_probe USING fts5(x, tokenize='trigram')");
+        probe.exec("DROP TABLE IF EXISTS temp.fts_probe");
+    }
+    const QString tokenizer = m_trigram ? "trigram" : "unicode61";
+
+    // 单字索引的待同步队列：触发器只记 (单字虚表, 源表主键)
+    {
+        QSqlQuery q(db);
+        if (!q.exec("CREATE TABLE IF NOT EXISTS fts_uni_pending ("
+                    "  tbl TEXT NOT NULL,"
+                    "  id  INTEGER NOT NULL,"
+                    "  PRIMARY KEY(tbl, id)"
+                    ") WITHOUT ROWID")) {
+            qWarning() << "[FTS] create fts_uni_pending failed:" << q.lastError().text();
+            m_ready = false;
+            return false;
+        }
+    }
+
+    for (const IndexDef &d : defs) {
+        QString err;
+        if (!createIndex(db, d.fts, d.cols.join(", "), d.source, d.rowid, tokenizer, &err)
+            || !createTriggers(db, d.fts, d.source, d.rowid, d.cols, &err)
+            || !createUnigramIndex(db, d, &err)) {
+            qWarning() << "[FTS] setup" << d.fts << "failed:" << err;
+            m_ready = false;
+            return false;
+        }
+    }
+
+    m_ready = true;
+    qDebug() << "[FTS] ready, tokenizer =" << tokenizer;
+    return true;
+}
+
+bool FullTextSearch::createIndex(QSqlDatabase &db, const QString &table, const QString &columns,
+                                 const QString &source, const QString &rowid, const QString &tokenizer,
+                                 QString *error)
+{
+    QSqlQuery q(db);
+    q.prepare("SELECT 1 FROM sqlite_master WHERE type='table' AND name=?");
+    q.addBindValue(table);
+    if (q.exec() && q.next()) return true;   // 已存在，触发器负责增量同步
+
+    QSqlQuery c(db);
+    if (!c.exec(QString("CREATE VIRTUAL TABLE %1 USING fts5(%2, content='%3', content_rowid='%4', tokenize='%5')")
+                    .arg(table, columns, source, rowid, tokenizer))) {
+        if (error) *error = c.lastError().text();
+        return false;
+    }
+
+    // 新建时从源表灌入现有数据
+    QSqlQuery r(db);
+    if (!r.exec(QString("INSERT INTO %1(%1) VALUES('rebuild')").arg(table))) {
+        if (error) *error = r.lastError().text();
+        return false;
+    }
+    return true;
+}
+
+bool FullTextSearch::createTriggers(QSqlDatabase &db, const QString &table, const QString &source,
+                                    const QString &rowid, const QStringList &cols, QString *error)
+{
+    const QString colList = cols.join(", ");
+    QStringList newVals, oldVals;
+    for (const QString &c : cols) {
+        newVals << "new." + c;
+        oldVals << "old." + c;
+    }
+
+    const QString ins = QString("INSERT INTO %1(rowid, %2) VALUES (new.%3, %4);")
+                            .arg(table, colList, rowid, newVals.join(", "));
+    const QString del = QString("INSERT INTO %1(%1, rowid, %2) VALUES ('delete', old.%3, %4);")
+                            .arg(table, colList, rowid, oldVals.join(", "));
+
+    const QStringList stmts = {
+        QString("CREATE TRIGGER IF NOT EXISTS trg_%1_ai AFTER INSERT ON %2 BEGIN %3 END")
+            .arg(table, source, ins),
+        QString("CREATE TRIGGER IF NOT EXISTS trg_%1_ad AFTER DELETE ON %2 BEGIN %3 END")
+            .arg(table, source, del),
+        QString("CREATE TRIGGER IF NOT EXISTS trg_%1_au AFTER UPDATE OF %2 ON %3 BEGIN %4 %5 END")
+            .arg(table, colList, source, del, ins),
+    };
+
+    for (const QString &sql : stmts) {
+        QSqlQuery q(db);
+        if (!q.exec(sql)) {
+            if (error) *error = q.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FullTextSearch::createUnigramIndex(QSqlDatabase &db, const IndexDef &def, QString *error)
+{
+    QSqlQuery q(db);
+    q.prepare("SELECT 1 FROM sqlite_master WHERE type='table' AND name=?");
+    q.addBindValue(def.uni);
+    const bool exists = q.exec() && q.next();
+
+    if (!exists) {
+        // 自带正文（拆过字的），rowid 即源表主键；新建时源表全部行排队，由 syncUnigram 分批灌入
+        QSqlQuery c(db);
+        if (!c.exec(QString("CREATE VIRTUAL TABLE %1 USING fts5(%2, tokenize='unicode61')")
+                        .arg(def.uni, def.cols.join(", ")))
+            || !c.exec(QString("INSERT OR IGNORE INTO fts_uni_pending(tbl, id) SELECT '%1', %2 FROM %3")
+                           .arg(def.uni, def.rowid, def.source))) {
+            if (error) *error = c.lastError().text();
+            return false;
+        }
+    }
+
+    const QString enqueue = QString("INSERT OR IGNORE INTO fts_uni_pending(tbl, id) VALUES ('%1', %2.%3);");
+    const QStringList stmts = {
+        QString("CREATE TRIGGER IF NOT EXISTS trg_%1_ai AFTER INSERT ON %2 BEGIN %3 END")
+            .arg(def.uni, def.source, enqueue.arg(def.uni, "new", def.rowid)),
+        QString("CREATE TRIGGER IF NOT EXISTS trg_%1_ad AFTER DELETE ON %2 BEGIN %3 END")
+            .arg(def.uni, def.source, enqueue.arg(def.uni, "old", def.rowid)),
+        QString("CREATE TRIGGER IF NOT EXISTS trg_%1_au AFTER UPDATE OF %2 ON %3 BEGIN %4 END")
+            .arg(def.uni, def.cols.join(", "), def.source, enqueue.arg(def.uni, "new", def.rowid)),
+    };
+    for (const QString &sql : stmts) {
+        QSqlQuery t(db);
+        if (!t.exec(sql)) {
+            if (error) *error = t.lastError().text();
+            return false;
+        }
+    }
+    return true;
+}
+
+int FullTextSearch::syncUnigram(QSqlDatabase &db, int maxRows)
+{
+    if (!m_ready) return 0;
+
+    QList<QPair<QString, qint64> > pending;
+    {
+        QSqlQuery q(db);
+        q.setForwardOnly(true);
+        q.prepare("SELECT tbl, id FROM fts_uni_pending LIMIT ?");
+        q.addBindValue(maxRows);
+        if (!profiledExec(m_profiler, q)) {
+            qWarning() << "[FTS] read fts_uni_pending failed:" << q.lastError().text();
+            return 0;
+        }
+        while (q.next()) pending.append(qMakePair(q.value(0).toString(), q.value(1).toLongLong()));
+    }
+    if (pending.isEmpty()) return 0;
+
+    QHash<QString, IndexDef> defs;
+    for (const IndexDef &d : indexDefs()) defs.insert(d.uni, d);
+
+    if (!db.transaction()) {
+        qWarning() << "[FTS] unigram sync: begin failed:" << db.lastError().text();
+        return 0;
+    }
+
+    // 先删队列再读源表：读之后的改动会重新入队，下一轮再同步
+    QString err;
+    for (const QPair<QString, qint64> &p : pending) {
+        QSqlQuery done(db);
+        done.prepare("DELETE FROM fts_uni_pending WHERE tbl=? AND id=?");
+        done.addBindValue(p.first);
+        done.addBindValue(p.second);
+        if (!profiledExec(m_profiler, done)) { err = done.lastError().text(); break; }
+
+        const auto it = defs.constFind(p.first);
+        if (it == defs.constEnd()) continue;        // 已不再使用的单字表
+        const IndexDef &d = it.value();
+
+        QSqlQuery del(db);
+        const QString delSql = QString("DELETE FROM %1 WHERE rowid=?").arg(d.uni);
+        del.prepare(delSql);
+        del.addBindValue(p.second);
+        if (!profiledExec(m_profiler, del)) { err = del.lastError().text(); break; }
+
+        QSqlQuery src(db);
+        src.prepare(QString("SELECT %1 FROM %2 WHERE %3=?").arg(d.cols.join(", "), d.source, d.rowid));
+        src.addBindValue(p.second);
+        if (!profiledExec(m_profiler, src)) { err = src.lastError().text(); break; }
+        if (!src.next()) continue;                  // 源行已删除
+
+        QStringList marks;
+        for (int i = 0; i < d.cols.size(); ++i) marks << "?";
+        QSqlQuery ins(db);
+        ins.prepare(QString("INSERT INTO %1(rowid, %2) VALUES (?, %3)")
+                        .arg(d.uni, d.cols.join(", "), marks.join(", ")));
+        ins.addBindValue(p.second);
+        for (int i = 0; i < d.cols.size(); ++i) ins.addBindValue(unigrams(src.value(i).toString()));
+        if (!profiledExec(m_profiler, ins)) { err = ins.lastError().text(); break; }
+    }
+
+    if (!err.isEmpty() || !db.commit()) {
+        qWarning() << "[FTS] unigram sync failed:" << (err.isEmpty() ? db.lastError().text() : err);
+        db.rollback();
+        return 0;
+    }
+    return pending.size();
+}
+
+// =============== 检索 ===============
+QString FullTextSearch::phrase(const QString &text)
+{
+    QString t = text;
+    t.replace("\"", "\"\"");
+    return "\"" + t + "\"";
+}
+
+bool FullTextSearch::useUnigram(const QString &text) const
+{
+    return !m_trigram || text.size() < 3;
+}
+
+QString FullTextSearch::unigrams(const QString &text)
+{
+    QString out;
+    out.reserve(text.size() * 2);
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar c = text.at(i);
+        if (c.isSpace()) continue;
+        if (!out.isEmpty()) out += ' ';
+        out += c;
+        if (c.isHighSurrogate() && i + 1 < text.size()) out += text.at(++i);   // 代理对算一个字
+    }
+    return out;
+}
+
+QString FullTextSearch::localSnippet(const QStringList &texts, const QString &term)
+{
+    const int context = 12;
+    for (const QString &t : texts) {
+        const int pos = t.indexOf(term, 0, Qt::CaseInsensitive);
+        if (pos < 0) continue;
+        const int from = qMax(0, pos - context);
+        const int to   = qMin(t.size(), pos + term.size() + context);
+        QString s;
+        if (from > 0) s += "…";
+        s += t.mid(from, pos - from);
+        s += "<b>" + t.mid(pos, term.size()) + "</b>";
+        s += t.mid(pos + term.size(), to - pos - term.size());
+        if (to < t.size()) s += "…";
+        return s;
+    }
+    return QString();
+}
+
+bool FullTextSearch::searchSource(QSqlDatabase &db, const Source &src, const Filter &filter,
+                                  const QString &text, int limit, QList<Hit> &hits, QString *error) const
+{
+    // 短词走单字索引：相邻单字组成的短语，片段从源表正文本地截取
+    const bool uni = useUnigram(text);
+    const QString fts = uni ? src.uni : src.fts;
+    const QString match = uni ? unigrams(text) : text;
+    if (match.isEmpty()) return true;
+
+    QStringList where;
+    QVariantList binds;
+
+    where << fts + " MATCH ?";
+    where << src.idCol + " = " + fts + ".rowid";
+    binds << phrase(match);
+
+    if (filter.patientId > 0 && !src.patientCol.isEmpty()) {
+        where << src.patientCol + " = ?";
+        binds << filter.patientId;
+    }
+    if (filter.doctorId > 0 && !src.doctorCol.isEmpty()) {
+        where << src.doctorCol + " = ?";
+        binds << filter.doctorId;
+    }
+    if (filter.userId > 0 && !src.userCols.isEmpty()) {
+        QStringList ors;
+        for (const QString &c : src.userCols) {
+            ors << c + " = ?";
+            binds << filter.userId;
+        }
+        where << "(" + ors.join(" OR ") + ")";
+    }
+
+    // rank 即 bm25()，越小越相关
+    const QString snippetCols = uni ? src.textCols.join(", ")
+                                    : QString("snippet(%1, -1, '<b>', '</b>', '…', 12)").arg(fts);
+    const QString sql = QString("SELECT %1, %2, %3, %4, %5.rank, %6 "
+                                "FROM %5, %7 WHERE %8 ORDER BY %5.rank LIMIT ?")
+                            .arg(src.idCol, src.keyA, src.keyB, src.timeCol, fts, snippetCols,
+                                 src.from, where.join(" AND "));
+    binds << limit;
+
+    QSqlQuery q(db);
+    q.setForwardOnly(true);
+    q.prepare(sql);
+    for (const QVariant &v : binds) q.addBindValue(v);
+    if (!profiledExec(m_profiler, q)) {
+        if (error) *error = q.lastError().text();
+        return false;
+    }
+
+    // 按本来源最佳命中归一：bm25 为负，越相关绝对值越大，best 是第一行
+    double best = 0.0;
+    bool first = true;
+    while (q.next()) {
+        QJsonObject o;
+        o["kind"]    = src.kind;
+        o["id"]      = q.value(0).toLongLong();
+        o[src.nameA] = q.value(1).toLongLong();
+        o[src.nameB] = q.value(2).toLongLong();
+        o["time"]    = QJsonValue::fromVariant(q.value(3));
+
+        const double rank = q.value(4).toDouble();
+        if (first) {
+            best = rank;
+            first = false;
+        }
+
+        if (uni) {
+            QStringList texts;
+            for (int i = 0; i < src.textCols.size(); ++i) texts << q.value(5 + i).toString();
+            o["snippet"] = localSnippet(texts, text);
+        } else {
+            o["snippet"] = q.value(5).toString();
+        }
+
+        Hit h;
+        h.score = best < 0.0 ? rank / best : 1.0;
+        o["score"] = h.score;
+        h.obj = o;
+        hits.append(h);
+    }
+    return true;
+}
+
+QJsonObject FullTextSearch::search(QSqlDatabase &db, const Filter &filter, const QString &text,
+                                   const QString &scope, int page, int pageSize) const
+{
+    if (!m_ready) {
+        return QJsonObject{{"ok", false}, {"error", "search index not available"}};
+    }
+
+    const QString query = text.trimmed();
+    if (query.isEmpty()) {
+        return QJsonObject{{"ok", false}, {"error", "empty query"}};
+    }
+
+    if (page < 1) page = 1;
+    if (pageSize <= 0) pageSize = 20;
+    if (pageSize > 100) pageSize = 100;
+    const int offset = (page - 1) * pageSize;
+    const int limit  = offset + pageSize + 1;   // 多取一条判断 has_more
+
+    const QString sc = scope.isEmpty() ? QString("all") : scope;
+    QList<Hit> hits;
+    bool matched = false;
+    for (const Source &src : sources()) {
+        if (sc != "all" && sc != src.fts.section('_', 0, 0)) continue;
+        matched = true;
+        QString err;
+        if (!searchSource(db, src, filter, query, limit, hits, &err)) {
+            return QJsonObject{{"ok", false}, {"error", QString("%1 search failed: %2").arg(src.kind, err)}};
+        }
+    }
+    if (!matched) {
+        return QJsonObject{{"ok", false}, {"error", "unknown scope: " + sc}};
+    }
+
+    // 多个来源按各自归一后的相对分合并排序再分页
+    std::stable_sort(hits.begin(), hits.end(), [](const Hit &a, const Hit &b) {
+        return a.score > b.score;
+    });
+
+    QJsonArray arr;
+    for (int i = offset; i < hits.size() && i < offset + pageSize; ++i)
+        arr.append(hits.at(i).obj);
+
+    QJsonObject payload;
+    payload["query"]     = query;
+    payload["scope"]     = sc;
+    payload["page"]      = page;
+    payload["page_size"] = pageSize;
+    payload["has_more"]  = hits.size() > offset + pageSize;
+    payload["tokenizer"] = useUnigram(query) ? "unigram" : (m_trigram ? "trigram" : "unicode61");
+    payload["hits"]      = arr;
+    return QJsonObject{{"ok", true}, {"payload", payload}};
+}
@@ -0,0 +1,106 @@
+#ifndef FULLTEXTSEARCH_H
+#define FULLTEXTSEARCH_H
+
+#include <QSqlDatabase>
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QJsonObject>
+#include <QJsonArray>
+
+class SqlProfiler;
+
+// 病历 / 医嘱 / 消息的 FTS5 全文索引：
+//   records_fts    ← medical_records(diagnosis, symptoms, treatment)
+//   encounters_fts ← encounters(notes)
+//   messages_fts   ← messages(content)
+// 均为外部内容表（不重复存正文），由触发器与源表保持同步。
+// 中文没有空格分词，优先用 trigram 分词器（SQLite ≥ 3.34），不支持时退回 unicode61。
+// trigram 查不了不足 3 个字的词（头痛、发热），另有一套单字索引 records_uni / encounters_uni /
+// messages_uni：正文逐字用空格隔开后交给 unicode61，短词按相邻单字的短语查询。
+// 拆字 SQL 里做不了，触发器只把变动的行记进 fts_uni_pending，由 syncUnigram() 定期补进索引。
+class FullTextSearch
+{
+public:
+    // 检索范围过滤：0 表示不限
+    struct Filter {
+        qint64 patientId = 0;   // 只看该患者的病历/医嘱
+        qint64 doctorId  = 0;   // 只看该医生经手的病历/医嘱
+        qint64 userId    = 0;   // 只看该用户收发的消息
+    };
+
+    FullTextSearch();
+
+    // 检索语句经 profiler 执行（见 SqlProfiler），可为空
+    void setProfiler(SqlProfiler *profiler) { m_profiler = profiler; }
+
+    // 建虚表与触发器；新建的虚表会从源表 rebuild 一次。调用方持有数据库锁
+    bool setup(QSqlDatabase &db);
+
+    bool isReady() const { return m_ready; }
+    bool trigram() const { return m_trigram; }
+
+    // scope: "records" / "encounters" / "messages" / "all"；page 从 1 开始
+    // 返回 { ok, payload:{ query, scope, page, page_size, has_more, tokenizer, hits:[...] } }
+    // hit.score 为 (0, 1]：该命中的 bm25 与同一来源最佳命中之比。各虚表的 bm25 统计量不同，
+    // 不能直接比较，合并时按这个来源内的相对分排序
+    QJsonObject search(QSqlDatabase &db, const Filter &filter, const QString &text,
+                       const QString &scope, int page, int pageSize) const;
+
+    // 把 fts_uni_pending 里最多 maxRows 行同步进单字索引，返回处理的行数；调用方持有数据库锁
+    int syncUnigram(QSqlDatabase &db, int maxRows);
+
+private:
+    struct Hit {
+        double score;
+        QJsonObject obj;
+    };
+
+    // 一个被索引的源表：trigram 虚表、单字虚表、源表、主键与正文列
+    struct IndexDef {
+        QString fts, uni, source, rowid;
+        QStringList cols;
+    };
+    static QList<IndexDef> indexDefs();
+
+    bool createIndex(QSqlDatabase &db, const QString &table, const QString &columns,
+                     const QString &source, const QString &rowid, const QString &tokenizer,
+                     QString *error);
+    bool createTriggers(QSqlDatabase &db, const QString &table, const QString &source,
+                        const QString &rowid, const QStringList &cols, QString *error);
+    // 建单字虚表（新建时把源表全部行排进 fts_uni_pending）与记录变动的触发器
+    bool createUnigramIndex(QSqlDatabase &db, const IndexDef &def, QString *error);
+
+    // 一种检索来源（虚表 + 源表连接 + 返回列）
+    struct Source {
+        QString kind;           // hit.kind: record / encounter / message
+        QString fts;            // 虚表名
+        QString uni;            // 单字虚表名
+        QString from;           // 源表及连接（带别名）
+        QString idCol;          // 源表主键 = 虚表 rowid
+        QString keyA, keyB;     // 两个关联字段
+        QString nameA, nameB;   // 对应 JSON 字段名
+        QString timeCol;
+        QStringList textCols;   // 正文列，单字索引命中时本地截取片段用
+        QString patientCol, doctorCol;   // Filter 对应列，空表示不适用
+        QStringList userCols;
+    };
+    static QList<Source> sources();
+
+    bool searchSource(QSqlDatabase &db, const Source &src, const Filter &filter,
+                      const QString &text, int limit, QList<Hit> &hits, QString *error) const;
+
+    // 把用户输入转成 FTS5 短语查询，避免 AND/OR/NEAR/引号被当成语法
+    static QString phrase(const QString &text);
+    // trigram 对不足 3 个字的词无法走索引（没有 trigram 时 unicode61 又不拆中文），这些查询走单字索引
+    bool useUnigram(const QString &text) const;
+    // 逐字用空格隔开（去掉原有空白），写单字索引和拼短语查询共用
+    static QString unigrams(const QString &text);
+    static QString localSnippet(const QStringList &texts, const QString &term);
+
+    bool m_ready;
+    bool m_trigram;
+    SqlProfiler *m_profiler;
+};
+
+#endif // FULLTEXTSEARCH_H
@@ -0,0 +1,109 @@
+#include "idletracker.h"
+
+IdleTracker::IdleTracker(int wheelSize)
+    : m_wheel(qMax(2, wheelSize))
+    , m_tick(0)
+    , m_pingAfter(0)
+    , m_idleTimeout(0)
+{
+}
+
+void IdleTracker::setTimeouts(int pingAfterSec, int idleTimeoutSec)
+{
+    m_idleTimeout = qMax(0, idleTimeoutSec);
+    // 心跳必须早于超时，否则发了也来不及回
+    m_pingAfter = pingAfterSec > 0 && pingAfterSec < m_idleTimeout ? pingAfterSec : 0;
+
+    // 已有连接按新的时限重新上轮
+    for (QVector<Slot> &bucket : m_wheel) bucket.clear();
+    if (!isEnabled()) return;
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        schedule(it.key(), nextDeadline(it.value()));
+    }
+}
+
+qint64 IdleTracker::nextDeadline(const Entry &e) const
+{
+    return e.lastTick + (m_pingAfter > 0 && !e.pinged ? m_pingAfter : m_idleTimeout);
+}
+
+void IdleTracker::add(ConnectionId connection)
+{
+    Entry e;
+    e.lastTick = m_tick;
+    e.pinged = false;
+    m_entries.insert(connection, e);
+    if (isEnabled()) schedule(connection, nextDeadline(e));
+}
+
+void IdleTracker::remove(ConnectionId connection)
+{
+    // 轮上留下的位置在转到时查不到表项，顺手丢掉
+    m_entries.remove(connection);
+}
+
+void IdleTracker::touch(ConnectionId connection)
+{
+    auto it = m_entries.find(connection);
+    if (it == m_entries.end()) return;
+    it.value().lastTick = m_tick;
+    it.value().pinged = false;
+}
+
+void IdleTracker::clear()
+{
+    m_entries.clear();
+    for (QVector<Slot> &bucket : m_wheel) bucket.clear();
+}
+
+void IdleTracker::schedule(ConnectionId connection, qint64 deadline)
+{
+    // 至少排到下一格，避免在正处理的格子里打转
+    deadline = qMax(deadline, m_tick + 1);
+    Slot s;
+    s.connection = connection;
+    s.deadline = deadline;
+    m_wheel[static_cast<int>(deadline % m_wheel.size())].append(s);
+}
+
+QVector<IdleTracker::Due> IdleTracker::advance(qint64 nowSec)
+{
+    QVector<Due> due;
+    if (!isEnabled()) {
+        m_tick = qMax(m_tick, nowSec);
+        return due;
+    }
+
+    // 停顿太久（进程挂起）时只需补转一圈：每个格子都会被看到一次
+    if (nowSec - m_tick > m_wheel.size()) m_tick = nowSec - m_wheel.size();
+
+    while (m_tick < nowSec) {
+        ++m_tick;
+        QVector<Slot> bucket;
+        bucket.swap(m_wheel[static_cast<int>(m_tick % m_wheel.size())]);
+
+        for (const Slot &s : bucket) {
+            auto it = m_entries.find(s.connection);
+            if (it == m_entries.end()) continue;
+            if (s.deadline > m_tick) {
+                schedule(s.connection, s.deadline);   // 还差若干圈
+                continue;
+            }
+
+            Entry &e = it.value();
+            const qint64 idle = m_tick - e.lastTick;
+            if (idle >= m_idleTimeout) {
+                due.append(Due{s.connection, Expire});
+                m_entries.erase(it);
+            } else if (m_pingAfter > 0 && !e.pinged && idle >= m_pingAfter) {
+                e.pinged = true;
+                due.append(Due{s.connection, Ping});
+                schedule(s.connection, e.lastTick + m_idleTimeout);
+            } else {
+                // 期间有过活动：按最后活动时间重新排
+                schedule(s.connection, nextDeadline(e));
+            }
+        }
+    }
+    return due;
+}
@@ -0,0 +1,66 @@
+#ifndef IDLETRACKER_H
+#define IDLETRACKER_H
+
+#include <QHash>
+#include <QVector>
+#include "connectiontable.h"
+
+// 连接空闲检测：以秒为刻度的时间轮。
+// 收到数据时 touch 只记下当前刻度（一次查表 + 一次赋值），不挪动轮上的位置；
+// 轮转到某个格子时才检查里面的连接：没到期的按最后活动时间重新挂到后面的格子，
+// 每个连接在轮上始终只有一个位置。只在所属 JsonTcpServer 的线程里使用（分片各有一个）。
+//
+// 静默 pingAfter 秒后发一次 ping，静默 idleTimeout 秒后判定连接已死（半开连接）。
+// 默认两者都为 0（关闭）：不回 ping 的客户端不能靠它判断死活，由使用方确认后再开。
+class IdleTracker
+{
+public:
+    enum Action {
+        Ping,       // 该发心跳了
+        Expire      // 超时，应断开
+    };
+
+    struct Due {
+        ConnectionId connection;
+        Action action;
+    };
+
+    explicit IdleTracker(int wheelSize = 256);
+
+    // pingAfterSec 为 0 不发心跳；idleTimeoutSec 为 0 关闭超时检测
+    void setTimeouts(int pingAfterSec, int idleTimeoutSec);
+    int pingAfter() const { return m_pingAfter; }
+    int idleTimeout() const { return m_idleTimeout; }
+    bool isEnabled() const { return m_idleTimeout > 0; }
+
+    void add(ConnectionId connection);
+    void remove(ConnectionId connection);
+    void touch(ConnectionId connection);
+    void clear();
+    int size() const { return m_entries.size(); }
+
+    // 时钟推进到 nowSec（从 0 起的单调秒数），返回到期的连接；Expire 的连接已从表中移除
+    QVector<Due> advance(qint64 nowSec);
+
+private:
+    struct Entry {
+        qint64 lastTick;    // 最后一次活动的刻度
+        bool pinged;
+    };
+    // 连接号带代数，断开后留在轮上的旧位置查表时自然对不上
+    struct Slot {
+        ConnectionId connection;
+        qint64 deadline;    // 可能在轮的若干圈之后
+    };
+
+    void schedule(ConnectionId connection, qint64 deadline);
+    qint64 nextDeadline(const Entry &e) const;
+
+    QVector<QVector<Slot> > m_wheel;
+    QHash<ConnectionId, Entry> m_entries;
+    qint64 m_tick;
+    int m_pingAfter;
+    int m_idleTimeout;
+};
+
+#endif // IDLETRACKER_H
@@ -2,17 +2,126 @@
 #include <QDebug>
 #include <QThread>
 #include <QString>
-JsonHandle::JsonHandle(const QJsonDocument &request, QTcpSocket *clientSocket,
+JsonHandle::JsonHandle(const QJsonDocument &request, ConnectionId client,
                        SqlDataBase *database, QObject *parent )
     : QObject(parent)
     , m_request(request)
-    , m_clientSocket(clientSocket)
+    , m_client(client)
     , m_database(database)
+    , m_capture(false)
+    , m_responded(false)
 {
-    // 确保socket在正确的线程
-    if (m_clientSocket) {
-        m_clientSocket->setParent(this);
+    // 连接归 JsonTcpServer 管理，handle 只记连接号；连接先断开时应答在发送处被丢弃
+    const QString type = requestType();
+    m_priority = priorityOf(type);
+    m_slow = isSlowType(type);
+    m_age.start();
+}
+
+// 请求类型元数据：只登记非默认的类型
+struct RequestTypeInfo {
+    const char *type;
+    JsonHandle::Priority priority;
+    bool slow;
+    bool coalesce;      // 只读且结果只取决于请求参数：相同请求在途时合并执行
+};
+
+static const RequestTypeInfo kRequestTypes[] = {
+    //  type                  priority                   slow   coalesce
+    {"login",               JsonHandle::HighPriority,   false, false},
+    {"register",            JsonHandle::HighPriority,   false, false},
+    {"denglu",              JsonHandle::HighPriority,   false, false},
+    {"zhuce",               JsonHandle::HighPriority,   false, false},
+    {"appt.create",         JsonHandle::HighPriority,   false, false},
+    {"appt.cancel",         JsonHandle::HighPriority,   false, false},
+
+    {"department_list",     JsonHandle::NormalPriority, false, true},
+    {"doctor_list",         JsonHandle::NormalPriority, false, true},
+    {"everysecond",         JsonHandle::NormalPriority, false, true},
+    {"appt.list",           JsonHandle::NormalPriority, false, false},
+    {"record",              JsonHandle::NormalPriority, false, false},
+    {"record.list",         JsonHandle::NormalPriority, false, false},
+    {"health.submit",       JsonHandle::NormalPriority, false, false},
+    {"health.get",          JsonHandle::NormalPriority, false, false},
+    {"userinfo",            JsonHandle::NormalPriority, false, false},
+    {"change_user_info",    JsonHandle::NormalPriority, false, false},
+    {"change_passwd",       JsonHandle::NormalPriority, false, false},
+    {"message",             JsonHandle::NormalPriority, false, false},
+    {"xiaoxi1",             JsonHandle::NormalPriority, false, false},
+    {"qingjia",             JsonHandle::NormalPriority, false, false},
+    {"xiaban",              JsonHandle::NormalPriority, false, false},
+    {"shangban",            JsonHandle::NormalPriority, false, false},
+    {"yizhu",               JsonHandle::NormalPriority, false, false},
+    {"yuyue",               JsonHandle::NormalPriority, false, false},
+    {"xiugai",              JsonHandle::NormalPriority, false, false},
+
+    {"shuju",               JsonHandle::LowPriority,    true,  true},
+    {"kaoqin",              JsonHandle::LowPriority,    true,  false},
+    {"search",              JsonHandle::LowPriority,    true,  false},
+    {"admin.backup",        JsonHandle::LowPriority,    false, false},
+    {"admin.backup.status", JsonHandle::LowPriority,    false, false},
+    {"admin.export",        JsonHandle::LowPriority,    true,  false},
+    {"admin.trace",         JsonHandle::LowPriority,    false, false},
+    {"admin.sqlprofile",    JsonHandle::LowPriority,    false, false},
+};
+
+static const RequestTypeInfo *requestTypeInfo(const QString &type)
+{
+    for (const RequestTypeInfo &info : kRequestTypes) {
+        if (type == QLatin1String(info.type)) return &info;
     }
+    return nullptr;
+}
+
+JsonHandle::Priority JsonHandle::priorityOf(const QString &type)
+{
+    const RequestTypeInfo *info = requestTypeInfo(type);
+    return info ? info->priority : NormalPriority;
+}
+
+bool JsonHandle::isSlowType(const QString &type)
+{
+    const RequestTypeInfo *info = requestTypeInfo(type);
+    return info && info->slow;
+}
+
+bool JsonHandle::isCoalescedType(const QString &type)
+{
+    const RequestTypeInfo *info = requestTypeInfo(type);
+    return info && info->coalesce;
+}
+
+QString JsonHandle::traceType(const QString &type)
+{
+    return requestTypeInfo(type) ? type : QStringLiteral("unknown");
+}
+
+void JsonHandle::setTrace(const RequestTracePtr &trace)
+{
+    m_trace = trace;
+    if (m_trace) m_trace->type = traceType(requestType());
+}
+
+QString JsonHandle::requestType() const
+{
+    return m_request.object().value("type").toString();
+}
+
+void JsonHandle::reject(int retryAfterMs, const QString &reason)
+{
+    const QJsonObject object = m_request.object();
+
+    QJsonObject res;
+    res["ok"] = false;
+    res["busy"] = true;
+    res["error"] = reason;
+    res["retry_after_ms"] = retryAfterMs;
+    res["seq"] = object.value("seq");
+    res["type"] = object.value("type");
+
+    respond(res);
+    emit wrnLog(QString("%1 request rejected: %2, retry after %3 ms")
+                    .arg(object.value("type").toString(), reason).arg(retryAfterMs));
 }
 
 QString JsonHandle::currentTime()
@@ -22,7 +131,78 @@ QString JsonHandle::currentTime()
     return QString("[%1] ").arg(time);
 }
 
+// 全局的在途请求表：相同的可合并读请求共享一次执行
+static SingleFlight s_flights;
+
+QJsonObject JsonHandle::coalescingStats()
+{
+    return s_flights.stats();
+}
+
+void JsonHandle::respond(const QJsonObject &res)
+{
+    if (m_capture) {
+        m_captured = res;
+        m_responded = true;
+        return;
+    }
+    // 在工作线程序列化，网络线程只负责写
+    if (m_trace) m_trace->stamp(RequestTrace::HandlerEnd);
+    const QByteArray body = QJsonDocument(res).toJson(QJsonDocument::Compact);
+    if (m_trace) m_trace->stamp(RequestTrace::Serialize);
+    emit frameReady(m_client, body, res.value("type").toString(), m_trace);
+}
+
 void JsonHandle::query()
+{
+    const QJsonObject object = m_request.object();
+    const QString requestType = object.value("type").toString();
+
+    if (m_trace) m_trace->stamp(RequestTrace::HandlerStart);
+
+    if (!isCoalescedType(requestType)) {
+        dispatch();
+        emit processingFinished(this);
+        return;
+    }
+
+    // 键 = 去掉 seq 的请求（QJsonObject 键有序，紧凑序列化即规范形式）
+    QJsonObject params = object;
+    params.remove("seq");
+    const QString key = QString::fromUtf8(QJsonDocument(params).toJson(QJsonDocument::Compact));
+
+    if (!s_flights.join(key, m_client, object.value("seq"), m_trace)) {
+        emit log(requestType + " request coalesced");
+        emit processingFinished(this);
+        return;
+    }
+
+    m_capture = true;
+    m_responded = false;
+    dispatch();
+    m_capture = false;
+
+    // 序列化一次，按各自的 seq 拼好后分发给所有等待者
+    const bool hasSeq = m_captured.contains("seq");
+    m_captured.remove("seq");
+    const QByteArray body = QJsonDocument(m_captured).toJson(QJsonDocument::Compact);
+    const QList<SingleFlight::Waiter> waiters = s_flights.finish(key);
+    if (m_responded) {
+        // 跟随者的 HandlerStart 是挂上来的时刻，执行结束和序列化与领头者相同
+        const qint64 handlerEnd = RequestTrace::now();
+        for (const SingleFlight::Waiter &w : waiters) {
+            if (w.trace) {
+                w.trace->stampAt(RequestTrace::HandlerEnd, handlerEnd);
+                w.trace->stamp(RequestTrace::Serialize);
+            }
+            emit frameReady(w.client, hasSeq ? SingleFlight::withSeq(body, w.seq) : body,
+                            requestType, w.trace);
+        }
+    }
+    emit processingFinished(this);
+}
+
+void JsonHandle::dispatch()
 {
     // qDebug() << "Starting query processing on thread:" << QThread::currentThreadId();
 
@@ -50,7 +230,7 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "register"){//患者注册
@@ -74,7 +254,7 @@ void JsonHandle::query()
         qDebug() << "***** register *****";
         qDebug() << QJsonDocument(res).toJson();
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "appt.create"){//创建预约
@@ -97,15 +277,16 @@ void JsonHandle::query()
         // tmp.insert("symptom",sympptoms);
         // res["payload"] = tmp;
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "appt.list"){//查看预约
         qDebug() << "***** appt.list *****";
 
         qint64 patient_id = object.value("user_id").toInt();
+        bool include_archive = object.value("include_archive").toBool(false);
         qDebug() << "start appt.list";
-        res = m_database->listAppointments(patient_id);
+        res = m_database->listAppointments(patient_id, include_archive);
         qDebug() << "appt.list done";
 //        res["payload"] = arr;
 
@@ -119,7 +300,7 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "appt.cancel"){//取消预约
@@ -132,7 +313,7 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "record"){//病例查看
@@ -145,19 +326,70 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "record.list"){
         qDebug() << "***** record.list *****";
 
         qint64 user_id = object.value("user_id").toInt();
+        bool include_archive = object.value("include_archive").toBool(false);
+
+        res = m_database->listUserRecords(user_id, include_archive);
+        res["seq"] = object.value("seq");
+        res["type"] = object.value("type");
+
+        respond(res);
+        emit log("one request processed");
+    }
+    else if(requestType == "search"){//全文检索（病历/医嘱/消息）
+        qDebug() << "***** search *****";
+
+        qint64 user_id = object.value("user_id").toInt();
+        QString text = object.value("q").toString();
+        QString scope = object.value("scope").toString("all");
+        int page = object.value("page").toInt(1);
+        int page_size = object.value("page_size").toInt(20);
+
+        res = m_database->search(user_id, text, scope, page, page_size);
+        res["seq"] = object.value("seq");
+        res["type"] = object.value("type");
+
+        respond(res);
+        emit log("one request processed");
+    }
+    else if(requestType == "admin.backup" || requestType == "admin.backup.status"
+            || requestType == "admin.export" || requestType == "admin.trace"
+            || requestType == "admin.sqlprofile"){//在线备份 / 备份状态 / 快照导出 / 延迟分解 / SQL 剖析（仅 admin）
+        qDebug() << "*****" << requestType << "*****";
 
-        res = m_database->listUserRecords(user_id);
+        qint64 user_id = object.value("user_id").toInt();
+        if (!m_database->isAdmin(user_id)) {
+            res = QJsonObject{{"ok", false}, {"error", "permission denied"}};
+        } else if (requestType == "admin.backup") {
+            res = m_database->startBackup();
+        } else if (requestType == "admin.backup.status") {
+            res = m_database->backupStatus();
+        } else if (requestType == "admin.trace") {
+            if (object.contains("slow_threshold_ms")) {
+                RequestTracer::instance()->setSlowThresholdMs(object.value("slow_threshold_ms").toInt());
+            }
+            res = RequestTracer::instance()->snapshot();
+            res["ok"] = true;
+        } else if (requestType == "admin.sqlprofile") {
+            res = m_database->sqlProfile(object.value("action").toString("dump"),
+                                         object.value("sample_rate").toInt(-1),
+                                         object.value("plan_threshold_ms").toInt(-1),
+                                         object.value("limit").toInt(50));
+        } else {
+            QStringList tables;
+            for (const QJsonValue &v : object.value("tables").toArray()) tables << v.toString();
+            res = m_database->startExport(tables);
+        }
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "health.submit"){//健康评估
@@ -173,20 +405,21 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "health.get"){
         qDebug() << "***** health.get *****";
 
         qint64 user_id = object.value("user_id").toInt();
+        bool include_archive = object.value("include_archive").toBool(false);
 
-        m_database->getHealth(user_id);
+        res = m_database->getHealth(user_id, include_archive);
 
         res["type"] = object.value("type");
         res["seq"] = object.value("seq");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "userinfo"){//用户的个人信息
@@ -198,7 +431,7 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "department_list"){//科室名称列表
@@ -208,7 +441,7 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "doctor_list"){//当前科室所有医生信息
@@ -220,7 +453,7 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "change_user_info"){//修改用户信息
@@ -239,7 +472,7 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
 
     }
@@ -257,7 +490,7 @@ void JsonHandle::query()
         res["seq"] = object.value("seq");
         res["type"] = object.value("type");
 
-        emit responseReady(m_clientSocket, QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "message" || requestType == "xiaoxi1"){//聊天
@@ -280,7 +513,7 @@ void JsonHandle::query()
             object["content"] = text;
         }
 
-        emit responseReady(nullptr, QJsonDocument(object));
+        emit responseReady(0, QJsonDocument(object));
         emit log("one request processed");
     }
     else if(requestType == "qingjia"){//请假
@@ -295,7 +528,7 @@ void JsonHandle::query()
         res["type"] = "qingjia";
         res = m_database->vacation(doctor_id, beginTime, endTime, reason);
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "xiaban"){//下班打卡
@@ -307,7 +540,7 @@ void JsonHandle::query()
         res = m_database->offWork(user_id, time);
         res["type"] = "xiaban";
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "shangban"){//上班打卡
@@ -321,7 +554,7 @@ void JsonHandle::query()
 
         doctorOnline = true;
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "yizhu"){//开医嘱
@@ -334,7 +567,7 @@ void JsonHandle::query()
         res = m_database->doctorOrder(user_id, patient_id, order);
         res["type"] = "yizhu";
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "everysecond"){//刷新数据
@@ -350,7 +583,7 @@ void JsonHandle::query()
             patientInfoBuffer = res.value("patient").toArray();
         }
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "yuyue"){//查看预约
@@ -365,7 +598,7 @@ void JsonHandle::query()
         if(bufferIndex >= patientInfoBuffer.size()){
             bufferIndex = 0;
         }
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "shuju"){//数据
@@ -380,7 +613,7 @@ void JsonHandle::query()
         res["payload"] = payload;
         res["type"] = "shuju";
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "kaoqin"){//考勤
@@ -388,11 +621,12 @@ void JsonHandle::query()
 
         qint64 user_id = object.value("user_id").toInt(6);
         qint64 limit = object.value("limit").toInt(30);
+        bool include_archive = object.value("include_archive").toBool(false);
 
-        res = m_database->checkWork(user_id, limit);
+        res = m_database->checkWork(user_id, limit, include_archive);
         res["type"] = "kaoqin";
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "zhuce"){//医生注册
@@ -404,7 +638,7 @@ void JsonHandle::query()
         res = m_database->registerDoctor(name, passwd);
         res["type"] = "zhuce";
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "xiugai"){//医生修改
@@ -418,7 +652,7 @@ void JsonHandle::query()
         res = m_database->doctorModify(user_id, doctor_number, identity, passwd);
         res["type"] = "xiugai";
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else if(requestType == "denglu"){//医生登录
@@ -431,13 +665,12 @@ void JsonHandle::query()
         res = m_database->doctorSignIn(name, passwd, role);
         res["type"] = "denglu";
 
-        emit responseReady(m_clientSocket,QJsonDocument(res));
+        respond(res);
         emit log("one request processed");
     }
     else{
         emit log("receive one log request");
     }
-    //emit responseReady(m_clientSocket, m_request);
-    emit processingFinished(this);
+    //emit responseReady(m_client, m_request);
 }
 
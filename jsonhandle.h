@@ -5,30 +5,85 @@
 #include <QJsonObject>
 #include <QJsonDocument>
 #include "sqldatabase.h"
+#include "singleflight.h"
+#include "requesttrace.h"
 #include <QJsonArray>
-#include <QTcpSocket>
+#include "connectiontable.h"
 #include <QDateTime>
+#include <QElapsedTimer>
 
 class JsonHandle : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit JsonHandle(const QJsonDocument &request, QTcpSocket *clientSocket, SqlDataBase *database, QObject *parent = nullptr);
+    // 请求优先级：队列紧张时先丢低优先级
+    enum Priority {
+        HighPriority = 0,   // 登录、注册、预约
+        NormalPriority,
+        LowPriority,        // 统计、考勤历史、检索、备份导出
+        PriorityCount
+    };
+
+    // client 为发起请求的连接号，0 表示不回复到任何连接
+    explicit JsonHandle(const QJsonDocument &request, ConnectionId client, SqlDataBase *database, QObject *parent = nullptr);
 
     void query(); // 执行查询处理
 
+    // 拒绝该请求：立即回复 { ok:false, busy:true, retry_after_ms, error } ，不访问数据库
+    void reject(int retryAfterMs, const QString &reason);
+
+    QString requestType() const;
+    ConnectionId client() const { return m_client; }
+    Priority priority() const { return m_priority; }
+    // 创建（收到请求）至今的纳秒数，用于统计排队时间
+    qint64 ageNs() const { return m_age.nsecsElapsed(); }
+
+    // 各阶段时间戳，由网络层创建；可以为空
+    // 同时按请求类型填上 trace->type
+    void setTrace(const RequestTracePtr &trace);
+    RequestTracePtr trace() const { return m_trace; }
+
+    // 已知耗时长的请求（统计、历史、检索、导出）走单独的慢车道
+    bool isSlow() const { return m_slow; }
+
+    // 请求类型的元数据（优先级、是否慢请求），未登记的类型为 NormalPriority、非慢请求
+    static Priority priorityOf(const QString &type);
+    static bool isSlowType(const QString &type);
+    static bool isCoalescedType(const QString &type);
+    // trace / 指标里用的类型名：未登记的类型一律记为 unknown，客户端乱填的 type 不会撑大分类
+    static QString traceType(const QString &type);
+
+    // 合并统计：{ leaders, followers }
+    static QJsonObject coalescingStats();
+
 signals:
-    void responseReady(QTcpSocket *clientSocket,const QJsonDocument &response);
+    // client 为 0 表示广播
+    void responseReady(ConnectionId client,const QJsonDocument &response);
+    // 合并执行后分发的应答：已序列化的紧凑 JSON
+    // 单个请求的应答也在工作线程序列化后经此发出；trace 随帧带到写出为止
+    void frameReady(ConnectionId client, const QByteArray &body, const QString &type,
+                    const RequestTracePtr &trace);
     void processingFinished(JsonHandle *handle); // 处理完成信号，用于队列管理
     void log(const QString& logStr);
     void wrnLog(const QString& wrnStr);
 private:
     QJsonDocument m_request;
-    QTcpSocket *m_clientSocket;
+    ConnectionId m_client;
     SqlDataBase *m_database;
+    Priority m_priority;
+    bool m_slow;
+    QElapsedTimer m_age;
+    RequestTracePtr m_trace;
 
     QString currentTime();
+
+    // 按请求类型执行；应答统一经 respond() 发出
+    void dispatch();
+    void respond(const QJsonObject &res);
+    bool m_capture;            // 合并执行中：应答先截留，由 query() 统一分发
+    bool m_responded;
+    QJsonObject m_captured;
     QJsonArray patientInfoBuffer;
     int bufferIndex = 0;
     bool doctorOnline = false;
@@ -1,16 +1,41 @@
 #include "jsonhandlequeue.h"
 #include <QDateTime>
 #include <QDebug>
+#include <QRandomGenerator>
+#include "metrics.h"
+
+// 工作线程：只跑队列的主循环
+class JsonHandleWorker : public QThread
+{
+public:
+    JsonHandleWorker(JsonHandleQueue *queue, JsonHandleQueue::Worker *worker)
+        : m_queue(queue), m_worker(worker) {}
+
+protected:
+    void run() override { m_queue->workerLoop(m_worker); }
+
+private:
+    JsonHandleQueue *m_queue;
+    JsonHandleQueue::Worker *m_worker;
+};
 
 JsonHandleQueue::JsonHandleQueue(QObject *parent)
     : QObject(parent)
-    , m_processing(false)
+    , m_capacity(256)
+    , m_perClientLimit(16)
+    , m_pendingFast(0)
+    , m_pendingSlow(0)
+    , m_idleFast(0)
+    , m_busyWorkers(0)
     , m_shutdown(false)
-    , m_currentHandle(nullptr)
+    , m_accepted(0)
+    , m_shedClient(0)
+    , m_evicted(0)
+    , m_serviceMsAvg(5.0)
+    , m_queueWaitUsAvg(0.0)
 {
-    m_processTimer = new QTimer(this);
-    m_processTimer->setSingleShot(true);
-    connect(m_processTimer, &QTimer::timeout, this, &JsonHandleQueue::processNextHandle);
+    for (int p = 0; p < JsonHandle::PriorityCount; ++p) m_shed[p] = 0;
+    m_clock.start();
 }
 
 JsonHandleQueue::~JsonHandleQueue()
@@ -20,125 +45,393 @@ JsonHandleQueue::~JsonHandleQueue()
 }
 
 
-void JsonHandleQueue::enqueueHandle(JsonHandle *handle)
+bool JsonHandleQueue::enqueueHandle(JsonHandle *handle)
 {
     if (!handle) {
         qWarning() << "Attempted to enqueue null JsonHandle";
-        return;
+        return false;
+    }
+
+    if (m_workers.isEmpty()) startProcessing();
+    if (handle->trace()) handle->trace()->stamp(RequestTrace::Enqueue);
+
+    const JsonHandle::Priority prio = handle->priority();
+    const bool slow = handle->isSlow();
+    JsonHandle *evicted = nullptr;
+    QString rejectReason;
+    int pending;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        pending = pendingLocked();
+
+        // 各优先级的准入线：越低越早开始拒绝，形成平滑的降级曲线
+        int limit = m_capacity;
+        if (prio == JsonHandle::LowPriority) limit = m_capacity / 2;
+        else if (prio == JsonHandle::NormalPriority) limit = m_capacity * 9 / 10;
+
+        const ConnectionId client = handle->client();
+        if (client && m_perClient.value(client) >= m_perClientLimit) {
+            ++m_shedClient;
+            rejectReason = "too many requests from this client";
+        } else if (pending >= limit) {
+            // 满了还来高优先级：挤掉最新的一个低/普通请求
+            if (prio == JsonHandle::HighPriority) evicted = evictLocked();
+            if (evicted) {
+                ++m_evicted;
+                releaseClient(evicted->client());
+            } else {
+                ++m_shed[prio];
+                rejectReason = "server busy";
+            }
+        }
+
+        if (rejectReason.isEmpty()) {
+            if (client) ++m_perClient[client];
+            ++m_accepted;
+            if (slow) {
+                m_slowQueues[prio].enqueue(handle);
+                ++m_pendingSlow;
+                m_slowCondition.wakeOne();
+            } else {
+                ++m_pendingFast;     // 先占位，放入 deque 后再唤醒
+            }
+            pending = pendingLocked();
+        }
+    }
+
+    if (evicted) shed(evicted, "server busy");
+    if (!rejectReason.isEmpty()) {
+        shed(handle, rejectReason);
+        return false;
+    }
+
+    Metrics::add(Metrics::RequestsAdmitted);
+    if (evicted) Metrics::add(Metrics::RequestsDropped);
+    if (!slow) pushFast(handle);
+
+    emit queueStatusChanged(pending, true);
+    return true;
+}
+
+// 随机挑两个快车道线程，放进较短的 deque；高优先级放队头
+void JsonHandleQueue::pushFast(JsonHandle *handle)
+{
+    const QList<Worker*> &fast = m_fastWorkers;
+    Worker *target = fast.at(QRandomGenerator::global()->bounded(fast.size()));
+    if (fast.size() > 1) {
+        Worker *other = fast.at(QRandomGenerator::global()->bounded(fast.size()));
+        if (other->queued.load() < target->queued.load()) target = other;
+    }
+
+    {
+        QMutexLocker locker(&target->mutex);
+        if (handle->priority() == JsonHandle::HighPriority) target->deque.push_front(handle);
+        else target->deque.push_back(handle);
+        target->queued.store(static_cast<int>(target->deque.size()));
+    }
+
+    // 没有空闲的快车道线程时叫醒慢车道线程来偷
+    QMutexLocker locker(&m_mutex);
+    if (m_idleFast > 0) m_fastCondition.wakeOne();
+    else m_slowCondition.wakeOne();
+}
+
+// 调用方持有 m_mutex：从慢车道或某个 deque 的队尾取出最新的非高优先级请求
+JsonHandle *JsonHandleQueue::evictLocked()
+{
+    for (int p = JsonHandle::LowPriority; p > JsonHandle::HighPriority; --p) {
+        if (!m_slowQueues[p].isEmpty()) {
+            --m_pendingSlow;
+            return m_slowQueues[p].takeLast();
+        }
     }
+    for (Worker *w : m_workers) {
+        QMutexLocker locker(&w->mutex);
+        if (!w->deque.empty() && w->deque.back()->priority() != JsonHandle::HighPriority) {
+            JsonHandle *h = w->deque.back();
+            w->deque.pop_back();
+            w->queued.store(static_cast<int>(w->deque.size()));
+            --m_pendingFast;
+            return h;
+        }
+    }
+    return nullptr;
+}
 
+void JsonHandleQueue::setCapacity(int capacity)
+{
+    QMutexLocker locker(&m_mutex);
+    m_capacity = qMax(1, capacity);
+}
+
+void JsonHandleQueue::setPerClientLimit(int limit)
+{
+    QMutexLocker locker(&m_mutex);
+    m_perClientLimit = qMax(1, limit);
+}
+
+QJsonObject JsonHandleQueue::stats() const
+{
     QMutexLocker locker(&m_mutex);
-    m_queue.enqueue(handle);
-    qDebug() << "JsonHandle enqueued. Queue size:" << m_queue.size();
+    QJsonObject o;
+    o["pending"]       = pendingLocked();
+    o["pending_slow"]  = m_pendingSlow;
+    o["capacity"]      = m_capacity;
+    o["busy_workers"]  = m_busyWorkers;
+    o["accepted"]      = static_cast<qint64>(m_accepted);
+    o["shed_high"]     = static_cast<qint64>(m_shed[JsonHandle::HighPriority]);
+    o["shed_normal"]   = static_cast<qint64>(m_shed[JsonHandle::NormalPriority]);
+    o["shed_low"]      = static_cast<qint64>(m_shed[JsonHandle::LowPriority]);
+    o["shed_client"]   = static_cast<qint64>(m_shedClient);
+    o["evicted"]       = static_cast<qint64>(m_evicted);
+    o["service_ms"]    = m_serviceMsAvg;
+    o["queue_wait_us"] = m_queueWaitUsAvg;
 
-    // 如果没有正在处理且定时器未激活，立即开始处理
-    if (!m_processing && !m_processTimer->isActive() && m_currentHandle == nullptr) {
-        qDebug() << "Starting processing...";
-        startProcessing();  // 显式调用 startProcessing() 启动定时器
+    const qint64 now = m_clock.nsecsElapsed();
+    QJsonArray workers;
+    for (const Worker *w : m_workers) {
+        QJsonObject wo;
+        wo["id"]          = w->id;
+        wo["lane"]        = w->slowLane ? "slow" : "fast";
+        wo["queued"]      = w->queued.load();
+        wo["tasks"]       = static_cast<qint64>(w->tasks.load());
+        wo["steals"]      = static_cast<qint64>(w->steals.load());
+        wo["busy_ns"]     = static_cast<double>(w->busyNs.load());
+        wo["wall_ns"]     = static_cast<double>(now - w->startNs);
+        workers.append(wo);
     }
+    o["workers"] = workers;
+    return o;
+}
+
+// 按当前积压、工作线程数和平均处理耗时估算多久后再试
+int JsonHandleQueue::retryAfterMs() const
+{
+    QMutexLocker locker(&m_mutex);
+    const int workers = qMax(1, m_workers.size());
+    const double ms = (pendingLocked() + 1) * m_serviceMsAvg / workers;
+    return qBound(100, static_cast<int>(ms), 10000);
+}
+
+void JsonHandleQueue::shed(JsonHandle *handle, const QString &reason)
+{
+    handle->reject(retryAfterMs(), reason);
+    handle->deleteLater();
+}
 
-    emit queueStatusChanged(m_queue.size(), m_processing);
+// 调用方持有 m_mutex
+void JsonHandleQueue::releaseClient(ConnectionId client)
+{
+    if (!client) return;
+    auto it = m_perClient.find(client);
+    if (it == m_perClient.end()) return;
+    if (--it.value() <= 0) m_perClient.erase(it);
 }
 
 int JsonHandleQueue::pendingHandles() const
 {
     QMutexLocker locker(&m_mutex);
-    return m_queue.size();
+    return pendingLocked();
 }
 
 bool JsonHandleQueue::isProcessing() const
 {
-    return m_processing;
+    QMutexLocker locker(&m_mutex);
+    return m_busyWorkers > 0;
 }
 
-void JsonHandleQueue::startProcessing(int processingIntervalMs)
+void JsonHandleQueue::startProcessing(int fastWorkers, int slowWorkers)
 {
-    if (m_shutdown) {
-        qWarning() << "Cannot start processing after shutdown";
-        return;
+    if (!m_workers.isEmpty()) return;
+
+    if (fastWorkers <= 0) fastWorkers = qBound(2, QThread::idealThreadCount(), 8);
+    slowWorkers = qMax(1, slowWorkers);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_shutdown = false;
     }
 
-    m_processTimer->setInterval(processingIntervalMs);
-    m_processing = true;
+    const qint64 now = m_clock.nsecsElapsed();
+    for (int i = 0; i < fastWorkers + slowWorkers; ++i) {
+        Worker *w = new Worker;
+        w->id = i;
+        w->slowLane = i >= fastWorkers;
+        w->startNs = now;
+        w->thread = new JsonHandleWorker(this, w);
+        w->thread->setObjectName(QString("JsonHandleWorker-%1%2").arg(w->slowLane ? "slow-" : "").arg(i));
+        m_workers.append(w);
+        if (!w->slowLane) m_fastWorkers.append(w);
+    }
+    for (Worker *w : m_workers) w->thread->start();
 
-    // 确保定时器启动时，队列处理被执行
-    QMetaObject::invokeMethod(this, "processNextHandle", Qt::QueuedConnection);
+    qDebug() << "JsonHandleQueue started" << fastWorkers << "fast and" << slowWorkers << "slow workers";
 }
 
-
 void JsonHandleQueue::stopProcessing()
 {
-    m_processing = false;
-    m_processTimer->stop();
+    {
+        QMutexLocker locker(&m_mutex);
+        m_shutdown = true;
+        m_fastCondition.wakeAll();
+        m_slowCondition.wakeAll();
+    }
+    for (Worker *w : m_workers) w->thread->wait();
+
+    // 线程都退出了：剩在 deque 里的请求直接丢弃
+    QMutexLocker locker(&m_mutex);
+    for (Worker *w : m_workers) {
+        for (JsonHandle *handle : w->deque) handle->deleteLater();
+        delete w->thread;
+        delete w;
+    }
+    m_workers.clear();
+    m_fastWorkers.clear();
+    m_pendingFast = 0;
 }
 
 void JsonHandleQueue::clearQueue()
 {
     QMutexLocker locker(&m_mutex);
-    while (!m_queue.isEmpty()) {
-        JsonHandle *handle = m_queue.dequeue();
-        handle->deleteLater();
+    for (int p = 0; p < JsonHandle::PriorityCount; ++p) {
+        while (!m_slowQueues[p].isEmpty()) {
+            JsonHandle *handle = m_slowQueues[p].dequeue();
+            handle->deleteLater();
+            Metrics::add(Metrics::RequestsDropped);
+        }
+    }
+    m_pendingSlow = 0;
+    for (Worker *w : m_workers) {
+        QMutexLocker wl(&w->mutex);
+        m_pendingFast -= static_cast<int>(w->deque.size());
+        Metrics::add(Metrics::RequestsDropped, w->deque.size());
+        for (JsonHandle *handle : w->deque) handle->deleteLater();
+        w->deque.clear();
+        w->queued.store(0);
+    }
+    m_perClient.clear();
+}
+
+JsonHandle *JsonHandleQueue::popOwn(Worker *w)
+{
+    QMutexLocker locker(&w->mutex);
+    if (w->deque.empty()) return nullptr;
+    JsonHandle *h = w->deque.front();
+    w->deque.pop_front();
+    w->queued.store(static_cast<int>(w->deque.size()));
+    return h;
+}
+
+// 从积压最多的快车道线程的队尾偷一个
+JsonHandle *JsonHandleQueue::steal(Worker *thief)
+{
+    Worker *victim = nullptr;
+    int most = 0;
+    for (Worker *w : m_workers) {
+        if (w == thief || w->slowLane) continue;
+        const int n = w->queued.load();
+        if (n > most) {
+            most = n;
+            victim = w;
+        }
     }
-    m_condition.wakeAll();
+    if (!victim) return nullptr;
+
+    QMutexLocker locker(&victim->mutex);
+    if (victim->deque.empty()) return nullptr;
+    JsonHandle *h = victim->deque.back();
+    victim->deque.pop_back();
+    victim->queued.store(static_cast<int>(victim->deque.size()));
+    thief->steals.fetch_add(1);
+    return h;
 }
 
-void JsonHandleQueue::processNextHandle()
+// 调用方持有 m_mutex
+JsonHandle *JsonHandleQueue::popSlowLocked()
 {
-    // 如果在处理过程中不允许再调用，直接返回
-    if (m_shutdown || !m_processing) {
-        return;
+    for (int p = 0; p < JsonHandle::PriorityCount; ++p) {
+        if (!m_slowQueues[p].isEmpty()) {
+            --m_pendingSlow;
+            return m_slowQueues[p].dequeue();
+        }
     }
+    return nullptr;
+}
 
-    JsonHandle *nextHandle = nullptr;
-    bool hasHandle = false;
+void JsonHandleQueue::workerLoop(Worker *w)
+{
+    while (true) {
+        JsonHandle *handle = nullptr;
+        bool fromFast = true;
 
-    {
-        QMutexLocker locker(&m_mutex);
-        if (!m_queue.isEmpty()) {
-            nextHandle = m_queue.dequeue();
-            hasHandle = true;
-            m_currentHandle = nextHandle;
-            m_processing = true;  // 正在处理
+        if (w->slowLane) {
+            QMutexLocker locker(&m_mutex);
+            handle = popSlowLocked();
+            fromFast = handle == nullptr;
         } else {
-            m_processing = false;  // 队列空，停止处理
-            m_currentHandle = nullptr;
-            emit queueEmpty();
-            emit queueStatusChanged(0, false);
-            m_processTimer->stop();  // 停止定时器
-            return;
+            handle = popOwn(w);
+        }
+        if (!handle) handle = steal(w);
+
+        if (handle) {
+            runHandle(w, handle, fromFast);
+            continue;
         }
-    }//锁作用域
 
-    if (hasHandle && nextHandle) {
-        int cntOfHandle = pendingHandles();
-        qDebug() << "Processing JsonHandle. Remaining in queue:" << cntOfHandle;
-        //emit log("")
+        QMutexLocker locker(&m_mutex);
+        if (m_shutdown) break;
 
-        emit handleStarted(nextHandle);
-        emit queueStatusChanged(pendingHandles(), true);
+        // 计数先于 deque 变化（入队占位 / 出队后才减），短暂不一致时让出 CPU 重试
+        const bool hasWork = w->slowLane ? (m_pendingSlow > 0 || m_pendingFast > 0)
+                                         : m_pendingFast > 0;
+        if (hasWork) {
+            locker.unlock();
+            QThread::yieldCurrentThread();
+            continue;
+        }
 
-        // 使用 QtConcurrent 进行异步处理
-        QtConcurrent::run([this, nextHandle]() {
-            qDebug() << "Running query for handle" << nextHandle;
-            emit log("running query at : " +QString::asprintf("%p", static_cast<void*>(nextHandle)));
-            nextHandle->query();
-            emit handleCompleted(nextHandle);  // 完成后发射信号
-            // 处理完毕后，进行下一次处理
-            QMetaObject::invokeMethod(this, "processNextHandle", Qt::QueuedConnection);
-        });
+        if (w->slowLane) {
+            m_slowCondition.wait(&m_mutex);
+        } else {
+            ++m_idleFast;
+            m_fastCondition.wait(&m_mutex);
+            --m_idleFast;
+        }
     }
 }
 
-
-void JsonHandleQueue::cleanupHandle(JsonHandle *handle)
+void JsonHandleQueue::runHandle(Worker *w, JsonHandle *handle, bool fromFast)
 {
-    if (handle == m_currentHandle) {
-        m_currentHandle = nullptr;
+    bool drained;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (fromFast) --m_pendingFast;
+        ++m_busyWorkers;
+        m_queueWaitUsAvg = m_queueWaitUsAvg * 0.9 + handle->ageNs() / 1e3 * 0.1;
+        drained = pendingLocked() == 0;
     }
 
-    // 删除handle
+    if (drained) emit queueEmpty();
+    if (handle->trace()) handle->trace()->stamp(RequestTrace::Dequeue);
+    Metrics::add(Metrics::RequestsDequeued);
+    emit handleStarted(handle);
+
+    QElapsedTimer timer;
+    timer.start();
+    handle->query();
+    const qint64 ns = timer.nsecsElapsed();
+    w->busyNs.fetch_add(ns);
+    w->tasks.fetch_add(1);
+    Metrics::add(Metrics::RequestsExecuted);
+    Metrics::add(Metrics::WorkerBusyNs, static_cast<quint64>(ns));
+
+    const ConnectionId client = handle->client();
+    emit handleCompleted(handle);
+    // handle 属于主线程，由主线程的事件循环释放；之后不再访问
     handle->deleteLater();
-    qDebug() << "JsonHandle processing completed";
-    emit log("JsonHandle processing completed");
-    emit handleCompleted(handle); // 确保这个信号在完成后发射
+
+    QMutexLocker locker(&m_mutex);
+    --m_busyWorkers;
+    releaseClient(client);
+    m_serviceMsAvg = m_serviceMsAvg * 0.9 + ns / 1e6 * 0.1;
 }
@@ -3,12 +3,25 @@
 
 #include <QObject>
 #include <QQueue>
+#include <QHash>
+#include <QList>
+#include <QJsonObject>
+#include <QJsonArray>
 #include <QMutex>
 #include <QWaitCondition>
-#include <QTimer>
-#include <QtConcurrent/QtConcurrent> // 添加QtConcurrent支持
+#include <QThread>
+#include <QElapsedTimer>
+#include <atomic>
+#include <deque>
 #include "jsonhandle.h"
 
+class JsonHandleWorker;
+
+// 请求执行器：工作窃取（work-stealing）。
+// 每个快车道工作线程有自己的双端队列，入队时挑两个里较短的放入，
+// 高优先级放队头、其余放队尾；线程先取自己队头，空了去别人队尾偷。
+// 已知的慢请求（JsonHandle::isSlow）进单独的慢车道，只由慢车道线程执行，
+// 永远占不满全部线程；慢车道空闲时也会去快车道偷活。
 class JsonHandleQueue : public QObject
 {
     Q_OBJECT
@@ -17,13 +30,27 @@ public:
     explicit JsonHandleQueue(QObject *parent = nullptr);
     ~JsonHandleQueue();
 
-    // 添加JsonHandle到队列
-    void enqueueHandle(JsonHandle *handle);
+    // 添加JsonHandle到队列；超出容量或该客户端份额时立即回复“忙”并丢弃，返回 false
+    bool enqueueHandle(JsonHandle *handle);
+
+    // 准入控制：总容量与单个客户端（排队 + 执行中）上限
+    // 低优先级在队列达到 50% 时开始拒绝，普通在 90%，高优先级只在满时拒绝（并可挤掉低优先级）
+    void setCapacity(int capacity);
+    void setPerClientLimit(int limit);
+
+    // { pending, pending_slow, capacity, busy_workers, accepted, shed_high, shed_normal, shed_low,
+    //   shed_client, evicted, service_ms, queue_wait_us,
+    //   workers:[ { id, lane, queued, tasks, steals, busy_ns, wall_ns } ] }
+    // busy_ns 为该线程累计执行请求的时间，wall_ns 为线程启动以来的时间；都只增不减，
+    // 调用方对相邻两次取值求差得到这段时间的占用率，stats() 本身不留状态，可并发调用
+    QJsonObject stats() const;
 
     // 队列管理
     int pendingHandles() const;
     bool isProcessing() const;
-    void startProcessing(int processingIntervalMs = 50);
+    // 启动 fastWorkers 个快车道线程（<=0 时按 CPU 核数）和 slowWorkers 个慢车道线程
+    void startProcessing(int fastWorkers = 0, int slowWorkers = 2);
+    // 通知工作线程退出并等待当前请求执行完
     void stopProcessing();
     void clearQueue();
 
@@ -34,21 +61,66 @@ signals:
     void queueStatusChanged(int pendingCount, bool isProcessing);
     void log(const QString& logStr);
     void wrnLog(const QString& wrnStr);
-public slots:
-    void processNextHandle();
 
 private:
-    QQueue<JsonHandle*> m_queue;
-    mutable QMutex m_mutex;
-    QWaitCondition m_condition;
+    friend class JsonHandleWorker;
+
+    struct Worker {
+        int id = 0;
+        bool slowLane = false;
+        JsonHandleWorker *thread = nullptr;
+
+        QMutex mutex;                       // 只保护 deque
+        std::deque<JsonHandle*> deque;
+        std::atomic<int> queued{0};         // deque.size() 的无锁副本，入队选线程用
+
+        std::atomic<qint64> busyNs{0};      // 累计执行时间
+        std::atomic<quint64> tasks{0};
+        std::atomic<quint64> steals{0};
+        qint64 startNs = 0;                 // 线程启动时刻（m_clock），之后不变
+    };
+
+    QList<Worker*> m_workers;
+    QList<Worker*> m_fastWorkers;          // m_workers 中快车道的部分
+    QQueue<JsonHandle*> m_slowQueues[JsonHandle::PriorityCount];   // 慢车道，受 m_mutex 保护
+
+    int m_capacity;
+    int m_perClientLimit;
+    QHash<ConnectionId, int> m_perClient;  // 每个客户端排队 + 执行中的请求数
+    int m_pendingFast;                     // 快车道各 deque 中的总数
+    int m_pendingSlow;
+    int m_idleFast;                        // 正在等待的快车道线程数
+    int m_busyWorkers;
+    bool m_shutdown;
+
+    // 统计
+    quint64 m_accepted;
+    quint64 m_shed[JsonHandle::PriorityCount];
+    quint64 m_shedClient;
+    quint64 m_evicted;
+    double m_serviceMsAvg;                 // 单个请求处理耗时的滑动平均
+    double m_queueWaitUsAvg;               // 入队到开始执行的滑动平均
+    QElapsedTimer m_clock;
+
+    mutable QMutex m_mutex;                // 计数、慢车道、准入
+    QWaitCondition m_fastCondition;        // 快车道有新请求 / 要退出
+    QWaitCondition m_slowCondition;        // 慢车道（或可偷的快车道）有新请求 / 要退出
 
-    std::atomic<bool> m_processing;
-    std::atomic<bool> m_shutdown;
+    int pendingLocked() const { return m_pendingFast + m_pendingSlow; }
+    int retryAfterMs() const;
+    void shed(JsonHandle *handle, const QString &reason);
+    void releaseClient(ConnectionId client);
 
-    QTimer *m_processTimer;
-    JsonHandle *m_currentHandle;
+    void pushFast(JsonHandle *handle);
+    JsonHandle *evictLocked();
+    JsonHandle *popOwn(Worker *w);
+    JsonHandle *steal(Worker *thief);
+    JsonHandle *popSlowLocked();
 
-    void cleanupHandle(JsonHandle *handle);
+    // 工作线程主循环
+    void workerLoop(Worker *w);
+    // fromFast：取自快车道 deque（需要在这里扣减 m_pendingFast）
+    void runHandle(Worker *w, JsonHandle *handle, bool fromFast);
 };
 
 #endif // JSONHANDLEQUEUE_H
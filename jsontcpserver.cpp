@@ -1,24 +1,154 @@
 // jsontcpserver.cpp
 #include "jsontcpserver.h"
 
+#include <QtEndian>
+#include <QTimer>
+#include <QThread>
+#include <QStringList>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include "framecompressor.h"
+#include "metrics.h"
+#include "reuseportlistener.h"
+#include "trafficcapture.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <limits.h>
+#include <errno.h>
+#include <unistd.h>
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0      // macOS 等没有该标志，Qt 已忽略 SIGPIPE
+#endif
+#endif
+
+// 一次 writev 最多带的帧数（每帧两个 iovec）
+static const int kMaxFramesPerWritev = 64;
+
+// 压缩帧解开后的上限，防止解压炸弹
+static const int kMaxInflatedFrame = 64 * 1024 * 1024;
+
+// TCP（含 WebSocket）和本地套接字的连接状态、断开接口各不相同，按实际类型分派
+static bool deviceConnected(const QObject *device)
+{
+    if (const QAbstractSocket *s = qobject_cast<const QAbstractSocket *>(device))
+        return s->state() == QAbstractSocket::ConnectedState;
+    if (const QLocalSocket *s = qobject_cast<const QLocalSocket *>(device))
+        return s->state() == QLocalSocket::ConnectedState;
+    return false;
+}
+
+static QByteArray closeFrame(quint16 code, const QByteArray &reason)
+{
+    const QByteArray payload = WebSocketCodec::closePayload(code, reason);
+    return WebSocketCodec::frameHeader(WebSocketCodec::Close, payload.size(), false) + payload;
+}
+
+// 分片统计并进总数：计数相加，max_ 开头的取最大
+static void mergeCounters(QJsonObject &total, const QJsonObject &part, const QStringList &keys)
+{
+    for (const QString &key : keys) {
+        const double a = total.value(key).toDouble();
+        const double b = part.value(key).toDouble();
+        total[key] = key.startsWith("max_") ? qMax(a, b) : a + b;
+    }
+}
+
+static void abortDevice(QObject *device)
+{
+    if (QAbstractSocket *s = qobject_cast<QAbstractSocket *>(device)) s->abort();
+    else if (QLocalSocket *s = qobject_cast<QLocalSocket *>(device)) s->abort();
+}
+
+static void disconnectDevice(QObject *device)
+{
+    if (QAbstractSocket *s = qobject_cast<QAbstractSocket *>(device)) {
+        s->disconnectFromHost();
+        if (s->state() != QAbstractSocket::UnconnectedState) s->waitForDisconnected(1000);
+    } else if (QLocalSocket *s = qobject_cast<QLocalSocket *>(device)) {
+        s->disconnectFromServer();
+        if (s->state() != QLocalSocket::UnconnectedState) s->waitForDisconnected(1000);
+    }
+}
+
+static qintptr deviceDescriptor(const QIODevice *device)
+{
+    if (const QAbstractSocket *s = qobject_cast<const QAbstractSocket *>(device)) return s->socketDescriptor();
+    if (const QLocalSocket *s = qobject_cast<const QLocalSocket *>(device)) return s->socketDescriptor();
+    return -1;
+}
+
 
 JsonTcpServer::JsonTcpServer(QObject *parent)
     : QObject(parent)
     , tcpServer(nullptr)
+    , outLowWatermark(64 * 1024)
+    , outHighWatermark(256 * 1024)
+    , outHardLimit(4 * 1024 * 1024)
+    , outMaxQueued(0)
+    , outDroppedPushes(0)
+    , outCoalesced(0)
+    , outSlowDisconnects(0)
+    , flushScheduled(false)
+    , outFramesSent(0)
+    , outWritevCalls(0)
+    , outWritevFrames(0)
+    , outBufferedFrames(0)
+    , capture(nullptr)
+    , idleTimer(new QTimer(this))
+    , keepAliveIdle(60)
+    , keepAliveInterval(10)
+    , keepAliveCount(3)
+    , maxConnections(10000)
+    , connRejected(0)
+    , connTimedOut(0)
+    , pingsSent(0)
+    , pongsReceived(0)
+    , acceptThreads(1)
+    , listenGeneration(0)
+    , nextShardTag(1)
+    , captureForward(false)
+    , localServer(nullptr)
+    , webSocketServer(nullptr)
+    , wsRejectedOrigins(0)
+    , compressThreshold(1024)
 {
+    idleClock.start();
+    idleTimer->setInterval(1000);
+    connect(idleTimer, &QTimer::timeout, this, &JsonTcpServer::onIdleTick);
 }
 
 JsonTcpServer::~JsonTcpServer()
 {
     close();
+    stopCapture();
 }
 
 bool JsonTcpServer::start(QHostAddress hostAddr, quint16 port)
 {
-    if (tcpServer) {
+    if (isListening()) {
         close();
     }
 
+    if (acceptThreads > 1) {
+        QString error;
+        if (startSharded(hostAddr, port, &error)) {
+            if (idleTracker.isEnabled()) idleTimer->start();
+            emit log(QString("JSON TCP Server started on %1 : %2 with %3 SO_REUSEPORT listeners")
+                         .arg(hostAddr.toString()).arg(serverPort()).arg(acceptThreads));
+            return true;
+        }
+        // 开不了分片（平台不支持、端口被非 REUSEPORT 套接字占用等）时退回单个监听者
+        emit wrnLog(QString("SO_REUSEPORT listeners unavailable (%1), using a single listener").arg(error));
+    }
+
     tcpServer = new QTcpServer(this);
     connect(tcpServer, &QTcpServer::newConnection, this, &JsonTcpServer::onNewConnection);
 
@@ -32,6 +162,8 @@ bool JsonTcpServer::start(QHostAddress hostAddr, quint16 port)
         tcpServer = nullptr;
         return false;
     }
+    if (idleTracker.isEnabled()) idleTimer->start();
+
     // emit wrnLog("test1");
     // emit log("test2");
     emit log(QString("JSON TCP Server started on %1 : %2")
@@ -44,20 +176,12 @@ bool JsonTcpServer::start(QHostAddress hostAddr, quint16 port)
 
 void JsonTcpServer::close()
 {
-    if (tcpServer) {
-        tcpServer->close();
-
-        // 断开所有客户端连接
-        for (QTcpSocket *socket : clientBuffers.keys()) {
-            socket->disconnectFromHost();
-            if (socket->state() != QTcpSocket::UnconnectedState) {
-                socket->waitForDisconnected(1000);
-            }
-            socket->deleteLater();
-        }
-
-        clientBuffers.clear();
-        clientExpectedSizes.clear();
+    if (isListening()) {
+        if (tcpServer) tcpServer->close();
+        stopSharded();
+        closeLocal();
+        closeWebSocket();
+        disconnectAll();
 
         delete tcpServer;
         tcpServer = nullptr;
@@ -66,26 +190,65 @@ void JsonTcpServer::close()
     qDebug() << "JSON TCP Server stopped";
 }
 
-bool JsonTcpServer::sendToClient(QTcpSocket *clientSocket, const QJsonDocument &document)
+void JsonTcpServer::disconnectAll()
 {
-    if (!clientSocket || clientSocket->state() != QTcpSocket::ConnectedState) {
-        qWarning() << "Client socket is not connected";
-        emit wrnLog("Client socket is not connected");
-        return false;
+    // 断开所有客户端连接；断开时槽会被释放，这里遍历连接号的副本
+    const QList<ConnectionId> ids = clients.ids();
+    for (ConnectionId id : ids) {
+        Client *c = clients.find(id);
+        if (!c) continue;
+        QObject *endpoint = c->endpoint;
+        // WebSocket 连接先发关闭帧，浏览器据此区分服务端正常关闭和断网
+        if (c->webSocket && c->wsOpen && !c->wsClosing) {
+            c->socket->write(closeFrame(WebSocketCodec::kCloseGoingAway, "server shutting down"));
+        }
+        disconnectDevice(endpoint);
+        endpoint->deleteLater();
     }
 
-    if (!clientBuffers.contains(clientSocket)) {
+    clients.clear();
+    flushQueue.clear();
+    idleTracker.clear();
+    idleTimer->stop();
+}
+
+// 分片的连接转给它所在的 I/O 线程发送，连接号是否还有效在那边判断，这里只要转出去就返回 true
+bool JsonTcpServer::sendToClient(ConnectionId client, const QJsonDocument &document)
+{
+    if (JsonTcpServer *worker = shardOf(client)) {
+        return QMetaObject::invokeMethod(worker, "whileJsonNeedSend", Qt::QueuedConnection,
+                                         Q_ARG(ConnectionId, client), Q_ARG(QJsonDocument, document));
+    }
+
+    // 应答可能在客户端断开之后才到：连接号已失效，查表即可发现
+    const Client *c = clients.find(client);
+    if (!c) {
         qWarning() << "Client socket not found in connected clients";
         emit wrnLog("Client socket not found in connected clients");
         return false;
     }
 
-    return sendJsonToSocket(clientSocket, document);
+    if (!deviceConnected(c->endpoint)) {
+        qWarning() << "Client socket is not connected";
+        emit wrnLog("Client socket is not connected");
+        return false;
+    }
+
+    // 周期刷新类应答可以合并，只需送达最新一帧
+    const FrameKind kind = document.object().value("type").toString() == "everysecond"
+                               ? CoalescedFrame : ResponseFrame;
+    return sendJsonToSocket(client, document, kind);
 }
 
 bool JsonTcpServer::broadcast(const QJsonDocument &document)
 {
-    if (clientBuffers.isEmpty()) {
+    // 各分片广播自己的连接
+    for (JsonTcpServer *worker : shardWorkers) {
+        QMetaObject::invokeMethod(worker, "whileJsonNeedSend", Qt::QueuedConnection,
+                                  Q_ARG(ConnectionId, 0), Q_ARG(QJsonDocument, document));
+    }
+
+    if (clients.isEmpty()) {
         qDebug() << "No clients connected to broadcast";
         return true; // 没有客户端也算成功
     }
@@ -93,16 +256,16 @@ bool JsonTcpServer::broadcast(const QJsonDocument &document)
     bool allSuccess = true;
     int successCount = 0;
 
-    for (auto it = clientBuffers.begin(); it != clientBuffers.end(); ++it) {
-        QTcpSocket *socket = it.key();
-        if (socket->state() == QTcpSocket::ConnectedState) {
-            if (sendJsonToSocket(socket, document)) {
-                successCount++;
-            } else {
-                allSuccess = false;
-            }
+    // 只序列化一次；顺序扫连接表，慢客户端在发送时被断开只是把槽标成空闲
+    const QByteArray body = document.toJson(QJsonDocument::Compact);
+    clients.forEach([&](ConnectionId id, Client &c) {
+        if (!deviceConnected(c.endpoint)) return;
+        if (sendFrame(id, body, PushFrame, QString())) {
+            successCount++;
+        } else {
+            allSuccess = false;
         }
-    }
+    });
 
     qDebug() << "Broadcast to" << successCount << "clients, success:" << allSuccess;
     return allSuccess;
@@ -110,77 +273,492 @@ bool JsonTcpServer::broadcast(const QJsonDocument &document)
 
 int JsonTcpServer::clientCount() const
 {
-    return clientBuffers.size();
+    int count = clients.size();
+    for (const QJsonObject &s : collectShardStats(false))
+        count += s.value("connections").toObject().value("connections").toInt();
+    return count;
+}
+
+quint16 JsonTcpServer::serverPort() const
+{
+    if (tcpServer) return tcpServer->serverPort();
+    return shardListeners.isEmpty() ? 0 : shardListeners.first()->serverPort();
+}
+
+QList<ConnectionId> JsonTcpServer::connectedClients() const
+{
+    QList<ConnectionId> ids = clients.ids();
+    for (const QJsonObject &s : collectShardStats(true)) {
+        for (const QJsonValue &c : s.value("clients").toArray())
+            ids.append(c.toObject().value("id").toString().toULongLong());
+    }
+    return ids;
+}
+
+QTcpSocket *JsonTcpServer::clientSocket(ConnectionId client) const
+{
+    const Client *c = clients.find(client);
+    return c ? qobject_cast<QTcpSocket *>(c->endpoint) : nullptr;
+}
+
+QJsonArray JsonTcpServer::clientsSnapshot() const
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QJsonArray a;
+    clients.forEach([&](ConnectionId id, const Client &c) {
+        QJsonObject o;
+        o["id"]           = QString::number(id);     // 64 位，double 放不下
+        o["peer"]         = c.peer;
+        o["transport"]    = c.webSocket ? "websocket"
+                            : qobject_cast<const QLocalSocket *>(c.socket) ? "local" : "tcp";
+        o["connected_s"]  = (now - c.connectedMs) / 1000.0;
+        o["frames_in"]    = static_cast<qint64>(c.framesIn);
+        o["frames_out"]   = static_cast<qint64>(c.framesOut);
+        o["bytes_in"]     = static_cast<qint64>(c.bytesIn);
+        o["bytes_out"]    = static_cast<qint64>(c.bytesOut);
+        o["queued_bytes"] = queuedBytes(c);
+        o["compressed"]   = c.compress || c.wsDeflate;
+        a.append(o);
+    });
+    for (const QJsonObject &s : collectShardStats(true)) {
+        for (const QJsonValue &c : s.value("clients").toArray()) a.append(c);
+    }
+    return a;
+}
+
+void JsonTcpServer::setOutboundLimits(qint64 lowWatermark, qint64 highWatermark, qint64 hardLimit)
+{
+    outLowWatermark  = lowWatermark;
+    outHighWatermark = qMax(lowWatermark, highWatermark);
+    outHardLimit     = qMax(outHighWatermark, hardLimit);
 }
 
-QList<QTcpSocket*> JsonTcpServer::connectedClients() const
+QJsonObject JsonTcpServer::outboundStats() const
 {
-    return clientBuffers.keys();
+    qint64 total = 0;
+    int slow = 0;
+    clients.forEach([&](ConnectionId, const Client &c) {
+        total += queuedBytes(c);
+        if (c.outbound.slow) ++slow;
+    });
+
+    QJsonObject o;
+    o["queued_bytes"]     = total;
+    o["max_queued_bytes"] = outMaxQueued;
+    o["slow_clients"]     = slow;
+    o["dropped_pushes"]   = static_cast<qint64>(outDroppedPushes);
+    o["coalesced"]        = static_cast<qint64>(outCoalesced);
+    o["slow_disconnects"] = static_cast<qint64>(outSlowDisconnects);
+    o["frames_sent"]      = static_cast<qint64>(outFramesSent);
+    o["writev_calls"]     = static_cast<qint64>(outWritevCalls);
+    o["writev_frames"]    = static_cast<qint64>(outWritevFrames);
+    o["buffered_frames"]  = static_cast<qint64>(outBufferedFrames);
+    o["compressed_frames"]  = static_cast<qint64>(compressor.framesCompressed() + wsCompressor.messagesCompressed());
+    o["compress_in_bytes"]  = static_cast<qint64>(compressor.bytesIn() + wsCompressor.bytesIn());
+    o["compress_out_bytes"] = static_cast<qint64>(compressor.bytesOut() + wsCompressor.bytesOut());
+    for (const QJsonObject &s : collectShardStats(false)) {
+        const QJsonObject part = s.value("outbound").toObject();
+        mergeCounters(o, part, part.keys());
+    }
+    return o;
 }
 
-bool JsonTcpServer::sendJsonToSocket(QTcpSocket *socket, const QJsonDocument &document)
+void JsonTcpServer::setCompressionThreshold(int bytes)
 {
-    if (!socket || socket->state() != QTcpSocket::ConnectedState) {
+    compressThreshold = qMax(0, bytes);
+}
+
+void JsonTcpServer::setIdleTimeout(int pingAfterSec, int idleTimeoutSec)
+{
+    idleTracker.setTimeouts(pingAfterSec, idleTimeoutSec);
+    if (idleTracker.isEnabled() && isListening()) {
+        idleTimer->start();
+    } else {
+        idleTimer->stop();
+    }
+    for (JsonTcpServer *worker : shardWorkers) {
+        QMetaObject::invokeMethod(worker, "setIdleTimeout", Qt::QueuedConnection,
+                                  Q_ARG(int, pingAfterSec), Q_ARG(int, idleTimeoutSec));
+    }
+}
+
+void JsonTcpServer::setKeepAlive(int idleSec, int intervalSec, int count)
+{
+    keepAliveIdle     = qMax(0, idleSec);
+    keepAliveInterval = qMax(1, intervalSec);
+    keepAliveCount    = qMax(1, count);
+}
+
+void JsonTcpServer::setMaxConnections(int maxConnections)
+{
+    this->maxConnections = qMax(0, maxConnections);
+}
+
+QJsonObject JsonTcpServer::connectionStats() const
+{
+    QJsonObject o;
+    o["connections"]     = clients.size();
+    o["max_connections"] = maxConnections;
+    o["rejected"]        = static_cast<qint64>(connRejected);
+    o["timed_out"]       = static_cast<qint64>(connTimedOut);
+    o["pings_sent"]      = static_cast<qint64>(pingsSent);
+    o["pongs_received"]  = static_cast<qint64>(pongsReceived);
+    o["idle_timeout_s"]  = idleTracker.idleTimeout();
+    o["ping_after_s"]    = idleTracker.pingAfter();
+    o["local_socket"]    = localServer ? localServer->fullServerName() : QString();
+    o["websocket_port"]  = webSocketServer ? webSocketServer->serverPort() : 0;
+    o["websocket_rejected_origins"] = static_cast<double>(wsRejectedOrigins);
+    // max_connections 是总上限，不按分片相加
+    const QStringList counters = { "connections", "rejected", "timed_out", "pings_sent", "pongs_received" };
+    for (const QJsonObject &s : collectShardStats(false))
+        mergeCounters(o, s.value("connections").toObject(), counters);
+    return o;
+}
+
+bool JsonTcpServer::startCapture(const QString &path, QString *error)
+{
+    stopCapture();
+    TrafficCapture *c = new TrafficCapture;
+    if (!c->open(path, error)) {
+        delete c;
         return false;
     }
+    capture = c;
+    for (JsonTcpServer *worker : shardWorkers) worker->captureForward.store(true);
+    // 已连上的客户端在各自下一帧到来时补记 Open
+    emit log(QString("traffic capture started: %1").arg(path));
+    return true;
+}
+
+void JsonTcpServer::stopCapture()
+{
+    if (!capture) return;
+    for (JsonTcpServer *worker : shardWorkers) worker->captureForward.store(false);
+    capture->close();
+    const QJsonObject s = capture->stats();
+    emit log(QString("traffic capture stopped: %1, %2 frames, %3 bytes, %4 redacted, %5 dropped")
+                 .arg(s.value("path").toString())
+                 .arg(s.value("frames").toDouble(), 0, 'f', 0)
+                 .arg(s.value("bytes").toDouble(), 0, 'f', 0)
+                 .arg(s.value("redacted_frames").toDouble(), 0, 'f', 0)
+                 .arg(s.value("dropped_frames").toDouble(), 0, 'f', 0));
+    delete capture;
+    capture = nullptr;
+}
+
+bool JsonTcpServer::isCapturing() const
+{
+    return capture != nullptr;
+}
+
+QJsonObject JsonTcpServer::captureStats() const
+{
+    if (!capture) {
+        QJsonObject o;
+        o["capturing"] = false;
+        return o;
+    }
+    return capture->stats();
+}
+
+void JsonTcpServer::captureConnection(ConnectionId id, bool opened)
+{
+    if (capture) {
+        if (opened) capture->connectionOpened(id);
+        else capture->connectionClosed(id);
+    } else if (captureForward.load(std::memory_order_relaxed)) {
+        emit shardConnectionCaptured(id, opened);
+    }
+}
+
+void JsonTcpServer::captureFrame(ConnectionId id, const QByteArray &frame, const QJsonDocument *document)
+{
+    if (capture) {
+        capture->frameReceived(id, frame, document);
+    } else if (captureForward.load(std::memory_order_relaxed)) {
+        emit shardFrameCaptured(id, frame, document ? *document : QJsonDocument(), document != nullptr);
+    }
+}
+
+// 录制在分片转过来之前可能已经停了
+void JsonTcpServer::onShardConnectionCaptured(ConnectionId client, bool opened)
+{
+    captureConnection(client, opened);
+}
+
+void JsonTcpServer::onShardFrameCaptured(ConnectionId client, const QByteArray &frame,
+                                         const QJsonDocument &document, bool parsed)
+{
+    if (capture) capture->frameReceived(client, frame, parsed ? &document : nullptr);
+}
 
-    QByteArray jsonData = document.toJson(QJsonDocument::Compact);
+qint64 JsonTcpServer::bufferedBytes(const Client &client)
+{
+    return client.socket ? client.socket->bytesToWrite() : 0;
+}
 
-    // 使用长度前缀法：先发送4字节的数据长度，再发送数据
-    QByteArray packet;
-    QDataStream stream(&packet, QIODevice::WriteOnly);
-    stream.setVersion(QDataStream::Qt_5_10);
-    stream << static_cast<quint32>(jsonData.size());
-    packet.append(jsonData);
+// 一个连接的积压 = 套接字写缓冲 + 本地待发队列
+qint64 JsonTcpServer::queuedBytes(const Client &client)
+{
+    return bufferedBytes(client) + client.outbound.pendingBytes;
+}
 
-    qint64 bytesWritten = socket->write(packet);
-    if (bytesWritten == -1) {
-        qWarning() << "Write error to client" << socket->peerAddress().toString()
-        << ":" << socket->errorString();
-        emit wrnLog(QString("Write error to client %1 : %2")
-                        .arg(socket->peerAddress().toString()
-                        .arg(socket->errorString())));
+bool JsonTcpServer::sendJsonToSocket(ConnectionId id, const QJsonDocument &document, FrameKind kind)
+{
+    const Client *c = clients.find(id);
+    if (!c || !deviceConnected(c->endpoint)) {
         return false;
     }
 
-    if (bytesWritten != packet.size()) {
-        qWarning() << "Partial write to client" << socket->peerAddress().toString()
-        << ":" << bytesWritten << "of" << packet.size() << "bytes";
+    const QString key = kind == CoalescedFrame ? document.object().value("type").toString() : QString();
+    return sendFrame(id, document.toJson(QJsonDocument::Compact), kind, key);
+}
+
+bool JsonTcpServer::sendFrame(ConnectionId id, const QByteArray &body, FrameKind kind, const QString &key,
+                              const RequestTracePtr &trace)
+{
+    Client *c = clients.find(id);
+    if (!c) return false;
+
+    // 使用长度前缀法：4字节大端长度 + 数据；头和正文分开，不拼包。
+    // WebSocket 连接用帧头代替长度头，同样和正文分开进队列
+    OutFrame frame;
+    frame.body = body;
+    if (c->webSocket) {
+        // 握手完成前、发出关闭帧后都不能再发消息
+        if (!c->wsOpen || c->wsClosing) return false;
+        // 协商过 permessage-deflate 的连接：够大的消息压缩后发送，帧头 RSV1 置位
+        bool deflated = false;
+        if (c->wsDeflate && compressThreshold > 0 && body.size() >= compressThreshold) {
+            QByteArray packed;
+            if (wsCompressor.compress(body, &packed)) {
+                frame.body = packed;
+                deflated = true;
+            }
+        }
+        frame.header = WebSocketCodec::frameHeader(c->binaryMessages ? WebSocketCodec::Binary : WebSocketCodec::Text,
+                                                   frame.body.size(), deflated);
+    } else {
+        quint32 flags = 0;
+        // 协商过压缩的连接：够大的帧压缩后发送，长度头最高位置位；压不小的照原样发
+        if (c->compress && compressThreshold > 0 && body.size() >= compressThreshold) {
+            QByteArray packed;
+            if (compressor.compress(body, &packed)) {
+                frame.body = packed;
+                flags = FrameCompressor::kCompressedFlag;
+            }
+        }
+        frame.header.resize(sizeof(quint32));
+        qToBigEndian<quint32>(static_cast<quint32>(frame.body.size()) | flags,
+                              reinterpret_cast<uchar *>(frame.header.data()));
+    }
+    frame.kind = kind;
+    frame.key = key;
+    frame.trace = trace;
+    const qint64 frameSize = frame.size();
+
+    OutboundQueue &q = c->outbound;
+    const qint64 queued = queuedBytes(*c);
+
+    // 积压到硬上限：这个客户端已经跟不上，断开，防止拖垮服务器内存
+    if (queued + frameSize > outHardLimit) {
+        ++outSlowDisconnects;
+        qWarning() << "Slow client" << c->peer
+                   << "exceeded outbound limit:" << queued << "bytes queued, disconnecting";
+        emit wrnLog(QString("slow client %1 exceeded outbound limit (%2 bytes queued), disconnecting")
+                        .arg(c->peer).arg(queued));
+        q.pending.clear();
+        q.pendingBytes = 0;
+        abortDevice(c->endpoint);   // 同步发出 disconnected，c 随之失效
         return false;
     }
 
-    socket->flush();
-    qDebug() << "Sent JSON to client" << socket->peerAddress().toString()
-             << ", size:" << jsonData.size() << "bytes\n" << document.toJson();
+    if (queued >= outHighWatermark) {
+        q.slow = true;
+
+        if (kind == PushFrame) {
+            ++outDroppedPushes;
+            return false;
+        }
+
+        if (kind == CoalescedFrame) {
+            for (OutFrame &f : q.pending) {
+                if (f.kind == CoalescedFrame && f.key == frame.key) {
+                    q.pendingBytes += frameSize - f.size();
+                    f = frame;
+                    ++outCoalesced;
+                    return true;
+                }
+            }
+        }
+    }
+
+    q.pending.append(frame);
+    q.pendingBytes += frameSize;
+    outMaxQueued = qMax(outMaxQueued, queued + frameSize);
+
+    // 不立即写：本轮事件循环结束前同一连接的多帧一起写出（写缓冲为空时走一次 writev）
+    scheduleFlush(id, *c);
+
+    qDebug() << "Queued JSON to client" << c->peer
+             << ", size:" << frame.body.size() << "bytes";
     emit log(QString("sent json to client %1 ,size: %2 bytes")
-             .arg(socket->peerAddress().toString(),QString::number(jsonData.size())));
+             .arg(c->peer, QString::number(frame.body.size())));
     return true;
 }
 
-bool JsonTcpServer::sendRawJsonToSocket(QTcpSocket *socket, const QJsonDocument &document)
+void JsonTcpServer::frameSent(Client &client, const OutFrame &frame)
 {
-    if (!socket || socket->state() != QTcpSocket::ConnectedState) {
-        return false;
+    ++client.framesOut;
+    client.bytesOut += static_cast<quint64>(frame.size());
+    ++outFramesSent;
+    Metrics::add(Metrics::FramesSent);
+    Metrics::add(Metrics::BytesSent, static_cast<quint64>(frame.size()));
+    if (frame.trace) {
+        frame.trace->stamp(RequestTrace::Write);
+        RequestTracer::instance()->record(*frame.trace);
     }
+}
 
-    QByteArray jsonData = document.toJson(QJsonDocument::Compact);
-    qint64 bytesWritten = socket->write(jsonData);
-    if (bytesWritten == -1) {
-        qWarning() << "Write error to client" << socket->peerAddress().toString()
-        << ":" << socket->errorString();
-        return false;
+void JsonTcpServer::scheduleFlush(ConnectionId id, Client &client)
+{
+    if (!client.flushQueued) {
+        client.flushQueued = true;
+        flushQueue.append(id);
+    }
+    if (!flushScheduled) {
+        flushScheduled = true;
+        QMetaObject::invokeMethod(this, "flushPendingWrites", Qt::QueuedConnection);
     }
+}
 
-    if (bytesWritten != jsonData.size()) {
-        qWarning() << "Partial write to client" << socket->peerAddress().toString()
-        << ":" << bytesWritten << "of" << jsonData.size() << "bytes";
-        return false;
+void JsonTcpServer::flushPendingWrites()
+{
+    flushScheduled = false;
+    QVector<ConnectionId> ids;
+    ids.swap(flushQueue);
+    for (ConnectionId id : ids) {
+        // 排队后断开的连接，连接号已失效
+        if (Client *c = clients.find(id)) {
+            c->flushQueued = false;
+            drainOutbound(*c);
+        }
     }
+}
 
-    socket->flush();
-    qDebug() << "Sent JSON to client" << socket->peerAddress().toString()
-             << ", size:" << jsonData.size() << "bytes";
-    return true;
+void JsonTcpServer::writeVectored(Client &client)
+{
+#ifdef Q_OS_UNIX
+    QIODevice *socket = client.socket;
+    OutboundQueue &q = client.outbound;
+    // 本地套接字同样是流式描述符，writev 一样适用
+    const qintptr fd = deviceDescriptor(socket);
+    if (fd == -1) return;
+
+    int frames = qMin(q.pending.size(), qMin(kMaxFramesPerWritev, IOV_MAX / 2));
+    struct iovec iov[2 * kMaxFramesPerWritev];
+    int n = 0;
+    for (int i = 0; i < frames; ++i) {
+        const OutFrame &f = q.pending.at(i);
+        iov[n].iov_base = const_cast<char *>(f.header.constData());
+        iov[n].iov_len  = static_cast<size_t>(f.header.size());
+        ++n;
+        iov[n].iov_base = const_cast<char *>(f.body.constData());
+        iov[n].iov_len  = static_cast<size_t>(f.body.size());
+        ++n;
+    }
+
+    // sendmsg 带 iovec 即 writev，另加 MSG_NOSIGNAL 防止对端已关闭时收到 SIGPIPE
+    struct msghdr msg = {};
+    msg.msg_iov = iov;
+    msg.msg_iovlen = n;
+
+    ssize_t written;
+    do {
+        written = ::sendmsg(static_cast<int>(fd), &msg, MSG_NOSIGNAL);
+    } while (written < 0 && errno == EINTR);
+    ++outWritevCalls;
+
+    if (written < 0) {
+        // EAGAIN：内核发送缓冲已满，交给 QTcpSocket 缓冲，由写通知继续；
+        // 其他错误同样交给 QTcpSocket，让它走正常的错误/断开流程
+        return;
+    }
+
+    // 去掉已完整写出的帧；写了一半的帧把剩余部分放进 QTcpSocket 缓冲，保证顺序
+    qint64 left = written;
+    while (!q.pending.isEmpty() && left > 0) {
+        OutFrame &f = q.pending.first();
+        const qint64 size = f.size();
+        if (left >= size) {
+            left -= size;
+            q.pendingBytes -= size;
+            frameSent(client, f);
+            q.pending.removeFirst();
+            ++outWritevFrames;
+            continue;
+        }
+        const qint64 headLeft = qMax<qint64>(0, f.header.size() - left);
+        if (headLeft > 0) socket->write(f.header.constData() + (f.header.size() - headLeft), headLeft);
+        const qint64 bodyOff = qMax<qint64>(0, left - f.header.size());
+        socket->write(f.body.constData() + bodyOff, f.body.size() - bodyOff);
+        q.pendingBytes -= size;
+        frameSent(client, f);
+        q.pending.removeFirst();
+        ++outBufferedFrames;
+        left = 0;
+    }
+#else
+    Q_UNUSED(client);
+#endif
+}
+
+void JsonTcpServer::drainOutbound(Client &client)
+{
+    QIODevice *socket = client.socket;
+    OutboundQueue &q = client.outbound;
+    if (q.pending.isEmpty()) return;
+    if (!socket) return;
+
+    // QTcpSocket 缓冲为空时才能绕过它直接写描述符，否则会乱序
+    if (socket->bytesToWrite() == 0) {
+        writeVectored(client);
+    }
+
+    // 写缓冲低于高水位才继续灌，剩下的留在待发队列里（可被丢弃/合并）；
+    // 不调用 flush()，由 QTcpSocket 的写通知在事件循环里写出
+    while (!q.pending.isEmpty() && socket->bytesToWrite() < outHighWatermark) {
+        const OutFrame frame = q.pending.takeFirst();
+        q.pendingBytes -= frame.size();
+        ++outBufferedFrames;
+
+        if (socket->write(frame.header) == -1 || socket->write(frame.body) == -1) {
+            qWarning() << "Write error to client" << client.peer
+            << ":" << socket->errorString();
+            emit wrnLog(QString("Write error to client %1 : %2")
+                            .arg(client.peer, socket->errorString()));
+            q.pending.clear();
+            q.pendingBytes = 0;
+            return;
+        }
+        frameSent(client, frame);
+    }
+
+    if (q.slow && q.pending.isEmpty() && socket->bytesToWrite() <= outLowWatermark) {
+        q.slow = false;
+    }
+}
+
+// 内核取走了数据：写缓冲回落到低水位再继续灌，避免每写一点就唤醒一次
+void JsonTcpServer::onClientBytesWritten(ConnectionId id)
+{
+    Client *c = clients.find(id);
+    if (!c) {
+        return;
+    }
+    if (bufferedBytes(*c) <= outLowWatermark) {
+        drainOutbound(*c);
+    }
 }
 
 void JsonTcpServer::onNewConnection()
@@ -189,46 +767,120 @@ void JsonTcpServer::onNewConnection()
     if (!clientSocket) {
         return;
     }
+    addClient(clientSocket, QString("%1:%2").arg(clientSocket->peerAddress().toString())
+                                            .arg(clientSocket->peerPort()));
+}
+
+void JsonTcpServer::onNewLocalConnection()
+{
+    while (QLocalSocket *localSocket = localServer->nextPendingConnection()) {
+        // 默认挂在 QLocalServer 下，改挂到这里，关闭本地监听不连带删掉在线连接
+        localSocket->setParent(this);
+        // 本地连接没有对端地址，用描述符区分
+        addClient(localSocket, QString("local#%1").arg(localSocket->socketDescriptor()));
+    }
+}
+
+// 分片的监听者和分片在同一个 I/O 线程里，accept 到的描述符直接在这里包成套接字
+void JsonTcpServer::onDescriptorAccepted(qintptr descriptor, int listener, quint32 generation)
+{
+    Q_UNUSED(listener);
+    // 监听已关闭后才送到的连接，或不是本批监听者的连接：不接手
+    if (!tcpServer || generation != listenGeneration) {
+#ifdef Q_OS_UNIX
+        ::close(static_cast<int>(descriptor));
+#endif
+        return;
+    }
+    QTcpSocket *clientSocket = new QTcpSocket(this);
+    if (!clientSocket->setSocketDescriptor(descriptor)) {
+        qWarning() << "Cannot adopt accepted socket:" << clientSocket->errorString();
+        delete clientSocket;
+#ifdef Q_OS_UNIX
+        ::close(static_cast<int>(descriptor));
+#endif
+        return;
+    }
+    addClient(clientSocket, QString("%1:%2").arg(clientSocket->peerAddress().toString())
+                                            .arg(clientSocket->peerPort()));
+}
+
+void JsonTcpServer::onNewWebSocketConnection()
+{
+    // 连接挂到本对象下，监听者删除后仍然有效；握手在收到的第一段数据里完成
+    while (QTcpSocket *socket = webSocketServer->nextPendingConnection()) {
+        socket->setParent(this);
+        addClient(socket, QString("ws://%1:%2").arg(socket->peerAddress().toString())
+                                              .arg(socket->peerPort()), true);
+    }
+}
+
+void JsonTcpServer::addClient(QObject *clientSocket, const QString &clientInfo, bool webSocket)
+{
+    if (maxConnections > 0 && clients.size() >= maxConnections) {
+        rejectConnection(clientSocket, clientInfo, webSocket);
+        return;
+    }
 
-    QString clientInfo = QString("%1:%2")
-                             .arg(clientSocket->peerAddress().toString())
-                             .arg(clientSocket->peerPort());
+    Client *c;
+    const ConnectionId id = clients.insert(&c);
+    c->endpoint = clientSocket;
+    c->socket = qobject_cast<QIODevice *>(clientSocket);
+    c->webSocket = webSocket;
+    c->peer = clientInfo;
+    c->connectedMs = QDateTime::currentMSecsSinceEpoch();
 
-    connect(clientSocket, &QTcpSocket::readyRead, this, &JsonTcpServer::onClientReadyRead);
-    connect(clientSocket, &QTcpSocket::disconnected, this, &JsonTcpServer::onClientDisconnected);
+    // 连接号随信号连接一起记下，回调里不再用 sender() 反查
+    if (c->socket) {
+        connect(c->socket, &QIODevice::readyRead, this, [this, id]() { onClientReadyRead(id); });
+        connect(c->socket, &QIODevice::bytesWritten, this, [this, id]() { onClientBytesWritten(id); });
+    }
+    if (QTcpSocket *tcpSocket = qobject_cast<QTcpSocket *>(clientSocket)) {
+        connect(tcpSocket, &QTcpSocket::disconnected, this, [this, id]() { onClientDisconnected(id); });
+        applyKeepAlive(tcpSocket);
+    } else if (QLocalSocket *localSocket = qobject_cast<QLocalSocket *>(clientSocket)) {
+        connect(localSocket, &QLocalSocket::disconnected, this, [this, id]() { onClientDisconnected(id); });
+    }
 
-    clientBuffers[clientSocket] = QByteArray();
-    clientExpectedSizes[clientSocket] = 0;
+    idleTracker.add(id);
+    Metrics::add(Metrics::ConnectionsOpened);
+    captureConnection(id, true);
 
     emit log("client connected: "+ clientInfo);
 
     qDebug() << "Client connected:" << clientInfo;
 
-    emit clientConnected(clientSocket);
+    emit clientConnected(id);
 }
 
-void JsonTcpServer::onClientReadyRead()
+void JsonTcpServer::onClientReadyRead(ConnectionId id)
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
-    if (!socket || !clientBuffers.contains(socket)) {
+    Client *c = clients.find(id);
+    if (!c) {
         return;
     }
 
-    QByteArray &buffer = clientBuffers[socket];
-    buffer.append(socket->readAll());
-    processReceiveBuffer(socket);
+    const QByteArray data = c->socket->readAll();
+    idleTracker.touch(id);
+    c->bytesIn += static_cast<quint64>(data.size());
+    Metrics::add(Metrics::BytesReceived, static_cast<quint64>(data.size()));
+    c->buffer.append(data);
+    processReceiveBuffer(id);
 }
 
-void JsonTcpServer::processReceiveBuffer(QTcpSocket *socket)
+void JsonTcpServer::processReceiveBuffer(ConnectionId id)
 {
-    if (!clientBuffers.contains(socket) || !clientExpectedSizes.contains(socket)) {
+    const Client *client = clients.find(id);
+    if (client && client->webSocket) {
+        processWebSocketBuffer(id);
         return;
     }
 
-    QByteArray &buffer = clientBuffers[socket];
-    quint32 &expectedSize = clientExpectedSizes[socket];
+    // 每帧都重新查表：处理过程中（如发送错误应答）连接可能被断开
+    while (Client *c = clients.find(id)) {
+        QByteArray &buffer = c->buffer;
+        quint32 &expectedSize = c->expectedSize;
 
-    while (true) {
         if (expectedSize == 0) {
 
             // 需要读取数据长度
@@ -236,74 +888,682 @@ void JsonTcpServer::processReceiveBuffer(QTcpSocket *socket)
                 break; // 等待更多数据
             }
 
-            QDataStream stream(buffer);
-            stream.setVersion(QDataStream::Qt_5_10);
-            stream >> expectedSize;
+            expectedSize = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(buffer.constData()));
             buffer.remove(0, sizeof(quint32));
+            c->inboundCompressed = (expectedSize & FrameCompressor::kCompressedFlag) != 0;
+            expectedSize &= ~FrameCompressor::kCompressedFlag;
+            c->frameStart = RequestTrace::now();
 
-            qDebug() << "Expecting data size from client" << socket->peerAddress().toString()
+            qDebug() << "Expecting data size from client" << c->peer
                      << ":" << expectedSize << "bytes";
             emit log(QString("expecting data size from client %1 : %2 bytes")
-                    .arg(socket->peerAddress().toString(),QString::number(expectedSize)));
+                    .arg(c->peer, QString::number(expectedSize)));
         }
 
         // 检查是否收到完整数据
-        if (buffer.size() < expectedSize) {
+        if (static_cast<quint32>(buffer.size()) < expectedSize) {
             break; // 等待更多数据
         }
 
         // 提取完整JSON数据
         QByteArray jsonData = buffer.left(expectedSize);
         buffer.remove(0, expectedSize);
+        expectedSize = 0;
+        if (c->inboundCompressed) {
+            QByteArray plain;
+            if (!compressor.decompress(jsonData, &plain, kMaxInflatedFrame)) {
+                qWarning() << "Corrupt compressed frame from client" << c->peer;
+                Metrics::add(Metrics::ParseErrors);
+                QJsonObject errorResponse;
+                errorResponse["status"] = "error";
+                errorResponse["message"] = "Invalid compressed frame";
+                sendToClient(id, QJsonDocument(errorResponse));
+                continue;
+            }
+            jsonData = plain;
+        }
+        dispatchFrame(id, jsonData, c->frameStart);
+    }
+}
 
-        // 解析JSON
-        QJsonParseError error;
-        QJsonDocument document = QJsonDocument::fromJson(jsonData, &error);
+void JsonTcpServer::processWebSocketBuffer(ConnectionId id)
+{
+    // 每帧都重新查表：处理过程中（如回关闭帧）连接可能被断开
+    while (Client *c = clients.find(id)) {
+        // 已拒绝握手或已发出关闭帧：后面的数据不再处理，等对端断开
+        if (c->wsClosing) {
+            c->buffer.clear();
+            break;
+        }
+        if (!c->wsOpen) {
+            if (!acceptWebSocket(id)) break;
+            continue;
+        }
 
-        if (error.error != QJsonParseError::NoError) {
-            qWarning() << "JSON parse error from client" << socket->peerAddress().toString()
-            << ":" << error.errorString();
+        WebSocketCodec::Frame frame;
+        quint16 closeCode = 0;
+        QString error;
+        const WebSocketCodec::ParseResult result =
+            WebSocketCodec::parseFrame(c->buffer, &frame, kMaxInflatedFrame, &closeCode, &error);
+        if (result == WebSocketCodec::NeedMore) {
+            break; // 等待更多数据
+        }
+        if (result == WebSocketCodec::ProtocolError) {
+            qWarning() << "WebSocket protocol error from client" << c->peer << ":" << error;
+            Metrics::add(Metrics::ParseErrors);
+            closeWebSocketClient(*c, closeCode, error.toUtf8());
+            break;
+        }
+        handleWebSocketFrame(id, frame);
+    }
+}
 
-            // 发送错误响应
-            QJsonObject errorResponse;
-            errorResponse["status"] = "error";
-            errorResponse["message"] = "Invalid JSON format";
-            sendToClient(socket, QJsonDocument(errorResponse));
-        } else {
-            qDebug() << "Received JSON from client" << socket->peerAddress().toString()
-                     << ", size:" << jsonData.size() << "bytes\n" << document.toJson();
+// HTTP 升级握手。请求还没收全时返回 false 等待更多数据；拒绝时回 HTTP 错误后断开
+bool JsonTcpServer::acceptWebSocket(ConnectionId id)
+{
+    Client *c = clients.find(id);
+    const WebSocketCodec::Handshake handshake = WebSocketCodec::parseHandshake(c->buffer);
+    if (!handshake.complete) {
+        return false;
+    }
+
+    QTcpSocket *socket = static_cast<QTcpSocket *>(c->endpoint);
+    int status = handshake.status;
+    QString error = handshake.error;
+    // 浏览器总会带 Origin；没有 Origin 的是非浏览器客户端，不受限制
+    if (status == 0 && !handshake.origin.isEmpty() && !wsAllowedOrigins.contains(handshake.origin)) {
+        status = 403;
+        error = "origin not allowed";
+        ++wsRejectedOrigins;
+        emit wrnLog(QString("WebSocket handshake from origin %1 rejected").arg(handshake.origin));
+    }
+    if (status != 0) {
+        QJsonObject res;
+        res["ok"] = false;
+        res["error"] = error;
+        c->wsClosing = true;
+        c->buffer.clear();
+        socket->write(WebSocketCodec::errorResponse(status, QJsonDocument(res).toJson(QJsonDocument::Compact)));
+        socket->disconnectFromHost();   // 写缓冲为空时同步断开，c 随之失效
+        return false;
+    }
+
+    // 压缩阈值为 0 时不接受 permessage-deflate，客户端照常以不压缩的方式连上
+    c->wsOpen = true;
+    c->wsDeflate = handshake.deflate && compressThreshold > 0;
+    socket->write(WebSocketCodec::acceptResponse(handshake.key, c->wsDeflate));
+    return true;
+}
 
-            // 发起信号通知接收到JSON文档
-            emit jsonDocumentReceived(socket, document);
+void JsonTcpServer::handleWebSocketFrame(ConnectionId id, const WebSocketCodec::Frame &frame)
+{
+    Client *c = clients.find(id);
+    if (!c) {
+        return;
+    }
+
+    switch (frame.opcode) {
+    case WebSocketCodec::Ping:
+        sendWebSocketControl(id, WebSocketCodec::Pong, frame.payload);
+        return;
+    case WebSocketCodec::Pong:
+        return;     // 收到数据时已刷新空闲时间
+    case WebSocketCodec::Close: {
+        // 回同一个关闭码后断开；不能出现在帧里的关闭码按协议错误处理
+        quint16 code = WebSocketCodec::kCloseNormal;
+        if (frame.payload.size() >= 2) {
+            code = qFromBigEndian<quint16>(reinterpret_cast<const uchar *>(frame.payload.constData()));
+        }
+        if (frame.payload.size() == 1 || code < 1000 || (code >= 1004 && code <= 1006) || code == 1015) {
+            code = WebSocketCodec::kCloseProtocol;
         }
+        closeWebSocketClient(*c, code, QByteArray());
+        return;
+    }
+    default:
+        break;
+    }
 
-        expectedSize = 0;
+    // 数据帧：分片拼成完整消息；RSV1 只能出现在消息的第一帧，且只在协商过 permessage-deflate 时有效
+    if (frame.opcode == WebSocketCodec::Continuation) {
+        if (c->wsOpcode == 0 || frame.compressed) {
+            closeWebSocketClient(*c, WebSocketCodec::kCloseProtocol, "unexpected continuation frame");
+            return;
+        }
+        if (c->wsMessage.size() + frame.payload.size() > kMaxInflatedFrame) {
+            closeWebSocketClient(*c, WebSocketCodec::kCloseTooBig, "message too big");
+            return;
+        }
+        c->wsMessage += frame.payload;
+    } else {
+        if (c->wsOpcode != 0) {
+            closeWebSocketClient(*c, WebSocketCodec::kCloseProtocol, "expected continuation frame");
+            return;
+        }
+        if (frame.compressed && !c->wsDeflate) {
+            closeWebSocketClient(*c, WebSocketCodec::kCloseProtocol, "compressed frame without permessage-deflate");
+            return;
+        }
+        c->wsOpcode = frame.opcode;
+        c->wsCompressed = frame.compressed;
+        c->wsMessage = frame.payload;
+        c->frameStart = RequestTrace::now();
+    }
+    if (!frame.fin) {
+        return;
+    }
+
+    QByteArray message;
+    message.swap(c->wsMessage);
+    const bool binary = c->wsOpcode == WebSocketCodec::Binary;
+    const bool compressed = c->wsCompressed;
+    c->wsOpcode = 0;
+    c->wsCompressed = false;
+    if (compressed) {
+        QByteArray plain;
+        if (!wsCompressor.decompress(message, &plain, kMaxInflatedFrame)) {
+            qWarning() << "Corrupt compressed message from client" << c->peer;
+            Metrics::add(Metrics::ParseErrors);
+            closeWebSocketClient(*c, WebSocketCodec::kCloseInvalidData, "corrupt compressed message");
+            return;
+        }
+        message = plain;
+    }
+    // 按客户端最近一次请求的消息类型（文本/二进制）回
+    c->binaryMessages = binary;
+    dispatchFrame(id, message, c->frameStart);
+}
+
+// 控制帧和数据帧一样进出站队列，保持顺序
+void JsonTcpServer::sendWebSocketControl(ConnectionId id, int opcode, const QByteArray &payload)
+{
+    Client *c = clients.find(id);
+    if (!c || !c->wsOpen || c->wsClosing) {
+        return;
+    }
+    // 积压时不回 pong：对端只关心最近一个，也免得 ping 洪水撑大队列
+    if (opcode == WebSocketCodec::Pong && queuedBytes(*c) >= outHighWatermark) {
+        return;
+    }
+    OutFrame frame;
+    frame.header = WebSocketCodec::frameHeader(opcode, payload.size(), false);
+    frame.body = payload;
+    frame.kind = ResponseFrame;
+    c->outbound.pending.append(frame);
+    c->outbound.pendingBytes += frame.size();
+    scheduleFlush(id, *c);
+}
+
+// 关闭帧之后不能再发数据帧：丢掉还没交给套接字的帧，关闭帧直接写入套接字。
+// 写缓冲发完才真正断开；缓冲为空时同步发出 disconnected，返回后 client 可能已失效
+void JsonTcpServer::closeWebSocketClient(Client &client, quint16 code, const QByteArray &reason)
+{
+    if (client.wsOpen && !client.wsClosing) {
+        client.outbound.pending.clear();
+        client.outbound.pendingBytes = 0;
+        client.socket->write(closeFrame(code, reason));
+    }
+    client.wsClosing = true;
+    client.buffer.clear();
+    static_cast<QTcpSocket *>(client.endpoint)->disconnectFromHost();
+}
+
+void JsonTcpServer::dispatchFrame(ConnectionId id, const QByteArray &jsonData, qint64 frameStart)
+{
+    Client *c = clients.find(id);
+    if (!c) {
+        return;
+    }
+    ++c->framesIn;
+    const QString peer = c->peer;
+
+    // 解析JSON
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson(jsonData, &error);
+    Metrics::add(Metrics::FramesReceived);
+    captureFrame(id, jsonData, error.error == QJsonParseError::NoError ? &document : nullptr);
+
+    if (error.error != QJsonParseError::NoError) {
+        qWarning() << "JSON parse error from client" << peer
+        << ":" << error.errorString();
+        Metrics::add(Metrics::ParseErrors);
+
+        // 发送错误响应
+        QJsonObject errorResponse;
+        errorResponse["status"] = "error";
+        errorResponse["message"] = "Invalid JSON format";
+        sendToClient(id, QJsonDocument(errorResponse));
+    } else if (document.isObject()
+               && (handleHeartbeat(id, document.object()) || handleCompression(id, document.object()))) {
+        // 心跳、压缩协商不进请求队列
+    } else {
+        qDebug() << "Received JSON from client" << peer
+                 << ", size:" << jsonData.size() << "bytes\n" << document.toJson();
+
+        RequestTracePtr trace(new RequestTrace);
+        // trace->type 由 JsonHandle::setTrace() 按登记的请求类型填写，不直接用客户端给的字符串
+        trace->stampAt(RequestTrace::Receive, frameStart);
+        trace->stamp(RequestTrace::Parse);
+
+        // 发起信号通知接收到JSON文档
+        emit jsonDocumentReceived(id, document, trace);
+    }
+}
+
+void JsonTcpServer::onClientDisconnected(ConnectionId id)
+{
+    Client *c = clients.find(id);
+    if (!c) {
+        return;
+    }
+
+    QObject *endpoint = c->endpoint;
+    const QString clientInfo = c->peer;
+
+    // 释放槽：缓冲、出站队列一起清掉，连接号从此失效
+    clients.remove(id);
+    idleTracker.remove(id);
+    Metrics::add(Metrics::ConnectionsClosed);
+    captureConnection(id, false);
+
+    qDebug() << "Client disconnected:" << clientInfo;
+    emit clientDisconnected(id);
+
+    endpoint->deleteLater();
+}
+
+void JsonTcpServer::setAcceptThreads(int threads)
+{
+    acceptThreads = qMax(1, threads);
+}
+
+bool JsonTcpServer::isListening() const
+{
+    return tcpServer || !shardWorkers.isEmpty() || localServer || webSocketServer;
+}
+
+bool JsonTcpServer::listenWebSocket(const QHostAddress &address, quint16 port)
+{
+    closeWebSocket();
+
+    QTcpServer *server = new QTcpServer(this);
+    if (!server->listen(address, port)) {
+        emit wrnLog(QString("WebSocket gateway could not listen on %1 : %2: %3")
+                        .arg(address.toString()).arg(port).arg(server->errorString()));
+        delete server;
+        return false;
+    }
+    connect(server, &QTcpServer::newConnection, this, &JsonTcpServer::onNewWebSocketConnection);
+    webSocketServer = server;
+    if (idleTracker.isEnabled()) idleTimer->start();
+
+    emit log(QString("WebSocket gateway listening on %1 : %2")
+                 .arg(address.toString()).arg(server->serverPort()));
+    return true;
+}
+
+void JsonTcpServer::setWebSocketAllowedOrigins(const QStringList &origins)
+{
+    wsAllowedOrigins = origins;
+}
+
+void JsonTcpServer::closeWebSocket()
+{
+    if (!webSocketServer) return;
+    webSocketServer->close();
+    delete webSocketServer;
+    webSocketServer = nullptr;
+
+    // 已建立的连接挂在本对象下，不随监听者删除：逐个发关闭帧后断开，握手还没完成的直接断开
+    const QList<ConnectionId> ids = clients.ids();
+    for (ConnectionId id : ids) {
+        Client *c = clients.find(id);
+        if (!c || !c->webSocket) continue;
+        closeWebSocketClient(*c, WebSocketCodec::kCloseGoingAway, "gateway closed");
+    }
+}
+
+bool JsonTcpServer::listenLocal(const QString &name)
+{
+    closeLocal();
+
+    QLocalServer *server = new QLocalServer(this);
+    // 同组用户（反向代理、报表任务）可连
+    server->setSocketOptions(QLocalServer::UserAccessOption | QLocalServer::GroupAccessOption);
+    // 上次异常退出残留的套接字文件会让 listen 失败
+    QLocalServer::removeServer(name);
+    if (!server->listen(name)) {
+        emit wrnLog(QString("local socket %1 could not listen: %2").arg(name, server->errorString()));
+        delete server;
+        return false;
+    }
+    connect(server, &QLocalServer::newConnection, this, &JsonTcpServer::onNewLocalConnection);
+    localServer = server;
+    if (idleTracker.isEnabled()) idleTimer->start();
+
+    emit log(QString("JSON server also listening on local socket %1").arg(server->fullServerName()));
+    return true;
+}
+
+void JsonTcpServer::closeLocal()
+{
+    if (!localServer) return;
+    localServer->close();       // 已建立的本地连接不受影响，随 close() 一起断开
+    delete localServer;
+    localServer = nullptr;
+}
+
+bool JsonTcpServer::startSharded(const QHostAddress &hostAddr, quint16 port, QString *error)
+{
+    if (!ReusePortListener::isSupported()) {
+        *error = "not supported on this platform";
+        return false;
+    }
+    qRegisterMetaType<qintptr>("qintptr");
+
+    ++listenGeneration;
+    const QString addressText = hostAddr == QHostAddress::Any ? QString() : hostAddr.toString();
+    const int shardMaxConnections = maxConnections > 0 ? (maxConnections + acceptThreads - 1) / acceptThreads : 0;
+    quint16 boundPort = port;
+    for (int i = 0; i < acceptThreads; ++i) {
+        // 分片连同连接表、出站队列、空闲时间轮整个归一个 I/O 线程；设置在移过去之前复制好
+        JsonTcpServer *worker = new JsonTcpServer;
+        worker->setOutboundLimits(outLowWatermark, outHighWatermark, outHardLimit);
+        worker->setKeepAlive(keepAliveIdle, keepAliveInterval, keepAliveCount);
+        worker->setIdleTimeout(idleTracker.pingAfter(), idleTracker.idleTimeout());
+        worker->setCompressionThreshold(compressThreshold);
+        worker->setMaxConnections(shardMaxConnections);
+        worker->clients.setTag(nextShardTag);
+        nextShardTag = nextShardTag % ConnectionTable<Client>::kMaxTag + 1;
+        worker->captureForward.store(capture != nullptr);
+
+        QThread *thread = new QThread;
+        thread->setObjectName(QString("shard-%1").arg(i));
+        worker->moveToThread(thread);
+        // 分片的套接字、定时器都要在它自己的线程里删
+        connect(thread, &QThread::finished, worker, &QObject::deleteLater);
+        connect(worker, &JsonTcpServer::jsonDocumentReceived, this, &JsonTcpServer::jsonDocumentReceived);
+        connect(worker, &JsonTcpServer::clientConnected, this, &JsonTcpServer::clientConnected);
+        connect(worker, &JsonTcpServer::clientDisconnected, this, &JsonTcpServer::clientDisconnected);
+        connect(worker, &JsonTcpServer::errorOccurred, this, &JsonTcpServer::errorOccurred);
+        connect(worker, &JsonTcpServer::log, this, &JsonTcpServer::log);
+        connect(worker, &JsonTcpServer::wrnLog, this, &JsonTcpServer::wrnLog);
+        connect(worker, &JsonTcpServer::shardConnectionCaptured, this, &JsonTcpServer::onShardConnectionCaptured);
+        connect(worker, &JsonTcpServer::shardFrameCaptured, this, &JsonTcpServer::onShardFrameCaptured);
+        thread->start();
+        shardWorkers.append(worker);
+        shardThreads.append(thread);
+
+        // 监听套接字和之后接入的连接，通知器都要建在分片自己的线程里
+        QString failure;
+        QMetaObject::invokeMethod(worker, "listenShard", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(QString, failure),
+                                  Q_ARG(QString, addressText), Q_ARG(quint16, boundPort),
+                                  Q_ARG(int, i), Q_ARG(quint32, listenGeneration));
+        if (!failure.isEmpty()) {
+            *error = failure;
+            stopSharded();
+            return false;
+        }
+        ReusePortListener *listener = static_cast<ReusePortListener *>(worker->tcpServer);
+        shardListeners.append(listener);
+        // 传 0 时第一个监听者拿到的端口给其余的共用
+        if (i == 0) boundPort = listener->serverPort();
+    }
+    return true;
+}
+
+void JsonTcpServer::stopSharded()
+{
+    for (int i = 0; i < shardWorkers.size(); ++i) {
+        JsonTcpServer *worker = shardWorkers.at(i);
+        QThread *thread = shardThreads.at(i);
+        QMetaObject::invokeMethod(worker, "closeShard", Qt::BlockingQueuedConnection);
+        disconnect(worker, nullptr, this, nullptr);     // 析构时的 stopped 日志不再转过来
+        thread->quit();
+        thread->wait();         // 线程结束时分片随 deleteLater 删除
+        delete thread;
+    }
+    shardWorkers.clear();
+    shardListeners.clear();
+    shardThreads.clear();
+}
+
+QString JsonTcpServer::listenShard(const QString &addressText, quint16 port, int index, quint32 generation)
+{
+    ReusePortListener *listener = new ReusePortListener(index, generation, this);
+    if (!listener->listenShared(addressText, port)) {
+        const QString error = listener->lastError();
+        delete listener;
+        return error;
+    }
+    // 同一线程，直连：accept 之后就地包装套接字
+    connect(listener, &ReusePortListener::descriptorAccepted, this, &JsonTcpServer::onDescriptorAccepted);
+    tcpServer = listener;
+    listenGeneration = generation;
+    if (idleTracker.isEnabled()) idleTimer->start();
+    return QString();
+}
+
+void JsonTcpServer::closeShard()
+{
+    if (tcpServer) tcpServer->close();
+    disconnectAll();
+    delete tcpServer;
+    tcpServer = nullptr;
+}
+
+QJsonObject JsonTcpServer::shardStats(bool withClients) const
+{
+    QJsonObject o;
+    o["connections"] = connectionStats();
+    o["outbound"]    = outboundStats();
+    if (withClients) o["clients"] = clientsSnapshot();
+    return o;
+}
+
+QList<QJsonObject> JsonTcpServer::collectShardStats(bool withClients) const
+{
+    QList<QJsonObject> out;
+    for (JsonTcpServer *worker : shardWorkers) {
+        QJsonObject s;
+        QMetaObject::invokeMethod(worker, "shardStats", Qt::BlockingQueuedConnection,
+                                  Q_RETURN_ARG(QJsonObject, s), Q_ARG(bool, withClients));
+        out.append(s);
+    }
+    return out;
+}
+
+JsonTcpServer *JsonTcpServer::shardOf(ConnectionId id) const
+{
+    const quint32 tag = ConnectionTable<Client>::tagOf(id);
+    if (tag == clients.tag()) return nullptr;
+    for (JsonTcpServer *worker : shardWorkers) {
+        if (worker->clients.tag() == tag) return worker;
+    }
+    return nullptr;
+}
+
+QJsonArray JsonTcpServer::listenerStats() const
+{
+    QJsonArray a;
+    for (const ReusePortListener *listener : shardListeners) a.append(listener->stats());
+    return a;
+}
+
+bool JsonTcpServer::handleHeartbeat(ConnectionId id, const QJsonObject &object)
+{
+    const QString type = object.value("type").toString();
+    if (type == "pong") {
+        ++pongsReceived;        // 活动时间已在收到数据时刷新
+        return true;
     }
+    if (type != "ping") return false;
+
+    // 客户端探测服务器是否还活着：原样带回 seq
+    QJsonObject pong;
+    pong["type"] = "pong";
+    pong["seq"] = object.value("seq");
+    pong["ts"] = QDateTime::currentMSecsSinceEpoch();
+    sendFrame(id, QJsonDocument(pong).toJson(QJsonDocument::Compact), ResponseFrame, QString());
+    return true;
 }
 
-void JsonTcpServer::onClientDisconnected()
+// 压缩协商：{"type":"compress","algorithms":["deflate"],"dictionary":"s0d1"}，
+// 应答带上实际启用的算法、字典版本和阈值；"algorithms":[] 或 "none" 关闭
+bool JsonTcpServer::handleCompression(ConnectionId id, const QJsonObject &object)
 {
-    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (object.value("type").toString() != "compress") return false;
+    Client *c = clients.find(id);
+    if (!c) return true;
 
-    if (socket) {
-        QString clientInfo = QString("%1:%2")
-        .arg(socket->peerAddress().toString())
-            .arg(socket->peerPort());
+    QJsonObject res;
+    res["type"] = "compress";
+    res["seq"] = object.value("seq");
 
-        clientBuffers.remove(socket);
-        clientExpectedSizes.remove(socket);
+    QStringList algorithms;
+    for (const QJsonValue &v : object.value("algorithms").toArray()) algorithms.append(v.toString());
+    if (object.contains("algorithm")) algorithms.append(object.value("algorithm").toString());
+    const QString dictionary = object.value("dictionary").toString(FrameCompressor::kDictionaryId);
 
-        qDebug() << "Client disconnected:" << clientInfo;
-        emit clientDisconnected(socket);
+    if (!algorithms.contains(FrameCompressor::kAlgorithm)) {
+        c->compress = false;
+        res["ok"] = true;
+        res["algorithm"] = "none";
+    } else if (c->webSocket) {
+        res["ok"] = false;
+        res["error"] = "WebSocket connections negotiate permessage-deflate in the handshake";
+    } else if (compressThreshold <= 0) {
+        res["ok"] = false;
+        res["error"] = "compression disabled";
+    } else if (dictionary != FrameCompressor::kDictionaryId) {
+        res["ok"] = false;
+        res["error"] = "unsupported dictionary";
+        res["dictionary"] = FrameCompressor::kDictionaryId;
+    } else {
+        res["ok"] = true;
+        res["algorithm"] = FrameCompressor::kAlgorithm;
+        res["dictionary"] = FrameCompressor::kDictionaryId;
+        res["threshold"] = compressThreshold;
+    }
+    // 应答本身不压缩：先发出去，再切换
+    sendFrame(id, QJsonDocument(res).toJson(QJsonDocument::Compact), ResponseFrame, QString());
+    if (res.value("ok").toBool() && res.value("algorithm").toString() == FrameCompressor::kAlgorithm) {
+        if (Client *cc = clients.find(id)) cc->compress = true;
+    }
+    return true;
+}
 
-        socket->deleteLater();
+void JsonTcpServer::onIdleTick()
+{
+    const QVector<IdleTracker::Due> due = idleTracker.advance(idleClock.elapsed() / 1000);
+    for (const IdleTracker::Due &d : due) {
+        const Client *c = clients.find(d.connection);
+        if (!c) continue;
+
+        if (d.action == IdleTracker::Ping) {
+            QJsonObject ping;
+            ping["type"] = "ping";
+            ping["ts"] = QDateTime::currentMSecsSinceEpoch();
+            // 积压时多次心跳只留最新一帧
+            sendFrame(d.connection, QJsonDocument(ping).toJson(QJsonDocument::Compact), CoalescedFrame, "ping");
+            ++pingsSent;
+            continue;
+        }
+
+        // 半开连接（移动网络断线、NAT 表项过期）：对端不会再回任何东西，直接复位
+        ++connTimedOut;
+        Metrics::add(Metrics::ConnectionsTimedOut);
+        emit wrnLog(QString("client %1 idle for %2 s, disconnecting")
+                        .arg(c->peer).arg(idleTracker.idleTimeout()));
+        abortDevice(c->endpoint);
+    }
+}
+
+void JsonTcpServer::applyKeepAlive(QTcpSocket *socket)
+{
+    if (keepAliveIdle <= 0) return;
+    socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+#ifdef Q_OS_UNIX
+    // 系统默认 2 小时后才开始探测，远长于 NAT 表项的寿命
+    const int fd = static_cast<int>(socket->socketDescriptor());
+    if (fd == -1) return;
+#ifdef TCP_KEEPIDLE
+    ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPIDLE, &keepAliveIdle, sizeof(keepAliveIdle));
+#elif defined(TCP_KEEPALIVE)
+    ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPALIVE, &keepAliveIdle, sizeof(keepAliveIdle));
+#endif
+#ifdef TCP_KEEPINTVL
+    ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPINTVL, &keepAliveInterval, sizeof(keepAliveInterval));
+#endif
+#ifdef TCP_KEEPCNT
+    ::setsockopt(fd, IPPROTO_TCP, TCP_KEEPCNT, &keepAliveCount, sizeof(keepAliveCount));
+#endif
+#endif
+}
+
+// 超过连接数上限：回一帧 busy 应答后关闭，不进任何客户端表
+void JsonTcpServer::rejectConnection(QObject *socket, const QString &peer, bool webSocket)
+{
+    ++connRejected;
+    Metrics::add(Metrics::ConnectionsRejected);
+    emit wrnLog(QString("connection limit (%1) reached, rejecting %2")
+                    .arg(maxConnections).arg(peer));
+
+    QJsonObject res;
+    res["ok"] = false;
+    res["busy"] = true;
+    res["error"] = "too many connections";
+    res["retry_after_ms"] = 5000;
+    const QByteArray body = QJsonDocument(res).toJson(QJsonDocument::Compact);
+
+    // WebSocket 还没握手：回 HTTP 503，浏览器的握手直接失败
+    if (webSocket) {
+        QTcpSocket *tcpSocket = static_cast<QTcpSocket *>(socket);
+        connect(tcpSocket, &QTcpSocket::disconnected, tcpSocket, &QObject::deleteLater);
+        tcpSocket->write(WebSocketCodec::errorResponse(503, body));
+        tcpSocket->disconnectFromHost();
+        return;
+    }
+
+    QIODevice *device = qobject_cast<QIODevice *>(socket);
+    QByteArray header(sizeof(quint32), Qt::Uninitialized);
+    qToBigEndian<quint32>(static_cast<quint32>(body.size()), reinterpret_cast<uchar *>(header.data()));
+    device->write(header);
+    device->write(body);
+    if (QTcpSocket *tcpSocket = qobject_cast<QTcpSocket *>(socket)) {
+        connect(tcpSocket, &QTcpSocket::disconnected, tcpSocket, &QObject::deleteLater);
+        tcpSocket->disconnectFromHost();
+    } else if (QLocalSocket *localSocket = qobject_cast<QLocalSocket *>(socket)) {
+        connect(localSocket, &QLocalSocket::disconnected, localSocket, &QObject::deleteLater);
+        localSocket->disconnectFromServer();
+    }
+}
+
+void JsonTcpServer::whileFrameNeedSend(ConnectionId client, const QByteArray &body, const QString &type,
+                                       const RequestTracePtr &trace)
+{
+    if (JsonTcpServer *worker = shardOf(client)) {
+        QMetaObject::invokeMethod(worker, "whileFrameNeedSend", Qt::QueuedConnection,
+                                  Q_ARG(ConnectionId, client), Q_ARG(QByteArray, body), Q_ARG(QString, type),
+                                  Q_ARG(RequestTracePtr, trace));
+        return;
+    }
+    const Client *c = clients.find(client);
+    if (!c || !deviceConnected(c->endpoint)) {
+        return;
+    }
+    if (type == "everysecond") {
+        sendFrame(client, body, CoalescedFrame, type, trace);
+    } else {
+        sendFrame(client, body, ResponseFrame, QString(), trace);
     }
 }
 
-void JsonTcpServer::whileJsonNeedSend(QTcpSocket *clientSocket, const QJsonDocument &document)
+void JsonTcpServer::whileJsonNeedSend(ConnectionId client, const QJsonDocument &document)
 {
-    if(clientSocket){
-        sendToClient(clientSocket,document);
+    if(client){
+        sendToClient(client,document);
     }
     else{
         //未指定则广播
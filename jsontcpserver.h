@@ -7,11 +7,28 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QObject>
-#include <QMap>
+#include <QJsonArray>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QVector>
 #include <QDataStream>
 #include <QDateTime>
 #include <QHostAddress>
+#include <QElapsedTimer>
 #include <QDebug>
+#include <atomic>
+#include "requesttrace.h"
+#include "idletracker.h"
+#include "connectiontable.h"
+#include "framecompressor.h"
+#include "websocketcodec.h"
+
+class QTimer;
+class QThread;
+class QLocalServer;
+class TrafficCapture;
+class ReusePortListener;
 
 
 class JsonTcpServer : public QObject
@@ -27,8 +44,35 @@ public:
     // 停止服务器
     void close();
 
-    // 向指定客户端发送JSON文档
-    bool sendToClient(QTcpSocket *clientSocket, const QJsonDocument &document);
+    // 接入线程数：大于 1 时在同一端口开这么多个 SO_REUSEPORT 监听套接字，各占一个 I/O 线程，
+    // 由内核分摊断网恢复后集中重连时的连接。每个线程里是一个分片 JsonTcpServer，自己的连接在那里
+    // 包装、读写、拆帧和解析；本对象转发它们的信号，按连接号（见 ConnectionTable 的标签）把应答转过去。
+    // 出站水位、keepalive、压缩阈值在 start 时复制给各分片，连接数上限平均分给各分片。
+    // 平台不支持时退回单个监听者。下次 start 生效
+    void setAcceptThreads(int threads);
+
+    // 另在本地套接字（Unix 域套接字 / Windows 命名管道）name 上监听，供同机的反向代理、
+    // 报表任务免走 TCP 回环；帧格式、请求分发与 TCP 连接完全相同。close() 时一并关闭
+    bool listenLocal(const QString &name);
+    void closeLocal();
+
+    // WebSocket 网关：浏览器前台直接连，每个文本或二进制消息是一帧 JSON（不带长度头），
+    // 进同一条请求分发，应答按请求的消息类型回，与 TCP 连接共用出站队列的水位、丢弃与合并规则。
+    // 客户端提议 permessage-deflate 时接受，不小于压缩阈值（setCompressionThreshold）的应答压缩发送。
+    // 默认不开，由调用方显式开启。closeWebSocket() 停止监听并断开所有 WebSocket 连接，close() 时一并关闭
+    bool listenWebSocket(const QHostAddress &address, quint16 port);
+    void closeWebSocket();
+
+    // 允许发起 WebSocket 连接的 Origin（如 "https://clinic.example.com"），精确匹配。
+    // 带 Origin 头的连接（浏览器）不在列表里即以 403 拒绝握手，列表为空时拒绝所有浏览器连接；
+    // 不带 Origin 头的非浏览器客户端不受限制
+    void setWebSocketAllowedOrigins(const QStringList &origins);
+
+    // 分片监听者各自的接入统计：[{ listener, accepted, accept_rate, peak_rate }]；单个监听者时为空
+    QJsonArray listenerStats() const;
+
+    // 向指定客户端发送JSON文档；连接已断开（连接号失效）时返回 false
+    bool sendToClient(ConnectionId client, const QJsonDocument &document);
 
     // 向所有连接的客户端广播JSON文档
     bool broadcast(const QJsonDocument &document);
@@ -36,18 +80,73 @@ public:
     // 获取当前连接的客户端数量
     int clientCount() const;
 
-    // 获取所有客户端套接字列表
-    QList<QTcpSocket*> connectedClients() const;
+    // 实际监听的端口（start 时传 0 则由系统分配）；未监听时为 0
+    quint16 serverPort() const;
+
+    // 所有在线客户端的连接号
+    QList<ConnectionId> connectedClients() const;
+
+    // 连接号对应的 TCP 套接字，已断开、是本地连接或属于分片 I/O 线程时为空；只在网络线程使用
+    QTcpSocket *clientSocket(ConnectionId client) const;
+
+    // 每个连接一项：{ id, peer, transport, connected_s, frames_in, frames_out, bytes_in, bytes_out, queued_bytes,
+    //               compressed }
+    QJsonArray clientsSnapshot() const;
+
+    // 出站队列水位（字节）：套接字写缓冲超过 high 时新帧先进本地待发队列，
+    // 回落到 low 以下再继续灌；单连接积压超过 hard 直接断开
+    void setOutboundLimits(qint64 lowWatermark, qint64 highWatermark, qint64 hardLimit);
+
+    // 出站统计：{ queued_bytes, max_queued_bytes, slow_clients, dropped_pushes, coalesced, slow_disconnects,
+    //            frames_sent, writev_calls, writev_frames, buffered_frames,
+    //            compressed_frames, compress_in_bytes, compress_out_bytes }
+    // compressed_* 含 WebSocket 的 permessage-deflate
+    // writev_calls 只数直接对描述符发的 sendmsg，writev_frames 是经它写出的帧；buffered_frames 交给
+    // QTcpSocket 缓冲，由 Qt 自己的 write 调用写出，不在计数里。因此这几项推不出每个应答的系统调用数。
+    // 实测（Qt 5.15，本机回环，客户端读得及时）：几百字节的小帧 Qt 的写缓冲本来就把同一轮的帧并成一次写，
+    // 两种写法每轮都是一次，省下的是每轮一次事件循环唤醒（eventfd 写）和一部分 poll；8 KiB 的帧 Qt
+    // 每次写通知只写一块，约 0.33 次/帧，直接 sendmsg 是每轮一次。内核发送缓冲满了以后两者都走 QTcpSocket，没有差别
+    QJsonObject outboundStats() const;
+
+    // 帧压缩（见 FrameCompressor）：客户端发 {"type":"compress"} 协商后，不小于 bytes 的帧
+    // 压缩发送并在长度头最高位标记；0 拒绝协商。WebSocket 连接不走这套协商，握手时谈 permessage-deflate，
+    // 阈值相同，0 时不接受该扩展
+    void setCompressionThreshold(int bytes);
+
+    // 空闲检测（见 IdleTracker）：静默 pingAfterSec 秒后发 {"type":"ping","ts":毫秒}，
+    // 静默 idleTimeoutSec 秒仍无任何数据则断开；idleTimeoutSec 为 0 关闭（默认，只靠 TCP keepalive）。
+    // 开启前要确认所有客户端都会回 {"type":"pong"}（或在时限内有别的请求），
+    // 否则安静的旧客户端会被当成死连接断开。帧格式见 README 的“心跳”一节
+    Q_INVOKABLE void setIdleTimeout(int pingAfterSec, int idleTimeoutSec);
+
+    // TCP keepalive：空闲 idleSec 秒后开始探测，每 intervalSec 秒一次，count 次无回应由内核断开；
+    // idleSec 为 0 不开启。只影响之后建立的连接
+    void setKeepAlive(int idleSec, int intervalSec, int count);
+
+    // 连接数上限，超过时新连接收到一帧 busy 应答后被关闭；0 表示不限
+    void setMaxConnections(int maxConnections);
+
+    // { connections, max_connections, rejected, timed_out, pings_sent, pongs_received, idle_timeout_s, ping_after_s,
+    //   local_socket, websocket_port, websocket_rejected_origins }
+    QJsonObject connectionStats() const;
+
+    // 流量录制（见 TrafficCapture）：把收到的帧写到 path，供 sever0-replay 回放
+    bool startCapture(const QString &path, QString *error = nullptr);
+    void stopCapture();
+    bool isCapturing() const;
+    // { path, capturing, frames, connections, bytes, redacted_frames, dropped_frames, elapsed_s }
+    QJsonObject captureStats() const;
 
 signals:
-    // 接收到JSON文档的信号
-    void jsonDocumentReceived(QTcpSocket *clientSocket, const QJsonDocument &document);
+    // 接收到JSON文档的信号；trace 已打上接收、解析两个时间戳
+    void jsonDocumentReceived(ConnectionId client, const QJsonDocument &document,
+                              const RequestTracePtr &trace);
 
     // 客户端连接信号
-    void clientConnected(QTcpSocket *clientSocket);
+    void clientConnected(ConnectionId client);
 
-    // 客户端断开信号
-    void clientDisconnected(QTcpSocket *clientSocket);
+    // 客户端断开信号；发出时连接号已失效
+    void clientDisconnected(ConnectionId client);
 
     // 错误信号
     void errorOccurred(const QString &errorMessage);
@@ -55,25 +154,192 @@ signals:
     void log(const QString& logStr);
     void wrnLog(const QString& wrnStr);
 
+    // 分片 I/O 线程里的录制事件，交给本对象写进 TrafficCapture（它不是线程安全的）
+    void shardConnectionCaptured(ConnectionId client, bool opened);
+    void shardFrameCaptured(ConnectionId client, const QByteArray &frame, const QJsonDocument &document,
+                            bool parsed);
+
 private slots:
     void onNewConnection();
-    void onClientReadyRead();
-    void onClientDisconnected();
+    void onDescriptorAccepted(qintptr descriptor, int listener, quint32 generation);
+    void onNewLocalConnection();
+    void onNewWebSocketConnection();
+    // 每轮事件循环一次：把本轮积攒的帧按连接批量写出
+    void flushPendingWrites();
+    // 每秒推进一次空闲时间轮
+    void onIdleTick();
+    void onShardConnectionCaptured(ConnectionId client, bool opened);
+    void onShardFrameCaptured(ConnectionId client, const QByteArray &frame, const QJsonDocument &document,
+                              bool parsed);
 public slots:
-    void whileJsonNeedSend(QTcpSocket *clientSocket, const QJsonDocument &document);
+    // client 为 0 时广播
+    void whileJsonNeedSend(ConnectionId client, const QJsonDocument &document);
+    // 已序列化好的应答正文（紧凑 JSON），用于一次序列化、多处分发
+    // trace 非空时在写出后记入 RequestTracer
+    void whileFrameNeedSend(ConnectionId client, const QByteArray &body, const QString &type,
+                            const RequestTracePtr &trace);
 
 private:
+    // 帧的类别决定慢消费者时的处理方式
+    enum FrameKind {
+        ResponseFrame,      // 请求的应答：必须送达，只排队
+        PushFrame,          // 广播推送：积压时丢弃
+        CoalescedFrame      // 周期刷新（everysecond）：只保留最新一帧
+    };
+
+    // 长度头与 JSON 正文分开存放，发送时用 writev 一起写，不再拼包复制
+    struct OutFrame {
+        QByteArray header;  // 4 字节大端长度，或 WebSocket 帧头
+        QByteArray body;
+        FrameKind kind;
+        QString key;        // 合并用的键（消息 type）
+        RequestTracePtr trace;
+        qint64 size() const { return header.size() + body.size(); }
+    };
+
+    // 每个连接的出站队列：套接字写缓冲之外的待发帧
+    struct OutboundQueue {
+        QList<OutFrame> pending;
+        qint64 pendingBytes = 0;
+        bool slow = false;  // 曾越过高水位，回落到低水位前算慢消费者
+    };
+
+    // 连接表的一个槽：一个连接的全部状态放在一起，收发时一次下标访问就够
+    struct Client {
+        QObject *endpoint = nullptr;    // 连接对象本身：QTcpSocket 或 QLocalSocket
+        QIODevice *socket = nullptr;    // 同一个对象，按流读写
+        bool webSocket = false;         // WebSocket 连接：同样是 QTcpSocket，帧格式按 RFC 6455
+        bool wsOpen = false;            // 已完成握手
+        bool wsClosing = false;         // 已发出关闭帧，之后收到的数据丢弃
+        bool wsDeflate = false;         // 已协商 permessage-deflate
+        int wsOpcode = 0;               // 正在拼接的分片消息的类型，0 表示没有
+        bool wsCompressed = false;      // 正在拼接的消息是压缩过的
+        QByteArray wsMessage;           // 已收到的分片
+        bool binaryMessages = false;    // WebSocket 客户端最近一次用的是二进制消息
+        bool compress = false;          // 已协商帧压缩
+        QString peer;                   // "ip:port"（本地连接为 "local#描述符"），连接时取一次，记日志不再反复格式化
+        QByteArray buffer;              // 接收缓冲区
+        quint32 expectedSize = 0;       // 当前帧的长度，0 表示在等帧头
+        bool inboundCompressed = false; // 当前帧的长度头带压缩标记
+        qint64 frameStart = 0;          // 当前帧收到帧头的时刻（RequestTrace::now）
+        OutboundQueue outbound;
+        bool flushQueued = false;       // 已在 flushQueue 里
+        qint64 connectedMs = 0;
+        quint64 framesIn = 0;
+        quint64 framesOut = 0;
+        quint64 bytesIn = 0;
+        quint64 bytesOut = 0;
+    };
+
+    bool isListening() const;
+    bool startSharded(const QHostAddress &hostAddr, quint16 port, QString *error);
+    void stopSharded();
+    // 以下三个在分片自己的 I/O 线程里执行（BlockingQueuedConnection）。
+    // listenShard 建监听者并开始接入，失败时返回错误信息
+    Q_INVOKABLE QString listenShard(const QString &addressText, quint16 port, int index, quint32 generation);
+    Q_INVOKABLE void closeShard();
+    // { connections: connectionStats(), outbound: outboundStats(), clients: clientsSnapshot() }，withClients 为 false 时不带 clients
+    Q_INVOKABLE QJsonObject shardStats(bool withClients) const;
+    QList<QJsonObject> collectShardStats(bool withClients) const;
+    // 连接号属于哪个分片；本对象自己的连接号（或分片已关闭）返回空
+    JsonTcpServer *shardOf(ConnectionId id) const;
+    // 断开并释放所有连接（close 和 closeShard 共用）
+    void disconnectAll();
+    // 录制：本线程有 TrafficCapture 就直接写，分片里则转给本对象
+    void captureConnection(ConnectionId id, bool opened);
+    void captureFrame(ConnectionId id, const QByteArray &frame, const QJsonDocument *document);
+    // 新连接入表（各监听方式共用）
+    void addClient(QObject *clientSocket, const QString &clientInfo, bool webSocket = false);
+
+    void onClientReadyRead(ConnectionId id);
+    void onClientDisconnected(ConnectionId id);
+    void onClientBytesWritten(ConnectionId id);
+
     // 处理接收缓冲区
-    void processReceiveBuffer(QTcpSocket *socket);
+    void processReceiveBuffer(ConnectionId id);
+    // WebSocket 连接的接收缓冲：先握手，之后逐帧拆包、拼接分片、解压
+    void processWebSocketBuffer(ConnectionId id);
+    // 握手请求收全后应答；返回 false 表示还没收全或已拒绝
+    bool acceptWebSocket(ConnectionId id);
+    void handleWebSocketFrame(ConnectionId id, const WebSocketCodec::Frame &frame);
+    // 控制帧（pong）排在出站队列里，不插到半截消息中间
+    void sendWebSocketControl(ConnectionId id, int opcode, const QByteArray &payload);
+    // 发关闭帧并断开；之后 client 可能已失效
+    void closeWebSocketClient(Client &client, quint16 code, const QByteArray &reason);
+    // 一帧完整的 JSON：解析、心跳、录制、发出 jsonDocumentReceived（各传输方式共用）
+    void dispatchFrame(ConnectionId id, const QByteArray &jsonData, qint64 frameStart);
+    // ping/pong 在这里就地处理，不进请求队列；返回 true 表示已处理
+    bool handleHeartbeat(ConnectionId id, const QJsonObject &object);
+    bool handleCompression(ConnectionId id, const QJsonObject &object);
+    void applyKeepAlive(QTcpSocket *socket);
+    void rejectConnection(QObject *socket, const QString &peer, bool webSocket);
 
     // 内部发送函数
-    bool sendJsonToSocket(QTcpSocket *socket, const QJsonDocument &document);
+    bool sendJsonToSocket(ConnectionId id, const QJsonDocument &document,
+                          FrameKind kind = ResponseFrame);
+    bool sendFrame(ConnectionId id, const QByteArray &body, FrameKind kind, const QString &key,
+                   const RequestTracePtr &trace = RequestTracePtr());
+    // 一帧已交给内核或套接字缓冲
+    void frameSent(Client &client, const OutFrame &frame);
+
+    // 把待发帧灌进套接字，直到写缓冲到达高水位
+    void drainOutbound(Client &client);
+    // 写缓冲为空时直接对套接字描述符 writev 一批帧；写不完的余量交给 QTcpSocket 缓冲
+    void writeVectored(Client &client);
+    void scheduleFlush(ConnectionId id, Client &client);
+    // 连接自身写缓冲里的字节（bytesToWrite()）
+    static qint64 bufferedBytes(const Client &client);
+    static qint64 queuedBytes(const Client &client);
 
-    //直接发送原始数据
-    bool sendRawJsonToSocket(QTcpSocket *socket, const QJsonDocument &document);
     QTcpServer *tcpServer;
-    QMap<QTcpSocket*, QByteArray> clientBuffers;      // 客户端接收缓冲区
-    QMap<QTcpSocket*, quint32> clientExpectedSizes;   // 客户端期望的数据大小
+    ConnectionTable<Client> clients;
+
+    qint64 outLowWatermark;
+    qint64 outHighWatermark;
+    qint64 outHardLimit;
+    qint64 outMaxQueued;
+    quint64 outDroppedPushes;
+    quint64 outCoalesced;
+    quint64 outSlowDisconnects;
+
+    QVector<ConnectionId> flushQueue;                 // 本轮有新帧待写的连接
+    bool flushScheduled;
+    quint64 outFramesSent;
+    quint64 outWritevCalls;
+    quint64 outWritevFrames;
+    quint64 outBufferedFrames;
+
+    TrafficCapture *capture;                          // 未录制时为空
+
+    IdleTracker idleTracker;
+    QTimer *idleTimer;
+    QElapsedTimer idleClock;
+    int keepAliveIdle;
+    int keepAliveInterval;
+    int keepAliveCount;
+    int maxConnections;
+    quint64 connRejected;
+    quint64 connTimedOut;
+    quint64 pingsSent;
+    quint64 pongsReceived;
+
+    int acceptThreads;
+    QList<JsonTcpServer*> shardWorkers;               // 各 I/O 线程里的分片，归各自线程，线程结束时删除
+    QList<ReusePortListener*> shardListeners;         // 各分片的监听者，只用来取端口和接入统计
+    QList<QThread*> shardThreads;
+    quint32 listenGeneration;                         // 每次 startSharded 加一
+    quint32 nextShardTag;                             // 下一个分片的连接表标签，1..255 轮转，
+                                                      // 上次 start 的旧连接号不会落到新分片上
+    std::atomic<bool> captureForward;                 // 分片用：本对象在录制，录制事件要转过来
+
+    QLocalServer *localServer;                        // 未开本地监听时为空
+    QTcpServer *webSocketServer;                      // 未开 WebSocket 网关时为空
+    QStringList wsAllowedOrigins;
+    quint64 wsRejectedOrigins;
+
+    FrameCompressor compressor;
+    WebSocketDeflate wsCompressor;
+    int compressThreshold;
 };
 
 #endif // JSONTCPSERVER_H
@@ -0,0 +1,99 @@
+#include "latencyhistogram.h"
+
+#include <QtGlobal>
+#include <QtAlgorithms>
+
+LatencyHistogram::LatencyHistogram()
+    : m_count(0)
+    , m_sum(0)
+    , m_max(0)
+{
+    for (int i = 0; i < kBucketCount; ++i) m_buckets[i].store(0, std::memory_order_relaxed);
+}
+
+int LatencyHistogram::bucketOf(qint64 us)
+{
+    if (us < 0) us = 0;
+    if (us >= (Q_INT64_C(1) << kMaxExponent)) us = (Q_INT64_C(1) << kMaxExponent) - 1;
+    if (us < kLinear) return static_cast<int>(us);
+
+    const int e = 63 - qCountLeadingZeroBits(static_cast<quint64>(us));    // floor(log2)
+    const int shift = e - kSubBucketBits;
+    const int sub = static_cast<int>(us >> shift) - kSubBuckets;
+    return kLinear + (e - kSubBucketBits - 1) * kSubBuckets + sub;
+}
+
+qint64 LatencyHistogram::bucketUpperBound(int index)
+{
+    if (index < kLinear) return index;
+    const int e = (index - kLinear) / kSubBuckets + kSubBucketBits + 1;
+    const int sub = (index - kLinear) % kSubBuckets;
+    const int shift = e - kSubBucketBits;
+    return (static_cast<qint64>(kSubBuckets + sub) << shift) + (Q_INT64_C(1) << shift) - 1;
+}
+
+void LatencyHistogram::record(qint64 us)
+{
+    if (us < 0) us = 0;
+    m_buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(static_cast<quint64>(us), std::memory_order_relaxed);
+
+    qint64 cur = m_max.load(std::memory_order_relaxed);
+    while (us > cur && !m_max.compare_exchange_weak(cur, us, std::memory_order_relaxed)) {
+    }
+}
+
+void LatencyHistogram::bucketCounts(quint64 *out) const
+{
+    for (int i = 0; i < kBucketCount; ++i) out[i] = m_buckets[i].load(std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::percentileOf(const quint64 *counts, double q)
+{
+    quint64 total = 0;
+    for (int i = 0; i < kBucketCount; ++i) total += counts[i];
+    if (total == 0) return 0;
+
+    const quint64 rank = qMax<quint64>(1, static_cast<quint64>(q * total + 0.5));
+    quint64 seen = 0;
+    for (int i = 0; i < kBucketCount; ++i) {
+        seen += counts[i];
+        if (seen >= rank) return bucketUpperBound(i);
+    }
+    return bucketUpperBound(kBucketCount - 1);
+}
+
+qint64 LatencyHistogram::percentile(double q) const
+{
+    // 快照期间仍可能有写入，以桶计数之和为准
+    quint64 counts[kBucketCount];
+    bucketCounts(counts);
+    return qMin(percentileOf(counts, q), max());
+}
+
+QJsonObject LatencyHistogram::summary() const
+{
+    const quint64 n = count();
+    QJsonObject o;
+    o["count"]   = static_cast<qint64>(n);
+    o["mean_us"] = n ? double(sum()) / n : 0.0;
+    o["p50_us"]  = percentile(0.50);
+    o["p90_us"]  = percentile(0.90);
+    o["p99_us"]  = percentile(0.99);
+    o["max_us"]  = max();
+    return o;
+}
+
+void LatencyHistogram::cumulative(const qint64 *upperBoundsUs, int n, quint64 *out) const
+{
+    int b = 0;
+    quint64 seen = 0;
+    for (int i = 0; i < n; ++i) {
+        while (b < kBucketCount && bucketUpperBound(b) <= upperBoundsUs[i]) {
+            seen += m_buckets[b].load(std::memory_order_relaxed);
+            ++b;
+        }
+        out[i] = seen;
+    }
+}
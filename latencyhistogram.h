@@ -0,0 +1,51 @@
+#ifndef LATENCYHISTOGRAM_H
+#define LATENCYHISTOGRAM_H
+
+#include <QJsonObject>
+#include <atomic>
+
+// HDR 风格的对数-线性直方图，单位微秒：
+// 0..63 us 每个值一个桶，之后每个 2 的幂区间再分 32 个桶（相对误差约 3%），上限约 1 小时。
+// record() 只做几次原子加法，无锁，可在任意线程调用。
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    void record(qint64 us);
+
+    quint64 count() const { return m_count.load(std::memory_order_relaxed); }
+    quint64 sum() const { return m_sum.load(std::memory_order_relaxed); }
+    qint64 max() const { return m_max.load(std::memory_order_relaxed); }
+
+    // 分位数（0~1），返回所在桶的上界
+    qint64 percentile(double q) const;
+
+    // { count, mean_us, p50_us, p90_us, p99_us, max_us }
+    QJsonObject summary() const;
+
+    // 复制各桶计数（kBucketCount 个），可用来对两次快照求差，得到一段时间内的分布
+    void bucketCounts(quint64 *out) const;
+    // 按桶计数求分位数
+    static qint64 percentileOf(const quint64 *counts, double q);
+
+    // 累计分布：upperBoundsUs 升序，返回每个上界处的累计计数（Prometheus 直方图用）
+    void cumulative(const qint64 *upperBoundsUs, int n, quint64 *out) const;
+
+    static const int kSubBucketBits = 5;
+    static const int kSubBuckets = 1 << kSubBucketBits;         // 32
+    static const int kLinear = 2 * kSubBuckets;                 // 0..63 线性
+    static const int kMaxExponent = 32;                         // 约 2^32 us
+    static const int kBucketCount = kLinear + (kMaxExponent - kSubBucketBits - 1) * kSubBuckets;
+
+    static int bucketOf(qint64 us);
+    static qint64 bucketUpperBound(int index);
+
+private:
+    std::atomic<quint64> m_buckets[kBucketCount];
+    std::atomic<quint64> m_count;
+    std::atomic<quint64> m_sum;
+    std::atomic<qint64> m_max;
+};
+
+#endif // LATENCYHISTOGRAM_H
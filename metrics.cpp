@@ -0,0 +1,46 @@
+#include "metrics.h"
+
+#include <QMutex>
+#include <QList>
+#include <atomic>
+
+namespace {
+
+// 尾部留一个缓存行的空白，相邻分配的分片不会落在同一缓存行
+struct Shard {
+    std::atomic<quint64> v[Metrics::CounterCount];
+    char pad[64];
+    Shard() { for (auto &c : v) c.store(0, std::memory_order_relaxed); }
+};
+
+QMutex s_shardsMutex;
+QList<Shard*> s_shards;          // 只增不删
+thread_local Shard *t_shard = nullptr;
+
+Shard *localShard()
+{
+    if (!t_shard) {
+        Shard *shard = new Shard;
+        QMutexLocker locker(&s_shardsMutex);
+        s_shards.append(shard);
+        t_shard = shard;
+    }
+    return t_shard;
+}
+
+}
+
+void Metrics::add(Counter counter, quint64 n)
+{
+    // 只有本线程写这个分片，relaxed 即可；读取方只需要最终一致
+    localShard()->v[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void Metrics::totals(quint64 out[CounterCount])
+{
+    for (int i = 0; i < CounterCount; ++i) out[i] = 0;
+    QMutexLocker locker(&s_shardsMutex);
+    for (const Shard *shard : s_shards) {
+        for (int i = 0; i < CounterCount; ++i) out[i] += shard->v[i].load(std::memory_order_relaxed);
+    }
+}
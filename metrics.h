@@ -0,0 +1,36 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <QtGlobal>
+
+// 进程内计数器：每个线程写自己的分片（无竞争的原子加），
+// 只有被抓取（totals）时才把所有分片加起来。
+// 线程退出后分片保留，计数器保持单调递增。
+class Metrics
+{
+public:
+    enum Counter {
+        ConnectionsOpened = 0,
+        ConnectionsClosed,
+        ConnectionsRejected,    // 超过连接数上限
+        ConnectionsTimedOut,    // 空闲超时断开
+        FramesReceived,
+        FramesSent,
+        BytesReceived,
+        BytesSent,
+        ParseErrors,
+        RequestsAdmitted,       // 通过准入进入队列
+        RequestsDequeued,       // 被工作线程取出
+        RequestsDropped,        // 在队列中被挤掉或清空
+        RequestsExecuted,
+        WorkerBusyNs,
+        CounterCount
+    };
+
+    static void add(Counter counter, quint64 n = 1);
+
+    // 合并所有线程的分片
+    static void totals(quint64 out[CounterCount]);
+};
+
+#endif // METRICS_H
@@ -0,0 +1,407 @@
+#include "metricsserver.h"
+#include "metrics.h"
+#include "requesttrace.h"
+#include "jsontcpserver.h"
+#include "jsonhandlequeue.h"
+#include "sqldatabase.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+// 请求头上限，超过直接断开
+static const int kMaxRequestBytes = 8 * 1024;
+
+// /metrics 里导出的 SQL 语句条数（按总耗时取前 N 条）
+static const int kSqlStatementLimit = 50;
+
+// 请求耗时直方图的桶（秒）
+static const double kLatencyBuckets[] = {
+    0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5
+};
+static const int kLatencyBucketCount = sizeof(kLatencyBuckets) / sizeof(kLatencyBuckets[0]);
+
+static const double kQuantiles[] = { 0.5, 0.9, 0.99 };
+
+namespace {
+
+// 拼 Prometheus 文本
+class Exposition
+{
+public:
+    void header(const char *name, const char *type, const char *help)
+    {
+        out += "# HELP "; out += name; out += ' '; out += help; out += '\n';
+        out += "# TYPE "; out += name; out += ' '; out += type; out += '\n';
+    }
+
+    void sample(const QByteArray &name, const QByteArray &labels, double value)
+    {
+        out += name;
+        if (!labels.isEmpty()) { out += '{'; out += labels; out += '}'; }
+        out += ' ';
+        out += QByteArray::number(value, 'g', 15);
+        out += '\n';
+    }
+
+    void value(const char *name, const char *type, const char *help, double v)
+    {
+        header(name, type, help);
+        sample(name, QByteArray(), v);
+    }
+
+    // 标签值转义：\ " 换行
+    static QByteArray label(const char *key, const QString &v)
+    {
+        QByteArray e = v.toUtf8();
+        e.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+        return QByteArray(key) + "=\"" + e + '"';
+    }
+
+    // 直方图：cumulative 给出累计计数，sum 单位秒
+    void histogram(const QByteArray &name, const QByteArray &labels, const LatencyHistogram &h)
+    {
+        qint64 bounds[kLatencyBucketCount];
+        quint64 counts[kLatencyBucketCount];
+        for (int i = 0; i < kLatencyBucketCount; ++i) bounds[i] = qRound64(kLatencyBuckets[i] * 1e6);
+        h.cumulative(bounds, kLatencyBucketCount, counts);
+
+        const QByteArray sep = labels.isEmpty() ? QByteArray() : labels + ',';
+        for (int i = 0; i < kLatencyBucketCount; ++i) {
+            sample(name + "_bucket", sep + "le=\"" + QByteArray::number(kLatencyBuckets[i]) + '"',
+                   static_cast<double>(counts[i]));
+        }
+        sample(name + "_bucket", sep + "le=\"+Inf\"", static_cast<double>(h.count()));
+        sample(name + "_sum", labels, h.sum() / 1e6);
+        sample(name + "_count", labels, static_cast<double>(h.count()));
+    }
+
+    // 摘要：分位数取自直方图
+    void summary(const QByteArray &name, const QByteArray &labels, const LatencyHistogram &h)
+    {
+        const QByteArray sep = labels.isEmpty() ? QByteArray() : labels + ',';
+        for (double q : kQuantiles) {
+            sample(name, sep + "quantile=\"" + QByteArray::number(q) + '"', h.percentile(q) / 1e6);
+        }
+        sample(name + "_sum", labels, h.sum() / 1e6);
+        sample(name + "_count", labels, static_cast<double>(h.count()));
+    }
+
+    QByteArray out;
+};
+
+}
+
+MetricsServer::MetricsServer(JsonTcpServer *server, JsonHandleQueue *queue, SqlDataBase *database,
+                             QObject *parent)
+    : QObject(parent)
+    , m_server(server)
+    , m_queue(queue)
+    , m_database(database)
+    , m_listener(nullptr)
+{
+}
+
+MetricsServer::~MetricsServer()
+{
+    close();
+}
+
+bool MetricsServer::start(const QHostAddress &address, quint16 port)
+{
+    close();
+    m_listener = new QTcpServer(this);
+    connect(m_listener, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+    if (!m_listener->listen(address, port)) {
+        emit wrnLog(QString("metrics endpoint could not listen on %1:%2: %3")
+                        .arg(address.toString()).arg(port).arg(m_listener->errorString()));
+        delete m_listener;
+        m_listener = nullptr;
+        return false;
+    }
+    emit log(QString("metrics endpoint on http://%1:%2/metrics").arg(address.toString()).arg(port));
+    return true;
+}
+
+void MetricsServer::close()
+{
+    if (!m_listener) return;
+    for (QTcpSocket *socket : m_requests.keys()) socket->abort();
+    m_requests.clear();
+    delete m_listener;
+    m_listener = nullptr;
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (QTcpSocket *socket = m_listener->nextPendingConnection()) {
+        m_requests.insert(socket, QByteArray());
+        connect(socket, &QTcpSocket::readyRead, this, &MetricsServer::onReadyRead);
+        connect(socket, &QTcpSocket::disconnected, this, [this, socket]() {
+            m_requests.remove(socket);
+            socket->deleteLater();
+        });
+    }
+}
+
+void MetricsServer::onReadyRead()
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(sender());
+    if (!socket || !m_requests.contains(socket)) return;
+
+    QByteArray &request = m_requests[socket];
+    request.append(socket->readAll());
+    if (request.size() > kMaxRequestBytes) {
+        socket->abort();
+        return;
+    }
+    if (!request.contains("\r\n\r\n")) return;   // 请求头未收完
+
+    // 只看请求行：GET /metrics HTTP/1.x
+    const QList<QByteArray> line = request.left(request.indexOf("\r\n")).split(' ');
+    const QByteArray method = line.value(0);
+    const QByteArray path = line.value(1).split('?').value(0);
+
+    if (method != "GET") {
+        reply(socket, "405 Method Not Allowed", "text/plain", "method not allowed\n");
+    } else if (path == "/metrics") {
+        reply(socket, "200 OK", "text/plain; version=0.0.4; charset=utf-8", render());
+    } else if (path == "/connections") {
+        reply(socket, "200 OK", "application/json; charset=utf-8", renderConnections());
+    } else {
+        reply(socket, "404 Not Found", "text/plain", "not found\n");
+    }
+}
+
+void MetricsServer::reply(QTcpSocket *socket, const QByteArray &status, const QByteArray &contentType,
+                          const QByteArray &body)
+{
+    QByteArray head = "HTTP/1.1 " + status + "\r\n"
+                      "Content-Type: " + contentType + "\r\n"
+                      "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                      "Connection: close\r\n\r\n";
+    socket->write(head);
+    socket->write(body);
+    socket->disconnectFromHost();
+}
+
+MetricsSnapshot MetricsServer::snapshot() const
+{
+    MetricsSnapshot s;
+    s.atMs = RequestTrace::now() / 1000000;
+
+    quint64 c[Metrics::CounterCount];
+    Metrics::totals(c);
+    s.connections = m_server ? m_server->clientCount() : 0;
+    s.requestsExecuted = c[Metrics::RequestsExecuted];
+    s.workerBusyNs = c[Metrics::WorkerBusyNs];
+    // 各分片分别累加，瞬间可能不一致，下限取 0
+    const qint64 depth = static_cast<qint64>(c[Metrics::RequestsAdmitted])
+                         - static_cast<qint64>(c[Metrics::RequestsDequeued])
+                         - static_cast<qint64>(c[Metrics::RequestsDropped]);
+    s.queueDepth = static_cast<int>(qMax<qint64>(0, depth));
+
+    RequestTracer *tracer = RequestTracer::instance();
+    s.handlerBusyUs = tracer->overall(RequestTracer::HandlerSpan).sum();
+    const QStringList types = tracer->types();
+    for (const QString &type : types) {
+        const LatencyHistogram *h = tracer->histogram(type, RequestTracer::TotalSpan);
+        if (!h) continue;
+        MetricsSnapshot::TypeLatency t;
+        t.type = type;
+        t.buckets.resize(LatencyHistogram::kBucketCount);
+        h->bucketCounts(t.buckets.data());
+        s.types.append(t);
+    }
+    return s;
+}
+
+QByteArray MetricsServer::renderConnections() const
+{
+    QJsonObject o;
+    if (m_server) {
+        o["summary"] = m_server->connectionStats();
+        o["clients"] = m_server->clientsSnapshot();
+        o["listeners"] = m_server->listenerStats();
+    }
+    return QJsonDocument(o).toJson(QJsonDocument::Compact);
+}
+
+QByteArray MetricsServer::render() const
+{
+    Exposition e;
+
+    // —— 分片计数器
+    quint64 c[Metrics::CounterCount];
+    Metrics::totals(c);
+    e.value("sever0_connections_opened_total", "counter", "Client connections accepted.",
+            c[Metrics::ConnectionsOpened]);
+    e.value("sever0_connections_closed_total", "counter", "Client connections closed.",
+            c[Metrics::ConnectionsClosed]);
+    e.value("sever0_connections_rejected_total", "counter", "Connections refused at the connection limit.",
+            c[Metrics::ConnectionsRejected]);
+    e.value("sever0_connections_timed_out_total", "counter", "Connections closed after the idle timeout.",
+            c[Metrics::ConnectionsTimedOut]);
+    e.value("sever0_frames_received_total", "counter", "Request frames received.",
+            c[Metrics::FramesReceived]);
+    e.value("sever0_frames_sent_total", "counter", "Frames handed to the kernel or socket buffer.",
+            c[Metrics::FramesSent]);
+    e.value("sever0_bytes_received_total", "counter", "Bytes read from client sockets.",
+            c[Metrics::BytesReceived]);
+    e.value("sever0_bytes_sent_total", "counter", "Bytes written to client sockets, including length headers.",
+            c[Metrics::BytesSent]);
+    e.value("sever0_parse_errors_total", "counter", "Frames that were not valid JSON.",
+            c[Metrics::ParseErrors]);
+    e.value("sever0_requests_executed_total", "counter", "Requests executed by worker threads.",
+            c[Metrics::RequestsExecuted]);
+    e.value("sever0_worker_busy_seconds_total", "counter", "Time worker threads spent executing requests.",
+            c[Metrics::WorkerBusyNs] / 1e9);
+
+    // —— 连接与出站
+    if (m_server) {
+        e.value("sever0_connections", "gauge", "Currently connected clients.", m_server->clientCount());
+        const QJsonObject out = m_server->outboundStats();
+        e.value("sever0_outbound_queued_bytes", "gauge", "Bytes queued for slow clients.",
+                out.value("queued_bytes").toDouble());
+        e.value("sever0_outbound_slow_clients", "gauge", "Clients above the outbound high watermark.",
+                out.value("slow_clients").toDouble());
+        e.value("sever0_outbound_dropped_pushes_total", "counter", "Push frames dropped for slow clients.",
+                out.value("dropped_pushes").toDouble());
+        e.value("sever0_outbound_coalesced_total", "counter", "Periodic frames replaced by a newer one.",
+                out.value("coalesced").toDouble());
+        e.value("sever0_outbound_slow_disconnects_total", "counter", "Clients disconnected for exceeding the outbound limit.",
+                out.value("slow_disconnects").toDouble());
+        e.value("sever0_writev_calls_total", "counter",
+                "Direct sendmsg calls; frames handed to the QTcpSocket buffer are written by Qt and not counted.",
+                out.value("writev_calls").toDouble());
+        e.value("sever0_compressed_frames_total", "counter", "Frames sent deflate-compressed.",
+                out.value("compressed_frames").toDouble());
+        e.header("sever0_compression_bytes_total", "counter", "Payload bytes of compressed frames before and after deflate.");
+        e.sample("sever0_compression_bytes_total", "stage=\"in\"", out.value("compress_in_bytes").toDouble());
+        e.sample("sever0_compression_bytes_total", "stage=\"out\"", out.value("compress_out_bytes").toDouble());
+
+        const QJsonArray listeners = m_server->listenerStats();
+        if (!listeners.isEmpty()) {
+            e.header("sever0_listener_accepted_total", "counter", "Connections accepted per SO_REUSEPORT listener.");
+            for (const QJsonValue &v : listeners) {
+                const QJsonObject l = v.toObject();
+                e.sample("sever0_listener_accepted_total",
+                         Exposition::label("listener", QString::number(l.value("listener").toInt())),
+                         l.value("accepted").toDouble());
+            }
+            e.header("sever0_listener_accept_rate", "gauge", "Connections accepted in the last full second per listener.");
+            for (const QJsonValue &v : listeners) {
+                const QJsonObject l = v.toObject();
+                e.sample("sever0_listener_accept_rate",
+                         Exposition::label("listener", QString::number(l.value("listener").toInt())),
+                         l.value("accept_rate").toDouble());
+            }
+        }
+    }
+
+    // —— 执行队列
+    if (m_queue) {
+        const QJsonObject q = m_queue->stats();
+        const int pending = q.value("pending").toInt();
+        const int pendingSlow = q.value("pending_slow").toInt();
+        e.header("sever0_queue_depth", "gauge", "Requests waiting for a worker.");
+        e.sample("sever0_queue_depth", "lane=\"fast\"", pending - pendingSlow);
+        e.sample("sever0_queue_depth", "lane=\"slow\"", pendingSlow);
+        e.value("sever0_queue_capacity", "gauge", "Queue admission capacity.", q.value("capacity").toDouble());
+
+        const QJsonArray workers = q.value("workers").toArray();
+        int slowWorkers = 0;
+        for (const QJsonValue &w : workers) {
+            if (w.toObject().value("lane").toString() == "slow") ++slowWorkers;
+        }
+        e.header("sever0_workers", "gauge", "Worker threads by lane.");
+        e.sample("sever0_workers", "lane=\"fast\"", workers.size() - slowWorkers);
+        e.sample("sever0_workers", "lane=\"slow\"", slowWorkers);
+        e.value("sever0_workers_busy", "gauge", "Worker threads currently executing a request.",
+                q.value("busy_workers").toDouble());
+        // 累计值，占用率由 rate() 求得
+        e.header("sever0_worker_thread_busy_seconds_total", "counter", "Time each worker thread spent executing requests.");
+        for (const QJsonValue &v : workers) {
+            const QJsonObject w = v.toObject();
+            e.sample("sever0_worker_thread_busy_seconds_total",
+                     Exposition::label("worker", QString::number(w.value("id").toInt()))
+                         + "," + Exposition::label("lane", w.value("lane").toString()),
+                     w.value("busy_ns").toDouble() / 1e9);
+        }
+
+        e.value("sever0_requests_accepted_total", "counter", "Requests admitted to the queue.",
+                q.value("accepted").toDouble());
+        e.header("sever0_requests_shed_total", "counter", "Requests refused by admission control.");
+        e.sample("sever0_requests_shed_total", "reason=\"high\"", q.value("shed_high").toDouble());
+        e.sample("sever0_requests_shed_total", "reason=\"normal\"", q.value("shed_normal").toDouble());
+        e.sample("sever0_requests_shed_total", "reason=\"low\"", q.value("shed_low").toDouble());
+        e.sample("sever0_requests_shed_total", "reason=\"client\"", q.value("shed_client").toDouble());
+        e.sample("sever0_requests_shed_total", "reason=\"evicted\"", q.value("evicted").toDouble());
+    }
+
+    // —— 请求耗时（按类型）与阶段分解
+    RequestTracer *tracer = RequestTracer::instance();
+    const QStringList types = tracer->types();
+
+    e.header("sever0_request_duration_seconds", "histogram",
+             "Time from receiving a request frame to writing its response, by request type.");
+    for (const QString &type : types) {
+        if (const LatencyHistogram *h = tracer->histogram(type, RequestTracer::TotalSpan)) {
+            e.histogram("sever0_request_duration_seconds", Exposition::label("type", type), *h);
+        }
+    }
+
+    e.header("sever0_request_handler_seconds", "summary", "Time spent in the request handler (database access included), by request type.");
+    for (const QString &type : types) {
+        if (const LatencyHistogram *h = tracer->histogram(type, RequestTracer::HandlerSpan)) {
+            e.summary("sever0_request_handler_seconds", Exposition::label("type", type), *h);
+        }
+    }
+
+    e.header("sever0_request_stage_seconds", "summary", "Per-stage latency across all request types.");
+    for (int s = 0; s < RequestTracer::TotalSpan; ++s) {
+        e.summary("sever0_request_stage_seconds",
+                  Exposition::label("stage", QString::fromLatin1(RequestTracer::spanName(s))),
+                  tracer->overall(static_cast<RequestTracer::Span>(s)));
+    }
+
+    // —— 数据库
+    if (m_database) {
+        e.value("sever0_db_connections", "gauge", "Open SQLite connections (main plus per-worker).",
+                m_database->openConnections());
+        e.value("sever0_db_wal_bytes", "gauge", "Size of the SQLite write-ahead log.",
+                static_cast<double>(m_database->walSizeBytes()));
+        e.value("sever0_db_file_bytes", "gauge", "Size of the main database file.",
+                static_cast<double>(m_database->fileSizeBytes()));
+
+        // SQL 剖析：抓取时取一次报告；按总耗时取前 kSqlStatementLimit 条，标签集有上限
+        const QJsonObject profile = m_database->sqlProfileReport(kSqlStatementLimit);
+        const QJsonArray statements = profile.value("statements").toArray();
+        e.value("sever0_sql_sample_rate", "gauge", "SQL profiler sampling rate (1 in N executions, 0 = off).",
+                profile.value("sample_rate").toInt());
+        e.value("sever0_sql_executions_total", "counter", "Statements executed through the SQL profiler.",
+                profile.value("calls").toDouble());
+
+        struct SqlSeries { const char *name; const char *type; const char *help; const char *field; double scale; };
+        static const SqlSeries kSqlSeries[] = {
+            { "sever0_sql_statement_samples_total", "counter", "Profiled (sampled) executions, by statement.", "samples", 1 },
+            { "sever0_sql_statement_calls_total", "counter", "Estimated executions (samples x sampling rate), by statement.", "est_calls", 1 },
+            { "sever0_sql_statement_seconds_total", "counter", "Total time of the sampled executions, by statement.", "total_ms", 1e-3 },
+            { "sever0_sql_statement_max_seconds", "gauge", "Slowest sampled execution, by statement.", "max_ms", 1e-3 },
+            { "sever0_sql_statement_rows_total", "counter", "Rows returned by the sampled executions, by statement.", "rows", 1 },
+            { "sever0_sql_statement_errors_total", "counter", "Failed sampled executions, by statement.", "errors", 1 },
+        };
+        for (const SqlSeries &s : kSqlSeries) {
+            e.header(s.name, s.type, s.help);
+            for (const QJsonValue &v : statements) {
+                const QJsonObject st = v.toObject();
+                e.sample(s.name, Exposition::label("sql", st.value("sql").toString()),
+                         st.value(s.field).toDouble() * s.scale);
+            }
+        }
+    }
+
+    return e.out;
+}
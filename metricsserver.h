@@ -0,0 +1,81 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QHostAddress>
+#include <QHash>
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <QVector>
+
+class QTcpServer;
+class QTcpSocket;
+class JsonTcpServer;
+class JsonHandleQueue;
+class SqlDataBase;
+
+// 面板用的轻量快照：只读分片计数器和无锁直方图，不碰队列锁
+struct MetricsSnapshot
+{
+    qint64 atMs = 0;            // 单调时钟
+    int connections = 0;
+    quint64 requestsExecuted = 0;
+    int queueDepth = 0;         // 已准入、尚未被取出
+    quint64 workerBusyNs = 0;
+    quint64 handlerBusyUs = 0;  // 所有请求处理函数阶段耗时之和
+
+    // 每种请求的端到端耗时直方图桶计数（LatencyHistogram::kBucketCount 个），
+    // 面板对相邻两次快照求差得到这段时间的 p50 / p99
+    struct TypeLatency {
+        QString type;
+        QVector<quint64> buckets;
+    };
+    QList<TypeLatency> types;
+};
+
+// 指标端点：在本地端口上提供 GET /metrics（Prometheus 文本格式 0.0.4），
+// 以及 GET /connections（JSON，逐连接的收发统计与各接入监听者的接入数）。
+// 计数器在各线程分片累加（Metrics），只有抓取时才合并；
+// 队列、出站、数据库等状态也在抓取时现取，平时不产生任何额外开销。
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    MetricsServer(JsonTcpServer *server, JsonHandleQueue *queue, SqlDataBase *database,
+                  QObject *parent = nullptr);
+    ~MetricsServer();
+
+    // 默认只监听回环地址
+    bool start(const QHostAddress &address = QHostAddress::LocalHost, quint16 port = 9464);
+    void close();
+
+    // 生成一次完整的指标文本
+    QByteArray render() const;
+
+    // { summary: JsonTcpServer::connectionStats(), clients: [...] }
+    QByteArray renderConnections() const;
+
+    // 只能在主线程调用（读取连接数）
+    MetricsSnapshot snapshot() const;
+
+signals:
+    void log(const QString& logStr);
+    void wrnLog(const QString& wrnStr);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+
+private:
+    void reply(QTcpSocket *socket, const QByteArray &status, const QByteArray &contentType,
+               const QByteArray &body);
+
+    JsonTcpServer *m_server;
+    JsonHandleQueue *m_queue;
+    SqlDataBase *m_database;
+    QTcpServer *m_listener;
+    QHash<QTcpSocket*, QByteArray> m_requests;   // 未收完的请求头
+};
+
+#endif // METRICSSERVER_H
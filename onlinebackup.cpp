@@ -0,0 +1,307 @@
+#include "onlinebackup.h"
+
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QSqlError>
+#include <QTimer>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <QThread>
+#include <QtConcurrent/QtConcurrent>
+#include <QDebug>
+
+#include "requesttrace.h"
+
+// 导出文件格式：
+//   "S0SNAP1\n"
+//   重复若干块：[quint32 大端 压缩后长度][qCompress(JSON)]
+//   每块 JSON：{ "table":..., "columns":[...], "rows":[[...],...] }，最多 kRowsPerChunk 行
+static const char kExportMagic[] = "S0SNAP1\n";
+static const int kRowsPerChunk = 1000;
+
+OnlineBackup::OnlineBackup(const QString &dbPath, const QString &backupDir, QObject *parent)
+    : QObject(parent)
+    , m_dbPath(dbPath)
+    , m_dir(backupDir)
+    , m_running(false)
+{
+    m_scheduleTimer = new QTimer(this);
+    connect(m_scheduleTimer, &QTimer::timeout, this, [this]() { startBackup(); });
+
+    connect(this, &OnlineBackup::snapshotCopied, this, &OnlineBackup::finish, Qt::QueuedConnection);
+}
+
+OnlineBackup::~OnlineBackup()
+{
+    // 工作线程还在拷贝或导出时等它们结束，临时文件随后删掉
+    m_future.waitForFinished();
+    m_exports.waitForFinished();
+    if (!m_tmpPath.isEmpty()) QFile::remove(m_tmpPath);
+}
+
+bool OnlineBackup::isRunning() const
+{
+    QMutexLocker lock(&m_stateMutex);
+    return m_running;
+}
+
+QJsonObject OnlineBackup::lastReport() const
+{
+    QMutexLocker lock(&m_stateMutex);
+    return m_lastReport;
+}
+
+QString OnlineBackup::lastBackupPath() const
+{
+    QMutexLocker lock(&m_stateMutex);
+    return m_lastBackupPath;
+}
+
+void OnlineBackup::setSchedule(int intervalMinutes)
+{
+    if (intervalMinutes <= 0) {
+        m_scheduleTimer->stop();
+        return;
+    }
+    m_scheduleTimer->start(intervalMinutes * 60 * 1000);
+}
+
+bool OnlineBackup::startBackup()
+{
+    {
+        QMutexLocker lock(&m_stateMutex);
+        if (m_running) {
+            emit wrnLog("backup already running");
+            return false;
+        }
+        m_running = true;
+    }
+
+    QDir().mkpath(m_dir);
+    const QString base = QFileInfo(m_dbPath).completeBaseName();
+    m_targetPath = QString("%1/%2_%3.db").arg(m_dir, base,
+                                             QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"));
+    m_tmpPath = m_targetPath + ".part";
+    QFile::remove(m_tmpPath);
+
+    // 开始前提交的导出都用这份快照
+    m_pendingExports += m_queuedExports;
+    m_queuedExports.clear();
+
+    // 备份期间的请求延迟：结束时与这份快照求差
+    m_latencyBefore.resize(LatencyHistogram::kBucketCount);
+    RequestTracer::instance()->overall(RequestTracer::TotalSpan).bucketCounts(m_latencyBefore.data());
+    m_elapsed.start();
+
+    emit log(QString("backup started -> %1").arg(m_targetPath));
+    const QString tmp = m_tmpPath;
+    m_future = QtConcurrent::run([this, tmp]() { runBackup(tmp); });
+    return true;
+}
+
+// 在工作线程里执行：独立的只读 QSQLITE 连接，VACUUM INTO 在一个读事务里写出整份快照，
+// 其他连接的写入既不会被挡住，也不会混进这份快照
+void OnlineBackup::runBackup(const QString &tmpPath)
+{
+    const QString conn = QString("backup_%1").arg(reinterpret_cast<quintptr>(this));
+    QString error;
+    int pages = 0;
+    int pageSize = 0;
+
+    {
+        QSqlDatabase src = QSqlDatabase::addDatabase("QSQLITE", conn);
+        src.setDatabaseName(m_dbPath);
+        src.setConnectOptions("QSQLITE_OPEN_READONLY;QSQLITE_BUSY_TIMEOUT=5000");
+        if (!src.open()) {
+            error = QString("open %1: %2").arg(m_dbPath, src.lastError().text());
+        } else {
+            QSqlQuery q(src);
+            if (q.exec("PRAGMA page_size") && q.next()) pageSize = q.value(0).toInt();
+            q.finish();
+
+            q.prepare("VACUUM INTO ?");
+            q.addBindValue(tmpPath);
+            if (!q.exec()) {
+                error = q.lastError().text();
+            } else if (pageSize > 0) {
+                pages = static_cast<int>(QFileInfo(tmpPath).size() / pageSize);
+            }
+        }
+        src.close();
+    }
+    QSqlDatabase::removeDatabase(conn);
+
+    emit snapshotCopied(error.isEmpty(), error, pages, pageSize);
+}
+
+void OnlineBackup::finish(bool ok, const QString &error, int pages, int pageSize)
+{
+    if (ok) {
+        QFile::remove(m_targetPath);
+        ok = QFile::rename(m_tmpPath, m_targetPath);
+    }
+    if (!ok) QFile::remove(m_tmpPath);
+    m_tmpPath.clear();
+
+    const qint64 elapsedMs = qMax<qint64>(1, m_elapsed.elapsed());
+    const double mb = double(pages) * pageSize / (1024.0 * 1024.0);
+
+    // 对请求的影响：备份期间写出的请求的端到端延迟，对比备份开始前的累计分布
+    QVector<quint64> during(LatencyHistogram::kBucketCount);
+    RequestTracer::instance()->overall(RequestTracer::TotalSpan).bucketCounts(during.data());
+    quint64 requests = 0;
+    qint64 maxUs = 0;
+    for (int i = 0; i < during.size(); ++i) {
+        during[i] -= m_latencyBefore.at(i);
+        requests += during.at(i);
+        if (during.at(i)) maxUs = LatencyHistogram::bucketUpperBound(i);
+    }
+
+    QJsonObject report;
+    report["ok"]              = ok;
+    report["path"]            = ok ? m_targetPath : QString();
+    report["pages"]           = pages;
+    report["page_size"]       = pageSize;
+    report["elapsed_ms"]      = elapsedMs;
+    report["mb_per_s"]        = mb * 1000.0 / elapsedMs;
+    report["requests"]        = static_cast<qint64>(requests);
+    report["p50_ms"]          = LatencyHistogram::percentileOf(during.constData(), 0.50) / 1e3;
+    report["p99_ms"]          = LatencyHistogram::percentileOf(during.constData(), 0.99) / 1e3;
+    report["max_ms"]          = maxUs / 1e3;
+    report["baseline_p50_ms"] = LatencyHistogram::percentileOf(m_latencyBefore.constData(), 0.50) / 1e3;
+    report["baseline_p99_ms"] = LatencyHistogram::percentileOf(m_latencyBefore.constData(), 0.99) / 1e3;
+    if (!error.isEmpty()) report["error"] = error;
+    {
+        QMutexLocker lock(&m_stateMutex);
+        m_lastReport = report;
+        if (ok) m_lastBackupPath = m_targetPath;
+        m_running = false;
+    }
+
+    if (ok) {
+        emit log(QString("backup done: %1 pages (%2 MB) in %3 ms, %4 MB/s; %5 requests meanwhile, p99 %6 ms (before %7 ms)")
+                     .arg(pages).arg(mb, 0, 'f', 1).arg(elapsedMs)
+                     .arg(report["mb_per_s"].toDouble(), 0, 'f', 1)
+                     .arg(static_cast<qint64>(requests))
+                     .arg(report["p99_ms"].toDouble(), 0, 'f', 2)
+                     .arg(report["baseline_p99_ms"].toDouble(), 0, 'f', 2));
+    } else {
+        emit wrnLog("backup failed: " + error);
+    }
+    emit backupFinished(ok, report);
+
+    // 等这次备份的导出依次开始
+    const QList<PendingExport> pending = m_pendingExports;
+    m_pendingExports.clear();
+    const QString source = m_targetPath;
+    bool allDone = true;
+    for (const QFuture<void> &f : m_exports.futures()) allDone = allDone && f.isFinished();
+    if (allDone) m_exports.clearFutures();   // 不让已结束的导出一直攒着
+    for (const PendingExport &e : pending) {
+        if (ok) {
+            m_exports.addFuture(QtConcurrent::run([this, source, e]() {
+                runExport(source, e.tables, e.outPath);
+            }));
+        } else {
+            emit exportFinished(false, e.outPath, 0, 0);
+        }
+    }
+
+    // 备份期间又提交了导出：再做一次备份给它们
+    if (!m_queuedExports.isEmpty()) startBackup();
+}
+
+void OnlineBackup::startExport(const QStringList &tables, const QString &outPath)
+{
+    // 总是排在一次新备份之后：进行中的备份是提交之前开始的，等它结束后再备份一次
+    m_queuedExports.append(PendingExport{tables, outPath});
+    if (!isRunning()) startBackup();
+}
+
+// 在工作线程里执行：独立连接读备份文件，边读边压缩写出
+void OnlineBackup::runExport(const QString &source, const QStringList &tables, const QString &outPath)
+{
+    const QString conn = QString("export_%1").arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    bool ok = true;
+    qint64 rows = 0;
+    qint64 bytes = 0;
+
+    {
+        QSqlDatabase src = QSqlDatabase::addDatabase("QSQLITE", conn);
+        src.setDatabaseName(source);
+        src.setConnectOptions("QSQLITE_OPEN_READONLY");
+
+        QFile out(outPath + ".part");
+        if (!src.open() || !out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            ok = false;
+        } else {
+            out.write(kExportMagic, sizeof(kExportMagic) - 1);
+
+            auto writeChunk = [&out, &bytes](const QJsonObject &chunk) {
+                const QByteArray z = qCompress(QJsonDocument(chunk).toJson(QJsonDocument::Compact));
+                uchar len[4];
+                qToBigEndian<quint32>(static_cast<quint32>(z.size()), len);
+                out.write(reinterpret_cast<const char *>(len), 4);
+                out.write(z);
+                bytes += 4 + z.size();
+            };
+
+            for (const QString &table : tables) {
+                // 表名只允许出现在备份库里的表，防止拼接注入
+                QSqlQuery chk(src);
+                chk.prepare("SELECT 1 FROM sqlite_master WHERE type='table' AND name=?");
+                chk.addBindValue(table);
+                if (!chk.exec() || !chk.next()) {
+                    qWarning() << "[Export] skip unknown table" << table;
+                    continue;
+                }
+
+                QSqlQuery q(src);
+                q.setForwardOnly(true);
+                if (!q.exec(QString("SELECT * FROM \"%1\"").arg(table))) {
+                    ok = false;
+                    break;
+                }
+
+                QJsonArray columns;
+                const QSqlRecord rec = q.record();
+                for (int i = 0; i < rec.count(); ++i) columns.append(rec.fieldName(i));
+
+                QJsonArray chunkRows;
+                while (q.next()) {
+                    QJsonArray row;
+                    for (int i = 0; i < rec.count(); ++i)
+                        row.append(QJsonValue::fromVariant(q.value(i)));
+                    chunkRows.append(row);
+                    ++rows;
+                    if (chunkRows.size() >= kRowsPerChunk) {
+                        writeChunk(QJsonObject{{"table", table}, {"columns", columns}, {"rows", chunkRows}});
+                        chunkRows = QJsonArray();
+                    }
+                }
+                if (!chunkRows.isEmpty())
+                    writeChunk(QJsonObject{{"table", table}, {"columns", columns}, {"rows", chunkRows}});
+            }
+            ok = ok && out.error() == QFileDevice::NoError;
+            out.close();
+        }
+        src.close();
+    }
+    QSqlDatabase::removeDatabase(conn);
+
+    if (ok) {
+        QFile::remove(outPath);
+        ok = QFile::rename(outPath + ".part", outPath);
+    } else {
+        QFile::remove(outPath + ".part");
+    }
+
+    emit log(QString("export %1: %2 rows, %3 bytes -> %4")
+                 .arg(ok ? "done" : "failed").arg(rows).arg(bytes).arg(outPath));
+    emit exportFinished(ok, outPath, rows, bytes);
+}
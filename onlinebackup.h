@@ -0,0 +1,93 @@
+#ifndef ONLINEBACKUP_H
+#define ONLINEBACKUP_H
+
+#include <QObject>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QStringList>
+#include <QList>
+#include <QFuture>
+#include <QFutureSynchronizer>
+#include <QVector>
+
+class QTimer;
+
+// 在线热备份：在工作线程里用独立的只读 QSQLITE 连接执行 VACUUM INTO，
+// 在同一个读事务里把快照整体写到临时文件。WAL 下读事务不挡写，请求照常执行。
+// 走 Qt 驱动自带的 SQLite，进程里不会出现第二份 SQLite 库。结束后原子改名为正式备份文件。
+// 另外支持导出指定表：每次导出都排在一次新备份之后，从这份快照流式读出，分块 + 压缩，不碰主库。
+class OnlineBackup : public QObject
+{
+    Q_OBJECT
+public:
+    OnlineBackup(const QString &dbPath, const QString &backupDir, QObject *parent = nullptr);
+    ~OnlineBackup();
+
+    // 以下三个可在任意线程调用
+    bool isRunning() const;
+
+    // 最近一次备份的报告：{ ok, path, pages, page_size, elapsed_ms, mb_per_s,
+    //   requests, p50_ms, p99_ms, max_ms, baseline_p50_ms, baseline_p99_ms }
+    // requests 起为备份期间写出的请求端到端延迟（RequestTracer 的 total），baseline_* 为备份开始前的累计分布
+    QJsonObject lastReport() const;
+
+    // 最近一次成功备份的文件
+    QString lastBackupPath() const;
+
+public slots:
+    // 开始一次备份（异步）；已在进行时返回 false
+    bool startBackup();
+
+    // 定时备份，intervalMinutes <= 0 关闭
+    void setSchedule(int intervalMinutes);
+
+    // 导出指定表到 outPath：先排队，等提交之后开始的那次备份完成，再从它导出。
+    // 备份进行中提交的导出等下一次备份，不用提交之前的旧快照
+    void startExport(const QStringList &tables, const QString &outPath);
+
+signals:
+    void backupFinished(bool ok, const QJsonObject &report);
+    void exportFinished(bool ok, const QString &path, qint64 rows, qint64 bytes);
+    void log(const QString &logStr);
+    void wrnLog(const QString &wrnStr);
+
+    // 工作线程 -> 本对象所在线程
+    void snapshotCopied(bool ok, const QString &error, int pages, int pageSize);
+
+private slots:
+    void finish(bool ok, const QString &error, int pages, int pageSize);
+
+private:
+    void runBackup(const QString &tmpPath);
+    void runExport(const QString &source, const QStringList &tables, const QString &outPath);
+
+    QString m_dbPath;
+    QString m_dir;
+
+    QTimer *m_scheduleTimer;
+    QFuture<void> m_future;
+
+    QString m_tmpPath;
+    QString m_targetPath;
+
+    // 统计
+    QElapsedTimer m_elapsed;
+    QVector<quint64> m_latencyBefore;   // 备份开始时 RequestTracer 总延迟直方图的各桶计数
+    QJsonObject m_lastReport;
+    QString m_lastBackupPath;
+    bool m_running;
+    mutable QMutex m_stateMutex;     // 保护 m_lastReport / m_lastBackupPath / m_running
+
+    // m_pendingExports：等当前这次备份结束后要做的导出（开始备份时从 m_queuedExports 取走）
+    // m_queuedExports：还没有对应备份的导出，下一次备份开始时接手
+    struct PendingExport {
+        QStringList tables;
+        QString outPath;
+    };
+    QList<PendingExport> m_pendingExports;
+    QList<PendingExport> m_queuedExports;
+    QFutureSynchronizer<void> m_exports;   // 进行中的导出，析构时等它们结束
+};
+
+#endif // ONLINEBACKUP_H
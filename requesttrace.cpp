@@ -0,0 +1,162 @@
+#include "requesttrace.h"
+
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QJsonArray>
+
+// 类型数量上限：请求类型来自客户端，防止随意的 type 撑爆表
+static const int kMaxTypes = 64;
+static const int kSlowSamples = 64;
+
+static QElapsedTimer &monotonicClock()
+{
+    static QElapsedTimer clock;
+    static bool started = (clock.start(), true);
+    Q_UNUSED(started);
+    return clock;
+}
+
+RequestTrace::RequestTrace()
+{
+    for (int i = 0; i < StageCount; ++i) t[i] = 0;
+}
+
+qint64 RequestTrace::now()
+{
+    return monotonicClock().nsecsElapsed();
+}
+
+RequestTracer::RequestTracer()
+    : m_slowNext(0)
+    , m_slowThresholdUs(200 * 1000)
+{
+}
+
+RequestTracer *RequestTracer::instance()
+{
+    static RequestTracer tracer;
+    return &tracer;
+}
+
+const char *RequestTracer::spanName(int span)
+{
+    static const char *const names[SpanCount] = {
+        "parse", "admit", "queue", "prepare", "handler", "serialize", "send", "total"
+    };
+    return span >= 0 && span < SpanCount ? names[span] : "";
+}
+
+void RequestTracer::setSlowThresholdMs(int ms)
+{
+    QMutexLocker locker(&m_slowMutex);
+    m_slowThresholdUs = static_cast<qint64>(ms) * 1000;
+}
+
+RequestTracer::Histograms *RequestTracer::histogramsFor(const QString &type)
+{
+    {
+        QReadLocker locker(&m_typesLock);
+        Histograms *h = m_types.value(type);
+        if (h) return h;
+    }
+
+    QWriteLocker locker(&m_typesLock);
+    Histograms *&h = m_types[m_types.size() >= kMaxTypes && !m_types.contains(type)
+                                 ? QStringLiteral("other") : type];
+    if (!h) h = new Histograms;
+    return h;
+}
+
+QStringList RequestTracer::types() const
+{
+    QReadLocker locker(&m_typesLock);
+    return m_types.keys();
+}
+
+const LatencyHistogram *RequestTracer::histogram(const QString &type, Span span) const
+{
+    QReadLocker locker(&m_typesLock);
+    const Histograms *h = m_types.value(type);
+    return h ? &h->spans[span] : nullptr;
+}
+
+void RequestTracer::record(const RequestTrace &trace)
+{
+    // 缺失的阶段（被拒绝、被合并的请求）沿用前一个时间戳，即该段计 0
+    qint64 t[RequestTrace::StageCount];
+    for (int i = 0; i < RequestTrace::StageCount; ++i) {
+        t[i] = trace.t[i] ? trace.t[i] : (i > 0 ? t[i - 1] : 0);
+    }
+    if (t[RequestTrace::Receive] == 0) return;
+
+    qint64 us[SpanCount];
+    for (int s = 0; s < TotalSpan; ++s) {
+        us[s] = (t[s + 1] - t[s]) / 1000;
+    }
+    us[TotalSpan] = (t[RequestTrace::Write] - t[RequestTrace::Receive]) / 1000;
+
+    Histograms *h = histogramsFor(trace.type);
+    for (int s = 0; s < SpanCount; ++s) {
+        m_all.spans[s].record(us[s]);
+        h->spans[s].record(us[s]);
+    }
+
+    QMutexLocker locker(&m_slowMutex);
+    if (us[TotalSpan] < m_slowThresholdUs) return;
+    SlowSample sample;
+    sample.type = trace.type;
+    sample.atMs = QDateTime::currentMSecsSinceEpoch();
+    for (int s = 0; s < SpanCount; ++s) sample.spanUs[s] = us[s];
+    if (m_slow.size() < kSlowSamples) {
+        m_slow.append(sample);
+    } else {
+        m_slow[m_slowNext] = sample;
+    }
+    m_slowNext = (m_slowNext + 1) % kSlowSamples;
+}
+
+QJsonObject RequestTracer::summarize(const Histograms &h)
+{
+    QJsonObject o;
+    for (int s = 0; s < SpanCount; ++s) {
+        o[spanName(s)] = h.spans[s].summary();
+    }
+    return o;
+}
+
+QJsonObject RequestTracer::snapshot() const
+{
+    QJsonObject types;
+    {
+        QReadLocker locker(&m_typesLock);
+        for (auto it = m_types.constBegin(); it != m_types.constEnd(); ++it) {
+            types[it.key()] = summarize(*it.value());
+        }
+    }
+
+    QJsonArray slow;
+    qint64 threshold;
+    {
+        QMutexLocker locker(&m_slowMutex);
+        threshold = m_slowThresholdUs;
+        // 从最新的开始
+        for (int i = 0; i < m_slow.size(); ++i) {
+            const int idx = (m_slowNext - 1 - i + m_slow.size()) % m_slow.size();
+            const SlowSample &sample = m_slow.at(idx);
+            QJsonObject o;
+            o["type"] = sample.type;
+            o["at"] = QDateTime::fromMSecsSinceEpoch(sample.atMs).toString(Qt::ISODateWithMs);
+            for (int s = 0; s < SpanCount; ++s) {
+                o[QString::fromLatin1(spanName(s)) + "_us"] = sample.spanUs[s];
+            }
+            slow.append(o);
+        }
+    }
+
+    QJsonObject o;
+    o["slow_threshold_ms"] = threshold / 1000;
+    o["all"] = summarize(m_all);
+    o["types"] = types;
+    o["slow"] = slow;
+    return o;
+}
@@ -0,0 +1,106 @@
+#ifndef REQUESTTRACE_H
+#define REQUESTTRACE_H
+
+#include <QString>
+#include <QHash>
+#include <QList>
+#include <QStringList>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QJsonObject>
+#include <QSharedPointer>
+#include <QMetaType>
+#include "latencyhistogram.h"
+
+// 单个请求在各阶段的时间戳（单调时钟，纳秒）。
+// 同一时刻只有一个线程持有它（网络线程 → 工作线程 → 网络线程，经排队信号传递），不加锁。
+struct RequestTrace
+{
+    enum Stage {
+        Receive = 0,    // 收到帧头
+        Parse,          // JSON 解析完成
+        Enqueue,        // 进入执行队列
+        Dequeue,        // 工作线程取出
+        HandlerStart,   // 开始执行请求处理函数（数据库访问、组装应答等都在其中）
+        HandlerEnd,     // 处理函数给出应答
+        Serialize,      // 应答序列化完成
+        Write,          // 交给内核 / 套接字缓冲
+        StageCount
+    };
+
+    RequestTrace();
+
+    QString type;
+    qint64 t[StageCount];
+
+    void stamp(Stage stage) { t[stage] = now(); }
+    void stampAt(Stage stage, qint64 ns) { t[stage] = ns; }
+
+    static qint64 now();
+};
+
+typedef QSharedPointer<RequestTrace> RequestTracePtr;
+Q_DECLARE_METATYPE(RequestTracePtr)
+
+// 汇总各请求类型、各阶段的耗时分布，并保留最近的慢请求完整分解。
+// record() 在写出线程调用：类型查找只拿读锁，直方图更新无锁。
+class RequestTracer
+{
+public:
+    // 相邻时间戳之间的区间
+    enum Span {
+        ParseSpan = 0,  // Receive      -> Parse
+        AdmitSpan,      // Parse        -> Enqueue
+        QueueSpan,      // Enqueue      -> Dequeue
+        PrepareSpan,    // Dequeue      -> HandlerStart
+        HandlerSpan,    // HandlerStart -> HandlerEnd：整个处理函数，不单是数据库访问
+        SerializeSpan,  // HandlerEnd   -> Serialize
+        SendSpan,       // Serialize    -> Write
+        TotalSpan,      // Receive      -> Write
+        SpanCount
+    };
+
+    static RequestTracer *instance();
+
+    // 请求已写出：计入直方图，超过慢阈值则保存样本
+    void record(const RequestTrace &trace);
+
+    void setSlowThresholdMs(int ms);
+
+    // { slow_threshold_ms, all:{ span:{summary} }, types:{ type:{ span:{summary} } }, slow:[ ... ] }
+    QJsonObject snapshot() const;
+
+    static const char *spanName(int span);
+
+    // 指标导出用：已出现的类型，和某类型 / 全部请求某一段的直方图（直方图不会被释放）
+    QStringList types() const;
+    const LatencyHistogram *histogram(const QString &type, Span span) const;
+    const LatencyHistogram &overall(Span span) const { return m_all.spans[span]; }
+
+private:
+    RequestTracer();
+
+    struct Histograms {
+        LatencyHistogram spans[SpanCount];
+    };
+
+    Histograms *histogramsFor(const QString &type);
+    static QJsonObject summarize(const Histograms &h);
+
+    Histograms m_all;
+    QHash<QString, Histograms*> m_types;   // 只增不删
+    mutable QReadWriteLock m_typesLock;
+
+    // 慢请求样本环
+    struct SlowSample {
+        QString type;
+        qint64 atMs;
+        qint64 spanUs[SpanCount];
+    };
+    QList<SlowSample> m_slow;
+    int m_slowNext;
+    qint64 m_slowThresholdUs;
+    mutable QMutex m_slowMutex;
+};
+
+#endif // REQUESTTRACE_H
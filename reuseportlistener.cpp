@@ -0,0 +1,133 @@
+#include "reuseportlistener.h"
+#include "requesttrace.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+ReusePortListener::ReusePortListener(int index, quint32 generation, QObject *parent)
+    : QTcpServer(parent)
+    , m_index(index)
+    , m_generation(generation)
+    , m_accepted(0)
+    , m_windowSec(0)
+    , m_windowCount(0)
+    , m_lastRate(0)
+    , m_peakRate(0)
+{
+}
+
+bool ReusePortListener::isSupported()
+{
+#if defined(Q_OS_UNIX) && defined(SO_REUSEPORT)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool ReusePortListener::listenShared(const QString &addressText, quint16 port)
+{
+#if defined(Q_OS_UNIX) && defined(SO_REUSEPORT)
+    const QHostAddress address = addressText.isEmpty() ? QHostAddress(QHostAddress::Any) : QHostAddress(addressText);
+    const bool v6 = address.protocol() == QAbstractSocket::IPv6Protocol || address == QHostAddress::Any;
+    struct sockaddr_storage ss;
+    memset(&ss, 0, sizeof(ss));
+    socklen_t len;
+    if (v6) {
+        struct sockaddr_in6 *sa = reinterpret_cast<struct sockaddr_in6 *>(&ss);
+        sa->sin6_family = AF_INET6;
+        sa->sin6_port = htons(port);
+        const Q_IPV6ADDR a = address == QHostAddress::Any ? QHostAddress(QHostAddress::AnyIPv6).toIPv6Address()
+                                                          : address.toIPv6Address();
+        memcpy(&sa->sin6_addr, &a, sizeof(a));
+        len = sizeof(*sa);
+    } else {
+        struct sockaddr_in *sa = reinterpret_cast<struct sockaddr_in *>(&ss);
+        sa->sin_family = AF_INET;
+        sa->sin_port = htons(port);
+        sa->sin_addr.s_addr = htonl(address.toIPv4Address());
+        len = sizeof(*sa);
+    }
+
+    const int fd = ::socket(v6 ? AF_INET6 : AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        m_error = QString::fromLocal8Bit(strerror(errno));
+        return false;
+    }
+    const int on = 1;
+    const int off = 0;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    // 同一端口上的每个监听套接字都必须设置，内核按四元组哈希分配新连接
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    if (v6) ::setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));    // Any 同时收 IPv4
+    ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+
+    if (::bind(fd, reinterpret_cast<struct sockaddr *>(&ss), len) < 0
+        || ::listen(fd, SOMAXCONN) < 0) {
+        m_error = QString::fromLocal8Bit(strerror(errno));
+        ::close(fd);
+        return false;
+    }
+
+    // 交给 QTcpServer：之后的可读通知、accept 都在本线程的事件循环里
+    if (!setSocketDescriptor(fd)) {
+        m_error = errorString();
+        ::close(fd);
+        return false;
+    }
+    return true;
+#else
+    Q_UNUSED(addressText);
+    Q_UNUSED(port);
+    m_error = "SO_REUSEPORT is not supported on this platform";
+    return false;
+#endif
+}
+
+void ReusePortListener::closeShared()
+{
+    close();
+}
+
+void ReusePortListener::incomingConnection(qintptr socketDescriptor)
+{
+    ++m_accepted;
+
+    // 按整秒滚动计数；只有本线程写
+    const qint64 sec = RequestTrace::now() / 1000000000LL;
+    if (sec != m_windowSec.load(std::memory_order_relaxed)) {
+        const quint32 rate = sec == m_windowSec.load(std::memory_order_relaxed) + 1 ? m_windowCount.load() : 0;
+        m_lastRate.store(rate, std::memory_order_relaxed);
+        m_windowSec.store(sec, std::memory_order_relaxed);
+        m_windowCount.store(0, std::memory_order_relaxed);
+    }
+    const quint32 count = m_windowCount.fetch_add(1, std::memory_order_relaxed) + 1;
+    if (count > m_peakRate.load(std::memory_order_relaxed)) m_peakRate.store(count, std::memory_order_relaxed);
+
+    // 不在这里建 QTcpSocket：套接字对象归同线程的分片 JsonTcpServer 管
+    emit descriptorAccepted(socketDescriptor, m_index, m_generation);
+}
+
+QJsonObject ReusePortListener::stats() const
+{
+    // 窗口已经过去（之后没有新连接）时，最近一秒的速率按 0 计
+    const qint64 sec = RequestTrace::now() / 1000000000LL;
+    const qint64 window = m_windowSec.load(std::memory_order_relaxed);
+    quint32 rate = 0;
+    if (sec == window) rate = m_lastRate.load(std::memory_order_relaxed);
+    else if (sec == window + 1) rate = m_windowCount.load(std::memory_order_relaxed);
+
+    QJsonObject o;
+    o["listener"]    = m_index;
+    o["accepted"]    = static_cast<qint64>(m_accepted.load());
+    o["accept_rate"] = static_cast<qint64>(rate);
+    o["peak_rate"]   = static_cast<qint64>(m_peakRate.load(std::memory_order_relaxed));
+    return o;
+}
@@ -0,0 +1,53 @@
+#ifndef REUSEPORTLISTENER_H
+#define REUSEPORTLISTENER_H
+
+#include <QTcpServer>
+#include <QHostAddress>
+#include <QJsonObject>
+#include <atomic>
+
+// 接入分片：同一端口上开多个 SO_REUSEPORT 监听套接字，每个放在自己的 I/O 线程里，
+// 由内核把新连接分散到各个监听者上，accept 不再挤在界面线程。
+// 每个监听者属于同线程的一个分片 JsonTcpServer（见 JsonTcpServer::setAcceptThreads），
+// 接到的描述符经 descriptorAccepted 直连交给它，就地包成 QTcpSocket；之后这个连接的读写、
+// 拆帧、解析都在该线程里，集中重连时的开销按监听者摊开。
+// 每批监听者带一个代数，分片只接手本批监听者的描述符。
+class ReusePortListener : public QTcpServer
+{
+    Q_OBJECT
+public:
+    ReusePortListener(int index, quint32 generation, QObject *parent = nullptr);
+
+    int index() const { return m_index; }
+    quint32 generation() const { return m_generation; }
+
+    // 当前平台能否开 SO_REUSEPORT
+    static bool isSupported();
+
+    // 在监听者所在线程里调用（BlockingQueuedConnection）：建好套接字并开始监听。
+    // 地址用字符串传，跨线程调用不必注册 QHostAddress；空串表示 QHostAddress::Any（双栈）
+    Q_INVOKABLE bool listenShared(const QString &addressText, quint16 port);
+    Q_INVOKABLE void closeShared();
+    QString lastError() const { return m_error; }
+
+    // { listener, accepted, accept_rate, peak_rate }；rate 为最近一个整秒的接入数
+    QJsonObject stats() const;
+
+signals:
+    void descriptorAccepted(qintptr descriptor, int listener, quint32 generation);
+
+protected:
+    void incomingConnection(qintptr socketDescriptor) override;
+
+private:
+    int m_index;
+    quint32 m_generation;
+    QString m_error;
+    std::atomic<quint64> m_accepted;
+    std::atomic<qint64> m_windowSec;        // 当前计数窗口（单调秒）
+    std::atomic<quint32> m_windowCount;
+    std::atomic<quint32> m_lastRate;
+    std::atomic<quint32> m_peakRate;
+};
+
+#endif // REUSEPORTLISTENER_H
@@ -1,6 +1,7 @@
 QT       += core gui
 QT       += network
 QT       += sql
+QT       += concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -18,22 +19,59 @@ DEFINES += QT_DEPRECATED_WARNINGS
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
 SOURCES += \
+    dashboardpanel.cpp \
+    diseasestatscube.cpp \
+    dataarchiver.cpp \
+    doctorconsolecounters.cpp \
+    framecompressor.cpp \
+    fulltextsearch.cpp \
+    idletracker.cpp \
     jsonhandle.cpp \
     jsonhandlequeue.cpp \
     jsontcpserver.cpp \
+    latencyhistogram.cpp \
     logout.cpp \
     main.cpp \
+    metrics.cpp \
+    metricsserver.cpp \
+    onlinebackup.cpp \
+    requesttrace.cpp \
+    reuseportlistener.cpp \
+    singleflight.cpp \
     sqldatabase.cpp \
+    sqlprofiler.cpp \
+    trafficcapture.cpp \
+    websocketcodec.cpp \
     widget.cpp
 
 HEADERS += \
+    connectiontable.h \
+    dashboardpanel.h \
+    diseasestatscube.h \
+    dataarchiver.h \
+    doctorconsolecounters.h \
+    framecompressor.h \
+    fulltextsearch.h \
+    idletracker.h \
     jsonhandle.h \
     jsonhandlequeue.h \
     jsontcpserver.h \
+    latencyhistogram.h \
     logout.h \
+    metrics.h \
+    metricsserver.h \
+    onlinebackup.h \
+    requesttrace.h \
+    reuseportlistener.h \
+    singleflight.h \
     sqldatabase.h \
+    sqlprofiler.h \
+    trafficcapture.h \
+    websocketcodec.h \
     widget.h
 
+LIBS += -lz
+
 FORMS += \
     widget.ui
 
@@ -0,0 +1,56 @@
+#include "singleflight.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+SingleFlight::SingleFlight()
+    : m_leaders(0)
+    , m_followers(0)
+{
+}
+
+bool SingleFlight::join(const QString &key, ConnectionId client, const QJsonValue &seq,
+                        const RequestTracePtr &trace)
+{
+    QMutexLocker locker(&m_mutex);
+    auto it = m_inflight.find(key);
+    if (it != m_inflight.end()) {
+        it.value().append(Waiter{client, seq, trace});
+        ++m_followers;
+        return false;
+    }
+    m_inflight.insert(key, QList<Waiter>{Waiter{client, seq, trace}});
+    ++m_leaders;
+    return true;
+}
+
+QList<SingleFlight::Waiter> SingleFlight::finish(const QString &key)
+{
+    QMutexLocker locker(&m_mutex);
+    return m_inflight.take(key);
+}
+
+QByteArray SingleFlight::withSeq(const QByteArray &body, const QJsonValue &seq)
+{
+    if (seq.isUndefined() || !body.startsWith('{')) return body;
+
+    // 单个值序列化：借一个数组再去掉两侧的方括号
+    QByteArray value = QJsonDocument(QJsonArray{seq}).toJson(QJsonDocument::Compact);
+    value = value.mid(1, value.size() - 2);
+
+    QByteArray out;
+    out.reserve(body.size() + value.size() + 8);
+    out.append("{\"seq\":");
+    out.append(value);
+    if (body.size() > 2) out.append(',');
+    out.append(body.constData() + 1, body.size() - 1);
+    return out;
+}
+
+QJsonObject SingleFlight::stats() const
+{
+    QJsonObject o;
+    o["leaders"]   = static_cast<qint64>(m_leaders.load());
+    o["followers"] = static_cast<qint64>(m_followers.load());
+    return o;
+}
@@ -0,0 +1,50 @@
+#ifndef SINGLEFLIGHT_H
+#define SINGLEFLIGHT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QJsonValue>
+#include <QJsonObject>
+#include <atomic>
+#include "requesttrace.h"
+#include "connectiontable.h"
+
+// 相同读请求合并（single-flight）：同一个键（请求类型 + 参数）正在执行时，
+// 后到的请求不再执行，只登记自己的连接和 seq；执行完的那一个把结果序列化一次，
+// 分发给所有登记者。后到者不占工作线程等待。
+class SingleFlight
+{
+public:
+    struct Waiter {
+        ConnectionId client;
+        QJsonValue seq;     // 请求里的 seq，没有则为 Undefined
+        RequestTracePtr trace;
+    };
+
+    SingleFlight();
+
+    // 返回 true：调用方是领头者，执行后必须调用 finish(key)；
+    // 返回 false：已挂到在途的同键请求上，调用方直接返回
+    bool join(const QString &key, ConnectionId client, const QJsonValue &seq,
+              const RequestTracePtr &trace = RequestTracePtr());
+
+    // 领头者执行完：取走所有等待者（含领头者自己），之后同键请求重新执行
+    QList<Waiter> finish(const QString &key);
+
+    // 把应答正文（已去掉 seq 的紧凑 JSON）拼上某个等待者的 seq，不重新序列化
+    static QByteArray withSeq(const QByteArray &body, const QJsonValue &seq);
+
+    // { leaders, followers }
+    QJsonObject stats() const;
+
+private:
+    mutable QMutex m_mutex;
+    QHash<QString, QList<Waiter> > m_inflight;
+    std::atomic<quint64> m_leaders;
+    std::atomic<quint64> m_followers;
+};
+
+#endif // SINGLEFLIGHT_H
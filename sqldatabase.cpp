@@ -6,18 +6,33 @@
 #include <QDir>
 #include <QSqlRecord>
 #include <QVariant>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QThread>
+#include <QAtomicInt>
 
 // =============== 构造/析构 ===============
 SqlDataBase::SqlDataBase(QString dataPath, QObject *parent)
-    : QObject(parent), dbPath(std::move(dataPath))
+    : QObject(parent), dbPath(std::move(dataPath)), statsDataVersion(-1)
+    , archiveHorizonDays(365), archiveTableIndex(-1), archiveTableMoved(0)
 {
     dbMutex = new QMutex();
 
     if (QDir(dbPath).isRelative())
         dbPath = QCoreApplication::applicationDirPath() + "/" + dbPath;
 
+    archiver = new DataArchiver(dbPath);
+
+    // 各组件自己执行的语句也记进同一个剖析器
+    archiver->setProfiler(&profiler);
+    statsCube.setProfiler(&profiler);
+    consoleCounters.setProfiler(&profiler);
+    fullText.setProfiler(&profiler);
+
     db = QSqlDatabase::addDatabase("QSQLITE");   // 需要 .pro: QT += sql
     db.setDatabaseName(dbPath);
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
 
     if (!db.open()) {
         qWarning() << "[DB] open failed:" << db.lastError().text()
@@ -25,14 +40,297 @@ SqlDataBase::SqlDataBase(QString dataPath, QObject *parent)
     } else {
         qDebug() << "[DB] connected. exists?" << QFile::exists(dbPath)
                  << " path=" << QFileInfo(dbPath).absoluteFilePath();
+
+        // 多个工作线程各有连接：WAL 下读不阻塞写，写之间靠 busy timeout 排队
+        QSqlQuery wal(db);
+        if (!exec(wal, "PRAGMA journal_mode=WAL"))
+            qWarning() << "[DB] enable WAL failed:" << wal.lastError().text();
+
+        // 统计立方体：启动时全量加载，之后定期检查 disease_stats 是否被改动
+        statsDataVersion = dataVersion();
+        statsFingerprint = diseaseStatsFingerprint();
+        statsCube.load(db);
+
+        // 医生仪表盘计数：启动时载入内存，之后由写路径累加、定时写回
+        consoleCounters.load(db);
+
+        // 病历/医嘱/消息全文索引（触发器同步；短词用的单字索引由 syncFullText 定时补）
+        fullText.setup(db);
     }
+
+    statsRefreshTimer = new QTimer(this);
+    connect(statsRefreshTimer, &QTimer::timeout, this, &SqlDataBase::refreshDiseaseStats);
+    statsRefreshTimer->start(5000);
+
+    consoleFlushTimer = new QTimer(this);
+    connect(consoleFlushTimer, &QTimer::timeout, this, &SqlDataBase::flushDoctorConsole);
+    consoleFlushTimer->start(2000);
+
+    fullTextSyncTimer = new QTimer(this);
+    connect(fullTextSyncTimer, &QTimer::timeout, this, &SqlDataBase::syncFullText);
+    fullTextSyncTimer->start(1000);
+
+    // 历史数据归档：启动后跑一次，之后每 6 小时一次
+    archiveTimer = new QTimer(this);
+    connect(archiveTimer, &QTimer::timeout, this, &SqlDataBase::runArchival);
+    archiveTimer->start(6 * 3600 * 1000);
+    QTimer::singleShot(60 * 1000, this, &SqlDataBase::runArchival);
+
+    // 在线备份：每天一次，另可由 admin 手动触发
+    backup = new OnlineBackup(dbPath, QFileInfo(dbPath).absolutePath() + "/backup", this);
+    connect(backup, &OnlineBackup::log, this, &SqlDataBase::log);
+    connect(backup, &OnlineBackup::wrnLog, this, &SqlDataBase::wrnLog);
+    backup->setSchedule(24 * 60);
 }
 
 SqlDataBase::~SqlDataBase() {
+    delete backup;      // 先结束进行中的备份，再关库
+    flushDoctorConsole();
     if (db.isOpen()) db.close();
+    delete archiver;
     delete dbMutex;
 }
 
+// =============== 每线程连接 ===============
+QSqlDatabase SqlDataBase::connection()
+{
+    if (QThread::currentThread() == thread()) return db;
+    if (threadConnections.hasLocalData()) return threadConnections.localData();
+
+    const QString name = QString("sever0_worker_%1")
+                             .arg(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+    QSqlDatabase conn = QSqlDatabase::addDatabase("QSQLITE", name);
+    conn.setDatabaseName(dbPath);
+    conn.setConnectOptions("QSQLITE_BUSY_TIMEOUT=5000");
+    if (!conn.open()) {
+        qWarning() << "[DB] open worker connection failed:" << conn.lastError().text();
+    }
+    threadConnections.setLocalData(conn);
+    ++workerConnections;
+
+    // 线程退出时（仍在该线程内）释放连接；不带 context 对象，保证直接调用
+    connect(QThread::currentThread(), &QThread::finished, [this, name]() {
+        threadConnections.setLocalData(QSqlDatabase());
+        QSqlDatabase::removeDatabase(name);
+        --workerConnections;
+    });
+    return conn;
+}
+
+// =============== 统计立方体刷新 ===============
+// PRAGMA data_version 只在其他连接提交后变化，不读表，开销可忽略；
+// 变化后再比对 disease_stats 的指纹，确有改动才重建立方体
+qint64 SqlDataBase::dataVersion()
+{
+    QSqlQuery q(db);
+    if (exec(q, "PRAGMA data_version") && q.next())
+        return q.value(0).toLongLong();
+    return -1;
+}
+
+QString SqlDataBase::diseaseStatsFingerprint()
+{
+    QSqlQuery q(db);
+    if (exec(q, "SELECT COUNT(*), TOTAL(count), MAX(stat_id) FROM disease_stats") && q.next())
+        return QString("%1/%2/%3").arg(q.value(0).toString(), q.value(1).toString(), q.value(2).toString());
+    return QString();
+}
+
+void SqlDataBase::refreshDiseaseStats()
+{
+    QMutexLocker lock(dbMutex);
+    if (!db.isOpen()) return;
+
+    const qint64 version = dataVersion();
+    if (version == statsDataVersion && statsCube.isLoaded()) return;
+    statsDataVersion = version;
+
+    const QString fingerprint = diseaseStatsFingerprint();
+    if (fingerprint == statsFingerprint && statsCube.isLoaded()) return;
+    statsFingerprint = fingerprint;
+
+    statsCube.load(db);
+}
+
+// =============== 历史数据归档 ===============
+void SqlDataBase::setArchiveHorizonDays(int days)
+{
+    archiveHorizonDays = days;
+}
+
+// 开始一轮归档；上一轮还没搬完时不重复开始
+void SqlDataBase::runArchival()
+{
+    if (archiveHorizonDays <= 0 || !db.isOpen() || archiveTableIndex >= 0) return;
+
+    archiveTableIndex = 0;
+    archiveTableMoved = 0;
+    archivePass.start();
+    QTimer::singleShot(0, this, &SqlDataBase::archiveStep);
+}
+
+// 一次只搬一批（单独持锁），搬满说明还有剩余，重新排到事件队列末尾，
+// 这样批与批之间主线程能处理网络事件和定时器，工作线程也能拿到数据库锁
+void SqlDataBase::archiveStep()
+{
+    const QStringList tables = DataArchiver::tables();
+    if (archiveTableIndex < 0 || archiveTableIndex >= tables.size()) return;
+
+    const int batchSize = 2000;
+    const QString table = tables.at(archiveTableIndex);
+    int moved = 0;
+    QString err;
+    bool ok;
+    {
+        QMutexLocker lock(dbMutex);
+        ok = archiver->archiveBatch(db, table, archiveHorizonDays, batchSize, &moved, &err);
+    }
+    if (!ok) qWarning() << "[Archive]" << table << "failed:" << err;
+    archiveTableMoved += moved;
+
+    if (ok && moved == batchSize) {
+        QTimer::singleShot(0, this, &SqlDataBase::archiveStep);
+        return;
+    }
+
+    // 这张表搬完（或出错），换下一张
+    if (archiveTableMoved > 0) {
+        qDebug() << "[Archive]" << table << ": moved" << archiveTableMoved << "rows older than"
+                 << archiveHorizonDays << "days";
+    }
+    archiveTableMoved = 0;
+    if (++archiveTableIndex < tables.size()) {
+        QTimer::singleShot(0, this, &SqlDataBase::archiveStep);
+        return;
+    }
+    archiveTableIndex = -1;
+    qDebug() << "[Archive] pass finished in" << archivePass.elapsed() << "ms";
+}
+
+// =============== 在线备份 / 快照导出 ===============
+QString SqlDataBase::userRole(qint64 userId)
+{
+    QSqlQuery q(connection());
+    q.prepare("SELECT role FROM users WHERE user_id=? AND status=1");
+    q.addBindValue(userId);
+    if (exec(q) && q.next()) return q.value(0).toString();
+    return QString();
+}
+
+bool SqlDataBase::isAdmin(qint64 user_id)
+{
+    return userRole(user_id) == "admin";
+}
+
+QJsonObject SqlDataBase::startBackup()
+{
+    if (backup->isRunning()) {
+        return QJsonObject{{"ok", false}, {"error", "backup already running"}};
+    }
+    QMetaObject::invokeMethod(backup, "startBackup", Qt::QueuedConnection);
+    return QJsonObject{{"ok", true}, {"payload", QJsonObject{{"started", true}}}};
+}
+
+QJsonObject SqlDataBase::backupStatus()
+{
+    QJsonObject payload;
+    payload["running"]     = backup->isRunning();
+    payload["last_backup"] = backup->lastBackupPath();
+    payload["report"]      = backup->lastReport();
+    return QJsonObject{{"ok", true}, {"payload", payload}};
+}
+
+QJsonObject SqlDataBase::startExport(const QStringList& tables)
+{
+    if (tables.isEmpty()) {
+        return QJsonObject{{"ok", false}, {"error", "no tables"}};
+    }
+    // 同一秒内的两次导出也要落到不同文件
+    static QAtomicInt exportSerial;
+    const QString out = QString("%1/backup/export_%2_%3.s0snap")
+                            .arg(QFileInfo(dbPath).absolutePath(),
+                                 QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss"))
+                            .arg(exportSerial.fetchAndAddRelaxed(1));
+    QMetaObject::invokeMethod(backup, "startExport", Qt::QueuedConnection,
+                              Q_ARG(QStringList, tables), Q_ARG(QString, out));
+    return QJsonObject{{"ok", true}, {"payload", QJsonObject{{"path", out}}}};
+}
+
+QJsonObject SqlDataBase::sqlProfile(const QString& action, int sampleRate, int planThresholdMs, int limit)
+{
+    if (action == "reset") {
+        profiler.reset();
+    } else if (action == "config") {
+        if (sampleRate >= 0) profiler.setSampleRate(sampleRate);
+        if (planThresholdMs >= 0) profiler.setPlanThresholdMs(planThresholdMs);
+        emit log(QString("sql profiler: sample rate 1/%1").arg(profiler.sampleRate()));
+    } else if (action != "dump") {
+        return QJsonObject{{"ok", false}, {"error", "unknown action"}};
+    }
+    return QJsonObject{{"ok", true}, {"payload", profiler.report(limit > 0 ? limit : 50)}};
+}
+
+int SqlDataBase::openConnections() const
+{
+    return (db.isOpen() ? 1 : 0) + workerConnections.load();
+}
+
+qint64 SqlDataBase::walSizeBytes() const
+{
+    return QFileInfo(dbPath + "-wal").size();
+}
+
+qint64 SqlDataBase::fileSizeBytes() const
+{
+    return QFileInfo(dbPath).size();
+}
+
+// 需要旧数据时：挂上归档库并返回 主库 UNION ALL 归档库 的子查询
+QString SqlDataBase::tableSource(const QString& table, bool includeArchive)
+{
+    if (!includeArchive) return table;
+    QSqlDatabase conn = connection();
+    return archiver->source(conn, table, archiver->attach(conn));
+}
+
+// =============== 医生仪表盘计数写回 ===============
+void SqlDataBase::flushDoctorConsole()
+{
+    QMutexLocker lock(dbMutex);
+    if (!db.isOpen()) return;
+    consoleCounters.flush(db);
+}
+
+// =============== 单字索引同步 ===============
+void SqlDataBase::syncFullText()
+{
+    static const int kBatch = 500;
+    int synced;
+    {
+        QMutexLocker lock(dbMutex);
+        if (!db.isOpen()) return;
+        synced = fullText.syncUnigram(db, kBatch);
+    }
+    // 新建索引后的首次灌入可能有很多行：满批就回到事件循环后接着做，期间停掉定时器免得重复排队
+    if (synced == kBatch) {
+        fullTextSyncTimer->stop();
+        QTimer::singleShot(0, this, &SqlDataBase::syncFullText);
+    } else if (!fullTextSyncTimer->isActive()) {
+        fullTextSyncTimer->start();
+    }
+}
+
+// 医生的 user_id -> doctor_id（非医生返回 -1）
+qint64 SqlDataBase::doctorIdFromUser(qint64 userId)
+{
+    QSqlQuery q(connection());
+    q.prepare("SELECT doctor_id FROM doctors WHERE user_id=?");
+    q.addBindValue(userId);
+    if (exec(q) && q.next())
+        return q.value(0).toLongLong();
+    return -1;
+}
+
 // =============== 工具：中文性别映射 ===============
 QString SqlDataBase::mapGender(const QString& genderCN) const {
     if (genderCN == "男") return "M";
@@ -44,14 +342,14 @@ QString SqlDataBase::mapGender(const QString& genderCN) const {
 QJsonObject SqlDataBase::loginPatient(const QString& username, const QString& password, const QString& role)
 {
     ////QMutexLocker lock(dbMutex);
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("SELECT user_id FROM users WHERE username=? AND password=? AND role=? AND status=1");
     q.addBindValue(username);
     q.addBindValue(password);
     q.addBindValue(role);
     qDebug() << "DB:path" << db.databaseName();
     qDebug() << "username:" << username;
-    if (!q.exec()) {
+    if (!exec(q)) {
         return QJsonObject{{"ok", false}, {"error", q.lastError().text()}};
     }
     if (!q.next()) {
@@ -70,7 +368,7 @@ QJsonObject SqlDataBase::registerPatient(const QString& username, const QString&
     ////QMutexLocker lock(dbMutex);
     qDebug() << role << idCard;
     // 创建用户
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
 
     q.prepare("INSERT INTO users(username,password,role,phone,id_card,gender,address,status) "
               "VALUES(?,?,?,?,?,?,?,1)");
@@ -82,20 +380,20 @@ QJsonObject SqlDataBase::registerPatient(const QString& username, const QString&
     q.addBindValue(mapGender(genderCN)); // M/F/NULL
     q.addBindValue(address);
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         return QJsonObject{{"ok", false}, {"error", q.lastError().text()}};
     }
 
     // 取 user_id
-    QSqlQuery qid(db); qid.exec("SELECT last_insert_rowid()");
+    QSqlQuery qid(connection()); exec(qid, "SELECT last_insert_rowid()");
     qid.next(); const qint64 uid = qid.value(0).toLongLong();
 
     // 创建患者资料
-    QSqlQuery qp(db);
+    QSqlQuery qp(connection());
     qp.prepare("INSERT INTO patients(user_id, full_name) VALUES(?,?)");
     qp.addBindValue(uid);
     qp.addBindValue(realName);
-    if (!qp.exec()) {
+    if (!exec(qp)) {
         return QJsonObject{{"ok", false}, {"error", qp.lastError().text()}};
     }
 
@@ -106,10 +404,10 @@ QJsonObject SqlDataBase::registerPatient(const QString& username, const QString&
 qint64 SqlDataBase::patientIdFromUser(qint64 userId)
 {
     //QMutexLocker lock(dbMutex);
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("SELECT patient_id FROM patients WHERE user_id=?");
     q.addBindValue(userId);
-    if (!q.exec()){
+    if (!exec(q)){
         qWarning() << "patientIdFromUser exec failed:" << q.lastError().text();
         return -1;
     }
@@ -134,7 +432,7 @@ QJsonObject SqlDataBase::createAppointment(qint64 user_id, qint64 doctorId, cons
     }
 
     // 2) 插入预约（status 固定为 confirmed；顺带写入 symptom）
-    QSqlQuery qi(db);
+    QSqlQuery qi(connection());
     qi.prepare("INSERT INTO appointments("
                "  patient_id, doctor_id, start_time, status, symptom"
                ") VALUES(?,?,?,?,?)");
@@ -144,14 +442,11 @@ QJsonObject SqlDataBase::createAppointment(qint64 user_id, qint64 doctorId, cons
     qi.addBindValue(QStringLiteral("pending"));
     qi.addBindValue(sym);
 
-    if (!qi.exec()) {
+    if (!exec(qi)) {
         return QJsonObject{{"ok", false}, {"error", qi.lastError().text()}};
     }
 
-    QSqlQuery qco(db);
-    qco.prepare("UPDATE DoctorConsole SET appointment_number=COALESCE(appointment_number,0)+1 WHERE de_id=?");
-    qco.addBindValue(1); // deId = 需要+1的那一行ID
-    qco.exec();
+    consoleCounters.add(doctorId, DoctorConsoleCounters::Appointments);
 
     // 3) 可选更新患者体征（能解析就写，失败不阻断）
     bool okH=false, okW=false;
@@ -159,7 +454,7 @@ QJsonObject SqlDataBase::createAppointment(qint64 user_id, qint64 doctorId, cons
     const double w = weight.trimmed().isEmpty() ? 0.0 : weight.toDouble(&okW);
 
     if (okH || okW || age > 0) {
-        QSqlQuery qu(db);
+        QSqlQuery qu(connection());
         qu.prepare("UPDATE patients "
                    "SET height_cm = COALESCE(?, height_cm), "
                    "    weight_kg = COALESCE(?, weight_kg), "
@@ -170,31 +465,31 @@ QJsonObject SqlDataBase::createAppointment(qint64 user_id, qint64 doctorId, cons
         qu.addBindValue(okW ? QVariant(w)   : QVariant(QVariant::Double));
         qu.addBindValue(age > 0 ? QVariant(age) : QVariant(QVariant::LongLong));
         qu.addBindValue(patientId);
-        qu.exec(); // 忽略失败
+        exec(qu); // 忽略失败
     }
 
 
     // 4) 取 appt_id
-    QSqlQuery qid(db);
-    qid.exec("SELECT last_insert_rowid()");
+    QSqlQuery qid(connection());
+    exec(qid, "SELECT last_insert_rowid()");
     qid.next();
     const qint64 apptId = qid.value(0).toLongLong();
 
     // 5) 插入对应发票（未支付）
-    QSqlQuery qfee(db);
+    QSqlQuery qfee(connection());
     qfee.prepare("SELECT reg_fee FROM doctors WHERE doctor_id=?");
     qfee.addBindValue(doctorId);
     double regFee = 0.0;
-    if (qfee.exec() && qfee.next()) {
+    if (exec(qfee) && qfee.next()) {
         regFee = qfee.value(0).toDouble();
     }
 
     // 发票: 此时没有 encounter_id 和 prescription_id，可以先挂 NULL
-    QSqlQuery qinv(db);
+    QSqlQuery qinv(connection());
     qinv.prepare("INSERT INTO invoices(encounter_id, prescription_id, amount, paid) "
                  "VALUES(NULL, NULL, ?, 0)");
     qinv.addBindValue(regFee);
-    qinv.exec(); // 忽略失败可行，但最好检查
+    exec(qinv); // 忽略失败可行，但最好检查
 
     // 返回给前端
     return QJsonObject{
@@ -214,13 +509,13 @@ QJsonObject SqlDataBase::cancelAppointment(qint64 apptId)
     //QMutexLocker lock(dbMutex);
 
     // 1) 更新预约状态
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("UPDATE appointments "
               "SET status='cancelled', updated_at=strftime('%s','now') "
               "WHERE appt_id=? AND status<>'cancelled'");
     q.addBindValue(apptId);
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         return QJsonObject{{"ok", false}, {"error", q.lastError().text()}};
     }
     if (q.numRowsAffected()==0){
@@ -228,7 +523,7 @@ QJsonObject SqlDataBase::cancelAppointment(qint64 apptId)
     }
 
     // 2) 删除/作废对应发票（未支付的才处理）
-    QSqlQuery qinv(db);
+    QSqlQuery qinv(connection());
     qinv.prepare("DELETE FROM invoices "
                  "WHERE paid=0 "
                  "  AND encounter_id IS NULL "
@@ -238,13 +533,13 @@ QJsonObject SqlDataBase::cancelAppointment(qint64 apptId)
                  "    JOIN appointments a ON a.appt_id=? "
                  "  )");
     qinv.addBindValue(apptId);
-    qinv.exec();
+    exec(qinv);
 
     return QJsonObject{{"ok", true}};
 }
 
 // =============== 查看预约（按 user_id 列出患者全部） ===============
-QJsonObject SqlDataBase::listAppointments(qint64 user_id)
+QJsonObject SqlDataBase::listAppointments(qint64 user_id, bool includeArchive)
 {
     QMutexLocker lock(dbMutex);
 
@@ -266,10 +561,10 @@ QJsonObject SqlDataBase::listAppointments(qint64 user_id)
     }
 
     // 2) 查询预约（注意 LEFT JOIN 科室，医生可能未分配科室）
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare(
         "SELECT a.appt_id, d.full_name, dp.name, a.start_time, a.status "
-        "FROM appointments a "
+        "FROM " + tableSource("appointments", includeArchive) + " a "
         "JOIN doctors d ON a.doctor_id = d.doctor_id "
         "LEFT JOIN departments dp ON d.department_id = dp.department_id "
         "WHERE a.patient_id = ? "
@@ -277,7 +572,7 @@ QJsonObject SqlDataBase::listAppointments(qint64 user_id)
     );
     q.addBindValue(patientId);
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         // SQL 执行失败：返回空集与 0 计数（也可 out["error"]=q.lastError().text()）
         payload["num_pending"]   = 0;
         payload["num_confirmed"] = 0;
@@ -336,7 +631,7 @@ QJsonObject SqlDataBase::listRecords(qint64 user_id,qint64 appt_id)
         return o; // 空对象表示未找到/无权限
     }
 
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare(
         "SELECT e.appt_id, e.doctor_id, d.name, dep.name, "
         "       e.notes, mr.treatment, pr.notes, pr.prescription_id "
@@ -349,7 +644,7 @@ QJsonObject SqlDataBase::listRecords(qint64 user_id,qint64 appt_id)
     q.addBindValue(appt_id);
     q.addBindValue(patientId);
 
-    if (q.exec() && q.next()) {
+    if (exec(q) && q.next()) {
         qint64 apptId      = q.value(0).toLongLong();
         qint64 doctorId    = q.value(1).toLongLong();
         QString doctorName = q.value(2).toString();
@@ -367,14 +662,14 @@ QJsonObject SqlDataBase::listRecords(qint64 user_id,qint64 appt_id)
 
         // 追加药品清单
         if (rxId > 0) {
-            QSqlQuery q2(db);
+            QSqlQuery q2(connection());
             q2.prepare(
                 "SELECT m.name, m.spec, pi.instruction, pi.quantity "
                 "FROM prescription_items pi "
                 "JOIN medications m ON m.med_id = pi.med_id "
                 "WHERE pi.prescription_id=?");
             q2.addBindValue(rxId);
-            if (q2.exec()) {
+            if (exec(q2)) {
                 while (q2.next()) {
                     QString line = QString("%1 %2, 用法:%3, 数量:%4")
                                        .arg(q2.value(0).toString())  // 药名
@@ -422,7 +717,7 @@ QJsonObject SqlDataBase::submitHealth(qint64 user_id,
     // 3) 写库
     // 优先尝试写入 created_at（若表里有该列，单位：unix 秒）
     // time_text 形如 "YYYY-MM-DD HH:MM" 或 "YYYY-MM-DD HH:MM:SS"
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("INSERT INTO health_assessments("
               "  patient_id, answers_json, score, risk, ai_advice, created_at"
               ") VALUES(?,?,?,?,?, strftime('%s', ?))");
@@ -433,9 +728,9 @@ QJsonObject SqlDataBase::submitHealth(qint64 user_id,
     q.addBindValue(adviceJson);
     q.addBindValue(time_text);
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         // 若失败，可能是没有 created_at 列；回退为不写 created_at 的版本
-        QSqlQuery q2(db);
+        QSqlQuery q2(connection());
         q2.prepare("INSERT INTO health_assessments("
                    "  patient_id, answers_json, score, risk, ai_advice"
                    ") VALUES(?,?,?,?,?)");
@@ -445,7 +740,7 @@ QJsonObject SqlDataBase::submitHealth(qint64 user_id,
         q2.addBindValue(risk_level);
         q2.addBindValue(adviceJson);
 
-        if (!q2.exec()) {
+        if (!exec(q2)) {
             return QJsonObject{{"ok", false}, {"error", q2.lastError().text()}};
         }
     }
@@ -460,7 +755,7 @@ QJsonObject SqlDataBase::submitHealth(qint64 user_id,
 // =============== 获取健康评估（最新一条） ===============
 // 请求:  type=health.get, {seq, user_id}
 // 返回:  { ok, payload: { time, risk_level, advice[] } }
-QJsonObject SqlDataBase::getHealth(qint64 user_id)
+QJsonObject SqlDataBase::getHealth(qint64 user_id, bool includeArchive)
 {
     QMutexLocker lock(dbMutex);
 
@@ -470,26 +765,26 @@ QJsonObject SqlDataBase::getHealth(qint64 user_id)
         return QJsonObject{{"ok", false}, {"error", "patient not found"}};
     }
 
-    // 选最新一条：NULL 的时间排最后，再按 created_at 降序、rowid 降序兜底
-    QSqlQuery q(db);
+    // 选最新一条：按 submitted_at（表里实际的时间列，也是归档按年分库用的列）降序，assess_id 兜底
+    QSqlQuery q(connection());
     q.prepare(
         "SELECT "
         "  risk, "
         "  ai_advice, "
-        // 统一成 'YYYY-MM-DD HH:MM'，兼容 created_at 为整数(Unix秒)或文本
+        // 统一成 'YYYY-MM-DD HH:MM'，兼容 submitted_at 为整数(Unix秒)或文本
         "  CASE "
-        "    WHEN typeof(created_at)='integer' THEN strftime('%Y-%m-%d %H:%M', created_at, 'unixepoch', 'localtime') "
-        "    WHEN created_at IS NOT NULL      THEN strftime('%Y-%m-%d %H:%M', created_at, 'localtime') "
+        "    WHEN typeof(submitted_at)='integer' THEN strftime('%Y-%m-%d %H:%M', submitted_at, 'unixepoch', 'localtime') "
+        "    WHEN submitted_at IS NOT NULL      THEN strftime('%Y-%m-%d %H:%M', submitted_at, 'localtime') "
         "    ELSE strftime('%Y-%m-%d %H:%M', 'now', 'localtime') "
         "  END AS time_text "
-        "FROM health_assessments "
+        "FROM " + tableSource("health_assessments", includeArchive) + " "
         "WHERE patient_id=? "
-        "ORDER BY (created_at IS NULL), created_at DESC, rowid DESC "
+        "ORDER BY submitted_at DESC, assess_id DESC "
         "LIMIT 1"
     );
     q.addBindValue(patientId);
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         return QJsonObject{{"ok", false}, {"error", q.lastError().text()}};
     }
 
@@ -547,39 +842,45 @@ QJsonObject SqlDataBase::getHealth(qint64 user_id)
 QJsonObject SqlDataBase::sendMessage(qint64 fromUserId, qint64 toUserId, const QString& content)
 {
     //QMutexLocker lock(dbMutex);
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("INSERT INTO messages(from_user,to_user,content) VALUES(?,?,?)");
     q.addBindValue(fromUserId);
     q.addBindValue(toUserId);
     q.addBindValue(content);
 
-    if (!q.exec()){
+    if (!exec(q)){
         return QJsonObject{{"ok", false}, {"error", q.lastError().text()}};
     }
-    QSqlQuery qid(db); qid.exec("SELECT last_insert_rowid()"); qid.next();
+    QSqlQuery qid(connection()); exec(qid, "SELECT last_insert_rowid()"); qid.next();
     const qint64 msgId = qid.value(0).toLongLong();
+
+    // 收件人是医生则计入其仪表盘消息数
+    const qint64 toDoctorId = doctorIdFromUser(toUserId);
+    if (toDoctorId > 0)
+        consoleCounters.add(toDoctorId, DoctorConsoleCounters::Messages);
     return QJsonObject{{"ok", true}, {"payload", QJsonObject{{"msg_id", msgId}}}};
 }
 
 // =============== 收件箱（可选 sinceUnix 起点） ===============
-QJsonArray SqlDataBase::inbox(qint64 myUserId, qint64 sinceUnix)
+QJsonArray SqlDataBase::inbox(qint64 myUserId, qint64 sinceUnix, bool includeArchive)
 {
     //QMutexLocker lock(dbMutex);
     QJsonArray arr;
 
-    QSqlQuery q(db);
+    const QString src = tableSource("messages", includeArchive);
+    QSqlQuery q(connection());
     if (sinceUnix > 0){
         q.prepare("SELECT msg_id, from_user, to_user, content, created_at "
-                  "FROM messages WHERE to_user=? AND created_at>=? ORDER BY created_at DESC");
+                  "FROM " + src + " WHERE to_user=? AND created_at>=? ORDER BY created_at DESC");
         q.addBindValue(myUserId);
         q.addBindValue(sinceUnix);
     } else {
         q.prepare("SELECT msg_id, from_user, to_user, content, created_at "
-                  "FROM messages WHERE to_user=? ORDER BY created_at DESC");
+                  "FROM " + src + " WHERE to_user=? ORDER BY created_at DESC");
         q.addBindValue(myUserId);
     }
 
-    if (!q.exec()) return arr;
+    if (!exec(q)) return arr;
 
     while (q.next()){
         QJsonObject m;
@@ -597,10 +898,10 @@ QJsonArray SqlDataBase::inbox(qint64 myUserId, qint64 sinceUnix)
 QJsonObject SqlDataBase::listDepartments()
 {
     ////QMutexLocker lock(dbMutex);
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     QJsonArray items;
 
-    if (q.exec("SELECT name FROM departments ORDER BY name ASC")) {
+    if (exec(q, "SELECT name FROM departments ORDER BY name ASC")) {
         while (q.next()){
             items.append(QJsonObject{{"department_name", q.value(0).toString()}});
         }
@@ -616,7 +917,7 @@ QJsonObject SqlDataBase::listDepartments()
 QJsonObject SqlDataBase::listDoctorsByDepartment(const QString& departmentName)
 {
     ////QMutexLocker lock(dbMutex);
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare(
         "SELECT d.doctor_id, d.full_name, d.bio, d.duty_start, d.reg_fee, d.daily_quota "
         "FROM doctors d "
@@ -625,7 +926,7 @@ QJsonObject SqlDataBase::listDoctorsByDepartment(const QString& departmentName)
         "ORDER BY d.full_name ASC");
     q.addBindValue(departmentName);
 
-    if (!q.exec()){
+    if (!exec(q)){
         return QJsonObject{{"ok", false}, {"error", q.lastError().text()}};
     }
 
@@ -647,7 +948,7 @@ QJsonObject SqlDataBase::listDoctorsByDepartment(const QString& departmentName)
 
 void SqlDataBase::test()
 {
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
 
     // 1) 插入 user
     if (!q.prepare("INSERT INTO users(username, password, role, phone, id_card, gender, address) "
@@ -663,19 +964,19 @@ void SqlDataBase::test()
     q.addBindValue("M");   // 男
     q.addBindValue("北京市");
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         qDebug() << "insert user failed:" << q.lastError().text();
         return;
     }
 
     // 获取刚插入的 user_id
-    q.exec("SELECT last_insert_rowid()");
+    exec(q, "SELECT last_insert_rowid()");
     q.next();
     qint64 userId = q.value(0).toLongLong();
     qDebug() << "Inserted user_id =" << userId;
 
     // 2) 插入 patient
-    QSqlQuery qp(db);
+    QSqlQuery qp(connection());
     qp.prepare("INSERT INTO patients(user_id, full_name, age, height_cm, weight_kg) "
                "VALUES(?,?,?,?,?)");
     qp.addBindValue(userId);
@@ -684,7 +985,7 @@ void SqlDataBase::test()
     qp.addBindValue(175);
     qp.addBindValue(70);
 
-    if (!qp.exec()) {
+    if (!exec(qp)) {
         qDebug() << "insert patient failed:" << qp.lastError().text();
         return;
     }
@@ -692,8 +993,8 @@ void SqlDataBase::test()
     qDebug() << "Inserted patient for user_id =" << userId;
 
     // 3) 查询 users + patients 确认插入
-    QSqlQuery qc(db);
-    qc.exec("SELECT u.user_id, u.username, p.full_name, p.age, p.height_cm, p.weight_kg "
+    QSqlQuery qc(connection());
+    exec(qc, "SELECT u.user_id, u.username, p.full_name, p.age, p.height_cm, p.weight_kg "
             "FROM users u "
             "LEFT JOIN patients p ON u.user_id=p.user_id "
             "ORDER BY u.user_id DESC LIMIT 5");
@@ -713,7 +1014,7 @@ void SqlDataBase::test()
 QJsonObject SqlDataBase::getUserInfo(qint64 userId)
 {
     ////QMutexLocker lock(dbMutex);
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("SELECT username, role, "
               "       COALESCE(p.full_name,''), "
               "       COALESCE(u.gender,''), "
@@ -725,7 +1026,7 @@ QJsonObject SqlDataBase::getUserInfo(qint64 userId)
               "WHERE u.user_id=?");
     q.addBindValue(userId);
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         return QJsonObject{{"ok", false}, {"error", q.lastError().text()}};
     }
     if (!q.next()) {
@@ -750,7 +1051,7 @@ QJsonObject SqlDataBase::getUserInfo(qint64 userId)
 }
 
 //根据user_id返回全部病例
-QJsonObject SqlDataBase::listUserRecords(qint64 user_id)
+QJsonObject SqlDataBase::listUserRecords(qint64 user_id, bool includeArchive)
 {
     ////QMutexLocker lock(dbMutex);
     QJsonObject result;
@@ -763,10 +1064,10 @@ QJsonObject SqlDataBase::listUserRecords(qint64 user_id)
         return result;
     }
 
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare(
         "SELECT a.appt_id, d.full_name, dp.name, a.start_time "
-        "FROM appointments a "
+        "FROM " + tableSource("appointments", includeArchive) + " a "
         "JOIN doctors d    ON d.doctor_id = a.doctor_id "
         "JOIN departments dp ON dp.department_id = d.department_id "
         "WHERE a.patient_id = ? "
@@ -774,7 +1075,7 @@ QJsonObject SqlDataBase::listUserRecords(qint64 user_id)
     );
     q.addBindValue(patientId);
 
-    if (q.exec()) {
+    if (exec(q)) {
         while (q.next()) {
             QJsonObject o;
             o["appt_id"]        = q.value(0).toLongLong();
@@ -801,7 +1102,7 @@ QJsonObject SqlDataBase::changeUserInfo(qint64 user_id, const QString& name,
     QJsonObject out;
     out["ok"] = false;
 
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("UPDATE users SET "
               " phone = ?, id_card = ?, address = ? "
               "WHERE user_id = ?");
@@ -815,7 +1116,7 @@ QJsonObject SqlDataBase::changeUserInfo(qint64 user_id, const QString& name,
     q.addBindValue(name);
     q.addBindValue(patientId);
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         out["error"] = q.lastError().text();
         return out;
     }
@@ -839,10 +1140,10 @@ QJsonObject SqlDataBase::changePassword(qint64 user_id,
     out["ok"] = false;
 
     // 1) 验证旧密码是否正确
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("SELECT password FROM users WHERE user_id=?");
     q.addBindValue(user_id);
-    if (!q.exec() || !q.next()) {
+    if (!exec(q) || !q.next()) {
         out["error"] = "user not found";
         return out;
     }
@@ -853,11 +1154,11 @@ QJsonObject SqlDataBase::changePassword(qint64 user_id,
     }
 
     // 2) 更新新密码
-    QSqlQuery u(db);
+    QSqlQuery u(connection());
     u.prepare("UPDATE users SET password=? WHERE user_id=?");
     u.addBindValue(new_passwd);
     u.addBindValue(user_id);
-    if (!u.exec()) {
+    if (!exec(u)) {
         out["error"] = u.lastError().text();
         return out;
     }
@@ -875,26 +1176,14 @@ QJsonObject SqlDataBase::getDoctorConsole(qint64 doctor_id)
     ////QMutexLocker lock(dbMutex);
     QJsonObject res;
 
-    // ========== 1. 查询 DoctorConsole ==========
-    QJsonArray daiban;
-    {
-        QSqlQuery q(db);
-        q.exec("SELECT appointment_number, encounter_number, message_number, prescription_number "
-                  "FROM DoctorConsole WHERE de_id=1");
-        if (q.next()) {
-            daiban.append(q.value(0).toInt());
-            daiban.append(q.value(1).toInt());
-            daiban.append(q.value(2).toInt());
-            daiban.append(q.value(3).toInt());
-        }
-    }
-    res["daiban"] = daiban;
+    // ========== 1. 待办计数（内存读取，按医生区分） ==========
+    res["daiban"] = consoleCounters.daiban(doctor_id);
 
     // ========== 2. 查询今日预约患者（未处理，最多4人） ==========
     QJsonArray patients;
     {
         qDebug() << "doctoc_id:" << doctor_id ;
-        QSqlQuery q(db);
+        QSqlQuery q(connection());
         q.prepare(
             "SELECT p.full_name, p.age, p.height_cm, p.weight_kg, a.symptom "
             "FROM appointments a "
@@ -903,7 +1192,7 @@ QJsonObject SqlDataBase::getDoctorConsole(qint64 doctor_id)
             "LIMIT 4");
         q.addBindValue(doctor_id);
 
-        if (q.exec()) {
+        if (exec(q)) {
             while (q.next()) {
                 QJsonObject o;
                 o["name"]    = q.value(0).toString();
@@ -926,8 +1215,8 @@ QJsonObject SqlDataBase::doctorAppoinment(qint64 doctor_id)
     ////QMutexLocker lock(dbMutex);
     QJsonObject o;
 
-    QSqlQuery q(db);
-    q.exec(
+    QSqlQuery q(connection());
+    exec(q, 
         "SELECT p.full_name, p.age, p.height_cm, p.weight_kg, a.symptom, p.patient_id "
         "FROM appointments a "
         "JOIN patients p ON p.patient_id = a.patient_id "
@@ -971,7 +1260,7 @@ QJsonObject SqlDataBase::doctorOrder(qint64 doctor_user_id, qint64 patient_id, c
     // 2) 最近一条预约
     qint64 appt_id = -1;
     {
-        QSqlQuery q(db);
+        QSqlQuery q(connection());
         q.prepare(
             "SELECT appt_id "
             "FROM appointments "
@@ -979,7 +1268,7 @@ QJsonObject SqlDataBase::doctorOrder(qint64 doctor_user_id, qint64 patient_id, c
             "ORDER BY datetime(start_time) DESC LIMIT 1");
         q.addBindValue(patient_id);
         q.addBindValue(doctor_id);
-        if (q.exec() && q.next()) appt_id = q.value(0).toLongLong();
+        if (exec(q) && q.next()) appt_id = q.value(0).toLongLong();
     }
     if (appt_id <= 0) {
         reply["ok"] = false;
@@ -987,13 +1276,15 @@ QJsonObject SqlDataBase::doctorOrder(qint64 doctor_user_id, qint64 patient_id, c
         return reply;
     }
 
-    // 3) 事务：无则插，有则改
-    db.transaction();
+    // 3) 事务：无则插，有则改（事务在本线程的连接上）
+    QSqlDatabase conn = connection();
+    conn.transaction();
     bool ok = true;
+    bool inserted = false;
 
     // 插入（若不存在）
     {
-        QSqlQuery ins(db);
+        QSqlQuery ins(connection());
         ins.prepare(
             "INSERT INTO encounters (appt_id, patient_id, doctor_id, notes) "
             "SELECT ?, ?, ?, ? "
@@ -1003,26 +1294,29 @@ QJsonObject SqlDataBase::doctorOrder(qint64 doctor_user_id, qint64 patient_id, c
         ins.addBindValue(doctor_id);
         ins.addBindValue(orderText);
         ins.addBindValue(appt_id);
-        ok = ins.exec() && ok;
+        ok = exec(ins) && ok;
+        inserted = ok && ins.numRowsAffected() > 0;
     }
 
     // 更新（覆盖 notes；若要“追加”可用 COALESCE 拼接方案）
     {
-        QSqlQuery upd(db);
+        QSqlQuery upd(connection());
         upd.prepare(
             "UPDATE encounters "
             "SET notes = ?, visit_time = datetime('now') "
             "WHERE appt_id = ?");
         upd.addBindValue(orderText);
         upd.addBindValue(appt_id);
-        ok = upd.exec() && ok;
+        ok = exec(upd) && ok;
     }
 
     if (ok) {
-        db.commit();
+        conn.commit();
+        if (inserted)
+            consoleCounters.add(doctor_id, DoctorConsoleCounters::Encounters);
         reply["ok"] = true;
     } else {
-        db.rollback();
+        conn.rollback();
         reply["ok"] = false;
         reply["error"] = "db error";
     }
@@ -1041,10 +1335,10 @@ QJsonObject SqlDataBase::doctorSendMessage(qint64 doctor_user_id, qint64 patient
     // 1) patient_id → user_id
     qint64 patient_user_id = -1;
     {
-        QSqlQuery q(db);
+        QSqlQuery q(connection());
         q.prepare("SELECT user_id FROM patients WHERE patient_id=?");
         q.addBindValue(patient_id);
-        if (q.exec() && q.next()) {
+        if (exec(q) && q.next()) {
             patient_user_id = q.value(0).toLongLong();
         }
     }
@@ -1055,7 +1349,7 @@ QJsonObject SqlDataBase::doctorSendMessage(qint64 doctor_user_id, qint64 patient
     }
 
     // 2) 插入消息
-    QSqlQuery ins(db);
+    QSqlQuery ins(connection());
     ins.prepare(
         "INSERT INTO messages (from_user, to_user, content, created_at) "
         "VALUES (?, ?, ?, strftime('%s','now'))"
@@ -1064,7 +1358,7 @@ QJsonObject SqlDataBase::doctorSendMessage(qint64 doctor_user_id, qint64 patient
     ins.addBindValue(patient_user_id);
     ins.addBindValue(content);
 
-    if (ins.exec()) {
+    if (exec(ins)) {
         out["ok"] = true;
     } else {
         out["ok"] = false;
@@ -1082,7 +1376,7 @@ QJsonObject SqlDataBase::doctorInBox(qint64 doctor_user_id, const QString& conte
     ////QMutexLocker lock(dbMutex);
     QJsonObject out;
 
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare(
         "INSERT INTO messages (from_user_id, to_user_id, content, is_read, created_at) "
         "VALUES (0, ?, ?, 0, strftime('%s','now'))"
@@ -1090,7 +1384,8 @@ QJsonObject SqlDataBase::doctorInBox(qint64 doctor_user_id, const QString& conte
     q.addBindValue(doctor_user_id);
     q.addBindValue(content);
 
-    if (q.exec()) {
+    if (exec(q)) {
+        consoleCounters.add(doctorIdFromUser(doctor_user_id), DoctorConsoleCounters::Messages);
         out["ok"] = true;
     } else {
         out["ok"] = false;
@@ -1105,13 +1400,13 @@ QJsonObject SqlDataBase::registerDoctor(const QString& name, const QString& pass
     ////QMutexLocker lock(dbMutex);
     QJsonObject out;
 
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("INSERT INTO users (username, \"password\", role) VALUES (?, ?, ?)");
     q.addBindValue(name);
     q.addBindValue(passwd);
     q.addBindValue("doctor");
 
-    if (q.exec()) {
+    if (exec(q)) {
         qint64 newId = q.lastInsertId().toLongLong();
         out["ok"] = true;
         out["user_id"] = newId;
@@ -1145,7 +1440,8 @@ QJsonObject SqlDataBase::doctorModify(qint64 user_id,
         return out;
     }
 
-    if (!db.transaction()) {
+    QSqlDatabase conn = connection();
+    if (!conn.transaction()) {
         out["ok"] = false;
         out["error"] = "begin transaction failed";
         return out;
@@ -1156,7 +1452,7 @@ QJsonObject SqlDataBase::doctorModify(qint64 user_id,
     // 按是否需要改 id_card 构造 SQL
     if (shenfen.trimmed().isEmpty()) {
         // 仅更新密码
-        QSqlQuery q(db);
+        QSqlQuery q(connection());
         q.prepare(R"SQL(
             UPDATE users
                SET password = ?, updated_at = strftime('%s','now')
@@ -1164,16 +1460,16 @@ QJsonObject SqlDataBase::doctorModify(qint64 user_id,
         )SQL");
         q.addBindValue(passwd);
         q.addBindValue(user_id);
-        okAll = q.exec();
+        okAll = exec(q);
         if (!okAll || q.numRowsAffected() == 0) {
-            db.rollback();
+            conn.rollback();
             out["ok"] = false;
             out["error"] = okAll ? "user not found" : q.lastError().text();
             return out;
         }
     } else {
         // 同时更新 id_card（注意 UNIQUE 约束可能报错）
-        QSqlQuery q(db);
+        QSqlQuery q(connection());
         q.prepare(R"SQL(
             UPDATE users
                SET id_card = ?, password = ?, updated_at = strftime('%s','now')
@@ -1182,16 +1478,16 @@ QJsonObject SqlDataBase::doctorModify(qint64 user_id,
         q.addBindValue(shenfen);
         q.addBindValue(passwd);
         q.addBindValue(user_id);
-        okAll = q.exec();
+        okAll = exec(q);
         if (!okAll || q.numRowsAffected() == 0) {
-            db.rollback();
+            conn.rollback();
             out["ok"] = false;
             out["error"] = okAll ? "user not found or id_card conflict" : q.lastError().text();
             return out;
         }
     }
 
-    if (!db.commit()) {
+    if (!conn.commit()) {
         out["ok"] = false;
         out["error"] = "commit failed";
         return out;
@@ -1213,10 +1509,10 @@ QJsonObject SqlDataBase::goWork(qint64 user_id, const QString& timeStr)
     // 1) user_id -> doctor_id
     qint64 doctor_id = -1;
     {
-        QSqlQuery q(db);
+        QSqlQuery q(connection());
         q.prepare("SELECT doctor_id FROM doctors WHERE user_id=?");
         q.addBindValue(user_id);
-        if (q.exec() && q.next())
+        if (exec(q) && q.next())
             doctor_id = q.value(0).toLongLong();
     }
     if (doctor_id <= 0) {
@@ -1229,7 +1525,7 @@ QJsonObject SqlDataBase::goWork(qint64 user_id, const QString& timeStr)
     const bool hasTime = !timeStr.trimmed().isEmpty();
 
     // 3) 写考勤（插入或覆盖同一天）
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     if (hasTime) {
         // 传入时间
         q.prepare(
@@ -1252,7 +1548,7 @@ QJsonObject SqlDataBase::goWork(qint64 user_id, const QString& timeStr)
         q.addBindValue(doctor_id);
     }
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         out["ok"] = false;
         out["error"] = q.lastError().text();
         return out;
@@ -1271,10 +1567,10 @@ QJsonObject SqlDataBase::offWork(qint64 user_id, const QString& timeStr /*可为
     // 1) user_id -> doctor_id
     qint64 doctor_id = -1;
     {
-        QSqlQuery q(db);
+        QSqlQuery q(connection());
         q.prepare("SELECT doctor_id FROM doctors WHERE user_id=?");
         q.addBindValue(user_id);
-        if (q.exec() && q.next())
+        if (exec(q) && q.next())
             doctor_id = q.value(0).toLongLong();
     }
     if (doctor_id <= 0) {
@@ -1284,7 +1580,7 @@ QJsonObject SqlDataBase::offWork(qint64 user_id, const QString& timeStr /*可为
     }
 
     // 2) 写考勤（传 time 用传入时间；否则用本地当前时间）
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     if (timeStr.trimmed().isEmpty()) {
         qDebug() << "hello1" ;
         q.prepare(
@@ -1307,7 +1603,7 @@ QJsonObject SqlDataBase::offWork(qint64 user_id, const QString& timeStr /*可为
         q.addBindValue(timeStr);  // check_out = timeStr
     }
 
-    if (!q.exec()) {
+    if (!exec(q)) {
         out["ok"] = false;
         out["error"] = q.lastError().text();
         return out;
@@ -1332,7 +1628,7 @@ QJsonObject SqlDataBase::vacation(qint64 doctor_id,
         return out;
     }
 
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare("INSERT INTO leaves (doctor_id, type, start_date, end_date, reason) "
               "VALUES (?, '因私', ?, ?, ?)");
     q.addBindValue(doctor_id);
@@ -1340,7 +1636,7 @@ QJsonObject SqlDataBase::vacation(qint64 doctor_id,
     q.addBindValue(end_date);
     q.addBindValue(reason);
 
-    if (q.exec()) {
+    if (exec(q)) {
         out["ok"] = true;
     } else {
         out["ok"] = false;
@@ -1351,7 +1647,7 @@ QJsonObject SqlDataBase::vacation(qint64 doctor_id,
 
 
 //医生考勤查询
-QJsonObject SqlDataBase::checkWork(qint64 user_id, int limitDays /*=30*/)
+QJsonObject SqlDataBase::checkWork(qint64 user_id, int limitDays /*=30*/, bool includeArchive)
 {
     ////QMutexLocker lock(dbMutex);
     QJsonObject out;
@@ -1360,10 +1656,10 @@ QJsonObject SqlDataBase::checkWork(qint64 user_id, int limitDays /*=30*/)
     // 1) user_id -> doctor_id
     qint64 doctor_id = -1;
     {
-        QSqlQuery q(db);
+        QSqlQuery q(connection());
         q.prepare("SELECT doctor_id FROM doctors WHERE user_id=?");
         q.addBindValue(user_id);
-        if (q.exec() && q.next()) doctor_id = q.value(0).toLongLong();
+        if (exec(q) && q.next()) doctor_id = q.value(0).toLongLong();
     }
     if (doctor_id <= 0) {
         // 返回空数组（按你们风格：面向结果，不抛错）
@@ -1377,10 +1673,10 @@ QJsonObject SqlDataBase::checkWork(qint64 user_id, int limitDays /*=30*/)
     if (limitDays <= 0) limitDays = 30;
 
     // 2) 查询 attendance
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare(
         "SELECT day, check_in, check_out, status "
-        "FROM attendance "
+        "FROM " + tableSource("attendance", includeArchive) + " "
         "WHERE doctor_id=? "
         "ORDER BY day DESC "
         "LIMIT ?"
@@ -1388,7 +1684,7 @@ QJsonObject SqlDataBase::checkWork(qint64 user_id, int limitDays /*=30*/)
     q.addBindValue(doctor_id);
     q.addBindValue(limitDays);
 
-    if (q.exec()) {
+    if (exec(q)) {
         while (q.next()) {
             const QString day  = q.value(0).toString();
 
@@ -1429,7 +1725,7 @@ QJsonObject SqlDataBase::doctorSignIn(const QString& name,
     ////QMutexLocker lock(dbMutex);
     QJsonObject out;
 
-    QSqlQuery q(db);
+    QSqlQuery q(connection());
     q.prepare(
         "SELECT user_id FROM users "
         "WHERE username=? AND password=? AND role=? AND status=1 LIMIT 1"
@@ -1438,7 +1734,7 @@ QJsonObject SqlDataBase::doctorSignIn(const QString& name,
     q.addBindValue(passwd);
     q.addBindValue(role);
 
-    if (!q.exec())
+    if (!exec(q))
     {
         qDebug() << "Exec Fail";
         out["ok"] = false;
@@ -1458,6 +1754,35 @@ QJsonObject SqlDataBase::doctorSignIn(const QString& name,
 }
 
 
+// =============== 全文检索（search） ===============
+// 按请求者角色限定范围：患者只搜自己的病历/医嘱/消息，医生只搜自己经手的，admin 不限
+QJsonObject SqlDataBase::search(qint64 user_id, const QString& text, const QString& scope,
+                                int page, int pageSize)
+{
+    const QString role = userRole(user_id);
+    if (role.isEmpty()) {
+        return QJsonObject{{"ok", false}, {"error", "user not found"}};
+    }
+
+    FullTextSearch::Filter filter;
+    if (role == "patient") {
+        filter.patientId = patientIdFromUser(user_id);
+        filter.userId    = user_id;
+        if (filter.patientId <= 0) {
+            return QJsonObject{{"ok", false}, {"error", "patient not found"}};
+        }
+    } else if (role == "doctor") {
+        filter.doctorId = doctorIdFromUser(user_id);
+        filter.userId   = user_id;
+        if (filter.doctorId <= 0) {
+            return QJsonObject{{"ok", false}, {"error", "doctor not found"}};
+        }
+    }
+
+    QSqlDatabase conn = connection();
+    return fullText.search(conn, filter, text, scope, page, pageSize);
+}
+
 //建造图
 // ---- 显式类型版本的排序工具（C++11可用） ----
 static QJsonArray sortByBuckets(const QJsonArray& arr,
@@ -1624,7 +1949,6 @@ static QJsonArray sortByBuckets(const QJsonArray& arr,
 // =============== 统计绘图（bing 仅允许四种：冠心病/青光眼/高血压/糖尿病） ===============
 QJsonObject SqlDataBase::statisticDraw(qint64 seq, QString bing)
 {
-    QMutexLocker _locker(dbMutex);
     QJsonObject out;
     out["ok"]  = false;
     out["seq"] = QString::number(seq);
@@ -1647,125 +1971,14 @@ QJsonObject SqlDataBase::statisticDraw(qint64 seq, QString bing)
         return out;
     }
 
-    // 桶顺序
-    const QStringList ageBuckets = {"0-18","19-40","41-65","65+"};
-    const QStringList wgtBuckets = {"<50kg","50-70kg","70-90kg","90kg+"};
-    const QStringList hgtBuckets = {"<160cm","160-170cm","170-180cm","180cm+"};
-
-    // 本地排序工具：按 buckets 顺序重排
-    auto sortByBucketsLocal = [](const QJsonArray& arr, const QString& key, const QStringList& buckets) -> QJsonArray {
-        struct Item { int idx; QJsonObject obj; };
-        QVector<Item> v; v.reserve(arr.size());
-        for (const auto& it : arr) {
-            QJsonObject o = it.toObject();
-            const int idx = qMax(0, buckets.indexOf(o.value(key).toString()));
-            v.push_back({ idx < 0 ? 9999 : idx, o });
-        }
-        std::sort(v.begin(), v.end(), [](const Item& a, const Item& b){ return a.idx < b.idx; });
-        QJsonArray out;
-        for (const auto& it : v) out.push_back(it.obj);
-        return out;
-    };
-
-    // 只查 chosen 这一种
-    QJsonArray diseasesArr;
-
-    // 2.1 年龄分布
-    QSqlQuery qAge(db);
-    qAge.prepare(
-        "SELECT age_group, SUM(count) "
-        "FROM disease_stats "
-        "WHERE disease=? AND age_group<>'ALL' "
-        "GROUP BY age_group"
-    );
-    qAge.addBindValue(chosen);
-    if (!qAge.exec()) {
-        out["error"] = QString("age stats failed(%1): %2").arg(chosen, qAge.lastError().text());
-        return out;
-    }
-    QJsonArray ageStats;
-    while (qAge.next()) {
-        ageStats.push_back(QJsonObject{
-            {"age",   qAge.value(0).toString()},
-            {"count", qAge.value(1).toInt()}
-        });
-    }
-    ageStats = sortByBucketsLocal(ageStats, "age", ageBuckets);
-
-    // 2.2 体重分布
-    QSqlQuery qW(db);
-    qW.prepare(
-        "SELECT weight_group, SUM(count) "
-        "FROM disease_stats "
-        "WHERE disease=? AND weight_group<>'ALL' "
-        "GROUP BY weight_group"
-    );
-    qW.addBindValue(chosen);
-    if (!qW.exec()) {
-        out["error"] = QString("weight stats failed(%1): %2").arg(chosen, qW.lastError().text());
+    if (!statsCube.isLoaded()) {
+        out["error"] = "disease stats not loaded";
         return out;
     }
-    QJsonArray weightStats;
-    while (qW.next()) {
-        weightStats.push_back(QJsonObject{
-            {"weight", qW.value(0).toString()},
-            {"count",  qW.value(1).toInt()}
-        });
-    }
-    weightStats = sortByBucketsLocal(weightStats, "weight", wgtBuckets);
-
-    // 2.3 身高分布
-    QSqlQuery qH(db);
-    qH.prepare(
-        "SELECT height_group, SUM(count) "
-        "FROM disease_stats "
-        "WHERE disease=? AND height_group<>'ALL' "
-        "GROUP BY height_group"
-    );
-    qH.addBindValue(chosen);
-    if (!qH.exec()) {
-        out["error"] = QString("height stats failed(%1): %2").arg(chosen, qH.lastError().text());
-        return out;
-    }
-    QJsonArray heightStats;
-    while (qH.next()) {
-        heightStats.push_back(QJsonObject{
-            {"height", qH.value(0).toString()},
-            {"count",  qH.value(1).toInt()}
-        });
-    }
-    heightStats = sortByBucketsLocal(heightStats, "height", hgtBuckets);
-
-    // 2.4 年份分布（ALL 汇总）
-    QSqlQuery qY(db);
-    qY.prepare(
-        "SELECT year, SUM(count) "
-        "FROM disease_stats "
-        "WHERE disease=? AND age_group='ALL' AND weight_group='ALL' AND height_group='ALL' "
-        "GROUP BY year ORDER BY year"
-    );
-    qY.addBindValue(chosen);
-    if (!qY.exec()) {
-        out["error"] = QString("year stats failed(%1): %2").arg(chosen, qY.lastError().text());
-        return out;
-    }
-    QJsonArray yearStats;
-    while (qY.next()) {
-        yearStats.push_back(QJsonObject{
-            {"year",  qY.value(0).toInt()},
-            {"count", qY.value(1).toInt()}
-        });
-    }
 
-    // 组装单一疾病
-    QJsonObject dObj;
-    dObj["disease"]      = chosen;
-    dObj["age_stats"]    = ageStats;
-    dObj["weight_stats"] = weightStats;
-    dObj["height_stats"] = heightStats;
-    dObj["year_stats"]   = yearStats;
-
-    diseasesArr.push_back(dObj);
+    // 从内存立方体取（已按桶顺序排好，按病种缓存），不再占用 dbMutex
+    QJsonArray diseasesArr;
+    diseasesArr.push_back(statsCube.diseaseStats(chosen));
 
     // 输出
     QJsonObject payload;
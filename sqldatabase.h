@@ -11,6 +11,18 @@
 #include <QJsonObject>      // 新增
 #include <QJsonArray>       // 新增
 #include <QJsonDocument>    // 提交健康评估时要把 answers 序列化为 json
+#include <QThreadStorage>
+#include <QElapsedTimer>
+#include <atomic>
+#include "diseasestatscube.h"
+#include "doctorconsolecounters.h"
+#include "fulltextsearch.h"
+#include "dataarchiver.h"
+#include "onlinebackup.h"
+#include "sqlprofiler.h"
+
+class QTimer;
+
 class SqlDataBase : public QObject
 {
     Q_OBJECT
@@ -31,12 +43,13 @@ public:
     QJsonObject createAppointment(qint64 user_id, qint64 doctorId, const QString& startIso,
                                   qint64 age, const QString& height, const QString& weight, const QString& sym);
     QJsonObject cancelAppointment(qint64 apptId);
-    QJsonObject  listAppointments(qint64 user_id);//patientId
+    // includeArchive=true 时连同归档库一起查（较慢，仅在请求明确要旧数据时使用）
+    QJsonObject  listAppointments(qint64 user_id, bool includeArchive = false);//patientId
 
     // —— 病例列表（record.list）
     QJsonObject  listRecords(qint64 user_id,qint64 appt_id);
 
-    QJsonObject listUserRecords(qint64 user_id);
+    QJsonObject listUserRecords(qint64 user_id, bool includeArchive = false);
 
     // —— 健康评估（health.submit）
     QJsonObject submitHealth(qint64 patientId, const QJsonArray& answers,
@@ -44,7 +57,7 @@ public:
 
     // —— 聊天：发送 / 收件箱
     QJsonObject sendMessage(qint64 fromUserId, qint64 toUserId, const QString& content);
-    QJsonArray  inbox(qint64 myUserId, qint64 sinceUnix = 0);
+    QJsonArray  inbox(qint64 myUserId, qint64 sinceUnix = 0, bool includeArchive = false);
 
     // —— 辅助：从 user_id 找 patient_id
     qint64 patientIdFromUser(qint64 userId);
@@ -84,9 +97,10 @@ public:
                                           const QJsonArray& advice_in);   // ["建议1","建议2",...]
 
     // =============== 获取健康评估（最新一条） ===============
-    // 请求:  type=health.get, {seq, user_id}
+    // 请求:  type=health.get, {seq, user_id, include_archive?}
     // 返回:  { ok, payload: { time, risk_level, advice[] } }
-    QJsonObject getHealth(qint64 user_id);
+    // includeArchive=true 时连同归档库一起找（最近一条已超过保留期时才需要）
+    QJsonObject getHealth(qint64 user_id, bool includeArchive = false);
 
 
 
@@ -101,7 +115,7 @@ public:
 
 
 
-    //返回医生的仪表盘
+    //返回医生的仪表盘（待办计数来自内存，不查 DoctorConsole 表）
     QJsonObject getDoctorConsole(qint64 doctor_id);
 
     //返回一个患者的情况
@@ -140,7 +154,7 @@ public:
                                       const QString& reason);
 
     //医生考勤查询
-    QJsonObject checkWork(qint64 user_id, int limitDays /*=30*/);
+    QJsonObject checkWork(qint64 user_id, int limitDays /*=30*/, bool includeArchive = false);
 
 
     //医生登录
@@ -148,14 +162,98 @@ public:
                                           const QString& passwd,
                                           const QString& role /*"doctor"*/);
 
-    //建造图
+    // 全文检索：病历 / 医嘱 / 消息（FTS5，bm25 排名，片段高亮，分页）
+    // scope: records / encounters / messages / all；page 从 1 开始
+    // 返回：{ ok, payload:{ query, scope, page, page_size, has_more, tokenizer, hits:[ {kind,id,...,snippet,score} ] } }
+    QJsonObject search(qint64 user_id, const QString& text, const QString& scope,
+                       int page, int pageSize);
+
+    //建造图（读内存立方体，不访问数据库）
     QJsonObject statisticDraw(qint64 seq,QString bing);
+
+    // 历史数据保留天数：appointments/attendance/health_assessments
+    // 超过该天数的行定期搬到按年份分的归档库；<=0 关闭归档
+    void setArchiveHorizonDays(int days);
+
+    // 在线热备份（仅 admin）：从读事务快照整体拷到 <库目录>/backup，不停服
+    // 可在工作线程调用，实际操作排队到数据库对象所在线程执行
+    bool isAdmin(qint64 user_id);
+    QJsonObject startBackup();
+    // 返回：{ ok, payload:{ running, last_backup, report:{ pages, elapsed_ms, mb_per_s, p99_ms, baseline_p99_ms, ... } } }
+    QJsonObject backupStatus();
+    // 从最近一次备份导出指定表（压缩分块），返回导出文件路径
+    QJsonObject startExport(const QStringList& tables);
+
+    // SQL 语句剖析（仅 admin）：action 为 dump / reset / config；
+    // sampleRate 每 N 次执行采样一次（0 关闭），planThresholdMs 超过则抓查询计划，传 -1 表示不修改
+    // 返回：{ ok, payload:{ sample_rate, plan_threshold_ms, calls, sampled, statements:[...] } }
+    QJsonObject sqlProfile(const QString& action, int sampleRate, int planThresholdMs, int limit);
+
+    // 指标：当前打开的连接数（主连接 + 各工作线程连接），WAL 文件与主库文件大小（字节）
+    int openConnections() const;
+    qint64 walSizeBytes() const;
+    qint64 fileSizeBytes() const;
+    // 指标：SqlProfiler::report(limit)，按总耗时取前 limit 条语句
+    QJsonObject sqlProfileReport(int limit) const { return profiler.report(limit); }
 signals:
+    void log(const QString& logStr);
+    void wrnLog(const QString& wrnStr);
+
+private slots:
+    // 定时检查 disease_stats 是否变化，变化则重建统计立方体
+    void refreshDiseaseStats();
+
+    // 定时把有变化的医生仪表盘计数写回 doctor_console
+    void flushDoctorConsole();
+
+    // 定时把变动的病历/医嘱/消息同步进单字索引；一次一批，满批就再排一次
+    void syncFullText();
+
+    // 把超过保留期的历史数据分批搬到归档库：runArchival 开始一轮，
+    // archiveStep 每次只搬一批，搬满一批就再排一次，中间回到事件循环
+    void runArchival();
+    void archiveStep();
 
 private:
     QSqlDatabase db;//可添加多个，根据需要选择
     QString dbPath;
     QMutex * dbMutex;
+
+    // 请求在工作线程里执行：每个线程一个独立连接（QSqlDatabase 不能跨线程使用），
+    // 主线程仍用 db；线程结束时自动移除
+    QSqlDatabase connection();
+    QThreadStorage<QSqlDatabase> threadConnections;
+
+    // 所有语句都经这里执行，由 profiler 按采样计时
+    SqlProfiler profiler;
+    bool exec(QSqlQuery& q) { return profiler.exec(q); }
+    bool exec(QSqlQuery& q, const QString& sql) { return profiler.exec(q, &sql); }
+    std::atomic<int> workerConnections{0};
+
+    DiseaseStatsCube statsCube;
+    QTimer *statsRefreshTimer;
+    qint64 statsDataVersion;
+    QString statsFingerprint;
+    qint64 dataVersion();
+    QString diseaseStatsFingerprint();
+
+    DoctorConsoleCounters consoleCounters;
+    QTimer *consoleFlushTimer;
+    qint64 doctorIdFromUser(qint64 userId);
+
+    FullTextSearch fullText;
+    QTimer *fullTextSyncTimer;
+
+    DataArchiver *archiver;
+    QTimer *archiveTimer;
+    int archiveHorizonDays;
+    int archiveTableIndex;          // 本轮正在搬的表在 DataArchiver::tables() 中的下标，-1 为空闲
+    int archiveTableMoved;          // 该表本轮已搬行数
+    QElapsedTimer archivePass;
+    QString tableSource(const QString& table, bool includeArchive);
+
+    OnlineBackup *backup;
+    QString userRole(qint64 userId);
     // 性别中文→存库代码（"男"→"M","女"→"F"，否则 NULL）
     QString mapGender(const QString& genderCN) const;
 };
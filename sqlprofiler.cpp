@@ -0,0 +1,175 @@
+#include "sqlprofiler.h"
+
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QSqlError>
+#include <QSqlDriver>
+#include <QSqlResult>
+#include <QVariant>
+#include <algorithm>
+
+// 不同语句数的上限：动态拼接的 SQL（如带 IN 列表）不能把表撑爆
+static const int kMaxStatements = 512;
+
+SqlProfiler::SqlProfiler()
+    : m_sampleRate(0)
+    , m_planThresholdNs(static_cast<qint64>(50) * 1000000)
+    , m_calls(0)
+    , m_sampled(0)
+{
+}
+
+void SqlProfiler::setSampleRate(int sampleRate)
+{
+    m_sampleRate.store(qMax(0, sampleRate), std::memory_order_relaxed);
+}
+
+void SqlProfiler::setPlanThresholdMs(int ms)
+{
+    m_planThresholdNs.store(static_cast<qint64>(qMax(0, ms)) * 1000000, std::memory_order_relaxed);
+}
+
+bool SqlProfiler::exec(QSqlQuery &q, const QString *sql)
+{
+    const int rate = m_sampleRate.load(std::memory_order_relaxed);
+    if (rate <= 0 || m_calls.fetch_add(1, std::memory_order_relaxed) % static_cast<quint64>(rate) != 0) {
+        return sql ? q.exec(*sql) : q.exec();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    const bool ok = sql ? q.exec(*sql) : q.exec();
+
+    // SQLite 在 exec 时只取到第一行，其余行在 next() 时才执行；
+    // 采样到的 SELECT 在这里取完（结果已缓存），计时才包含完整执行，随后退回到第一行之前
+    qint64 rows = -1;
+    if (ok && q.isSelect()) {
+        if (!q.isForwardOnly() && q.last()) {
+            rows = q.at() + 1;
+            q.seek(QSql::BeforeFirstRow);
+        } else if (!q.isForwardOnly()) {
+            rows = 0;
+        }
+    } else if (ok) {
+        rows = q.numRowsAffected();
+    }
+    const qint64 ns = timer.nsecsElapsed();
+
+    record(q, ns, rows, ok);
+    return ok;
+}
+
+QString SqlProfiler::normalize(const QString &sql)
+{
+    // 多行拼接的 SQL 压成一行，同一语句只算一条
+    return sql.simplified();
+}
+
+QStringList SqlProfiler::explain(const QSqlQuery &q)
+{
+    QStringList plan;
+    if (!q.driver()) return plan;
+    QSqlQuery e(q.driver()->createResult());
+    if (!e.prepare("EXPLAIN QUERY PLAN " + q.lastQuery())) {
+        plan << ("explain failed: " + e.lastError().text());
+        return plan;
+    }
+    const int n = q.boundValues().size();
+    for (int i = 0; i < n; ++i) e.bindValue(i, q.boundValue(i));
+    if (!e.exec()) {
+        plan << ("explain failed: " + e.lastError().text());
+        return plan;
+    }
+    // 列：id, parent, notused, detail
+    while (e.next()) plan << e.value(3).toString();
+    return plan;
+}
+
+void SqlProfiler::record(const QSqlQuery &q, qint64 ns, qint64 rows, bool ok)
+{
+    const QString key = normalize(q.lastQuery());
+    const int rate = qMax(1, m_sampleRate.load(std::memory_order_relaxed));
+
+    bool needPlan = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        ++m_sampled;
+        auto it = m_stats.find(key);
+        if (it == m_stats.end()) {
+            if (m_stats.size() >= kMaxStatements) return;
+            it = m_stats.insert(key, Stat());
+        }
+        Stat &s = it.value();
+        ++s.samples;
+        s.sampleRate = rate;
+        if (!ok) ++s.errors;
+        s.totalNs += ns;
+        s.maxNs = qMax(s.maxNs, ns);
+        if (rows > 0) s.rows += rows;
+
+        // 每条语句只在更慢的一次上重新抓计划
+        needPlan = ok && ns >= m_planThresholdNs.load(std::memory_order_relaxed) && ns > s.planNs;
+        if (needPlan) s.planNs = ns;
+    }
+    if (!needPlan) return;
+
+    const QString head = key.left(16).toUpper();
+    if (head.startsWith("PRAGMA") || head.startsWith("EXPLAIN") || head.startsWith("BEGIN")
+        || head.startsWith("COMMIT") || head.startsWith("ROLLBACK") || head.startsWith("ATTACH")) {
+        return;
+    }
+
+    const QStringList plan = explain(q);
+    QMutexLocker locker(&m_mutex);
+    auto it = m_stats.find(key);
+    if (it != m_stats.end()) it.value().plan = plan;
+}
+
+QJsonObject SqlProfiler::report(int limit) const
+{
+    QList<QPair<QString, Stat> > list;
+    quint64 sampled;
+    {
+        QMutexLocker locker(&m_mutex);
+        sampled = m_sampled;
+        for (auto it = m_stats.constBegin(); it != m_stats.constEnd(); ++it) {
+            list.append(qMakePair(it.key(), it.value()));
+        }
+    }
+    std::sort(list.begin(), list.end(), [](const QPair<QString, Stat> &a, const QPair<QString, Stat> &b) {
+        return a.second.totalNs > b.second.totalNs;
+    });
+
+    QJsonArray statements;
+    for (int i = 0; i < list.size() && i < limit; ++i) {
+        const QString &sql = list.at(i).first;
+        const Stat &s = list.at(i).second;
+        QJsonObject o;
+        o["sql"]       = sql;
+        o["samples"]   = static_cast<qint64>(s.samples);
+        o["est_calls"] = static_cast<qint64>(s.samples * s.sampleRate);
+        o["total_ms"]  = s.totalNs / 1e6;
+        o["avg_ms"]    = s.samples ? s.totalNs / 1e6 / s.samples : 0.0;
+        o["max_ms"]    = s.maxNs / 1e6;
+        o["rows"]      = s.rows;
+        o["avg_rows"]  = s.samples ? double(s.rows) / s.samples : 0.0;
+        o["errors"]    = static_cast<qint64>(s.errors);
+        if (!s.plan.isEmpty()) o["plan"] = QJsonArray::fromStringList(s.plan);
+        statements.append(o);
+    }
+
+    QJsonObject o;
+    o["sample_rate"]       = sampleRate();
+    o["plan_threshold_ms"] = m_planThresholdNs.load(std::memory_order_relaxed) / 1000000;
+    o["calls"]             = static_cast<qint64>(m_calls.load(std::memory_order_relaxed));
+    o["sampled"]           = static_cast<qint64>(sampled);
+    o["statements"]        = statements;
+    return o;
+}
+
+void SqlProfiler::reset()
+{
+    QMutexLocker locker(&m_mutex);
+    m_stats.clear();
+    m_sampled = 0;
+}
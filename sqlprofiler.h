@@ -0,0 +1,70 @@
+#ifndef SQLPROFILER_H
+#define SQLPROFILER_H
+
+#include <QSqlQuery>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QMutex>
+#include <QJsonObject>
+#include <atomic>
+
+// SQL 语句剖析：包住 SqlDataBase 里每一次 QSqlQuery::exec（全文检索、仪表盘计数、
+// 统计立方体、归档这些组件经 setProfiler 拿到同一个实例，语句也记在这里），
+// 按语句（预编译的 SQL 文本）统计调用次数、总/平均/最大耗时、返回行数，
+// 单次超过阈值时抓一次 EXPLAIN QUERY PLAN。
+// 默认关闭；按 1/N 采样，未采样的调用只多一次原子加法，可以在线上常开。
+class SqlProfiler
+{
+public:
+    SqlProfiler();
+
+    // sampleRate：每 N 次执行剖析一次；<= 0 关闭
+    void setSampleRate(int sampleRate);
+    int sampleRate() const { return m_sampleRate.load(std::memory_order_relaxed); }
+
+    // 单次超过该毫秒数时抓取查询计划
+    void setPlanThresholdMs(int ms);
+
+    // 执行并（按采样）记录；sql 为空时执行已 prepare 的语句
+    bool exec(QSqlQuery &q, const QString *sql = nullptr);
+
+    // { sample_rate, plan_threshold_ms, sampled, statements:[ { sql, samples, est_calls, total_ms,
+    //   avg_ms, max_ms, rows, avg_rows, errors, plan[] } ] }，按总耗时降序，最多 limit 条
+    QJsonObject report(int limit = 50) const;
+    void reset();
+
+private:
+    struct Stat {
+        quint64 samples = 0;
+        quint64 errors = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+        qint64 rows = 0;
+        int sampleRate = 1;      // 记录时的采样率，用来估算总调用次数
+        QStringList plan;
+        qint64 planNs = 0;       // 抓计划那一次的耗时
+    };
+
+    void record(const QSqlQuery &q, qint64 ns, qint64 rows, bool ok);
+    static QString normalize(const QString &sql);
+    // 在同一连接上对同一语句（同样的绑定值）做 EXPLAIN QUERY PLAN
+    static QStringList explain(const QSqlQuery &q);
+
+    std::atomic<int> m_sampleRate;
+    std::atomic<qint64> m_planThresholdNs;
+    std::atomic<quint64> m_calls;
+
+    mutable QMutex m_mutex;              // 只在采样到的调用上获取
+    QHash<QString, Stat> m_stats;
+    quint64 m_sampled;
+};
+
+// 组件里执行语句用：profiler 为空时直接执行
+inline bool profiledExec(SqlProfiler *profiler, QSqlQuery &q, const QString *sql = nullptr)
+{
+    if (profiler) return profiler->exec(q, sql);
+    return sql ? q.exec(*sql) : q.exec();
+}
+
+#endif // SQLPROFILER_H
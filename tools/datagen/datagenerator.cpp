@@ -0,0 +1,1184 @@
+#include "datagenerator.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTextStream>
+#include <sqlite3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+namespace {
+
+// 科室：名称、病种分组、就诊量权重；模板库里没有的科室会补上
+struct DeptDef { const char *name; int diseaseSet; double weight; };
+const DeptDef kDepartments[] = {
+    {"内科", 0, 20}, {"外科", 1, 8}, {"儿科", 2, 10}, {"骨科", 3, 7}, {"妇产科", 4, 8},
+    {"眼科", 5, 5}, {"耳鼻喉科", 6, 4}, {"口腔科", 7, 5}, {"皮肤科", 8, 4}, {"神经内科", 9, 4},
+    {"心血管内科", 0, 5}, {"呼吸内科", 0, 5}, {"消化内科", 0, 4}, {"内分泌科", 0, 3},
+    {"急诊科", 10, 4}, {"康复科", 10, 2}, {"中医科", 10, 3},
+};
+const int kPediatrics = 2;
+const int kGynecology = 4;
+const int kGeneralSet = 10;
+
+// 病种：分组、诊断、症状、处理、年龄倾向（1 中老年多发，-1 儿童/青年多发）、常用药
+struct DiseaseDef {
+    int set;
+    const char *name;
+    const char *symptoms;
+    const char *treatment;
+    int ageBias;
+    const char *meds[2];
+};
+const DiseaseDef kDiseases[] = {
+    {0, "上呼吸道感染", "发热、咳嗽、咽痛", "对症支持治疗，多饮水", 0, {"布洛芬片", "连花清瘟胶囊"}},
+    {0, "高血压", "头晕、头痛", "低盐饮食，规律服用降压药", 1, {"苯磺酸氨氯地平片", "缬沙坦胶囊"}},
+    {0, "2型糖尿病", "口渴、多尿、乏力", "控制饮食，监测血糖", 1, {"二甲双胍片", "阿卡波糖片"}},
+    {0, "冠心病", "胸闷、胸痛", "抗血小板、调脂治疗", 1, {"阿司匹林肠溶片", "阿托伐他汀钙片"}},
+    {0, "慢性胃炎", "上腹痛、反酸", "抑酸护胃，规律饮食", 0, {"奥美拉唑肠溶胶囊", "铝碳酸镁咀嚼片"}},
+    {0, "急性支气管炎", "咳嗽、咳痰", "止咳化痰", 0, {"氨溴索片", "阿莫西林胶囊"}},
+    {0, "高脂血症", "体检发现血脂高", "调脂治疗，低脂饮食", 1, {"阿托伐他汀钙片", nullptr}},
+    {0, "流行性感冒", "高热、肌肉酸痛", "抗病毒、对症治疗", 0, {"奥司他韦胶囊", "布洛芬片"}},
+    {1, "急性阑尾炎", "右下腹痛", "手术治疗", -1, {"头孢呋辛酯片", nullptr}},
+    {1, "胆囊结石", "右上腹痛、腹胀", "择期手术", 1, {"熊去氧胆酸胶囊", nullptr}},
+    {1, "腹股沟疝", "腹股沟包块", "疝修补术", 1, {nullptr, nullptr}},
+    {1, "软组织挫伤", "局部肿痛", "冷敷、制动", 0, {"双氯芬酸钠凝胶", "布洛芬片"}},
+    {1, "甲状腺结节", "颈部肿物", "定期复查超声", 0, {nullptr, nullptr}},
+    {2, "小儿肺炎", "发热、咳嗽、气促", "抗感染、雾化", -1, {"阿莫西林颗粒", "氨溴索口服液"}},
+    {2, "手足口病", "发热、手足疱疹", "隔离、对症治疗", -1, {nullptr, nullptr}},
+    {2, "小儿腹泻", "腹泻、呕吐", "补液、调节肠道菌群", -1, {"蒙脱石散", "口服补液盐"}},
+    {2, "急性扁桃体炎", "咽痛、发热", "抗感染治疗", -1, {"阿莫西林颗粒", nullptr}},
+    {3, "腰椎间盘突出症", "腰痛、下肢麻木", "卧床休息、理疗", 1, {"塞来昔布胶囊", "甲钴胺片"}},
+    {3, "膝骨关节炎", "膝关节疼痛", "减重、理疗", 1, {"氨基葡萄糖胶囊", "塞来昔布胶囊"}},
+    {3, "桡骨远端骨折", "腕部肿痛、畸形", "复位固定", 0, {nullptr, nullptr}},
+    {3, "颈椎病", "颈肩痛、手麻", "理疗、颈托", 1, {"甲钴胺片", nullptr}},
+    {4, "早孕检查", "停经", "定期产检", -1, {"叶酸片", nullptr}},
+    {4, "子宫肌瘤", "月经量多", "定期复查", 1, {nullptr, nullptr}},
+    {4, "阴道炎", "分泌物异常", "局部用药", 0, {"甲硝唑片", nullptr}},
+    {5, "青光眼", "眼胀、视物模糊", "降眼压治疗", 1, {"噻吗洛尔滴眼液", nullptr}},
+    {5, "白内障", "视物模糊", "手术治疗", 1, {nullptr, nullptr}},
+    {5, "结膜炎", "眼红、分泌物多", "抗感染滴眼", 0, {"左氧氟沙星滴眼液", nullptr}},
+    {5, "近视", "视远模糊", "验光配镜", -1, {nullptr, nullptr}},
+    {6, "慢性鼻窦炎", "鼻塞、流脓涕", "鼻腔冲洗", 0, {"糠酸莫米松鼻喷雾剂", nullptr}},
+    {6, "中耳炎", "耳痛、听力下降", "抗感染治疗", -1, {"阿莫西林胶囊", nullptr}},
+    {6, "过敏性鼻炎", "鼻痒、打喷嚏", "抗过敏治疗", 0, {"氯雷他定片", "糠酸莫米松鼻喷雾剂"}},
+    {7, "龋齿", "牙痛", "充填治疗", 0, {nullptr, nullptr}},
+    {7, "牙周炎", "牙龈出血", "洁治、刮治", 1, {"甲硝唑片", nullptr}},
+    {8, "湿疹", "皮肤瘙痒、红斑", "外用激素软膏", 0, {"丁酸氢化可的松乳膏", "氯雷他定片"}},
+    {8, "痤疮", "面部丘疹", "外用药物", -1, {"阿达帕林凝胶", nullptr}},
+    {8, "荨麻疹", "风团、瘙痒", "抗过敏治疗", 0, {"氯雷他定片", nullptr}},
+    {9, "偏头痛", "头痛、畏光", "止痛药+休息", 0, {"布洛芬片", nullptr}},
+    {9, "脑梗死", "肢体无力、言语不清", "抗血小板、康复治疗", 1, {"阿司匹林肠溶片", "阿托伐他汀钙片"}},
+    {9, "失眠", "入睡困难", "睡眠卫生指导", 0, {"右佐匹克隆片", nullptr}},
+    {10, "上呼吸道感染", "发热、咳嗽、咽痛", "对症支持治疗，多饮水", 0, {"布洛芬片", "连花清瘟胶囊"}},
+    {10, "高血压", "头晕、头痛", "低盐饮食，规律服用降压药", 1, {"苯磺酸氨氯地平片", nullptr}},
+    {10, "腰肌劳损", "腰酸痛", "理疗、休息", 0, {"双氯芬酸钠凝胶", nullptr}},
+    {10, "失眠", "入睡困难", "睡眠卫生指导", 0, {"右佐匹克隆片", nullptr}},
+};
+const int kDiseaseCount = int(sizeof(kDiseases) / sizeof(kDiseases[0]));
+
+struct MedDef { const char *name; const char *spec; const char *usage; };
+const MedDef kMedications[] = {
+    {"布洛芬片", "0.2g*24片", "口服，每次2片，一日3次"},
+    {"阿莫西林胶囊", "0.5g*20粒", "口服，每次1粒，一日3次"},
+    {"氯雷他定片", "10mg*10片", "口服，每日1片"},
+    {"连花清瘟胶囊", "0.35g*24粒", "口服，每次4粒，一日3次"},
+    {"苯磺酸氨氯地平片", "5mg*14片", "口服，每日1片"},
+    {"缬沙坦胶囊", "80mg*7粒", "口服，每日1粒"},
+    {"二甲双胍片", "0.5g*20片", "口服，每次1片，一日2-3次，随餐"},
+    {"阿卡波糖片", "50mg*30片", "口服，每次1片，一日3次，随第一口饭嚼服"},
+    {"阿司匹林肠溶片", "100mg*30片", "口服，每日1片"},
+    {"阿托伐他汀钙片", "20mg*7片", "口服，每晚1片"},
+    {"奥美拉唑肠溶胶囊", "20mg*14粒", "口服，每日1-2次，餐前"},
+    {"铝碳酸镁咀嚼片", "0.5g*20片", "嚼服，每次2片，一日3次"},
+    {"氨溴索片", "30mg*20片", "口服，每次1片，一日3次"},
+    {"奥司他韦胶囊", "75mg*10粒", "口服，每次1粒，一日2次"},
+    {"头孢呋辛酯片", "0.25g*12片", "口服，每次1片，一日2次"},
+    {"熊去氧胆酸胶囊", "0.25g*25粒", "口服，每次1粒，一日2次"},
+    {"双氯芬酸钠凝胶", "20g", "外用，一日3-4次"},
+    {"阿莫西林颗粒", "0.125g*12袋", "口服，按体重分次服用"},
+    {"氨溴索口服液", "100ml", "口服，按年龄分次服用"},
+    {"蒙脱石散", "3g*10袋", "口服，每次1袋，一日3次"},
+    {"口服补液盐", "5.125g*6袋", "溶于温水后分次口服"},
+    {"塞来昔布胶囊", "0.2g*6粒", "口服，每日1-2次"},
+    {"甲钴胺片", "0.5mg*20片", "口服，每次1片，一日3次"},
+    {"氨基葡萄糖胶囊", "0.25g*24粒", "口服，每次2粒，一日3次"},
+    {"叶酸片", "0.4mg*31片", "口服，每日1片"},
+    {"甲硝唑片", "0.2g*21片", "口服，每次2片，一日3次"},
+    {"噻吗洛尔滴眼液", "5ml", "滴眼，每次1滴，一日2次"},
+    {"左氧氟沙星滴眼液", "5ml", "滴眼，每次1滴，一日4次"},
+    {"糠酸莫米松鼻喷雾剂", "50μg*60揿", "喷鼻，每日1次"},
+    {"丁酸氢化可的松乳膏", "10g", "外用，一日2次"},
+    {"阿达帕林凝胶", "30g", "外用，每晚1次"},
+    {"右佐匹克隆片", "3mg*7片", "睡前口服1片"},
+};
+
+// 常见姓氏按人口排序，抽取时按 Zipf 加权
+const char *const kSurnames[] = {
+    "王", "李", "张", "刘", "陈", "杨", "黄", "赵", "吴", "周", "徐", "孙", "马", "朱", "胡",
+    "郭", "何", "高", "林", "罗", "郑", "梁", "谢", "宋", "唐", "许", "韩", "冯", "邓", "曹",
+    "彭", "曾", "肖", "田", "董", "袁", "潘", "于", "蒋", "蔡", "余", "杜", "叶", "程", "苏",
+    "魏", "吕", "丁", "任", "沈", "姚", "卢", "姜", "崔", "钟", "谭", "陆", "汪", "范", "金",
+};
+const char *const kMaleChars[] = {
+    "伟", "强", "磊", "军", "勇", "杰", "涛", "斌", "超", "明", "刚", "平", "辉", "鹏", "华",
+    "飞", "鑫", "波", "宇", "浩", "凯", "健", "俊", "帆", "帅", "旭", "宁", "龙", "林", "阳",
+};
+const char *const kFemaleChars[] = {
+    "芳", "娜", "敏", "静", "丽", "艳", "娟", "霞", "秀", "燕", "玲", "桂", "丹", "萍", "红",
+    "婷", "雪", "琳", "晶", "颖", "慧", "莉", "梅", "倩", "欣", "怡", "佳", "悦", "彤", "萱",
+};
+const char *const kCities[] = {
+    "北京市", "上海市", "广州市", "深圳市", "杭州市", "成都市", "武汉市", "西安市",
+    "南京市", "重庆市", "天津市", "苏州市", "长沙市", "郑州市", "青岛市",
+};
+const char *const kPatientMessages[] = {
+    "医生您好，我想咨询一下复查时间。",
+    "吃了药之后好多了，还需要继续吃吗？",
+    "最近又有点不舒服，需要再来看吗？",
+    "请问检查结果出来了吗？",
+    "医生您好，我明天能加号吗？",
+    "药快吃完了，可以续方吗？",
+};
+const char *const kDoctorMessages[] = {
+    "可以的，请准时来。",
+    "建议按时服药，一周后复查。",
+    "检查结果正常，注意休息。",
+    "症状加重请及时就诊。",
+    "可以，来门诊开药即可。",
+    "注意饮食清淡，规律作息。",
+};
+const char *const kPrivateLeave[] = { "家中有事", "身体不适", "探亲" };
+const char *const kDutyLeave[] = { "外出学术会议", "进修培训", "下乡义诊" };
+
+template <typename T, int N>
+inline int countOf(T (&)[N]) { return N; }
+
+// 月份、星期几的就诊量系数：冬春呼吸道疾病高发，周一最忙、周末最少
+const double kMonthWeight[12] = { 1.25, 1.2, 1.05, 0.95, 0.9, 0.85, 0.85, 0.9, 0.95, 1.0, 1.1, 1.25 };
+const double kWeekdayWeight[7] = { 1.3, 1.15, 1.1, 1.05, 1.0, 0.45, 0.35 };
+const double kMaxDayWeight = 1.25 * 1.3;
+
+// 人口年龄结构，按 10 岁一档
+const double kAgeDecadeWeight[10] = { 10, 10, 13, 15, 15, 15, 12, 7, 3, 0 };
+
+// 天数（1970-01-01 起）-> 年月日
+void civilFromDays(qint64 days, int *y, int *m, int *d)
+{
+    days += 719468;
+    const qint64 era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = unsigned(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    const unsigned dd = doy - (153 * mp + 2) / 5 + 1;
+    const unsigned mm = mp < 10 ? mp + 3 : mp - 9;
+    *y = int(yoe) + int(era) * 400 + (mm <= 2 ? 1 : 0);
+    *m = int(mm);
+    *d = int(dd);
+}
+
+inline int weekdayOf(qint64 days) { return int(((days % 7) + 7 + 3) % 7); }   // 0 = 周一
+
+// 按值返回，同一条语句里绑定多个时间也不会互相覆盖
+struct Text { char s[24]; };
+
+Text dayText(qint64 secs)
+{
+    Text t;
+    int y, m, d;
+    civilFromDays(secs / 86400, &y, &m, &d);
+    std::snprintf(t.s, sizeof(t.s), "%04d-%02d-%02d", y, m, d);
+    return t;
+}
+
+Text minuteText(qint64 secs)
+{
+    Text t;
+    int y, m, d;
+    civilFromDays(secs / 86400, &y, &m, &d);
+    const int sod = int(secs % 86400);
+    std::snprintf(t.s, sizeof(t.s), "%04d-%02d-%02d %02d:%02d", y, m, d, sod / 3600, sod / 60 % 60);
+    return t;
+}
+
+Text secondText(qint64 secs)
+{
+    Text t;
+    int y, m, d;
+    civilFromDays(secs / 86400, &y, &m, &d);
+    const int sod = int(secs % 86400);
+    std::snprintf(t.s, sizeof(t.s), "%04d-%02d-%02d %02d:%02d:%02d",
+                  y, m, d, sod / 3600, sod / 60 % 60, sod % 60);
+    return t;
+}
+
+Text clockText(int minutes)
+{
+    Text t;
+    std::snprintf(t.s, sizeof(t.s), "%02d:%02d", minutes / 60, minutes % 60);
+    return t;
+}
+
+QVector<double> cumulative(const QVector<double> &weights)
+{
+    QVector<double> cum(weights.size());
+    double sum = 0;
+    for (int i = 0; i < weights.size(); ++i) {
+        sum += weights[i];
+        cum[i] = sum;
+    }
+    return cum;
+}
+
+} // namespace
+
+// ---------------- Rng ----------------
+
+DataGenerator::Rng::Rng(quint64 seed)
+{
+    // splitmix64 展开种子
+    for (int i = 0; i < 4; ++i) {
+        seed += 0x9E3779B97F4A7C15ULL;
+        quint64 z = seed;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        s[i] = z ^ (z >> 31);
+    }
+}
+
+quint64 DataGenerator::Rng::next()
+{
+    const quint64 result = ((s[1] * 5) << 7 | (s[1] * 5) >> 57) * 9;
+    const quint64 t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return result;
+}
+
+double DataGenerator::Rng::uniform()
+{
+    return double(next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int DataGenerator::Rng::below(int n)
+{
+    return n <= 1 ? 0 : int((next() >> 32) * quint64(n) >> 32);
+}
+
+int DataGenerator::Rng::range(int lo, int hi)
+{
+    return lo + below(hi - lo + 1);
+}
+
+bool DataGenerator::Rng::chance(double p)
+{
+    return uniform() < p;
+}
+
+double DataGenerator::Rng::normal(double mean, double sd)
+{
+    // Box-Muller，只用一个分量
+    const double u1 = 1.0 - uniform();
+    const double u2 = uniform();
+    return mean + sd * std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+}
+
+double DataGenerator::Rng::exponential(double mean)
+{
+    return -mean * std::log(1.0 - uniform());
+}
+
+int DataGenerator::Rng::weighted(const QVector<double> &cum)
+{
+    if (cum.isEmpty())
+        return -1;
+    const double x = uniform() * cum.last();
+    const int i = int(std::upper_bound(cum.constBegin(), cum.constEnd(), x) - cum.constBegin());
+    return qMin(i, cum.size() - 1);
+}
+
+// ---------------- Stmt ----------------
+
+DataGenerator::Stmt &DataGenerator::Stmt::i(qint64 v)
+{
+    sqlite3_bind_int64(st, ++col, v);
+    return *this;
+}
+
+DataGenerator::Stmt &DataGenerator::Stmt::d(double v)
+{
+    sqlite3_bind_double(st, ++col, v);
+    return *this;
+}
+
+DataGenerator::Stmt &DataGenerator::Stmt::t(const QByteArray &v)
+{
+    sqlite3_bind_text(st, ++col, v.constData(), v.size(), SQLITE_TRANSIENT);
+    return *this;
+}
+
+DataGenerator::Stmt &DataGenerator::Stmt::t(const char *v)
+{
+    sqlite3_bind_text(st, ++col, v, -1, SQLITE_TRANSIENT);
+    return *this;
+}
+
+DataGenerator::Stmt &DataGenerator::Stmt::null()
+{
+    sqlite3_bind_null(st, ++col);
+    return *this;
+}
+
+// ---------------- DataGenerator ----------------
+
+DataGenerator::DataGenerator(const DataGenConfig &config)
+    : m_config(config)
+    , m_rng(config.seed)
+    , m_db(nullptr)
+    , m_nextUser(1), m_nextDoctor(1), m_nextPatient(1), m_nextSchedule(1), m_nextAppt(1)
+    , m_nextEncounter(1), m_nextRecord(1), m_nextRx(1), m_nextRxItem(1), m_nextInvoice(1)
+    , m_nextMsg(1), m_nextAssess(1), m_nextAttendance(1), m_nextLeave(1)
+    , m_scheduleBase(1)
+    , m_firstEncounter(1)
+    , m_rowsInTx(0)
+    , m_rowsTotal(0)
+    , m_rowsAtLastReport(0)
+    , m_lastReportMs(0)
+{
+    // 时间按本地墙上时间算，和服务器写入的 'yyyy-MM-dd HH:mm' 一致
+    const QDateTime now = QDateTime::currentDateTime();
+    m_now = QDateTime(now.date(), now.time(), Qt::UTC).toMSecsSinceEpoch() / 1000;
+    const int years = qMax(1, m_config.years);
+    m_today = years * 365;
+    m_windowStart = (m_now / 86400 - m_today) * 86400;
+    m_windowDays = m_today + 14;
+
+    for (int i = 0; i < kDiseaseCount; ++i) {
+        const int set = kDiseases[i].set;
+        if (m_diseaseSets.size() <= set)
+            m_diseaseSets.resize(set + 1);
+        m_diseaseSets[set].append(i);
+    }
+}
+
+DataGenerator::~DataGenerator()
+{
+    if (m_db)
+        sqlite3_close(m_db);
+}
+
+bool DataGenerator::exec(const char *sql, QString *error)
+{
+    char *msg = nullptr;
+    if (sqlite3_exec(m_db, sql, nullptr, nullptr, &msg) != SQLITE_OK) {
+        if (error) *error = QString::fromUtf8(msg ? msg : "sqlite error") + " [" + QString::fromUtf8(sql) + "]";
+        sqlite3_free(msg);
+        return false;
+    }
+    return true;
+}
+
+bool DataGenerator::prepare(Stmt *stmt, const char *sql, QString *error)
+{
+    if (sqlite3_prepare_v2(m_db, sql, -1, &stmt->st, nullptr) != SQLITE_OK) {
+        if (error) *error = QString::fromUtf8(sqlite3_errmsg(m_db)) + " [" + QString::fromUtf8(sql) + "]";
+        return false;
+    }
+    return true;
+}
+
+bool DataGenerator::step(Stmt *stmt, QString *error)
+{
+    const int rc = sqlite3_step(stmt->st);
+    sqlite3_reset(stmt->st);
+    stmt->col = 0;
+    if (rc != SQLITE_DONE) {
+        if (error) *error = QString::fromUtf8(sqlite3_errmsg(m_db)) + " [" + QString::fromUtf8(sqlite3_sql(stmt->st)) + "]";
+        return false;
+    }
+    return tick(error);
+}
+
+bool DataGenerator::tick(QString *error)
+{
+    ++m_rowsTotal;
+    if (++m_rowsInTx < m_config.batchRows)
+        return true;
+    m_rowsInTx = 0;
+    return exec("COMMIT; BEGIN", error);
+}
+
+void DataGenerator::progress(const char *table, bool force)
+{
+    const qint64 ms = m_clock.elapsed();
+    if (!force && ms - m_lastReportMs < 1000)
+        return;
+    const qint64 rows = m_rowsTotal - m_rowsAtLastReport;
+    const double rate = ms > m_lastReportMs ? rows * 1000.0 / (ms - m_lastReportMs) : 0;
+    QTextStream(stdout) << QString("[%1s] %2: %3 rows total, %4 rows/s\n")
+                           .arg(ms / 1000.0, 0, 'f', 1).arg(table)
+                           .arg(m_rowsTotal).arg(qRound64(rate));
+    m_lastReportMs = ms;
+    m_rowsAtLastReport = m_rowsTotal;
+}
+
+qint64 DataGenerator::maxId(const char *table, const char *pk)
+{
+    const QByteArray sql = QByteArray("SELECT IFNULL(MAX(") + pk + "), 0) FROM " + table;
+    sqlite3_stmt *st = nullptr;
+    qint64 v = 0;
+    if (sqlite3_prepare_v2(m_db, sql.constData(), -1, &st, nullptr) == SQLITE_OK
+        && sqlite3_step(st) == SQLITE_ROW)
+        v = sqlite3_column_int64(st, 0);
+    sqlite3_finalize(st);
+    return v;
+}
+
+bool DataGenerator::run(QString *error)
+{
+    m_clock.start();
+
+    if (!QFileInfo::exists(m_config.templatePath)) {
+        if (error) *error = "template database not found: " + m_config.templatePath;
+        return false;
+    }
+    if (QFileInfo::exists(m_config.outPath) && !m_config.force) {
+        if (error) *error = m_config.outPath + " already exists (use --force to overwrite)";
+        return false;
+    }
+
+    // 先写临时文件，完成后改名，失败时不留下半成品
+    m_tmpPath = m_config.outPath + ".tmp";
+    QFile::remove(m_tmpPath);
+    if (sqlite3_open_v2(QFile::encodeName(m_tmpPath).constData(), &m_db,
+                        SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        if (error) *error = "cannot create " + m_tmpPath;
+        return false;
+    }
+
+    bool ok = exec("PRAGMA page_size=8192;"
+                   "PRAGMA journal_mode=OFF;"
+                   "PRAGMA synchronous=OFF;"
+                   "PRAGMA locking_mode=EXCLUSIVE;"
+                   "PRAGMA temp_store=MEMORY;"
+                   "PRAGMA cache_size=-262144;", error)
+              && createSchema(error)
+              && exec("BEGIN", error)
+              && genReference(error)
+              && genDoctors(error)
+              && genDoctorCalendar(error)
+              && genPatients(error)
+              && exec("COMMIT", error)
+              && finishSchema(error);
+
+    sqlite3_close(m_db);
+    m_db = nullptr;
+
+    if (ok) {
+        QFile::remove(m_config.outPath);
+        ok = QFile::rename(m_tmpPath, m_config.outPath);
+        if (!ok && error) *error = "cannot rename " + m_tmpPath + " to " + m_config.outPath;
+    }
+    if (!ok) {
+        QFile::remove(m_tmpPath);
+        return false;
+    }
+    progress("done", true);
+    return true;
+}
+
+bool DataGenerator::createSchema(QString *error)
+{
+    const QByteArray tpl = QFile::encodeName(m_config.templatePath);
+    Stmt attach;
+    if (!prepare(&attach, "ATTACH DATABASE ? AS tpl", error))
+        return false;
+    attach.t(tpl);
+    const int rc = sqlite3_step(attach.st);
+    sqlite3_finalize(attach.st);
+    if (rc != SQLITE_DONE) {
+        if (error) *error = QString::fromUtf8(sqlite3_errmsg(m_db));
+        return false;
+    }
+
+    // 表立即建；索引、视图、触发器留到数据灌完。
+    // 全文检索等虚表由服务器启动时自行重建，这里连同其影子表和相关触发器一起跳过
+    Stmt master;
+    if (!prepare(&master, "SELECT type, name, sql FROM tpl.sqlite_master "
+                          "WHERE sql IS NOT NULL ORDER BY rowid", error))
+        return false;
+    QStringList virtualTables;
+    QStringList creates;
+    while (sqlite3_step(master.st) == SQLITE_ROW) {
+        const QString type = QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(master.st, 0)));
+        const QString name = QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(master.st, 1)));
+        const QString sql  = QString::fromUtf8(reinterpret_cast<const char *>(sqlite3_column_text(master.st, 2)));
+        if (name.startsWith("sqlite_"))
+            continue;
+        bool virtualRelated = false;
+        for (const QString &v : virtualTables)
+            if (name.startsWith(v + "_") || sql.contains(v))
+                virtualRelated = true;
+        if (virtualRelated)
+            continue;
+        if (type == "table") {
+            if (sql.startsWith("CREATE VIRTUAL TABLE", Qt::CaseInsensitive)) {
+                virtualTables << name;
+                continue;
+            }
+            creates << sql;
+            m_tables << name;
+        } else {
+            m_deferredSql << sql;
+        }
+    }
+    sqlite3_finalize(master.st);
+
+    if (!exec("BEGIN", error))
+        return false;
+    for (const QString &sql : creates)
+        if (!exec(sql.toUtf8().constData(), error))
+            return false;
+    if (m_config.keepSeedRows && !copySeedRows(error))
+        return false;
+    if (!exec("COMMIT; DETACH DATABASE tpl", error))
+        return false;
+
+    m_nextUser       = maxId("users", "user_id") + 1;
+    m_nextDoctor     = maxId("doctors", "doctor_id") + 1;
+    m_nextPatient    = maxId("patients", "patient_id") + 1;
+    m_nextSchedule   = maxId("schedules", "schedule_id") + 1;
+    m_nextAppt       = maxId("appointments", "appt_id") + 1;
+    m_nextEncounter  = maxId("encounters", "encounter_id") + 1;
+    m_nextRecord     = maxId("medical_records", "record_id") + 1;
+    m_nextRx         = maxId("prescriptions", "prescription_id") + 1;
+    m_nextRxItem     = maxId("prescription_items", "item_id") + 1;
+    m_nextInvoice    = maxId("invoices", "invoice_id") + 1;
+    m_nextMsg        = maxId("messages", "msg_id") + 1;
+    m_nextAssess     = maxId("health_assessments", "assess_id") + 1;
+    m_nextAttendance = maxId("attendance", "att_id") + 1;
+    m_nextLeave      = maxId("leaves", "leave_id") + 1;
+    m_firstEncounter = m_nextEncounter;
+
+    progress("schema", true);
+    return true;
+}
+
+bool DataGenerator::copySeedRows(QString *error)
+{
+    for (const QString &table : m_tables) {
+        const QByteArray sql = QString("INSERT INTO main.\"%1\" SELECT * FROM tpl.\"%1\"")
+                               .arg(table).toUtf8();
+        if (!exec(sql.constData(), error))
+            return false;
+    }
+    return true;
+}
+
+bool DataGenerator::genReference(QString *error)
+{
+    Stmt dept, med;
+    if (!prepare(&dept, "INSERT OR IGNORE INTO departments(name) VALUES(?)", error)
+        || !prepare(&med, "INSERT OR IGNORE INTO medications(name, spec, usage_info) VALUES(?,?,?)", error))
+        return false;
+    bool ok = true;
+    for (int i = 0; ok && i < countOf(kDepartments); ++i)
+        ok = step(&dept.t(kDepartments[i].name), error);
+    for (int i = 0; ok && i < countOf(kMedications); ++i)
+        ok = step(&med.t(kMedications[i].name).t(kMedications[i].spec).t(kMedications[i].usage), error);
+    sqlite3_finalize(dept.st);
+    sqlite3_finalize(med.st);
+    if (!ok)
+        return false;
+
+    // 读回主键（模板库原有的科室、药品保持原 id）
+    sqlite3_stmt *st = nullptr;
+    sqlite3_prepare_v2(m_db, "SELECT department_id, name FROM departments ORDER BY department_id", -1, &st, nullptr);
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        Department d;
+        d.id = sqlite3_column_int(st, 0);
+        d.name = QByteArray(reinterpret_cast<const char *>(sqlite3_column_text(st, 1)));
+        d.diseaseSet = kGeneralSet;
+        d.weight = 1;
+        for (int i = 0; i < countOf(kDepartments); ++i) {
+            if (d.name == kDepartments[i].name) {
+                d.diseaseSet = kDepartments[i].diseaseSet;
+                d.weight = kDepartments[i].weight;
+            }
+        }
+        m_departments.append(d);
+    }
+    sqlite3_finalize(st);
+
+    sqlite3_prepare_v2(m_db, "SELECT med_id, name, usage_info FROM medications", -1, &st, nullptr);
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        const qint64 id = sqlite3_column_int64(st, 0);
+        m_medicationByName.insert(QByteArray(reinterpret_cast<const char *>(sqlite3_column_text(st, 1))), id);
+        m_medicationUsage.insert(id, QByteArray(reinterpret_cast<const char *>(sqlite3_column_text(st, 2))));
+        m_medicationIds.append(id);
+    }
+    sqlite3_finalize(st);
+
+    // 各人群的科室分布
+    for (int c = 0; c < CohortCount; ++c) {
+        QVector<double> w;
+        for (const Department &d : m_departments) {
+            double x = d.weight;
+            const bool child = c == Child;
+            const bool old = c == OldMan || c == OldWoman;
+            const bool woman = c == Woman || c == OldWoman;
+            if (d.diseaseSet == kPediatrics)
+                x = child ? x * 8 : 0;
+            else if (d.diseaseSet == kGynecology)
+                x = woman ? (old ? x * 0.3 : x) : 0;
+            else if (child)
+                x *= 0.5;
+            else if (old && (d.diseaseSet == 0 || d.diseaseSet == 3 || d.diseaseSet == 5 || d.diseaseSet == 9))
+                x *= 1.8;
+            w.append(x);
+        }
+        m_departmentCum[c] = cumulative(w);
+    }
+    return true;
+}
+
+QByteArray DataGenerator::chineseName(bool male)
+{
+    // 姓氏按 1/rank 加权，前几个大姓占比接近真实
+    static QVector<double> surnameCum;
+    if (surnameCum.isEmpty()) {
+        QVector<double> w;
+        for (int i = 0; i < countOf(kSurnames); ++i)
+            w.append(1.0 / (i + 1));
+        surnameCum = cumulative(w);
+    }
+    QByteArray name(kSurnames[m_rng.weighted(surnameCum)]);
+    const int n = m_rng.chance(0.7) ? 2 : 1;
+    for (int i = 0; i < n; ++i)
+        name += male ? kMaleChars[m_rng.below(countOf(kMaleChars))]
+                     : kFemaleChars[m_rng.below(countOf(kFemaleChars))];
+    return name;
+}
+
+QByteArray DataGenerator::idCard(int region, qint64 seq, int year, int month, int day)
+{
+    // 18 位身份证号：地区码 + 出生日期 + 顺序码 + 校验码（GB 11643）。
+    // 地区码/顺序码由序号推出，保证 UNIQUE 约束不冲突
+    char buf[20];
+    std::snprintf(buf, sizeof(buf), "%06d%04d%02d%02d%03d", region, year, month, day, int(seq % 1000));
+    static const int weights[17] = { 7, 9, 10, 5, 8, 4, 2, 1, 6, 3, 7, 9, 10, 5, 8, 4, 2 };
+    int sum = 0;
+    for (int i = 0; i < 17; ++i)
+        sum += (buf[i] - '0') * weights[i];
+    buf[17] = "10X98765432"[sum % 11];
+    buf[18] = 0;
+    return QByteArray(buf, 18);
+}
+
+QByteArray DataGenerator::phone(const char *prefix)
+{
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "%s%08d", prefix, m_rng.below(100000000));
+    return QByteArray(buf);
+}
+
+bool DataGenerator::genDoctors(QString *error)
+{
+    QHash<int, int> deptIndex;
+    for (int i = 0; i < m_departments.size(); ++i)
+        deptIndex.insert(m_departments[i].id, i);
+
+    // 模板库原有医生也参与分配预约（排在各科最前，是最热门的医生）
+    sqlite3_stmt *st = nullptr;
+    sqlite3_prepare_v2(m_db, "SELECT doctor_id, user_id, department_id, IFNULL(reg_fee, 0), "
+                             "IFNULL(daily_quota, 30) FROM doctors ORDER BY doctor_id", -1, &st, nullptr);
+    while (sqlite3_step(st) == SQLITE_ROW) {
+        const int dept = deptIndex.value(sqlite3_column_int(st, 2), -1);
+        if (dept < 0)
+            continue;
+        Doctor doc;
+        doc.doctorId = sqlite3_column_int64(st, 0);
+        doc.userId = sqlite3_column_int64(st, 1);
+        doc.dept = dept;
+        doc.regFee = sqlite3_column_double(st, 3);
+        doc.dailyQuota = sqlite3_column_int(st, 4);
+        m_departments[dept].doctors.append(m_doctors.size());
+        m_doctors.append(doc);
+    }
+    sqlite3_finalize(st);
+
+    Stmt user, doctor;
+    if (!prepare(&user, "INSERT INTO users(user_id, username, password, role, phone, id_card, gender, "
+                        "status, created_at, address) VALUES(?,?,?,?,?,?,?,?,?,?)", error)
+        || !prepare(&doctor, "INSERT INTO doctors(doctor_id, user_id, department_id, full_name, bio, "
+                             "duty_start, reg_fee, daily_quota, created_at) VALUES(?,?,?,?,?,?,?,?,?)", error))
+        return false;
+
+    QVector<double> deptWeights;
+    for (const Department &d : m_departments)
+        deptWeights.append(d.weight);
+    const QVector<double> deptCum = cumulative(deptWeights);
+
+    const int count = m_config.doctors > 0 ? m_config.doctors
+                                           : int(qMax<qint64>(20, m_config.patients / 500));
+    bool ok = true;
+    for (int k = 0; ok && k < count; ++k) {
+        // 先保证每个科室至少一名医生，其余按就诊量分配
+        const int dept = k < m_departments.size() ? k : m_rng.weighted(deptCum);
+        const bool male = m_rng.chance(0.55);
+        const int age = m_rng.range(28, 62);
+        int y, mo, d;
+        civilFromDays(m_now / 86400 - age * 365 - m_rng.below(365), &y, &mo, &d);
+        const QByteArray username = QByteArray("gd") + QByteArray::number(k + 1).rightJustified(6, '0');
+        const QByteArray card = idCard(610000 + k / 1000, k, y, mo, d);
+        const QByteArray tel = phone(m_rng.chance(0.5) ? "139" : "186");
+        const QByteArray name = chineseName(male);
+        const char *city = kCities[m_rng.below(countOf(kCities))];
+        const qint64 createdAt = m_windowStart - qint64(m_rng.below(3 * 365)) * 86400;
+
+        // 职称决定挂号费：主任 15%、副主任 30%、主治 55%
+        const double r = m_rng.uniform();
+        const char *title = r < 0.15 ? "主任医师" : r < 0.45 ? "副主任医师" : "主治医师";
+        const double fee = r < 0.15 ? 50 : r < 0.45 ? 30 : 20;
+        const int quota = m_rng.range(20, 40);
+
+        Doctor doc;
+        doc.doctorId = m_nextDoctor++;
+        doc.userId = m_nextUser++;
+        doc.dept = dept;
+        doc.regFee = fee;
+        doc.dailyQuota = quota;
+        doc.calIndex = k;
+
+        ok = step(&user.i(doc.userId).t(username).t("123456").t("doctor").t(tel).t(card)
+                       .t(male ? "M" : "F").i(1).i(createdAt).t(city), error)
+             && step(&doctor.i(doc.doctorId).i(doc.userId).i(m_departments[dept].id).t(name)
+                            .t(m_departments[dept].name + title).t("周一至周五 8:00-17:00")
+                            .d(fee).i(quota).i(createdAt), error);
+        m_departments[dept].doctors.append(m_doctors.size());
+        m_doctors.append(doc);
+        progress("doctors");
+    }
+    sqlite3_finalize(user.st);
+    sqlite3_finalize(doctor.st);
+
+    // 科室内医生的受欢迎程度服从 Zipf（s = 0.8）
+    for (Department &d : m_departments) {
+        QVector<double> w;
+        for (int rank = 0; rank < d.doctors.size(); ++rank)
+            w.append(1.0 / std::pow(rank + 1.0, 0.8));
+        d.doctorCum = cumulative(w);
+    }
+    progress("doctors", true);
+    return ok;
+}
+
+bool DataGenerator::onLeave(const Doctor &doctor, int day) const
+{
+    for (const QPair<int, int> &l : doctor.leaves)
+        if (day >= l.first && day <= l.second)
+            return true;
+    return false;
+}
+
+bool DataGenerator::genDoctorCalendar(QString *error)
+{
+    // 请假、排班（工作日上午/下午各一班）、考勤（工作日，截至今天）
+    Stmt leave, schedule, attendance;
+    if (!prepare(&leave, "INSERT INTO leaves(leave_id, doctor_id, type, start_date, end_date, reason, "
+                         "created_at) VALUES(?,?,?,?,?,?,?)", error)
+        || !prepare(&schedule, "INSERT INTO schedules(schedule_id, doctor_id, start_time, end_time, "
+                               "quota, created_at) VALUES(?,?,?,?,?,?)", error)
+        || !prepare(&attendance, "INSERT INTO attendance(att_id, doctor_id, day, check_in, check_out, "
+                                 "status, created_at) VALUES(?,?,?,?,?,?,?)", error))
+        return false;
+
+    m_scheduleBase = m_nextSchedule;
+    const qint64 firstDay = m_windowStart / 86400;
+    bool ok = true;
+    for (int di = 0; ok && di < m_doctors.size(); ++di) {
+        Doctor &doc = m_doctors[di];
+        if (doc.calIndex < 0)
+            continue;
+
+        // 平均每年 3 次、每次 1~3 天
+        const int leaveCount = m_rng.range(0, 6 * m_today / 365);
+        for (int i = 0; ok && i < leaveCount; ++i) {
+            const int start = m_rng.below(m_windowDays);
+            const int end = qMin(m_windowDays - 1, start + m_rng.range(0, 2));
+            const bool duty = m_rng.chance(0.3);
+            const char *reason = duty ? kDutyLeave[m_rng.below(countOf(kDutyLeave))]
+                                      : kPrivateLeave[m_rng.below(countOf(kPrivateLeave))];
+            const qint64 startSecs = (firstDay + start) * 86400;
+            const qint64 endSecs = (firstDay + end) * 86400;
+            const qint64 createdAt = startSecs - qint64(m_rng.range(1, 14)) * 86400;
+            doc.leaves.append(qMakePair(start, end));
+            ok = step(&leave.i(m_nextLeave++).i(doc.doctorId).t(duty ? "因公" : "因私")
+                           .t(dayText(startSecs).s).t(dayText(endSecs).s).t(reason).i(createdAt), error);
+        }
+
+        for (int day = 0; ok && day < m_windowDays; ++day) {
+            if (weekdayOf(firstDay + day) >= 5)
+                continue;
+            const qint64 daySecs = (firstDay + day) * 86400;
+            const bool away = onLeave(doc, day);
+            if (!away) {
+                for (int half = 0; ok && half < 2; ++half) {
+                    const qint64 id = m_scheduleBase + (qint64(doc.calIndex) * m_windowDays + day) * 2 + half;
+                    const qint64 start = daySecs + (half ? 13 : 8) * 3600;
+                    const qint64 end = daySecs + (half ? 17 : 12) * 3600;
+                    ok = step(&schedule.i(id).i(doc.doctorId).t(minuteText(start).s).t(minuteText(end).s)
+                                       .i(qMax(1, doc.dailyQuota / 2)).i(daySecs - 7 * 86400), error);
+                }
+            }
+            if (ok && day < m_today) {
+                attendance.i(m_nextAttendance++).i(doc.doctorId).t(dayText(daySecs).s);
+                if (away) {
+                    attendance.null().null().t("leave").i(daySecs);
+                } else {
+                    // 上班 8:20 左右打卡，下班 17:20 左右，偶尔漏打下班卡
+                    const int in = 8 * 60 + qBound(-20, qRound(m_rng.normal(20, 10)), 59);
+                    const int out = 17 * 60 + qBound(-30, qRound(m_rng.normal(20, 25)), 120);
+                    const bool missed = m_rng.chance(0.01);
+                    attendance.t(clockText(in).s);
+                    if (missed)
+                        attendance.null();
+                    else
+                        attendance.t(clockText(out).s);
+                    attendance.t("normal").i(daySecs + in * 60);
+                }
+                ok = step(&attendance, error);
+            }
+            progress("schedules/attendance");
+        }
+    }
+    sqlite3_finalize(leave.st);
+    sqlite3_finalize(schedule.st);
+    sqlite3_finalize(attendance.st);
+    m_nextSchedule = m_scheduleBase + qint64(m_doctors.size()) * m_windowDays * 2;
+    progress("schedules/attendance", true);
+    return ok;
+}
+
+int DataGenerator::sampleDay()
+{
+    // 拒绝采样：按月份和星期几的系数加权
+    const qint64 firstDay = m_windowStart / 86400;
+    for (;;) {
+        const int day = m_rng.below(m_windowDays);
+        int y, m, d;
+        civilFromDays(firstDay + day, &y, &m, &d);
+        const double w = kMonthWeight[m - 1] * kWeekdayWeight[weekdayOf(firstDay + day)];
+        if (m_rng.uniform() * kMaxDayWeight < w)
+            return day;
+    }
+}
+
+int DataGenerator::pickDoctor(int age, bool male)
+{
+    const Cohort c = age < 14 ? Child : age >= 65 ? (male ? OldMan : OldWoman) : (male ? Man : Woman);
+    const int dept = m_rng.weighted(m_departmentCum[c]);
+    const Department &d = m_departments[dept];
+    if (d.doctors.isEmpty())
+        return m_rng.below(m_doctors.size());
+    return d.doctors[m_rng.weighted(d.doctorCum)];
+}
+
+int DataGenerator::pickDisease(int dept, int age)
+{
+    const int set = m_departments[dept].diseaseSet;
+    const QVector<int> &list = m_diseaseSets[set < m_diseaseSets.size() && !m_diseaseSets[set].isEmpty()
+                                             ? set : kGeneralSet];
+    double w[16];
+    double sum = 0;
+    const int n = qMin(list.size(), 16);
+    for (int i = 0; i < n; ++i) {
+        const int bias = kDiseases[list[i]].ageBias;
+        double x = 1;
+        if (bias > 0)
+            x = age >= 50 ? 3 : age >= 35 ? 1 : 0.2;
+        else if (bias < 0)
+            x = age < 30 ? 2.5 : age < 50 ? 1 : 0.4;
+        sum += x;
+        w[i] = sum;
+    }
+    const double r = m_rng.uniform() * sum;
+    for (int i = 0; i < n; ++i)
+        if (r < w[i])
+            return list[i];
+    return list[n - 1];
+}
+
+bool DataGenerator::genPatients(QString *error)
+{
+    Stmt user, patient, appt, encounter, record, rx, rxItem, invoice, message, assess;
+    if (!prepare(&user, "INSERT INTO users(user_id, username, password, role, phone, id_card, gender, "
+                        "status, created_at, address) VALUES(?,?,?,?,?,?,?,?,?,?)", error)
+        || !prepare(&patient, "INSERT INTO patients(patient_id, user_id, full_name, birth_date, age, "
+                              "height_cm, weight_kg, created_at) VALUES(?,?,?,?,?,?,?,?)", error)
+        || !prepare(&appt, "INSERT INTO appointments(appt_id, patient_id, doctor_id, schedule_id, "
+                           "start_time, status, symptom) VALUES(?,?,?,?,?,?,?)", error)
+        || !prepare(&encounter, "INSERT INTO encounters(encounter_id, appt_id, patient_id, doctor_id, "
+                                "visit_time, notes, created_at) VALUES(?,?,?,?,?,?,?)", error)
+        || !prepare(&record, "INSERT INTO medical_records(record_id, encounter_id, department_id, "
+                             "diagnosis, symptoms, treatment, created_at) VALUES(?,?,?,?,?,?,?)", error)
+        || !prepare(&rx, "INSERT INTO prescriptions(prescription_id, encounter_id, doctor_id, created_at, "
+                         "notes) VALUES(?,?,?,?,?)", error)
+        || !prepare(&rxItem, "INSERT INTO prescription_items(item_id, prescription_id, med_id, "
+                             "instruction, quantity) VALUES(?,?,?,?,?)", error)
+        || !prepare(&invoice, "INSERT INTO invoices(invoice_id, encounter_id, prescription_id, amount, "
+                              "paid, created_at) VALUES(?,?,?,?,?,?)", error)
+        || !prepare(&message, "INSERT INTO messages(msg_id, from_user, to_user, content, created_at) "
+                              "VALUES(?,?,?,?,?)", error)
+        || !prepare(&assess, "INSERT INTO health_assessments(assess_id, patient_id, submitted_at, answers_json, "
+                             "score, risk, ai_advice, height_cm, weight_kg, heart_rate, blood_pressure, "
+                             "vital_capacity) VALUES(?,?,?,?,?,?,?,?,?,?,?,?)", error))
+        return false;
+
+    QVector<double> ageWeights;
+    for (double w : kAgeDecadeWeight)
+        ageWeights.append(w);
+    const QVector<double> ageCum = cumulative(ageWeights);
+    const qint64 firstDay = m_windowStart / 86400;
+    const qint64 today = m_now / 86400;
+    std::vector<qint64> times;
+    std::vector<qint64> rxMeds;
+
+    bool ok = true;
+    for (qint64 i = 0; ok && i < m_config.patients; ++i) {
+        // ---- 患者本人 ----
+        const bool male = m_rng.chance(0.49);
+        const int age = qMin(95, m_rng.weighted(ageCum) * 10 + m_rng.below(10));
+        int by, bm, bd;
+        civilFromDays(today - qint64(age * 365.25) - m_rng.below(365), &by, &bm, &bd);
+
+        // 身高：儿童按生长曲线，成人按性别的正态分布，老年略有下降；体重由 BMI 推出
+        const double adult = male ? m_rng.normal(171, 6.5) : m_rng.normal(159.5, 6);
+        double height = age <= 1 ? 50 + 25 * age : qMin(adult, 75 + 6.2 * (age - 1));
+        if (age < 18)
+            height = m_rng.normal(height, height * 0.04);
+        if (age > 60)
+            height -= (age - 60) * 0.1;
+        const double bmi = age < 18 ? m_rng.normal(15.5 + 0.25 * age, 1.8)
+                                    : m_rng.normal(21.5 + qMin(age, 60) * 0.05, 3.2);
+        const double weight = qBound(14.0, bmi, 45.0) * (height / 100) * (height / 100);
+        const double heightCm = std::round(height * 10) / 10;
+        const double weightKg = std::round(weight * 10) / 10;
+
+        const qint64 userId = m_nextUser++;
+        const qint64 patientId = m_nextPatient++;
+        const QByteArray username = QByteArray("gp") + QByteArray::number(i + 1).rightJustified(8, '0');
+        const QByteArray card = idCard(310000 + int(i / 1000), i, by, bm, bd);
+        const QByteArray tel = phone(m_rng.chance(0.6) ? "138" : "159");
+        const QByteArray name = chineseName(male);
+        const char *city = kCities[m_rng.below(countOf(kCities))];
+        const qint64 createdAt = m_windowStart - qint64(m_rng.below(2 * 365)) * 86400;
+        char birth[16];
+        std::snprintf(birth, sizeof(birth), "%04d-%02d-%02d", by, bm, bd);
+
+        ok = step(&user.i(userId).t(username).t("123456").t("patient").t(tel).t(card)
+                       .t(male ? "M" : "F").i(1).i(createdAt).t(city), error)
+             && step(&patient.i(patientId).i(userId).t(name).t(birth).i(age)
+                             .d(heightCm).d(weightKg).i(createdAt), error);
+
+        // ---- 预约：次数重尾分布，年纪越大越多；55% 找固定的主治医生 ----
+        const int home = pickDoctor(age, male);
+        const int n = qMin(500, int(m_rng.exponential(m_config.apptsPerPatient * (0.45 + age / 70.0))));
+        times.clear();
+        for (int k = 0; k < n; ++k) {
+            const int day = sampleDay();
+            const bool morning = m_rng.chance(0.58);
+            const int slot = m_rng.below(24);
+            times.push_back((firstDay + day) * 86400 + (morning ? 8 * 3600 : 13 * 3600) + slot * 600);
+        }
+        std::sort(times.begin(), times.end());
+        for (size_t k = 1; k < times.size(); ++k)
+            if (times[k] <= times[k - 1])
+                times[k] = times[k - 1] + 600;     // (患者, 医生, 时间) 唯一
+
+        for (size_t k = 0; ok && k < times.size(); ++k) {
+            const qint64 t = times[k];
+            const int di = m_rng.chance(0.55) ? home : pickDoctor(age, male);
+            const Doctor &doc = m_doctors[di];
+            const DiseaseDef &disease = kDiseases[pickDisease(doc.dept, age)];
+            const int day = int(t / 86400 - firstDay);
+            const int half = (t % 86400) < 12 * 3600 ? 0 : 1;
+            const bool past = t < m_now;
+            const bool away = doc.calIndex >= 0 && onLeave(doc, day);
+            const bool workday = weekdayOf(t / 86400) < 5;
+
+            // 医生请假的号被取消；过去的号多数已就诊，未来的号多为待确认
+            const double r = m_rng.uniform();
+            const char *status = away ? "cancelled"
+                               : past ? (r < 0.12 ? "cancelled" : r < 0.15 ? "pending" : "confirmed")
+                                      : (r < 0.55 ? "pending" : r < 0.95 ? "confirmed" : "cancelled");
+            const qint64 apptId = m_nextAppt++;
+            appt.i(apptId).i(patientId).i(doc.doctorId);
+            if (doc.calIndex >= 0 && workday && !away && day < m_windowDays)
+                appt.i(m_scheduleBase + (qint64(doc.calIndex) * m_windowDays + day) * 2 + half);
+            else
+                appt.null();
+            ok = step(&appt.t(minuteText(t).s).t(status).t(disease.symptoms), error);
+
+            // ---- 就诊、病历、处方、发票 ----
+            if (!ok || !past || status[0] != 'c' || status[1] != 'o' || !m_rng.chance(0.92))
+                continue;
+            const qint64 visit = t + m_rng.range(0, 40) * 60 + m_rng.below(60);
+            const qint64 encounterId = m_nextEncounter++;
+            ok = step(&encounter.i(encounterId).i(apptId).i(patientId).i(doc.doctorId)
+                                .t(secondText(visit).s).t(disease.treatment).i(visit), error)
+                 && step(&record.i(m_nextRecord++).i(encounterId).i(m_departments[doc.dept].id)
+                                 .t(disease.name).t(disease.symptoms).t(disease.treatment).i(visit), error)
+                 && step(&invoice.i(m_nextInvoice++).i(encounterId).null().d(doc.regFee).i(1).i(visit), error);
+            if (!ok || !m_rng.chance(0.7))
+                continue;
+
+            rxMeds.clear();
+            for (const char *medName : disease.meds) {
+                if (!medName)
+                    continue;
+                const qint64 id = m_medicationByName.value(QByteArray(medName), 0);
+                if (id > 0)
+                    rxMeds.push_back(id);
+            }
+            if (rxMeds.empty() || m_rng.chance(0.3)) {
+                const qint64 extra = m_medicationIds[m_rng.below(m_medicationIds.size())];
+                if (std::find(rxMeds.begin(), rxMeds.end(), extra) == rxMeds.end())
+                    rxMeds.push_back(extra);
+            }
+            const qint64 rxId = m_nextRx++;
+            const qint64 rxAt = visit + m_rng.range(5, 20) * 60;
+            ok = step(&rx.i(rxId).i(encounterId).i(doc.doctorId).i(rxAt)
+                         .t(m_rng.chance(0.4) ? "饭后服用" : ""), error);
+            double amount = 0;
+            for (size_t j = 0; ok && j < rxMeds.size(); ++j) {
+                const int quantity = m_rng.range(1, 3);
+                amount += quantity * m_rng.range(15, 120);
+                ok = step(&rxItem.i(m_nextRxItem++).i(rxId).i(rxMeds[j])
+                                 .t(m_medicationUsage.value(rxMeds[j])).d(quantity), error);
+            }
+            if (ok) {
+                const bool paid = m_rng.chance(0.96);
+                ok = step(&invoice.i(m_nextInvoice++).i(encounterId).i(rxId).d(amount).i(paid ? 1 : 0).i(rxAt), error);
+            }
+        }
+
+        // ---- 与主治医生的消息往来 ----
+        const int messages = int(m_rng.exponential(m_config.messagesPerPatient));
+        if (ok && messages > 0) {
+            times.clear();
+            for (int k = 0; k < messages; ++k)
+                times.push_back(m_windowStart + qint64(m_rng.below(m_today)) * 86400 + m_rng.range(7 * 3600, 23 * 3600));
+            std::sort(times.begin(), times.end());
+            const qint64 doctorUser = m_doctors[home].userId;
+            for (int k = 0; ok && k < messages; ++k) {
+                const bool fromPatient = k % 2 == 0;
+                const char *content = fromPatient ? kPatientMessages[m_rng.below(countOf(kPatientMessages))]
+                                                  : kDoctorMessages[m_rng.below(countOf(kDoctorMessages))];
+                ok = step(&message.i(m_nextMsg++).i(fromPatient ? userId : doctorUser)
+                                  .i(fromPatient ? doctorUser : userId).t(content).i(times[k]), error);
+            }
+        }
+
+        // ---- 健康评估：得分随年龄、问卷答案下降 ----
+        if (ok && m_rng.chance(m_config.assessmentRatio)) {
+            const int rounds = m_rng.range(1, 3);
+            for (int k = 0; ok && k < rounds; ++k) {
+                int answers[4];
+                int sum = 0;
+                for (int &a : answers) {
+                    a = qBound(0, int(m_rng.exponential(0.6 + age / 80.0)), 3);
+                    sum += a;
+                }
+                const QByteArray json = QString("[%1,%2,%3,%4]").arg(answers[0]).arg(answers[1])
+                                        .arg(answers[2]).arg(answers[3]).toUtf8();
+                const double score = qBound(40.0, std::round(100 - sum * 5 - qMax(0, age - 50) * 0.3
+                                                             + m_rng.normal(0, 3)), 100.0);
+                const char *risk = score >= 80 ? "low" : score >= 60 ? "medium" : "high";
+                const char *advice = score >= 80 ? "注意休息，规律作息"
+                                   : score >= 60 ? "建议适量运动，定期体检"
+                                                 : "建议尽快到医院进一步检查";
+                const int over30 = qMax(0, age - 30);
+                const int heartRate = qRound(m_rng.normal(76, 9));
+                const int systolic = qRound(m_rng.normal(112 + 0.5 * over30, 12));
+                const int diastolic = qRound(m_rng.normal(74 + 0.2 * over30, 8));
+                const double vital = std::round(m_rng.normal(male ? 4000 - 15 * over30 : 3000 - 11 * over30, 450));
+                const double w = std::round((weightKg + m_rng.normal(0, 1.5)) * 10) / 10;
+                const qint64 at = m_windowStart + qint64(m_rng.below(m_today)) * 86400 + m_rng.range(8 * 3600, 22 * 3600);
+                const QByteArray bp = QByteArray::number(systolic) + "/" + QByteArray::number(diastolic);
+                ok = step(&assess.i(m_nextAssess++).i(patientId).i(at).t(json).d(score).t(risk).t(advice)
+                                 .d(heightCm).d(w).i(heartRate).t(bp).d(vital), error);
+            }
+        }
+        progress("patients");
+    }
+
+    for (Stmt *s : { &user, &patient, &appt, &encounter, &record, &rx, &rxItem, &invoice, &message, &assess })
+        sqlite3_finalize(s->st);
+    progress("patients", true);
+    return ok;
+}
+
+bool DataGenerator::genDiseaseStats(QString *error)
+{
+    // 从生成的病历汇总，格式与原表一致：每行只细分一个维度，其余为 ALL
+    const char *const groups[3][2] = {
+        { "CASE WHEN p.age <= 18 THEN '0-18' WHEN p.age <= 40 THEN '19-40' "
+          "WHEN p.age <= 65 THEN '41-65' ELSE '65+' END", "%1, 'ALL', 'ALL'" },
+        { "CASE WHEN p.weight_kg < 50 THEN '<50kg' WHEN p.weight_kg < 70 THEN '50-70kg' "
+          "WHEN p.weight_kg < 90 THEN '70-90kg' ELSE '90kg+' END", "'ALL', %1, 'ALL'" },
+        { "CASE WHEN p.height_cm < 160 THEN '<160cm' WHEN p.height_cm < 170 THEN '160-170cm' "
+          "WHEN p.height_cm < 180 THEN '170-180cm' ELSE '180cm+' END", "'ALL', 'ALL', %1" },
+    };
+    for (const auto &g : groups) {
+        const QByteArray sql = QString(
+            "INSERT INTO disease_stats(disease, age_group, weight_group, height_group, year, count) "
+            "SELECT diagnosis, %1, y, COUNT(DISTINCT patient_id) FROM ("
+            "  SELECT r.diagnosis, p.patient_id, %2 AS grp, CAST(substr(e.visit_time, 1, 4) AS INTEGER) AS y"
+            "  FROM medical_records r"
+            "  JOIN encounters e ON e.encounter_id = r.encounter_id"
+            "  JOIN patients p ON p.patient_id = e.patient_id"
+            "  WHERE r.encounter_id >= %3) "
+            "GROUP BY diagnosis, grp, y")
+            .arg(QString(g[1]).arg("grp"), QString(g[0])).arg(m_firstEncounter).toUtf8();
+        if (!exec(sql.constData(), error))
+            return false;
+    }
+    return true;
+}
+
+bool DataGenerator::finishSchema(QString *error)
+{
+    if (!exec("BEGIN", error) || !genDiseaseStats(error))
+        return false;
+    progress("disease_stats", true);
+
+    // 数据灌完再建索引（一次排序建成）、视图和触发器
+    for (const QString &sql : m_deferredSql) {
+        if (!exec(sql.toUtf8().constData(), error))
+            return false;
+        progress("indexes");
+    }
+    if (!exec("COMMIT; ANALYZE; PRAGMA journal_mode=DELETE", error))
+        return false;
+    progress("indexes", true);
+
+    // 汇总各表行数
+    for (const QString &table : m_tables) {
+        const QByteArray sql = QString("SELECT COUNT(*) FROM \"%1\"").arg(table).toUtf8();
+        sqlite3_stmt *st = nullptr;
+        if (sqlite3_prepare_v2(m_db, sql.constData(), -1, &st, nullptr) == SQLITE_OK
+            && sqlite3_step(st) == SQLITE_ROW)
+            QTextStream(stdout) << QString("  %1 %2\n").arg(table, -20).arg(sqlite3_column_int64(st, 0));
+        sqlite3_finalize(st);
+    }
+    return true;
+}
@@ -0,0 +1,149 @@
+#ifndef DATAGENERATOR_H
+#define DATAGENERATOR_H
+
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QPair>
+#include <QVector>
+#include <QHash>
+#include <QElapsedTimer>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// 生成配置；规模按患者数推算，其余表按比例生成
+struct DataGenConfig
+{
+    QString templatePath = "MedicalData.db";   // 取表结构（及可选的原有数据）
+    QString outPath = "MedicalData_large.db";
+    qint64 patients = 100000;
+    int doctors = 0;                    // <=0 时按 patients / 500（至少 20）
+    double apptsPerPatient = 20;        // 每个患者平均预约数（重尾分布）
+    double messagesPerPatient = 2;
+    double assessmentRatio = 0.3;       // 做过健康评估的患者比例
+    int years = 3;                      // 历史跨度，另加未来 14 天的预约
+    quint64 seed = 20250901;
+    int batchRows = 200000;             // 每个事务的行数
+    bool keepSeedRows = true;           // 保留模板库原有的行（基准与示例账号依赖它们）
+    bool force = false;                 // 覆盖已存在的输出文件
+};
+
+// 合成数据生成器：按模板库的表结构生成大规模、分布接近真实的 MedicalData.db。
+// 先只建表、批量灌数据（journal 关闭，预编译语句复用，大事务），
+// 最后再建索引、视图和触发器，避免逐行维护索引和逐行触发。
+class DataGenerator
+{
+public:
+    explicit DataGenerator(const DataGenConfig &config);
+    ~DataGenerator();
+
+    bool run(QString *error);
+
+private:
+    // 确定性随机数（xoshiro256**），同一个 seed 生成同一个库
+    struct Rng {
+        quint64 s[4];
+        explicit Rng(quint64 seed);
+        quint64 next();
+        double uniform();                   // [0, 1)
+        int below(int n);                   // [0, n)
+        int range(int lo, int hi);          // [lo, hi]
+        bool chance(double p);
+        double normal(double mean, double sd);
+        double exponential(double mean);
+        int weighted(const QVector<double> &cumulative);
+    };
+
+    struct Stmt {
+        sqlite3_stmt *st = nullptr;
+        int col = 0;
+        Stmt &i(qint64 v);
+        Stmt &d(double v);
+        Stmt &t(const QByteArray &v);
+        Stmt &t(const char *v);
+        Stmt &null();
+    };
+
+    // 按年龄段、性别区分的就诊人群：科室权重不同（儿科、妇产科等）
+    enum Cohort { Child, Man, Woman, OldMan, OldWoman, CohortCount };
+
+    struct Department {
+        int id = 0;
+        QByteArray name;
+        int diseaseSet = 0;                 // 病种表中的分组
+        double weight = 1;                  // 就诊量权重
+        QVector<int> doctors;               // 医生下标，按受欢迎程度排
+        QVector<double> doctorCum;          // Zipf 累计权重
+    };
+
+    struct Doctor {
+        qint64 doctorId = 0;
+        qint64 userId = 0;
+        int dept = 0;                       // m_departments 下标
+        double regFee = 0;
+        int dailyQuota = 0;
+        int calIndex = -1;                  // 生成的医生才有排班/考勤，-1 为模板库原有医生
+        QVector<QPair<int, int> > leaves;   // 请假的日期区间（时间窗内的天序号）
+    };
+
+    bool exec(const char *sql, QString *error);
+    bool prepare(Stmt *stmt, const char *sql, QString *error);
+    bool step(Stmt *stmt, QString *error);
+    bool tick(QString *error);              // 计数，满一批提交事务
+    void progress(const char *table, bool force = false);
+    qint64 maxId(const char *table, const char *pk);
+
+    bool createSchema(QString *error);
+    bool copySeedRows(QString *error);
+    bool genReference(QString *error);
+    bool genDoctors(QString *error);
+    bool genPatients(QString *error);
+    bool genDoctorCalendar(QString *error);
+    bool genDiseaseStats(QString *error);
+    bool finishSchema(QString *error);
+
+    int sampleDay();
+    bool onLeave(const Doctor &doctor, int day) const;
+    int pickDoctor(int age, bool male);
+    int pickDisease(int dept, int age);
+    QByteArray chineseName(bool male);
+    QByteArray idCard(int region, qint64 seq, int year, int month, int day);
+    QByteArray phone(const char *prefix);
+
+    DataGenConfig m_config;
+    Rng m_rng;
+    sqlite3 *m_db;
+    QString m_tmpPath;
+    QStringList m_tables;
+    QStringList m_deferredSql;              // 灌完数据后才执行的 CREATE INDEX/VIEW/TRIGGER
+
+    QVector<Department> m_departments;
+    QVector<double> m_departmentCum[CohortCount];
+    QVector<QVector<int> > m_diseaseSets;   // 病种分组 -> 病种下标
+    QVector<Doctor> m_doctors;
+    QHash<QByteArray, qint64> m_medicationByName;
+    QHash<qint64, QByteArray> m_medicationUsage;
+    QVector<qint64> m_medicationIds;
+
+    // 时间窗（本地时间当作 UTC 计算的秒数，只用来格式化）
+    qint64 m_now;
+    qint64 m_windowStart;
+    int m_windowDays;
+    int m_today;                            // 今天在时间窗内的天序号
+
+    // 各表下一个主键
+    qint64 m_nextUser, m_nextDoctor, m_nextPatient, m_nextSchedule, m_nextAppt, m_nextEncounter,
+           m_nextRecord, m_nextRx, m_nextRxItem, m_nextInvoice, m_nextMsg, m_nextAssess,
+           m_nextAttendance, m_nextLeave;
+    qint64 m_scheduleBase;                  // 排班主键按 (医生, 天, 上下午) 计算，预约据此关联
+    qint64 m_firstEncounter;
+
+    qint64 m_rowsInTx;
+    qint64 m_rowsTotal;
+    qint64 m_rowsAtLastReport;
+    QElapsedTimer m_clock;
+    qint64 m_lastReportMs;
+};
+
+#endif // DATAGENERATOR_H
@@ -0,0 +1,58 @@
+#include "datagenerator.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+// sever0-datagen：按 MedicalData.db 的表结构生成大规模合成数据，用于压测与基准
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sever0-datagen");
+
+    DataGenConfig config;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Synthetic dataset generator for the sever0 MedicalData.db schema.\n"
+                                     "Example: --patients 1000000 --appts-per-patient 20 (about 20M appointments)");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"template", "Database to copy the schema (and seed rows) from.", "db", config.templatePath},
+        {{"o", "out"}, "Output database.", "db", config.outPath},
+        {{"p", "patients"}, "Number of generated patients.", "n", QString::number(config.patients)},
+        {"doctors", "Number of generated doctors (default: patients / 500, at least 20).", "n"},
+        {"appts-per-patient", "Mean appointments per patient (heavy-tailed).", "n",
+         QString::number(config.apptsPerPatient)},
+        {"messages-per-patient", "Mean messages per patient.", "n", QString::number(config.messagesPerPatient)},
+        {"assessment-ratio", "Share of patients with health assessments.", "r",
+         QString::number(config.assessmentRatio)},
+        {"years", "Years of history to generate.", "n", QString::number(config.years)},
+        {"seed", "Random seed; the same seed produces the same database.", "n", QString::number(config.seed)},
+        {"batch", "Rows per transaction.", "n", QString::number(config.batchRows)},
+        {"no-seed-rows", "Do not copy the template's existing rows."},
+        {"force", "Overwrite the output file if it exists."},
+    });
+    parser.process(app);
+
+    config.templatePath = parser.value("template");
+    config.outPath = parser.value("out");
+    config.patients = qMax<qint64>(1, parser.value("patients").toLongLong());
+    if (parser.isSet("doctors"))
+        config.doctors = qMax(1, parser.value("doctors").toInt());
+    config.apptsPerPatient = qMax(0.0, parser.value("appts-per-patient").toDouble());
+    config.messagesPerPatient = qMax(0.0, parser.value("messages-per-patient").toDouble());
+    config.assessmentRatio = qBound(0.0, parser.value("assessment-ratio").toDouble(), 1.0);
+    config.years = qBound(1, parser.value("years").toInt(), 50);
+    config.seed = parser.value("seed").toULongLong();
+    config.batchRows = qMax(1000, parser.value("batch").toInt());
+    config.keepSeedRows = !parser.isSet("no-seed-rows");
+    config.force = parser.isSet("force");
+
+    DataGenerator generator(config);
+    QString error;
+    if (!generator.run(&error)) {
+        QTextStream(stderr) << error << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,20 @@
+QT       += core
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = sever0-datagen
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# 直接用 SQLite C API 批量写入
+LIBS += -lsqlite3
+
+SOURCES += \
+    datagenerator.cpp \
+    main.cpp
+
+HEADERS += \
+    datagenerator.h
@@ -0,0 +1,414 @@
+#include "loadgenerator.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+#include <QThread>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <QStringList>
+
+bool LoadConfig::parseMix(const QString &text, QList<QPair<QString, int> > *mix, QString *error)
+{
+    mix->clear();
+    for (const QString &part : text.split(',', QString::SkipEmptyParts)) {
+        const QStringList kv = part.trimmed().split('=');
+        bool ok = true;
+        const int weight = kv.size() > 1 ? kv.at(1).toInt(&ok) : 1;
+        if (kv.at(0).isEmpty() || !ok || weight < 0 || kv.size() > 2) {
+            *error = "bad mix entry: " + part;
+            return false;
+        }
+        if (weight > 0) mix->append(qMakePair(kv.at(0), weight));
+    }
+    if (mix->isEmpty()) {
+        *error = "empty request mix";
+        return false;
+    }
+    return true;
+}
+
+// ================= LoadGenerator =================
+
+LoadGenerator::LoadGenerator(const LoadConfig &config, QObject *parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_running(0)
+    , m_measuredNs(0)
+{
+    for (const auto &entry : m_config.mix) {
+        if (!m_stats.contains(entry.first)) m_stats.insert(entry.first, new TypeStats);
+    }
+}
+
+LoadGenerator::~LoadGenerator()
+{
+    for (QThread *t : m_threads) {
+        t->quit();
+        t->wait();
+    }
+    qDeleteAll(m_workers);
+    qDeleteAll(m_threads);
+    qDeleteAll(m_stats);
+}
+
+void LoadGenerator::start()
+{
+    static std::atomic<qint64> seq(1);
+
+    const int threads = qMax(1, qMin(m_config.threads, m_config.connections));
+    m_elapsed.start();
+    for (int i = 0; i < threads; ++i) {
+        // 连接和速率平均分给各线程
+        const int conns = m_config.connections / threads + (i < m_config.connections % threads ? 1 : 0);
+        LoadWorker *worker = new LoadWorker(m_config, i, conns, m_config.rate / threads, m_stats, &seq);
+        QThread *thread = new QThread;
+        worker->moveToThread(thread);
+        connect(thread, &QThread::started, worker, &LoadWorker::start);
+        connect(worker, &LoadWorker::finished, this, &LoadGenerator::onWorkerFinished);
+        m_workers.append(worker);
+        m_threads.append(thread);
+        ++m_running;
+        thread->start();
+    }
+}
+
+void LoadGenerator::onWorkerFinished()
+{
+    if (--m_running > 0) return;
+    m_measuredNs = static_cast<qint64>(m_config.durationSec - m_config.warmupSec) * 1000000000;
+    emit finished();
+}
+
+QJsonObject LoadGenerator::report() const
+{
+    int connected = 0;
+    quint64 failures = 0, unmatched = 0;
+    for (const LoadWorker *w : m_workers) {
+        connected += w->connected.load();
+        failures += w->connectFailures.load();
+        unmatched += w->unmatched.load();
+    }
+    const double seconds = m_measuredNs > 0 ? m_measuredNs / 1e9 : 1.0;
+
+    QJsonObject types;
+    quint64 totalReceived = 0;
+    for (auto it = m_stats.constBegin(); it != m_stats.constEnd(); ++it) {
+        const TypeStats *s = it.value();
+        QJsonObject o;
+        o["sent"]       = static_cast<qint64>(s->sent.load());
+        o["received"]   = static_cast<qint64>(s->received.load());
+        o["failed"]     = static_cast<qint64>(s->failed.load());
+        o["busy"]       = static_cast<qint64>(s->busy.load());
+        o["timeouts"]   = static_cast<qint64>(s->timeouts.load());
+        o["throughput"] = s->corrected.count() / seconds;
+        o["corrected"]  = s->corrected.summary();
+        o["service"]    = s->service.summary();
+        types[it.key()] = o;
+        totalReceived += s->corrected.count();
+    }
+
+    QJsonObject config;
+    config["host"]        = m_config.host;
+    config["port"]        = m_config.port;
+    config["connections"] = m_config.connections;
+    config["threads"]     = m_config.threads;
+    config["rate"]        = m_config.rate;
+    config["duration_s"]  = m_config.durationSec;
+    config["warmup_s"]    = m_config.warmupSec;
+    QJsonObject mix;
+    for (const auto &entry : m_config.mix) mix[entry.first] = entry.second;
+    config["mix"] = mix;
+
+    QJsonObject o;
+    o["config"]           = config;
+    o["measured_s"]       = seconds;
+    o["connected"]        = connected;
+    o["connect_failures"] = static_cast<qint64>(failures);
+    o["unmatched"]        = static_cast<qint64>(unmatched);
+    o["throughput"]       = totalReceived / seconds;
+    o["types"]            = types;
+    return o;
+}
+
+QString LoadGenerator::textReport() const
+{
+    const QJsonObject r = report();
+    QString out;
+    out += QString("connected %1/%2, connect failures %3, unmatched frames %4\n")
+               .arg(r.value("connected").toInt()).arg(m_config.connections)
+               .arg(r.value("connect_failures").toInt()).arg(r.value("unmatched").toInt());
+    out += QString("measured %1 s, throughput %2 req/s (target %3)\n\n")
+               .arg(r.value("measured_s").toDouble(), 0, 'f', 1)
+               .arg(r.value("throughput").toDouble(), 0, 'f', 1)
+               .arg(m_config.rate, 0, 'f', 1);
+    out += QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10\n")
+               .arg("type", -16).arg("sent", 9).arg("recv", 9).arg("busy", 7).arg("fail", 7)
+               .arg("t/o", 7).arg("req/s", 9).arg("p50 ms", 9).arg("p99 ms", 9).arg("max ms", 9);
+
+    const QJsonObject types = r.value("types").toObject();
+    for (auto it = types.constBegin(); it != types.constEnd(); ++it) {
+        const QJsonObject t = it.value().toObject();
+        const QJsonObject c = t.value("corrected").toObject();
+        out += QString("%1 %2 %3 %4 %5 %6 %7 %8 %9 %10\n")
+                   .arg(it.key(), -16)
+                   .arg(t.value("sent").toInt(), 9).arg(t.value("received").toInt(), 9)
+                   .arg(t.value("busy").toInt(), 7).arg(t.value("failed").toInt(), 7)
+                   .arg(t.value("timeouts").toInt(), 7)
+                   .arg(t.value("throughput").toDouble(), 9, 'f', 1)
+                   .arg(c.value("p50_us").toDouble() / 1000, 9, 'f', 2)
+                   .arg(c.value("p99_us").toDouble() / 1000, 9, 'f', 2)
+                   .arg(c.value("max_us").toDouble() / 1000, 9, 'f', 2);
+    }
+    out += "\nlatency is measured from the scheduled send time (coordinated-omission corrected)\n";
+    return out;
+}
+
+// ================= LoadWorker =================
+
+LoadWorker::LoadWorker(const LoadConfig &config, int index, int connections, double rate,
+                       const QHash<QString, TypeStats*> &stats, std::atomic<qint64> *seq)
+    : m_config(config)
+    , m_index(index)
+    , m_target(connections)
+    , m_intervalNs(rate > 0 ? static_cast<qint64>(1e9 / rate) : 0)
+    , m_stats(stats)
+    , m_seq(seq)
+    , m_nextConn(0)
+    , m_totalWeight(0)
+    , m_nextDueNs(0)
+    , m_warmupEndNs(0)
+    , m_endNs(0)
+    , m_tickTimer(nullptr)
+    , m_connectTimer(nullptr)
+    , m_stopping(false)
+{
+    for (const auto &entry : m_config.mix) {
+        m_totalWeight += entry.second;
+        m_cumulativeWeights.append(m_totalWeight);
+    }
+}
+
+void LoadWorker::start()
+{
+    m_clock.start();
+
+    // 先按建连速率把连接建起来，随后开始计时发送
+    m_connectTimer = new QTimer(this);
+    connect(m_connectTimer, &QTimer::timeout, this, &LoadWorker::connectMore);
+    m_connectTimer->start(10);
+    connectMore();
+
+    m_tickTimer = new QTimer(this);
+    m_tickTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_tickTimer, &QTimer::timeout, this, &LoadWorker::tick);
+}
+
+void LoadWorker::connectMore()
+{
+    const int threads = qMax(1, m_config.threads);
+    const int batch = qMax(1, m_config.connectPerSec / 100 / threads);
+    for (int i = 0; i < batch && m_conns.size() < m_target; ++i) {
+        Conn *conn = new Conn;
+        conn->socket = new QTcpSocket(this);
+        conn->socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        connect(conn->socket, &QTcpSocket::connected, this, [this, conn]() {
+            conn->ready = true;
+            ++connected;
+        });
+        connect(conn->socket, &QTcpSocket::readyRead, this, [this, conn]() { onReadyRead(conn); });
+        connect(conn->socket, &QTcpSocket::disconnected, this, [this, conn]() {
+            if (conn->ready) --connected;
+            conn->ready = false;
+        });
+        connect(conn->socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error),
+                this, [this, conn](QAbstractSocket::SocketError) {
+            if (!conn->ready) ++connectFailures;
+        });
+        conn->socket->connectToHost(m_config.host, m_config.port);
+        m_conns.append(conn);
+    }
+
+    if (m_conns.size() >= m_target && m_connectTimer->isActive()) {
+        m_connectTimer->stop();
+        // 所有连接发起后开始发送；各线程错开起点，避免同一时刻集中发送
+        const qint64 startNs = now() + 200 * 1000000;
+        m_nextDueNs = startNs + (m_intervalNs > 0 ? m_intervalNs * m_index / qMax(1, m_config.threads) : 0);
+        m_warmupEndNs = startNs + static_cast<qint64>(m_config.warmupSec) * 1000000000;
+        m_endNs = startNs + static_cast<qint64>(m_config.durationSec) * 1000000000;
+        m_tickTimer->start(1);
+    }
+}
+
+void LoadWorker::tick()
+{
+    const qint64 t = now();
+    if (t >= m_endNs) {
+        if (!m_stopping) {
+            m_stopping = true;
+            m_tickTimer->stop();
+            QTimer::singleShot(m_config.drainMs, this, &LoadWorker::drained);
+        }
+        return;
+    }
+    if (m_intervalNs <= 0) return;
+
+    // 开环：把到期的请求全部发出，哪怕定时器晚了
+    while (m_nextDueNs <= t && m_nextDueNs < m_endNs) {
+        send(m_nextDueNs);
+        m_nextDueNs += m_intervalNs;
+    }
+}
+
+void LoadWorker::drained()
+{
+    for (Conn *conn : m_conns) {
+        for (auto it = conn->pending.constBegin(); it != conn->pending.constEnd(); ++it) {
+            if (it.value().intendedNs < m_warmupEndNs) continue;
+            if (TypeStats *s = m_stats.value(it.value().type)) ++s->timeouts;
+        }
+        conn->pending.clear();
+        // 先断开信号再关连接，lambda 里持有的 conn 马上就要释放
+        conn->socket->disconnect(this);
+        conn->socket->abort();
+        conn->socket->deleteLater();
+    }
+    qDeleteAll(m_conns);
+    m_conns.clear();
+    emit finished();
+}
+
+QString LoadWorker::pickType()
+{
+    const int r = QRandomGenerator::global()->bounded(m_totalWeight);
+    for (int i = 0; i < m_cumulativeWeights.size(); ++i) {
+        if (r < m_cumulativeWeights.at(i)) return m_config.mix.at(i).first;
+    }
+    return m_config.mix.last().first;
+}
+
+QJsonObject LoadWorker::makeRequest(const QString &type, qint64 seq) const
+{
+    QJsonObject o;
+    o["type"] = type;
+    o["seq"] = seq;
+
+    if (type == "login") {
+        o["user"] = m_config.user;
+        o["pswd"] = m_config.password;
+        o["role"] = "patient";
+    } else if (type == "appt.create") {
+        o["user_id"] = m_config.userId;
+        QJsonObject payload;
+        payload["doctor_id"] = m_config.doctorId;
+        payload["age"] = 30;
+        payload["start_time"] = QDateTime::currentDateTime().addDays(1).toString(Qt::ISODate);
+        payload["height"] = "170";
+        payload["weight"] = "60";
+        payload["sympptoms"] = "loadgen";
+        o["payload"] = payload;
+    } else if (type == "everysecond") {
+        o["user_id"] = m_config.doctorUserId;
+    } else if (type == "message") {
+        // 服务器会广播给所有连接，慎用较高权重
+        o["user_id"] = m_config.userId;
+        o["content"] = "loadgen";
+    } else if (type == "shuju") {
+        o["user_id"] = m_config.doctorUserId;
+        o["bing"] = m_config.disease;
+    } else if (type == "doctor_list") {
+        o["department_name"] = m_config.department;
+    } else if (type == "kaoqin" || type == "qingjia" || type == "shangban" || type == "xiaban") {
+        o["user_id"] = m_config.doctorUserId;
+    } else {
+        // appt.list / record.list / userinfo / health.get 等只需要 user_id
+        o["user_id"] = m_config.userId;
+    }
+    return o;
+}
+
+void LoadWorker::send(qint64 intendedNs)
+{
+    const QString type = pickType();
+    TypeStats *stats = m_stats.value(type);
+
+    // 轮询找一个已连上的连接
+    Conn *conn = nullptr;
+    for (int i = 0; i < m_conns.size(); ++i) {
+        Conn *c = m_conns.at((m_nextConn + i) % m_conns.size());
+        if (c->ready) {
+            conn = c;
+            m_nextConn = (m_nextConn + i + 1) % m_conns.size();
+            break;
+        }
+    }
+    if (!conn) {
+        // 没有可用连接：按超时计，保持开环节奏
+        if (stats && intendedNs >= m_warmupEndNs) ++stats->timeouts;
+        return;
+    }
+
+    const qint64 seq = m_seq->fetch_add(1);
+    const QByteArray body = QJsonDocument(makeRequest(type, seq)).toJson(QJsonDocument::Compact);
+    QByteArray header(4, Qt::Uninitialized);
+    qToBigEndian<quint32>(static_cast<quint32>(body.size()), reinterpret_cast<uchar *>(header.data()));
+    conn->socket->write(header);
+    conn->socket->write(body);
+
+    conn->pending.insert(seq, Pending{type, intendedNs, now()});
+    if (stats && intendedNs >= m_warmupEndNs) ++stats->sent;
+}
+
+void LoadWorker::onReadyRead(Conn *conn)
+{
+    conn->buffer.append(conn->socket->readAll());
+    while (true) {
+        if (conn->expected == 0) {
+            if (conn->buffer.size() < 4) return;
+            conn->expected = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(conn->buffer.constData()));
+            conn->buffer.remove(0, 4);
+        }
+        if (static_cast<quint32>(conn->buffer.size()) < conn->expected) return;
+        const QByteArray body = conn->buffer.left(conn->expected);
+        conn->buffer.remove(0, conn->expected);
+        conn->expected = 0;
+        onFrame(conn, body);
+    }
+}
+
+void LoadWorker::onFrame(Conn *conn, const QByteArray &body)
+{
+    const qint64 t = now();
+    const QJsonObject o = QJsonDocument::fromJson(body).object();
+
+    // 先按 seq 对号；不带 seq 的应答（部分类型不回 seq）按同类型最早的在途请求对号
+    auto it = conn->pending.end();
+    const QJsonValue seq = o.value("seq");
+    if (seq.isDouble()) it = conn->pending.find(static_cast<qint64>(seq.toDouble()));
+    if (it == conn->pending.end() && !seq.isDouble()) {
+        const QString type = o.value("type").toString();
+        for (auto p = conn->pending.begin(); p != conn->pending.end(); ++p) {
+            if (p.value().type == type && (it == conn->pending.end() || p.value().intendedNs < it.value().intendedNs)) {
+                it = p;
+            }
+        }
+    }
+    if (it == conn->pending.end()) {
+        ++unmatched;
+        return;
+    }
+
+    const Pending p = it.value();
+    conn->pending.erase(it);
+    if (p.intendedNs < m_warmupEndNs) return;
+
+    TypeStats *s = m_stats.value(p.type);
+    if (!s) return;
+    ++s->received;
+    if (o.value("busy").toBool()) ++s->busy;
+    else if (o.contains("ok") && !o.value("ok").toBool()) ++s->failed;
+    s->corrected.record((t - p.intendedNs) / 1000);
+    s->service.record((t - p.sentNs) / 1000);
+}
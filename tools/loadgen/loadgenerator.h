@@ -0,0 +1,160 @@
+#ifndef LOADGENERATOR_H
+#define LOADGENERATOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QPair>
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <atomic>
+#include "latencyhistogram.h"
+
+class QTcpSocket;
+class QTimer;
+class QThread;
+
+// 压测配置
+struct LoadConfig
+{
+    QString host = "127.0.0.1";
+    quint16 port = 8000;
+    int connections = 1000;
+    int threads = 4;
+    double rate = 1000;             // 目标总请求速率（每秒），开环：不等应答
+    int durationSec = 30;
+    int warmupSec = 5;              // 预热期的请求不计入统计
+    int connectPerSec = 2000;       // 建连速率，避免一次性 SYN 洪峰
+    int drainMs = 3000;             // 结束后等待在途应答的时间
+    QList<QPair<QString, int> > mix;    // 请求类型及权重
+
+    // 请求参数
+    qint64 userId = 1;
+    qint64 doctorUserId = 1;
+    qint64 doctorId = 1;
+    QString user = "loadgen";
+    QString password = "loadgen";
+    QString department = "内科";
+    QString disease = "感冒";
+
+    // 解析 "login=10,appt.list=30,everysecond=20"
+    static bool parseMix(const QString &text, QList<QPair<QString, int> > *mix, QString *error);
+};
+
+// 每种请求类型的统计，运行期间只做原子操作，多个线程共享
+struct TypeStats
+{
+    std::atomic<quint64> sent{0};
+    std::atomic<quint64> received{0};
+    std::atomic<quint64> failed{0};         // ok == false（不含 busy）
+    std::atomic<quint64> busy{0};           // 服务器准入拒绝
+    std::atomic<quint64> timeouts{0};       // 结束时仍未收到应答
+    LatencyHistogram corrected;             // 应答时刻 - 计划发送时刻（修正协调遗漏）
+    LatencyHistogram service;               // 应答时刻 - 实际发送时刻
+};
+
+class LoadWorker;
+
+// 开环压测：按固定间隔生成请求的“计划发送时刻”，到点就发，不管上一条是否返回。
+// 发送线程落后时照样补发，延迟从计划时刻算起，避免协调遗漏（coordinated omission）把慢的时段藏掉。
+class LoadGenerator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit LoadGenerator(const LoadConfig &config, QObject *parent = nullptr);
+    ~LoadGenerator();
+
+    void start();
+
+    // { config, elapsed_s, connected, connect_failures, unmatched, types:{ type:{ sent, received, failed, busy,
+    //   timeouts, throughput, corrected:{summary}, service:{summary} } } }
+    QJsonObject report() const;
+
+    // 文本表格
+    QString textReport() const;
+
+signals:
+    void finished();
+
+private slots:
+    void onWorkerFinished();
+
+private:
+    LoadConfig m_config;
+    QHash<QString, TypeStats*> m_stats;     // 启动前建好，运行时只读
+    QList<QThread*> m_threads;
+    QList<LoadWorker*> m_workers;
+    int m_running;
+    QElapsedTimer m_elapsed;
+    qint64 m_measuredNs;
+};
+
+// 一个线程里的若干连接和它们的发送节奏
+class LoadWorker : public QObject
+{
+    Q_OBJECT
+public:
+    LoadWorker(const LoadConfig &config, int index, int connections, double rate,
+               const QHash<QString, TypeStats*> &stats, std::atomic<qint64> *seq);
+
+    std::atomic<int> connected{0};
+    std::atomic<quint64> connectFailures{0};
+    std::atomic<quint64> unmatched{0};      // 对不上号的帧（广播推送等）
+
+public slots:
+    void start();
+
+signals:
+    void finished();
+
+private slots:
+    void connectMore();
+    void tick();
+    void drained();
+
+private:
+    struct Pending {
+        QString type;
+        qint64 intendedNs;
+        qint64 sentNs;
+    };
+    struct Conn {
+        QTcpSocket *socket = nullptr;
+        QByteArray buffer;
+        quint32 expected = 0;
+        bool ready = false;
+        QHash<qint64, Pending> pending;     // seq -> 在途请求
+    };
+
+    void send(qint64 intendedNs);
+    void onReadyRead(Conn *conn);
+    void onFrame(Conn *conn, const QByteArray &body);
+    QString pickType();
+    QJsonObject makeRequest(const QString &type, qint64 seq) const;
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+
+    LoadConfig m_config;
+    int m_index;
+    int m_target;
+    qint64 m_intervalNs;
+    const QHash<QString, TypeStats*> &m_stats;
+    std::atomic<qint64> *m_seq;
+
+    QList<Conn*> m_conns;
+    int m_nextConn;
+    QVector<int> m_cumulativeWeights;
+    int m_totalWeight;
+
+    QElapsedTimer m_clock;
+    qint64 m_nextDueNs;
+    qint64 m_warmupEndNs;
+    qint64 m_endNs;
+    QTimer *m_tickTimer;
+    QTimer *m_connectTimer;
+    bool m_stopping;
+};
+
+#endif // LOADGENERATOR_H
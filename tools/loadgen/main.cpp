@@ -0,0 +1,75 @@
+#include "loadgenerator.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QFile>
+#include <QTextStream>
+
+// sever0-loadgen：按 JsonTcpServer 的帧格式（4 字节大端长度 + JSON）对服务器做开环压测
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sever0-loadgen");
+
+    LoadConfig config;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Open-loop load generator for the sever0 JSON/TCP protocol");
+    parser.addHelpOption();
+    parser.addOptions({
+        {"host", "Server address.", "host", config.host},
+        {"port", "Server port.", "port", QString::number(config.port)},
+        {{"c", "connections"}, "Number of client connections.", "n", QString::number(config.connections)},
+        {{"t", "threads"}, "Client threads.", "n", QString::number(config.threads)},
+        {{"r", "rate"}, "Target total request rate (req/s).", "rps", QString::number(config.rate)},
+        {{"d", "duration"}, "Run time in seconds, including warm-up.", "s", QString::number(config.durationSec)},
+        {"warmup", "Warm-up seconds excluded from the results.", "s", QString::number(config.warmupSec)},
+        {"connect-rate", "New connections per second.", "n", QString::number(config.connectPerSec)},
+        {"mix", "Request mix as type=weight,...", "mix",
+         "login=5,appt.list=30,appt.create=5,everysecond=40,department_list=10,shuju=10"},
+        {"user-id", "user_id for patient requests.", "id", QString::number(config.userId)},
+        {"doctor-user-id", "user_id for doctor requests.", "id", QString::number(config.doctorUserId)},
+        {"doctor-id", "doctor_id for appt.create.", "id", QString::number(config.doctorId)},
+        {"user", "Login user name.", "name", config.user},
+        {"password", "Login password.", "password", config.password},
+        {"json", "Also write the report as JSON to this file.", "file"},
+    });
+    parser.process(app);
+
+    config.host = parser.value("host");
+    config.port = static_cast<quint16>(parser.value("port").toUInt());
+    config.connections = qMax(1, parser.value("connections").toInt());
+    config.threads = qMax(1, parser.value("threads").toInt());
+    config.rate = parser.value("rate").toDouble();
+    config.durationSec = qMax(1, parser.value("duration").toInt());
+    config.warmupSec = qBound(0, parser.value("warmup").toInt(), config.durationSec - 1);
+    config.connectPerSec = qMax(1, parser.value("connect-rate").toInt());
+    config.userId = parser.value("user-id").toLongLong();
+    config.doctorUserId = parser.value("doctor-user-id").toLongLong();
+    config.doctorId = parser.value("doctor-id").toLongLong();
+    config.user = parser.value("user");
+    config.password = parser.value("password");
+
+    QString error;
+    if (!LoadConfig::parseMix(parser.value("mix"), &config.mix, &error)) {
+        QTextStream(stderr) << error << "\n";
+        return 2;
+    }
+
+    LoadGenerator generator(config);
+    QObject::connect(&generator, &LoadGenerator::finished, &app, [&]() {
+        QTextStream(stdout) << generator.textReport();
+        if (parser.isSet("json")) {
+            QFile f(parser.value("json"));
+            if (f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                f.write(QJsonDocument(generator.report()).toJson());
+            } else {
+                QTextStream(stderr) << "cannot write " << f.fileName() << "\n";
+            }
+        }
+        app.quit();
+    });
+    generator.start();
+    return app.exec();
+}
@@ -0,0 +1,22 @@
+QT       += core network
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = sever0-loadgen
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# 与服务器共用延迟直方图
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../latencyhistogram.cpp \
+    loadgenerator.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../latencyhistogram.h \
+    loadgenerator.h
@@ -0,0 +1,89 @@
+#include "replayer.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <QFile>
+#include <QTextStream>
+
+// sever0-replay：把服务器“Capture”录下的流量按原时间轴（可加速）重放，对比不同版本的延迟
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("sever0-replay");
+
+    ReplayConfig config;
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Replays a sever0 traffic capture against a server");
+    parser.addHelpOption();
+    parser.addPositionalArgument("capture", "Capture file (.s0cap) written by the server.");
+    parser.addOptions({
+        {"host", "Server address.", "host", config.host},
+        {"port", "Server port.", "port", QString::number(config.port)},
+        {{"s", "speed"}, "Timeline speed-up factor; 0 sends as fast as possible.", "x", QString::number(config.speed)},
+        {{"t", "threads"}, "Client threads.", "n", QString::number(config.threads)},
+        {"no-wait", "Do not wait for the previous response before sending the next frame on a connection."},
+        {"timeout", "Per-request timeout in milliseconds.", "ms", QString::number(config.timeoutMs)},
+        {"account", "Fixture account used for sign-in requests; captures carry no passwords, so without it "
+                    "login and everything behind it fail.", "user:password"},
+        {"json", "Also write the report as JSON to this file.", "file"},
+        {"baseline", "Compare against a JSON report from an earlier run.", "file"},
+    });
+    parser.process(app);
+
+    if (parser.positionalArguments().size() != 1) parser.showHelp(2);
+    config.capturePath = parser.positionalArguments().first();
+    config.host = parser.value("host");
+    config.port = static_cast<quint16>(parser.value("port").toUInt());
+    config.speed = qMax(0.0, parser.value("speed").toDouble());
+    config.threads = qMax(1, parser.value("threads").toInt());
+    config.waitResponse = !parser.isSet("no-wait");
+    config.timeoutMs = qMax(1, parser.value("timeout").toInt());
+    if (parser.isSet("account")) {
+        const QString account = parser.value("account");
+        const int colon = account.indexOf(':');
+        if (colon <= 0) {
+            QTextStream(stderr) << "--account expects user:password\n";
+            return 2;
+        }
+        config.accountUser = account.left(colon);
+        config.accountPassword = account.mid(colon + 1);
+    }
+
+    QJsonObject baseline;
+    if (parser.isSet("baseline")) {
+        QFile f(parser.value("baseline"));
+        if (!f.open(QIODevice::ReadOnly)) {
+            QTextStream(stderr) << "cannot read " << f.fileName() << "\n";
+            return 2;
+        }
+        baseline = QJsonDocument::fromJson(f.readAll()).object();
+    }
+
+    Replayer replayer(config);
+    QString error;
+    if (!replayer.load(&error)) {
+        QTextStream(stderr) << config.capturePath << ": " << error << "\n";
+        return 2;
+    }
+
+    QObject::connect(&replayer, &Replayer::finished, &app, [&]() {
+        const QJsonObject report = replayer.report();
+        QTextStream(stdout) << replayer.textReport();
+        if (!baseline.isEmpty()) {
+            QTextStream(stdout) << "\n" << Replayer::compare(baseline, report);
+        }
+        if (parser.isSet("json")) {
+            QFile f(parser.value("json"));
+            if (f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                f.write(QJsonDocument(report).toJson());
+            } else {
+                QTextStream(stderr) << "cannot write " << f.fileName() << "\n";
+            }
+        }
+        app.quit();
+    });
+    replayer.start();
+    return app.exec();
+}
@@ -0,0 +1,507 @@
+#include "replayer.h"
+#include "trafficcapture.h"
+
+#include <QTcpSocket>
+#include <QTimer>
+#include <QThread>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QtEndian>
+#include <QSet>
+#include <algorithm>
+
+// 回放开始前留给各线程就位的时间
+static const qint64 kLeadNs = 200 * 1000000LL;
+
+// ================= Replayer =================
+
+Replayer::Replayer(const ReplayConfig &config, QObject *parent)
+    : QObject(parent)
+    , m_config(config)
+    , m_frames(0)
+    , m_durationUs(0)
+    , m_running(0)
+    , m_elapsedNs(0)
+{
+}
+
+Replayer::~Replayer()
+{
+    for (QThread *t : m_threads) {
+        t->quit();
+        t->wait();
+    }
+    qDeleteAll(m_workers);
+    qDeleteAll(m_threads);
+    qDeleteAll(m_stats);
+}
+
+bool Replayer::load(QString *error)
+{
+    QVector<TrafficCapture::Record> records;
+    if (!TrafficCapture::read(m_config.capturePath, &records, nullptr, error)) return false;
+
+    // 按录制连接号拆成脚本；同一连接号的记录天然按时间排好
+    QHash<quint32, int> index;
+    qint64 seq = 1;
+    for (const TrafficCapture::Record &r : records) {
+        auto it = index.find(r.connection);
+        if (it == index.end()) {
+            ReplayScript s;
+            s.id = r.connection;
+            s.openUs = r.timeUs;
+            m_scripts.append(s);
+            it = index.insert(r.connection, m_scripts.size() - 1);
+        }
+        ReplayScript &s = m_scripts[it.value()];
+        m_durationUs = qMax(m_durationUs, r.timeUs);
+
+        if (r.kind == TrafficCapture::Close) {
+            s.closeUs = r.timeUs;
+            index.erase(it);            // 连接号不会复用，保险起见之后的记录另起脚本
+            continue;
+        }
+        if (r.kind != TrafficCapture::Frame) continue;
+
+        // 写入回放自己的 seq，应答据此对号；原来的 seq 被覆盖
+        ReplayScript::Step step;
+        step.atUs = r.timeUs;
+        QJsonParseError pe;
+        const QJsonDocument doc = QJsonDocument::fromJson(r.body, &pe);
+        if (pe.error == QJsonParseError::NoError && doc.isObject()) {
+            QJsonObject o = doc.object();
+            step.type = o.value("type").toString();
+            if (step.type.isEmpty()) step.type = "(none)";
+            if (!m_config.accountUser.isEmpty()) applyAccount(step.type, &o);
+            step.seq = seq++;
+            o["seq"] = step.seq;
+            step.body = QJsonDocument(o).toJson(QJsonDocument::Compact);
+        } else {
+            step.type = "(invalid)";
+            step.seq = -1;
+            step.body = r.body;
+        }
+        s.steps.append(step);
+        ++m_frames;
+        if (!m_stats.contains(step.type)) m_stats.insert(step.type, new ReplayStats);
+    }
+
+    std::stable_sort(m_scripts.begin(), m_scripts.end(),
+                     [](const ReplayScript &a, const ReplayScript &b) { return a.openUs < b.openUs; });
+    if (m_frames == 0) {
+        if (error) *error = "capture contains no frames";
+        return false;
+    }
+    return true;
+}
+
+// 按 JsonHandle 各请求实际读的键补回录制时删掉的密码；登录请求连用户名一起换成固定账号
+void Replayer::applyAccount(const QString &type, QJsonObject *request) const
+{
+    QJsonObject &o = *request;
+    if (type == "login") {
+        o["user"] = m_config.accountUser;
+        o["pswd"] = m_config.accountPassword;
+    } else if (type == "denglu") {
+        o["name"] = m_config.accountUser;
+        o["passwd"] = m_config.accountPassword;
+    } else if (type == "zhuce" || type == "xiugai") {
+        o["passwd"] = m_config.accountPassword;
+    } else if (type == "register" || type == "change_passwd") {
+        QJsonObject payload = o.value("payload").toObject();
+        payload["passwd"] = m_config.accountPassword;
+        if (type == "change_passwd") payload["new_passwd"] = m_config.accountPassword;
+        o["payload"] = payload;
+    }
+}
+
+void Replayer::start()
+{
+    const int threads = qMax(1, qMin(m_config.threads, m_scripts.size()));
+    QVector<QList<const ReplayScript*> > parts(threads);
+    for (int i = 0; i < m_scripts.size(); ++i) parts[i % threads].append(&m_scripts.at(i));
+
+    // 各线程共用同一个时间起点
+    m_elapsed.start();
+    for (int i = 0; i < threads; ++i) {
+        ReplayWorker *worker = new ReplayWorker(m_config, parts.at(i), m_stats, m_elapsed);
+        QThread *thread = new QThread;
+        worker->moveToThread(thread);
+        connect(thread, &QThread::started, worker, &ReplayWorker::start);
+        connect(worker, &ReplayWorker::finished, this, &Replayer::onWorkerFinished);
+        m_workers.append(worker);
+        m_threads.append(thread);
+        ++m_running;
+        thread->start();
+    }
+}
+
+void Replayer::onWorkerFinished()
+{
+    if (--m_running > 0) return;
+    m_elapsedNs = qMax<qint64>(1, m_elapsed.nsecsElapsed() - kLeadNs);
+    emit finished();
+}
+
+QJsonObject Replayer::report() const
+{
+    quint64 failures = 0, unmatched = 0;
+    for (const ReplayWorker *w : m_workers) {
+        failures += w->connectFailures.load();
+        unmatched += w->unmatched.load();
+    }
+    const double seconds = m_elapsedNs > 0 ? m_elapsedNs / 1e9 : 1.0;
+
+    QJsonObject types;
+    quint64 totalReceived = 0;
+    for (auto it = m_stats.constBegin(); it != m_stats.constEnd(); ++it) {
+        const ReplayStats *s = it.value();
+        QJsonObject o;
+        o["sent"]       = static_cast<qint64>(s->sent.load());
+        o["received"]   = static_cast<qint64>(s->received.load());
+        o["failed"]     = static_cast<qint64>(s->failed.load());
+        o["busy"]       = static_cast<qint64>(s->busy.load());
+        o["timeouts"]   = static_cast<qint64>(s->timeouts.load());
+        o["throughput"] = s->corrected.count() / seconds;
+        o["corrected"]  = s->corrected.summary();
+        o["service"]    = s->service.summary();
+        types[it.key()] = o;
+        totalReceived += s->corrected.count();
+    }
+
+    QJsonObject config;
+    config["capture"]       = m_config.capturePath;
+    config["host"]          = m_config.host;
+    config["port"]          = m_config.port;
+    config["speed"]         = m_config.speed;
+    config["threads"]       = m_config.threads;
+    config["wait_response"] = m_config.waitResponse;
+    config["timeout_ms"]    = m_config.timeoutMs;
+    config["account"]       = m_config.accountUser;
+
+    QJsonObject capture;
+    capture["connections"] = m_scripts.size();
+    capture["frames"]      = m_frames;
+    capture["duration_s"]  = m_durationUs / 1e6;
+
+    QJsonObject o;
+    o["config"]           = config;
+    o["capture"]          = capture;
+    o["elapsed_s"]        = seconds;
+    o["connect_failures"] = static_cast<qint64>(failures);
+    o["unmatched"]        = static_cast<qint64>(unmatched);
+    o["throughput"]       = totalReceived / seconds;
+    o["types"]            = types;
+    return o;
+}
+
+QString Replayer::textReport() const
+{
+    const QJsonObject r = report();
+    const QJsonObject cap = r.value("capture").toObject();
+    QString out;
+    out += QString("capture %1: %2 connections, %3 frames over %4 s\n")
+               .arg(m_config.capturePath).arg(cap.value("connections").toInt())
+               .arg(cap.value("frames").toDouble(), 0, 'f', 0)
+               .arg(cap.value("duration_s").toDouble(), 0, 'f', 1);
+    out += QString("replayed in %1 s at %2, connect failures %3, unmatched frames %4, throughput %5 req/s\n\n")
+               .arg(r.value("elapsed_s").toDouble(), 0, 'f', 1)
+               .arg(m_config.speed > 0 ? QString("%1x").arg(m_config.speed) : QString("full speed"))
+               .arg(r.value("connect_failures").toInt()).arg(r.value("unmatched").toInt())
+               .arg(r.value("throughput").toDouble(), 0, 'f', 1);
+    out += QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+               .arg("type", -16).arg("sent", 9).arg("recv", 9).arg("busy", 7).arg("fail", 7)
+               .arg("t/o", 7).arg("p50 ms", 9).arg("p99 ms", 9).arg("max ms", 9);
+
+    const QJsonObject types = r.value("types").toObject();
+    for (auto it = types.constBegin(); it != types.constEnd(); ++it) {
+        const QJsonObject t = it.value().toObject();
+        const QJsonObject c = t.value("corrected").toObject();
+        out += QString("%1 %2 %3 %4 %5 %6 %7 %8 %9\n")
+                   .arg(it.key(), -16)
+                   .arg(t.value("sent").toInt(), 9).arg(t.value("received").toInt(), 9)
+                   .arg(t.value("busy").toInt(), 7).arg(t.value("failed").toInt(), 7)
+                   .arg(t.value("timeouts").toInt(), 7)
+                   .arg(c.value("p50_us").toDouble() / 1000, 9, 'f', 2)
+                   .arg(c.value("p99_us").toDouble() / 1000, 9, 'f', 2)
+                   .arg(c.value("max_us").toDouble() / 1000, 9, 'f', 2);
+    }
+    out += "\nlatency is measured from the frame's time on the (scaled) capture timeline\n";
+    return out;
+}
+
+QString Replayer::compare(const QJsonObject &baseline, const QJsonObject &current)
+{
+    auto delta = [](double before, double after) {
+        return before > 0 ? QString("%1%2%").arg(after >= before ? "+" : "")
+                                .arg((after - before) * 100 / before, 0, 'f', 1)
+                          : QString("n/a");
+    };
+
+    QString out = QString("%1 %2 %3 %4 %5 %6 %7\n")
+                      .arg("type", -16).arg("p50 base", 10).arg("p50 now", 10).arg("", 8)
+                      .arg("p99 base", 10).arg("p99 now", 10).arg("", 8);
+    const QJsonObject before = baseline.value("types").toObject();
+    const QJsonObject after = current.value("types").toObject();
+    for (auto it = after.constBegin(); it != after.constEnd(); ++it) {
+        if (!before.contains(it.key())) continue;
+        const QJsonObject b = before.value(it.key()).toObject().value("corrected").toObject();
+        const QJsonObject a = it.value().toObject().value("corrected").toObject();
+        const double b50 = b.value("p50_us").toDouble() / 1000, a50 = a.value("p50_us").toDouble() / 1000;
+        const double b99 = b.value("p99_us").toDouble() / 1000, a99 = a.value("p99_us").toDouble() / 1000;
+        out += QString("%1 %2 %3 %4 %5 %6 %7\n")
+                   .arg(it.key(), -16)
+                   .arg(b50, 10, 'f', 2).arg(a50, 10, 'f', 2).arg(delta(b50, a50), 8)
+                   .arg(b99, 10, 'f', 2).arg(a99, 10, 'f', 2).arg(delta(b99, a99), 8);
+    }
+    if (baseline.value("config").toObject().value("capture") != current.value("config").toObject().value("capture"))
+        out += "\nwarning: baseline was recorded from a different capture file\n";
+    return out;
+}
+
+// ================= ReplayWorker =================
+
+ReplayWorker::ReplayWorker(const ReplayConfig &config, const QList<const ReplayScript*> &scripts,
+                           const QHash<QString, ReplayStats*> &stats, const QElapsedTimer &clock)
+    : m_config(config)
+    , m_scripts(scripts)
+    , m_stats(stats)
+    , m_clock(clock)
+    , m_conns(scripts.size())
+    , m_nextOpen(0)
+    , m_done(0)
+    , m_tickTimer(nullptr)
+    , m_timeoutTimer(nullptr)
+    , m_finished(false)
+{
+    for (int i = 0; i < m_scripts.size(); ++i) m_conns[i].script = m_scripts.at(i);
+}
+
+void ReplayWorker::start()
+{
+    m_tickTimer = new QTimer(this);
+    m_tickTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_tickTimer, &QTimer::timeout, this, &ReplayWorker::tick);
+    m_tickTimer->start(1);
+
+    m_timeoutTimer = new QTimer(this);
+    connect(m_timeoutTimer, &QTimer::timeout, this, &ReplayWorker::checkTimeouts);
+    m_timeoutTimer->start(100);
+}
+
+qint64 ReplayWorker::scheduledNs(qint64 captureUs) const
+{
+    if (m_config.speed <= 0) return kLeadNs;
+    return kLeadNs + static_cast<qint64>(captureUs * 1000 / m_config.speed);
+}
+
+void ReplayWorker::tick()
+{
+    const qint64 t = now();
+
+    while (m_nextOpen < m_conns.size() && scheduledNs(m_conns.at(m_nextOpen).script->openUs) <= t) {
+        openConn(m_nextOpen++);
+    }
+
+    while (!m_queue.empty() && m_queue.top().first <= t) {
+        const int index = m_queue.top().second;
+        m_queue.pop();
+        m_conns[index].due = true;
+        trySend(index);
+    }
+
+    finishIfDone();
+}
+
+void ReplayWorker::openConn(int index)
+{
+    Conn &conn = m_conns[index];
+    conn.socket = new QTcpSocket(this);
+    conn.socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    connect(conn.socket, &QTcpSocket::connected, this, [this, index]() {
+        m_conns[index].ready = true;
+        trySend(index);
+    });
+    connect(conn.socket, &QTcpSocket::readyRead, this, [this, index]() { onReadyRead(index); });
+    connect(conn.socket, &QTcpSocket::disconnected, this, [this, index]() { abandon(index); });
+    connect(conn.socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error),
+            this, [this, index](QAbstractSocket::SocketError) {
+        if (!m_conns[index].ready) ++connectFailures;
+        abandon(index);
+    });
+    conn.socket->connectToHost(m_config.host, m_config.port);
+
+    if (!conn.script->steps.isEmpty()) {
+        m_queue.push(Due(scheduledNs(conn.script->steps.first().atUs), index));
+    } else if (conn.script->closeUs >= 0) {
+        m_queue.push(Due(scheduledNs(conn.script->closeUs), index));
+    }
+}
+
+void ReplayWorker::trySend(int index)
+{
+    Conn &conn = m_conns[index];
+    const QVector<ReplayScript::Step> &steps = conn.script->steps;
+
+    while (!conn.closed && conn.due && conn.ready) {
+        if (conn.next >= steps.size()) {
+            maybeClose(index);
+            return;
+        }
+        // 保持录制时的因果顺序：上一条没回来就先不发（超时会放行）
+        if (m_config.waitResponse && !conn.pending.isEmpty()) return;
+
+        const ReplayScript::Step &step = steps.at(conn.next);
+        QByteArray header(4, Qt::Uninitialized);
+        qToBigEndian<quint32>(static_cast<quint32>(step.body.size()), reinterpret_cast<uchar *>(header.data()));
+        conn.socket->write(header);
+        conn.socket->write(step.body);
+
+        const qint64 t = now();
+        if (step.seq >= 0) conn.pending.insert(step.seq, Pending{step.type, scheduledNs(step.atUs), t});
+        if (ReplayStats *s = m_stats.value(step.type)) ++s->sent;
+
+        ++conn.next;
+        const qint64 nextNs = conn.next < steps.size() ? scheduledNs(steps.at(conn.next).atUs)
+                            : conn.script->closeUs >= 0 ? scheduledNs(conn.script->closeUs)
+                                                        : -1;
+        if (nextNs < 0) {
+            conn.due = false;       // 录制里没断开：留到最后统一关闭
+        } else if (nextNs > t) {
+            conn.due = false;
+            m_queue.push(Due(nextNs, index));
+        }
+    }
+}
+
+void ReplayWorker::maybeClose(int index)
+{
+    Conn &conn = m_conns[index];
+    if (conn.closed || !conn.pending.isEmpty()) return;
+    conn.closed = true;
+    ++m_done;
+    conn.socket->disconnect(this);
+    conn.socket->disconnectFromHost();
+    conn.socket->deleteLater();
+    conn.socket = nullptr;
+}
+
+// 连接失败或被服务器断开：剩下的请求发不出去了，按超时计
+void ReplayWorker::abandon(int index)
+{
+    Conn &conn = m_conns[index];
+    if (conn.closed) return;
+    for (auto it = conn.pending.constBegin(); it != conn.pending.constEnd(); ++it) {
+        if (ReplayStats *s = m_stats.value(it.value().type)) ++s->timeouts;
+    }
+    conn.pending.clear();
+    const QVector<ReplayScript::Step> &steps = conn.script->steps;
+    for (; conn.next < steps.size(); ++conn.next) {
+        if (ReplayStats *s = m_stats.value(steps.at(conn.next).type)) ++s->timeouts;
+    }
+    conn.ready = false;
+    conn.closed = true;
+    ++m_done;
+    conn.socket->disconnect(this);
+    conn.socket->abort();
+    conn.socket->deleteLater();
+    conn.socket = nullptr;
+}
+
+void ReplayWorker::checkTimeouts()
+{
+    const qint64 t = now();
+    const qint64 limit = static_cast<qint64>(m_config.timeoutMs) * 1000000;
+    for (int i = 0; i < m_nextOpen; ++i) {
+        Conn &conn = m_conns[i];
+        if (conn.pending.isEmpty()) continue;
+        for (auto it = conn.pending.begin(); it != conn.pending.end();) {
+            if (t - it.value().sentNs > limit) {
+                if (ReplayStats *s = m_stats.value(it.value().type)) ++s->timeouts;
+                it = conn.pending.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        if (conn.pending.isEmpty()) trySend(i);
+    }
+    finishIfDone();
+}
+
+void ReplayWorker::onReadyRead(int index)
+{
+    Conn &conn = m_conns[index];
+    conn.buffer.append(conn.socket->readAll());
+    while (!conn.closed) {
+        if (conn.expected == 0) {
+            if (conn.buffer.size() < 4) return;
+            conn.expected = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(conn.buffer.constData()));
+            conn.buffer.remove(0, 4);
+        }
+        if (static_cast<quint32>(conn.buffer.size()) < conn.expected) return;
+        const QByteArray body = conn.buffer.left(conn.expected);
+        conn.buffer.remove(0, conn.expected);
+        conn.expected = 0;
+        onFrame(index, body);
+    }
+}
+
+void ReplayWorker::onFrame(int index, const QByteArray &body)
+{
+    Conn &conn = m_conns[index];
+    const qint64 t = now();
+    const QJsonObject o = QJsonDocument::fromJson(body).object();
+
+    // 与 sever0-loadgen 相同：先按 seq 对号，不带 seq 的应答按同类型最早的在途请求对号
+    auto it = conn.pending.end();
+    const QJsonValue seq = o.value("seq");
+    if (seq.isDouble()) it = conn.pending.find(static_cast<qint64>(seq.toDouble()));
+    if (it == conn.pending.end() && !seq.isDouble()) {
+        const QString type = o.value("type").toString();
+        for (auto p = conn.pending.begin(); p != conn.pending.end(); ++p) {
+            if (p.value().type == type && (it == conn.pending.end() || p.value().intendedNs < it.value().intendedNs)) {
+                it = p;
+            }
+        }
+    }
+    if (it == conn.pending.end()) {
+        ++unmatched;        // 广播推送、超时后才到的应答
+        return;
+    }
+
+    const Pending p = it.value();
+    conn.pending.erase(it);
+    if (ReplayStats *s = m_stats.value(p.type)) {
+        ++s->received;
+        if (o.value("busy").toBool()) ++s->busy;
+        else if (o.contains("ok") && !o.value("ok").toBool()) ++s->failed;
+        s->corrected.record(qMax<qint64>(0, t - p.intendedNs) / 1000);
+        s->service.record((t - p.sentNs) / 1000);
+    }
+
+    if (conn.pending.isEmpty()) trySend(index);
+}
+
+void ReplayWorker::finishIfDone()
+{
+    if (m_finished || m_nextOpen < m_conns.size() || !m_queue.empty()) return;
+
+    // 所有连接都已发完、应答都已回来（或超时）
+    for (const Conn &conn : m_conns) {
+        if (conn.closed) continue;
+        if (conn.next < conn.script->steps.size() || !conn.pending.isEmpty()) return;
+    }
+
+    m_finished = true;
+    m_tickTimer->stop();
+    m_timeoutTimer->stop();
+    for (Conn &conn : m_conns) {
+        if (conn.closed) continue;
+        conn.closed = true;
+        conn.socket->disconnect(this);
+        conn.socket->disconnectFromHost();
+        conn.socket->deleteLater();
+        conn.socket = nullptr;
+    }
+    emit finished();
+}
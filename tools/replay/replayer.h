@@ -0,0 +1,175 @@
+#ifndef REPLAYER_H
+#define REPLAYER_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QElapsedTimer>
+#include <atomic>
+#include <queue>
+#include <vector>
+#include "latencyhistogram.h"
+
+class QTcpSocket;
+class QTimer;
+class QThread;
+
+// 回放配置
+struct ReplayConfig
+{
+    QString capturePath;
+    QString host = "127.0.0.1";
+    quint16 port = 8000;
+    double speed = 1.0;             // 时间轴加速倍数；0 表示不等时间，尽快发
+    int threads = 4;
+    bool waitResponse = true;       // 同一连接上一条应答回来（或超时）后才发下一条
+    int timeoutMs = 5000;           // 单条请求超时，超时后同一连接继续往下发
+
+    // 录制里的密码已删掉、用户名是假名（见 TrafficCapture）。设了固定账号时，登录请求
+    // （login / denglu）换成这个账号，注册、改密码等其余要密码的请求补上这个密码；
+    // 不设时这些请求照录制原样发出，必然失败，登录之后的路径也就复现不了
+    QString accountUser;
+    QString accountPassword;
+};
+
+// 每种请求类型的统计，运行期间只做原子操作，多个线程共享
+struct ReplayStats
+{
+    std::atomic<quint64> sent{0};
+    std::atomic<quint64> received{0};
+    std::atomic<quint64> failed{0};         // ok == false（不含 busy）
+    std::atomic<quint64> busy{0};
+    std::atomic<quint64> timeouts{0};
+    LatencyHistogram corrected;             // 应答时刻 - 录制时间轴上的计划时刻
+    LatencyHistogram service;               // 应答时刻 - 实际发送时刻
+};
+
+// 一条录制连接的脚本
+struct ReplayScript
+{
+    struct Step {
+        qint64 atUs;                // 录制时间轴上的时刻
+        QString type;
+        QByteArray body;            // 已写入回放用的 seq
+        qint64 seq;                 // -1：不是合法 JSON，不等应答
+    };
+    quint32 id = 0;
+    qint64 openUs = 0;
+    qint64 closeUs = -1;            // -1：录制结束时仍连着
+    QVector<Step> steps;
+};
+
+class ReplayWorker;
+
+// 按录制的时间轴重放：每条录制连接对应一条新连接，帧在同一连接上按原顺序发送。
+// speed > 1 时时间轴按比例压缩；延迟从（压缩后的）计划时刻算起，发送落后也照实计入。
+class Replayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Replayer(const ReplayConfig &config, QObject *parent = nullptr);
+    ~Replayer();
+
+    // 读录制文件，建脚本
+    bool load(QString *error);
+    void start();
+
+    // { config, capture:{ connections, frames, duration_s }, elapsed_s, connect_failures, unmatched,
+    //   throughput, types:{ type:{ sent, received, failed, busy, timeouts, corrected:{}, service:{} } } }
+    QJsonObject report() const;
+    QString textReport() const;
+
+    // 与另一份报告（通常是上一个版本在同一录制上的结果）逐类型比较 p50/p99
+    static QString compare(const QJsonObject &baseline, const QJsonObject &current);
+
+signals:
+    void finished();
+
+private slots:
+    void onWorkerFinished();
+
+private:
+    void applyAccount(const QString &type, QJsonObject *request) const;
+
+    ReplayConfig m_config;
+    QList<ReplayScript> m_scripts;
+    qint64 m_frames;
+    qint64 m_durationUs;
+    QHash<QString, ReplayStats*> m_stats;   // 启动前建好，运行时只读
+    QList<QThread*> m_threads;
+    QList<ReplayWorker*> m_workers;
+    int m_running;
+    QElapsedTimer m_elapsed;
+    qint64 m_elapsedNs;
+};
+
+// 一个线程里的若干连接
+class ReplayWorker : public QObject
+{
+    Q_OBJECT
+public:
+    ReplayWorker(const ReplayConfig &config, const QList<const ReplayScript*> &scripts,
+                 const QHash<QString, ReplayStats*> &stats, const QElapsedTimer &clock);
+
+    std::atomic<quint64> connectFailures{0};
+    std::atomic<quint64> unmatched{0};
+
+public slots:
+    void start();
+
+signals:
+    void finished();
+
+private slots:
+    void tick();
+    void checkTimeouts();
+
+private:
+    struct Pending {
+        QString type;
+        qint64 intendedNs;
+        qint64 sentNs;
+    };
+    struct Conn {
+        const ReplayScript *script = nullptr;
+        QTcpSocket *socket = nullptr;
+        QByteArray buffer;
+        quint32 expected = 0;
+        bool ready = false;
+        bool closed = false;
+        int next = 0;                       // 下一条要发的 step
+        bool due = false;                   // 下一条已到时间，在等连接/应答
+        QHash<qint64, Pending> pending;     // seq -> 在途请求
+    };
+    // 小顶堆：(计划时刻, 连接下标)
+    typedef std::pair<qint64, int> Due;
+
+    qint64 now() const { return m_clock.nsecsElapsed(); }
+    qint64 scheduledNs(qint64 captureUs) const;
+    void openConn(int index);
+    void trySend(int index);
+    void maybeClose(int index);
+    void abandon(int index);
+    void onReadyRead(int index);
+    void onFrame(int index, const QByteArray &body);
+    void finishIfDone();
+
+    ReplayConfig m_config;
+    QList<const ReplayScript*> m_scripts;   // 按 openUs 排好
+    const QHash<QString, ReplayStats*> &m_stats;
+    QElapsedTimer m_clock;
+
+    QVector<Conn> m_conns;
+    int m_nextOpen;
+    int m_done;                             // 已关闭的连接数
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due> > m_queue;
+    QTimer *m_tickTimer;
+    QTimer *m_timeoutTimer;
+    bool m_finished;
+};
+
+#endif // REPLAYER_H
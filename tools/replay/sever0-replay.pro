@@ -0,0 +1,25 @@
+QT       += core network
+QT       -= gui
+
+CONFIG += c++11 console
+CONFIG -= app_bundle
+
+TARGET = sever0-replay
+TEMPLATE = app
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+# 与服务器共用录制格式和延迟直方图
+INCLUDEPATH += ../..
+
+SOURCES += \
+    ../../latencyhistogram.cpp \
+    ../../trafficcapture.cpp \
+    replayer.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../connectiontable.h \
+    ../../latencyhistogram.h \
+    ../../trafficcapture.h \
+    replayer.h
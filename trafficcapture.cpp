@@ -0,0 +1,334 @@
+#include "trafficcapture.h"
+
+#include <QDateTime>
+#include <QJsonArray>
+#include <QCryptographicHash>
+#include <QRandomGenerator>
+#include <QtEndian>
+#include <cstring>
+
+static const char kMagic[8] = { 'S', '0', 'C', 'A', 'P', 1, 0, 0 };
+static const int kFlushBytes = 64 * 1024;
+static const qint64 kFlushIntervalUs = 1000000;    // 流量小时也至少每秒落盘一次
+static const int kMaxPseudonymCache = 100000;
+
+static void appendVarint(QByteArray *out, quint64 v)
+{
+    while (v >= 0x80) {
+        out->append(static_cast<char>((v & 0x7f) | 0x80));
+        v >>= 7;
+    }
+    out->append(static_cast<char>(v));
+}
+
+static bool readVarint(const uchar *&p, const uchar *end, quint64 *v)
+{
+    quint64 result = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        const uchar b = *p++;
+        result |= quint64(b & 0x7f) << shift;
+        if (!(b & 0x80)) {
+            *v = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+TrafficCapture::TrafficCapture()
+    : m_lastUs(0)
+    , m_lastFlushUs(0)
+    , m_maxBytes(1024LL * 1024 * 1024)
+    , m_written(0)
+    , m_full(false)
+    , m_nextConnection(1)
+    , m_frames(0)
+    , m_redactedFrames(0)
+    , m_droppedFrames(0)
+{
+    setRedactedFields(defaultRedactedFields());
+}
+
+TrafficCapture::~TrafficCapture()
+{
+    close();
+}
+
+QStringList TrafficCapture::defaultRedactedFields()
+{
+    // 与 JsonHandle 里实际用到的键对应（含 adress 这样的既有拼写）；user 是 login / register 的用户名，
+    // shenfen 是医生身份证号，gonghao 是工号
+    return { "user", "name", "full_name", "phone", "id_number", "id_card", "adress", "address",
+             "shenfen", "gonghao" };
+}
+
+QStringList TrafficCapture::credentialFields()
+{
+    return { "passwd", "pswd", "new_passwd" };
+}
+
+void TrafficCapture::setRedactedFields(const QStringList &fields)
+{
+    m_redacted.clear();
+    m_credentials.clear();
+    m_needles.clear();
+    for (const QString &f : fields) {
+        m_redacted.insert(f);
+        m_needles.append("\"" + f.toUtf8() + "\"");
+    }
+    for (const QString &f : credentialFields()) {
+        m_credentials.insert(f);
+        m_needles.append("\"" + f.toUtf8() + "\"");
+    }
+}
+
+bool TrafficCapture::open(const QString &path, QString *error)
+{
+    close();
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        if (error) *error = m_file.errorString();
+        return false;
+    }
+
+    QByteArray header(kMagic, sizeof(kMagic));
+    header.resize(16);
+    qToLittleEndian<qint64>(QDateTime::currentMSecsSinceEpoch(), reinterpret_cast<uchar *>(header.data() + 8));
+    m_buffer = header;
+
+    // 每次录制换一个盐，假名只在本文件内一致
+    m_salt.resize(16);
+    for (int i = 0; i < m_salt.size(); ++i)
+        m_salt[i] = static_cast<char>(QRandomGenerator::global()->generate());
+    m_pseudonyms.clear();
+
+    m_connections.clear();
+    m_nextConnection = 1;
+    m_lastUs = 0;
+    m_lastFlushUs = 0;
+    m_written = 0;
+    m_full = false;
+    m_frames = m_redactedFrames = m_droppedFrames = 0;
+    m_clock.start();
+    return true;
+}
+
+void TrafficCapture::close()
+{
+    if (!m_file.isOpen()) return;
+    flush();
+    m_file.close();
+    m_connections.clear();
+    m_pseudonyms.clear();
+}
+
+quint32 TrafficCapture::recordNumber(ConnectionId connection, bool *isNew)
+{
+    auto it = m_connections.constFind(connection);
+    if (it != m_connections.constEnd()) {
+        *isNew = false;
+        return it.value();
+    }
+    *isNew = true;
+    const quint32 id = m_nextConnection++;
+    m_connections.insert(connection, id);
+    return id;
+}
+
+void TrafficCapture::connectionOpened(ConnectionId connection)
+{
+    if (!isOpen()) return;
+    bool isNew;
+    const quint32 id = recordNumber(connection, &isNew);
+    if (isNew) writeRecord(Open, id, nullptr);
+}
+
+void TrafficCapture::connectionClosed(ConnectionId connection)
+{
+    if (!isOpen()) return;
+    auto it = m_connections.find(connection);
+    if (it == m_connections.end()) return;      // 录制开始后没说过话的旧连接
+    writeRecord(Close, it.value(), nullptr);
+    m_connections.erase(it);
+}
+
+void TrafficCapture::frameReceived(ConnectionId connection, const QByteArray &json, const QJsonDocument *document)
+{
+    if (!isOpen()) return;
+    if (m_full) {
+        ++m_droppedFrames;
+        return;
+    }
+
+    // 录制开始前就已建立的连接，在第一帧前补一条 Open
+    bool isNew;
+    const quint32 id = recordNumber(connection, &isNew);
+    if (isNew) writeRecord(Open, id, nullptr);
+
+    if (document) {
+        // 解析过的帧一律按键名脱敏：键名可能写成 "\u0070hone" 这样的转义，原始字节里找不到
+        const QJsonValue original = document->isArray() ? QJsonValue(document->array())
+                                                        : QJsonValue(document->object());
+        const QJsonValue v = redact(original);
+        const QByteArray body = v.isArray() ? QJsonDocument(v.toArray()).toJson(QJsonDocument::Compact)
+                                            : QJsonDocument(v.toObject()).toJson(QJsonDocument::Compact);
+        writeRecord(Frame, id, &body);
+        if (v != original) ++m_redactedFrames;
+    } else {
+        // 没解析的帧只能看原始字节：可能带敏感字段（含转义写法）就宁可不录
+        bool sensitive = json.contains("\\u");
+        for (const QByteArray &needle : m_needles) {
+            if (sensitive) break;
+            sensitive = json.contains(needle);
+        }
+        if (sensitive) {
+            ++m_droppedFrames;
+            return;
+        }
+        writeRecord(Frame, id, &json);
+    }
+    ++m_frames;
+}
+
+QJsonValue TrafficCapture::redact(const QJsonValue &value)
+{
+    if (value.isArray()) {
+        QJsonArray a = value.toArray();
+        for (int i = 0; i < a.size(); ++i) a[i] = redact(a.at(i));
+        return a;
+    }
+    if (!value.isObject()) return value;
+
+    QJsonObject o = value.toObject();
+    for (const QString &key : m_credentials) o.remove(key);
+    for (auto it = o.begin(); it != o.end(); ++it) {
+        const QJsonValue v = it.value();
+        if (m_redacted.contains(it.key()) && (v.isString() || v.isDouble())) {
+            const QString text = v.isString() ? v.toString() : QString::number(v.toDouble(), 'f', 0);
+            it.value() = pseudonym(text);
+        } else if (v.isObject() || v.isArray()) {
+            it.value() = redact(v);
+        }
+    }
+    return o;
+}
+
+QString TrafficCapture::pseudonym(const QString &value)
+{
+    if (value.isEmpty()) return value;
+    auto cached = m_pseudonyms.constFind(value);
+    if (cached != m_pseudonyms.constEnd()) return cached.value();
+
+    const QByteArray h = QCryptographicHash::hash(m_salt + value.toUtf8(), QCryptographicHash::Sha256);
+
+    // 电话、身份证号这类数字串保持长度（末位 X 保留），服务端的格式校验照样能走通
+    bool digits = true;
+    for (int i = 0; i < value.size(); ++i) {
+        const QChar c = value.at(i);
+        if (!c.isDigit() && !(i == value.size() - 1 && (c == 'X' || c == 'x'))) {
+            digits = false;
+            break;
+        }
+    }
+
+    QString out;
+    if (digits) {
+        out.reserve(value.size());
+        for (int i = 0; i < value.size(); ++i) {
+            const QChar c = value.at(i);
+            out.append(c.isDigit() ? QChar('0' + static_cast<uchar>(h.at(i % h.size())) % 10) : c);
+        }
+    } else {
+        out = "anon_" + QString::fromLatin1(h.toHex().left(10));
+    }
+
+    if (m_pseudonyms.size() >= kMaxPseudonymCache) m_pseudonyms.clear();
+    m_pseudonyms.insert(value, out);
+    return out;
+}
+
+void TrafficCapture::writeRecord(RecordKind kind, quint32 connection, const QByteArray *body)
+{
+    const qint64 us = m_clock.nsecsElapsed() / 1000;
+    m_buffer.append(static_cast<char>(kind));
+    appendVarint(&m_buffer, static_cast<quint64>(qMax<qint64>(0, us - m_lastUs)));
+    appendVarint(&m_buffer, connection);
+    if (body) {
+        appendVarint(&m_buffer, static_cast<quint64>(body->size()));
+        m_buffer.append(*body);
+    }
+    m_lastUs = us;
+
+    if (m_buffer.size() >= kFlushBytes || us - m_lastFlushUs >= kFlushIntervalUs) {
+        m_lastFlushUs = us;
+        flush();
+    }
+}
+
+void TrafficCapture::flush()
+{
+    if (m_buffer.isEmpty() || !m_file.isOpen()) return;
+    m_file.write(m_buffer);
+    m_file.flush();
+    m_written += m_buffer.size();
+    m_buffer.clear();
+    if (m_written >= m_maxBytes) m_full = true;
+}
+
+QJsonObject TrafficCapture::stats() const
+{
+    QJsonObject o;
+    o["path"]            = path();
+    o["capturing"]       = isOpen() && !m_full;
+    o["frames"]          = static_cast<qint64>(m_frames);
+    o["connections"]     = static_cast<qint64>(m_nextConnection - 1);
+    o["bytes"]           = m_written + m_buffer.size();
+    o["redacted_frames"] = static_cast<qint64>(m_redactedFrames);
+    o["dropped_frames"]  = static_cast<qint64>(m_droppedFrames);
+    o["elapsed_s"]       = isOpen() ? m_clock.elapsed() / 1000.0 : 0.0;
+    return o;
+}
+
+bool TrafficCapture::read(const QString &path, QVector<Record> *records, qint64 *startMs, QString *error)
+{
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        if (error) *error = f.errorString();
+        return false;
+    }
+    const QByteArray data = f.readAll();
+    if (data.size() < 16 || memcmp(data.constData(), kMagic, 5) != 0) {
+        if (error) *error = "not a sever0 capture file";
+        return false;
+    }
+    if (data.at(5) != kMagic[5]) {
+        if (error) *error = QString("unsupported capture version %1").arg(int(data.at(5)));
+        return false;
+    }
+    if (startMs) *startMs = qFromLittleEndian<qint64>(reinterpret_cast<const uchar *>(data.constData() + 8));
+
+    records->clear();
+    const uchar *p = reinterpret_cast<const uchar *>(data.constData()) + 16;
+    const uchar *end = reinterpret_cast<const uchar *>(data.constData()) + data.size();
+    qint64 t = 0;
+    while (p < end) {
+        Record r;
+        const quint8 kind = *p++;
+        quint64 delta = 0, conn = 0, len = 0;
+        if (kind < Open || kind > Close || !readVarint(p, end, &delta) || !readVarint(p, end, &conn)) {
+            // 录制中途崩溃时末尾可能不完整，保留已读出的部分
+            break;
+        }
+        if (kind == Frame) {
+            if (!readVarint(p, end, &len) || len > quint64(end - p)) break;
+            r.body = QByteArray(reinterpret_cast<const char *>(p), static_cast<int>(len));
+            p += len;
+        }
+        t += static_cast<qint64>(delta);
+        r.kind = static_cast<RecordKind>(kind);
+        r.timeUs = t;
+        r.connection = static_cast<quint32>(conn);
+        records->append(r);
+    }
+    return true;
+}
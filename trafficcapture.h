@@ -0,0 +1,104 @@
+#ifndef TRAFFICCAPTURE_H
+#define TRAFFICCAPTURE_H
+
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QJsonDocument>
+#include <QElapsedTimer>
+#include "connectiontable.h"
+
+// 流量录制：把收到的每一帧连同时间戳、连接号写进紧凑的二进制日志，供 sever0-replay 回放。
+//
+// 文件格式（整数均为小端 / LEB128 变长）：
+//   文件头  8 字节魔数 "S0CAP" 01 00 00，8 字节起始墙钟时间（ms since epoch）
+//   记录    u8 类型 | varint 距上一条记录的微秒数 | varint 连接号 | [帧：varint 长度 + JSON 正文]
+//
+// 用户名、姓名、电话、身份证号、地址等字段写盘前替换为假名：同一次录制里同一个值
+// 总是映射到同一个假名（注册后再用同一个名字之类的前后关联不丢），纯数字保持原长度；
+// 盐只在内存里，录下的文件无法反推原值。
+// 密码类字段直接删掉，不录假名：假名密码回放时反正登录不上。要回放登录后的请求，
+// 由 sever0-replay --account 换成测试库里的固定账号（见 ReplayConfig）。
+// 只在主线程（JsonTcpServer 所在线程）使用。
+class TrafficCapture
+{
+public:
+    enum RecordKind : quint8 {
+        Open  = 1,      // 连接建立
+        Frame = 2,      // 收到一帧
+        Close = 3       // 连接断开
+    };
+
+    struct Record {
+        RecordKind kind;
+        qint64 timeUs;          // 距录制开始的微秒数
+        quint32 connection;
+        QByteArray body;        // 仅 Frame
+    };
+
+    TrafficCapture();
+    ~TrafficCapture();
+
+    bool open(const QString &path, QString *error = nullptr);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+    QString path() const { return m_file.fileName(); }
+
+    // 需要替换为假名的 JSON 键（任意层级）
+    void setRedactedFields(const QStringList &fields);
+    static QStringList defaultRedactedFields();
+    // 写盘前整个删掉的 JSON 键（任意层级）：密码
+    static QStringList credentialFields();
+
+    // 文件达到上限后停止记录帧（连接的开/关照常记录）
+    void setMaxBytes(qint64 bytes) { m_maxBytes = bytes; }
+
+    void connectionOpened(ConnectionId connection);
+    // document 为空表示这帧不是合法 JSON，原样记录（含敏感键时丢弃）
+    void frameReceived(ConnectionId connection, const QByteArray &json, const QJsonDocument *document);
+    void connectionClosed(ConnectionId connection);
+
+    // { path, frames, connections, bytes, redacted_frames, dropped_frames, elapsed_s }
+    QJsonObject stats() const;
+
+    // 读入整个录制文件；startMs 返回录制开始的墙钟时间
+    static bool read(const QString &path, QVector<Record> *records, qint64 *startMs, QString *error);
+
+private:
+    // 文件里用从 1 开始的小号代替 64 位连接号，变长编码只占一两个字节
+    quint32 recordNumber(ConnectionId connection, bool *isNew);
+    void writeRecord(RecordKind kind, quint32 connection, const QByteArray *body);
+    void flush();
+    QJsonValue redact(const QJsonValue &value);
+    QString pseudonym(const QString &value);
+
+    QFile m_file;
+    QByteArray m_buffer;                    // 攒满一批再写文件
+    QElapsedTimer m_clock;
+    qint64 m_lastUs;
+    qint64 m_lastFlushUs;
+    qint64 m_maxBytes;
+    qint64 m_written;
+    bool m_full;
+
+    QHash<ConnectionId, quint32> m_connections;
+    quint32 m_nextConnection;
+
+    QSet<QString> m_redacted;
+    QSet<QString> m_credentials;
+    QList<QByteArray> m_needles;            // "\"key\""：没解析的帧里出现这些键就不录
+    QByteArray m_salt;
+    QHash<QString, QString> m_pseudonyms;
+
+    quint64 m_frames;
+    quint64 m_redactedFrames;
+    quint64 m_droppedFrames;
+};
+
+#endif // TRAFFICCAPTURE_H
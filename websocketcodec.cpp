@@ -0,0 +1,343 @@
+#include "websocketcodec.h"
+
+#include <QCryptographicHash>
+#include <QList>
+#include <QtEndian>
+#include <string.h>
+#include <zlib.h>
+
+// RFC 6455 4.2.2：Sec-WebSocket-Accept = base64(sha1(key + GUID))
+static const char kAcceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// Z_SYNC_FLUSH 在末尾留下的空 stored 块，RFC 7692 规定发送时去掉、接收时补回
+static const char kDeflateTail[] = { '\x00', '\x00', '\xff', '\xff' };
+
+// 逗号分隔的头部值里是否有某个记号（不区分大小写）
+static bool hasToken(const QByteArray &value, const char *token)
+{
+    for (const QByteArray &part : value.split(',')) {
+        if (part.trimmed().toLower() == token) return true;
+    }
+    return false;
+}
+
+// 一个 permessage-deflate 提议本端能否接受。共用的压缩流固定 15 位窗口，
+// 要求服务端用更小窗口的提议不接受；client_max_window_bits 只限制对端，本端按 15 位解压都能解开
+static bool acceptableDeflateOffer(const QByteArray &offer)
+{
+    const QList<QByteArray> parts = offer.split(';');
+    if (parts.first().trimmed().toLower() != "permessage-deflate") return false;
+
+    QList<QByteArray> seen;
+    for (int i = 1; i < parts.size(); ++i) {
+        const QByteArray param = parts.at(i).trimmed();
+        const int eq = param.indexOf('=');
+        const QByteArray name = (eq < 0 ? param : param.left(eq)).trimmed().toLower();
+        QByteArray value = eq < 0 ? QByteArray() : param.mid(eq + 1).trimmed();
+        if (value.size() >= 2 && value.startsWith('"') && value.endsWith('"')) value = value.mid(1, value.size() - 2);
+        if (seen.contains(name)) return false;     // 同一参数出现两次，提议无效
+        seen.append(name);
+
+        bool ok = false;
+        if (name == "server_no_context_takeover" || name == "client_no_context_takeover") {
+            if (eq >= 0) return false;
+        } else if (name == "client_max_window_bits") {
+            if (eq >= 0) {
+                const int bits = value.toInt(&ok);
+                if (!ok || bits < 8 || bits > 15) return false;
+            }
+        } else if (name == "server_max_window_bits") {
+            const int bits = value.toInt(&ok);
+            if (!ok || bits != 15) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+WebSocketCodec::Handshake WebSocketCodec::parseHandshake(QByteArray &buffer)
+{
+    Handshake h;
+    const int end = buffer.indexOf("\r\n\r\n");
+    if (end < 0 || end > kMaxHandshake) {
+        if (buffer.size() > kMaxHandshake) {
+            h.complete = true;
+            h.status = 400;
+            h.error = "handshake too large";
+        }
+        return h;
+    }
+    const QByteArray head = buffer.left(end);
+    buffer.remove(0, end + 4);
+    h.complete = true;
+
+    // 请求行：GET <path> HTTP/1.1
+    const QList<QByteArray> lines = head.split('\n');
+    const QList<QByteArray> request = lines.first().trimmed().split(' ');
+    if (request.size() != 3 || request.at(0) != "GET" || request.at(2) != "HTTP/1.1") {
+        h.status = 400;
+        h.error = "not a WebSocket upgrade request";
+        return h;
+    }
+
+    QByteArray upgrade;
+    QByteArray connection;
+    QByteArray version;
+    QByteArray extensions;
+    for (int i = 1; i < lines.size(); ++i) {
+        const QByteArray line = lines.at(i).trimmed();
+        const int colon = line.indexOf(':');
+        if (colon <= 0) continue;
+        const QByteArray name = line.left(colon).trimmed().toLower();
+        const QByteArray value = line.mid(colon + 1).trimmed();
+        if (name == "upgrade") {
+            upgrade = value;
+        } else if (name == "connection") {
+            connection = value;
+        } else if (name == "sec-websocket-version") {
+            version = value;
+        } else if (name == "sec-websocket-key") {
+            h.key = value;
+        } else if (name == "origin") {
+            h.origin = QString::fromUtf8(value);
+        } else if (name == "sec-websocket-extensions") {
+            // 可以分成多个头，按出现顺序合并
+            if (!extensions.isEmpty()) extensions += ',';
+            extensions += value;
+        }
+    }
+
+    if (!hasToken(upgrade, "websocket") || !hasToken(connection, "upgrade")) {
+        h.status = 400;
+        h.error = "not a WebSocket upgrade request";
+        return h;
+    }
+    if (version != "13") {
+        h.status = 426;
+        h.error = "unsupported WebSocket version";
+        return h;
+    }
+    if (QByteArray::fromBase64(h.key).size() != 16) {
+        h.status = 400;
+        h.error = "invalid Sec-WebSocket-Key";
+        return h;
+    }
+
+    for (const QByteArray &offer : extensions.split(',')) {
+        if (acceptableDeflateOffer(offer)) {
+            h.deflate = true;
+            break;
+        }
+    }
+    return h;
+}
+
+QByteArray WebSocketCodec::acceptResponse(const QByteArray &key, bool deflate)
+{
+    const QByteArray accept = QCryptographicHash::hash(key + kAcceptGuid, QCryptographicHash::Sha1).toBase64();
+    QByteArray res = "HTTP/1.1 101 Switching Protocols\r\n"
+                     "Upgrade: websocket\r\n"
+                     "Connection: Upgrade\r\n"
+                     "Sec-WebSocket-Accept: " + accept + "\r\n";
+    if (deflate) {
+        res += "Sec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover; client_no_context_takeover\r\n";
+    }
+    res += "\r\n";
+    return res;
+}
+
+QByteArray WebSocketCodec::errorResponse(int status, const QByteArray &body)
+{
+    const QByteArray reason = status == 403 ? "Forbidden"
+                            : status == 426 ? "Upgrade Required"
+                            : status == 503 ? "Service Unavailable" : "Bad Request";
+    QByteArray res = "HTTP/1.1 " + QByteArray::number(status) + ' ' + reason + "\r\n";
+    if (status == 426) res += "Sec-WebSocket-Version: 13\r\n";
+    if (status == 503) res += "Retry-After: 5\r\n";
+    res += "Content-Type: application/json\r\n"
+           "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+           "Connection: close\r\n\r\n";
+    res += body;
+    return res;
+}
+
+WebSocketCodec::ParseResult WebSocketCodec::parseFrame(QByteArray &buffer, Frame *frame, qint64 maxPayload,
+                                                       quint16 *closeCode, QString *error)
+{
+    if (buffer.size() < 2) return NeedMore;
+    const uchar *p = reinterpret_cast<const uchar *>(buffer.constData());
+    const int opcode = p[0] & 0x0f;
+    const bool control = (opcode & 0x8) != 0;
+    qint64 length = p[1] & 0x7f;
+    int offset = 2;
+
+    *closeCode = kCloseProtocol;
+    if (p[0] & 0x30) {
+        *error = "reserved bits set";
+        return ProtocolError;
+    }
+    if (opcode != Continuation && opcode != Text && opcode != Binary
+        && opcode != Close && opcode != Ping && opcode != Pong) {
+        *error = "unknown opcode";
+        return ProtocolError;
+    }
+    if (!(p[1] & 0x80)) {
+        *error = "client frames must be masked";
+        return ProtocolError;
+    }
+    if (length == 126) {
+        if (buffer.size() < 4) return NeedMore;
+        length = qFromBigEndian<quint16>(p + 2);
+        offset = 4;
+    } else if (length == 127) {
+        if (buffer.size() < 10) return NeedMore;
+        const quint64 l = qFromBigEndian<quint64>(p + 2);
+        if (l >> 63) {
+            *error = "invalid frame length";
+            return ProtocolError;
+        }
+        length = static_cast<qint64>(l);
+        offset = 10;
+    }
+    if (control && (!(p[0] & 0x80) || length > 125 || (p[0] & 0x40))) {
+        *error = "invalid control frame";
+        return ProtocolError;
+    }
+    if (length > maxPayload) {
+        *closeCode = kCloseTooBig;
+        *error = "message too big";
+        return ProtocolError;
+    }
+    if (buffer.size() - offset - 4 < length) return NeedMore;
+
+    frame->fin = (p[0] & 0x80) != 0;
+    frame->compressed = (p[0] & 0x40) != 0;
+    frame->opcode = opcode;
+    frame->payload = buffer.mid(offset + 4, static_cast<int>(length));
+    const uchar *mask = p + offset;
+    char *d = frame->payload.data();
+    for (int i = 0; i < frame->payload.size(); ++i) d[i] = static_cast<char>(d[i] ^ mask[i & 3]);
+    buffer.remove(0, offset + 4 + static_cast<int>(length));
+    return FrameReady;
+}
+
+QByteArray WebSocketCodec::frameHeader(int opcode, qint64 payloadSize, bool compressed)
+{
+    QByteArray h;
+    h.reserve(10);
+    h.append(static_cast<char>(0x80 | (compressed ? 0x40 : 0) | (opcode & 0x0f)));
+    if (payloadSize < 126) {
+        h.append(static_cast<char>(payloadSize));
+    } else if (payloadSize <= 0xffff) {
+        uchar len[2];
+        qToBigEndian<quint16>(static_cast<quint16>(payloadSize), len);
+        h.append(static_cast<char>(126));
+        h.append(reinterpret_cast<const char *>(len), 2);
+    } else {
+        uchar len[8];
+        qToBigEndian<quint64>(static_cast<quint64>(payloadSize), len);
+        h.append(static_cast<char>(127));
+        h.append(reinterpret_cast<const char *>(len), 8);
+    }
+    return h;
+}
+
+QByteArray WebSocketCodec::closePayload(quint16 code, const QByteArray &reason)
+{
+    QByteArray payload(2, Qt::Uninitialized);
+    qToBigEndian<quint16>(code, reinterpret_cast<uchar *>(payload.data()));
+    payload += reason.left(123);    // 控制帧正文不超过 125 字节
+    return payload;
+}
+
+
+WebSocketDeflate::WebSocketDeflate()
+    : m_deflate(new z_stream)
+    , m_inflate(new z_stream)
+    , m_lastOk(false)
+    , m_messages(0)
+    , m_bytesIn(0)
+    , m_bytesOut(0)
+{
+    memset(m_deflate, 0, sizeof(z_stream));
+    memset(m_inflate, 0, sizeof(z_stream));
+    deflateInit2(m_deflate, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+    inflateInit2(m_inflate, -15);
+}
+
+WebSocketDeflate::~WebSocketDeflate()
+{
+    deflateEnd(m_deflate);
+    inflateEnd(m_inflate);
+    delete m_deflate;
+    delete m_inflate;
+}
+
+bool WebSocketDeflate::compress(const QByteArray &in, QByteArray *out)
+{
+    if (!in.isEmpty() && in.constData() == m_lastIn.constData() && in.size() == m_lastIn.size()) {
+        if (!m_lastOk) return false;
+        *out = m_lastOut;
+        ++m_messages;
+        m_bytesIn += static_cast<quint64>(in.size());
+        m_bytesOut += static_cast<quint64>(m_lastOut.size());
+        return true;
+    }
+
+    deflateReset(m_deflate);
+    // deflateBound 按 Z_FINISH 估算，Z_SYNC_FLUSH 另有一个空 stored 块
+    QByteArray buf(static_cast<int>(deflateBound(m_deflate, static_cast<uLong>(in.size()))) + 16, Qt::Uninitialized);
+    m_deflate->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(in.constData()));
+    m_deflate->avail_in = static_cast<uInt>(in.size());
+    m_deflate->next_out = reinterpret_cast<Bytef *>(buf.data());
+    m_deflate->avail_out = static_cast<uInt>(buf.size());
+    const int rc = deflate(m_deflate, Z_SYNC_FLUSH);
+    const int size = static_cast<int>(m_deflate->total_out);
+
+    m_lastIn = in;
+    m_lastOk = rc == Z_OK && m_deflate->avail_in == 0 && m_deflate->avail_out > 0
+               && size >= 4 && memcmp(buf.constData() + size - 4, kDeflateTail, 4) == 0
+               && size - 4 < in.size();
+    if (!m_lastOk) {
+        m_lastOut.clear();
+        return false;
+    }
+    buf.resize(size - 4);
+    m_lastOut = buf;
+    *out = buf;
+    ++m_messages;
+    m_bytesIn += static_cast<quint64>(in.size());
+    m_bytesOut += static_cast<quint64>(buf.size());
+    return true;
+}
+
+bool WebSocketDeflate::decompress(const QByteArray &in, QByteArray *out, int maxSize)
+{
+    // 对端不跨消息保留窗口，每条消息从空窗口开始
+    inflateReset(m_inflate);
+    QByteArray input = in;
+    input.append(kDeflateTail, 4);
+
+    QByteArray buf(qMin(maxSize, qMax(256, input.size() * 4)), Qt::Uninitialized);
+    m_inflate->next_in = reinterpret_cast<Bytef *>(input.data());
+    m_inflate->avail_in = static_cast<uInt>(input.size());
+    m_inflate->next_out = reinterpret_cast<Bytef *>(buf.data());
+    m_inflate->avail_out = static_cast<uInt>(buf.size());
+
+    for (;;) {
+        const int rc = inflate(m_inflate, Z_SYNC_FLUSH);
+        if (rc == Z_STREAM_END) break;                  // 对端用 BFINAL 块结束消息也合法
+        if (rc != Z_OK && rc != Z_BUF_ERROR) return false;
+        if (m_inflate->avail_in == 0 && m_inflate->avail_out > 0) break;
+        if (m_inflate->avail_out > 0) return false;     // 还有输入却解不动：数据损坏
+        if (buf.size() >= maxSize) return false;        // 解压炸弹
+        const int used = buf.size();
+        buf.resize(qMin(maxSize, used * 2));
+        m_inflate->next_out = reinterpret_cast<Bytef *>(buf.data() + used);
+        m_inflate->avail_out = static_cast<uInt>(buf.size() - used);
+    }
+    buf.resize(static_cast<int>(m_inflate->total_out));
+    *out = buf;
+    return true;
+}
@@ -0,0 +1,108 @@
+#ifndef WEBSOCKETCODEC_H
+#define WEBSOCKETCODEC_H
+
+#include <QByteArray>
+#include <QString>
+
+struct z_stream_s;
+
+// WebSocket（RFC 6455）服务端的握手与帧编解码。QtWebSockets 不支持扩展协商（收到 RSV1 置位的帧直接断开），
+// 做不了 permessage-deflate，所以网关直接在 QTcpSocket 上做 WebSocket：握手之后每条消息的帧头和正文
+// 像 TCP 连接的长度头和正文一样进出站队列，走同一条 writev 路径和同一套水位规则。
+// 只有静态函数，连接状态放在 JsonTcpServer 的连接表里。
+class WebSocketCodec
+{
+public:
+    enum Opcode {
+        Continuation = 0x0,
+        Text         = 0x1,
+        Binary       = 0x2,
+        Close        = 0x8,
+        Ping         = 0x9,
+        Pong         = 0xA
+    };
+
+    // 关闭码
+    static const quint16 kCloseNormal       = 1000;
+    static const quint16 kCloseGoingAway    = 1001;
+    static const quint16 kCloseProtocol     = 1002;
+    static const quint16 kCloseInvalidData  = 1007;
+    static const quint16 kCloseTooBig       = 1009;
+
+    // HTTP 升级请求的上限，超过还没收全按坏请求处理
+    static const int kMaxHandshake = 8 * 1024;
+
+    struct Handshake {
+        bool complete = false;      // 请求头已收全（并已从缓冲里取走）
+        int status = 0;             // 不能升级时的 HTTP 状态码（400、426），可以升级时为 0
+        QString error;
+        QByteArray key;             // Sec-WebSocket-Key
+        QString origin;             // 没有 Origin 头（非浏览器客户端）时为空
+        bool deflate = false;       // 客户端提议了本端能接受的 permessage-deflate
+    };
+
+    // 从 buffer 开头解析 HTTP 升级请求
+    static Handshake parseHandshake(QByteArray &buffer);
+    // 101 应答；deflate 为 true 时接受 permessage-deflate，并要求双方都不跨消息保留窗口
+    static QByteArray acceptResponse(const QByteArray &key, bool deflate);
+    // 拒绝升级的 HTTP 应答（Connection: close），body 按 JSON 发
+    static QByteArray errorResponse(int status, const QByteArray &body);
+
+    struct Frame {
+        bool fin = false;
+        bool compressed = false;    // RSV1：permessage-deflate 压缩过的消息的第一帧
+        int opcode = 0;
+        QByteArray payload;         // 已去掉掩码
+    };
+
+    enum ParseResult {
+        NeedMore,
+        FrameReady,
+        ProtocolError
+    };
+
+    // 从 buffer 开头拆一帧。客户端的帧必须带掩码；控制帧不得分片、不得超过 125 字节。
+    // 出错时 closeCode、error 给出应回的关闭码和原因
+    static ParseResult parseFrame(QByteArray &buffer, Frame *frame, qint64 maxPayload,
+                                  quint16 *closeCode, QString *error);
+
+    // 服务端发出的帧不带掩码；消息不分片，一条消息就是一帧
+    static QByteArray frameHeader(int opcode, qint64 payloadSize, bool compressed);
+    static QByteArray closePayload(quint16 code, const QByteArray &reason = QByteArray());
+};
+
+// permessage-deflate（RFC 7692）：raw deflate，每条消息以 Z_SYNC_FLUSH 结束并去掉末尾的 00 00 ff ff。
+// 握手时要求 server_no_context_takeover 和 client_no_context_takeover，双方每条消息都从空窗口开始，
+// 于是一个流每条消息 reset 一次就能给所有连接共用，不必每个连接各留一份 32 KiB 的窗口；
+// 出站队列丢弃、合并消息也不会破坏对端的解压状态。
+// 不加锁，只在网络线程使用。
+class WebSocketDeflate
+{
+public:
+    WebSocketDeflate();
+    ~WebSocketDeflate();
+
+    // 压缩后不比原文小时返回 false，调用方照原样发送。广播时同一份正文连续压缩多次，直接复用上一次的结果
+    bool compress(const QByteArray &in, QByteArray *out);
+
+    // 解压不超过 maxSize 字节；数据损坏或超限返回 false
+    bool decompress(const QByteArray &in, QByteArray *out, int maxSize);
+
+    quint64 messagesCompressed() const { return m_messages; }
+    quint64 bytesIn() const { return m_bytesIn; }
+    quint64 bytesOut() const { return m_bytesOut; }
+
+private:
+    Q_DISABLE_COPY(WebSocketDeflate)
+
+    z_stream_s *m_deflate;
+    z_stream_s *m_inflate;
+    QByteArray m_lastIn;        // 持有一份引用，保证地址不会被复用
+    QByteArray m_lastOut;
+    bool m_lastOk;
+    quint64 m_messages;
+    quint64 m_bytesIn;
+    quint64 m_bytesOut;
+};
+
+#endif // WEBSOCKETCODEC_H
@@ -5,7 +5,10 @@
 #include "jsonhandlequeue.h"
 #include "sqldatabase.h"
 #include "logout.h"
+#include "metricsserver.h"
 #include <QCoreApplication>
+#include <QDir>
+#include <QDateTime>
 
 Widget::Widget(QWidget *parent)
     : QWidget(parent)
@@ -25,13 +28,31 @@ Widget::Widget(QWidget *parent)
     jsonHandlerQueue = new JsonHandleQueue(this);
 
     //连接相关槽函数
+    //请求追踪在线程间经排队信号传递
+    qRegisterMetaType<RequestTracePtr>("RequestTracePtr");
+    //应答经工作线程发出的信号按连接号投递
+    qRegisterMetaType<ConnectionId>("ConnectionId");
+
     QObject::connect(server, &JsonTcpServer::log, log, &LogOut::sLog);
     QObject::connect(server, &JsonTcpServer::wrnLog, log, &LogOut::sWarning);
     QObject::connect(jsonHandlerQueue, &JsonHandleQueue::log , log, &LogOut::sLog);
     QObject::connect(jsonHandlerQueue, &JsonHandleQueue::wrnLog, log, &LogOut::sWarning);
+    jsonHandlerQueue->startProcessing();
 
     //数据库
     database = new SqlDataBase("MedicalData.db",this);
+    QObject::connect(database, &SqlDataBase::log, log, &LogOut::sLog);
+    QObject::connect(database, &SqlDataBase::wrnLog, log, &LogOut::sWarning);
+
+    //指标端点（Prometheus），只监听本机
+    metrics = new MetricsServer(server, jsonHandlerQueue, database, this);
+    QObject::connect(metrics, &MetricsServer::log, log, &LogOut::sLog);
+    QObject::connect(metrics, &MetricsServer::wrnLog, log, &LogOut::sWarning);
+    metrics->start();
+
+    //性能面板，放在监听设置与日志之间
+    dashboard = new DashboardPanel(metrics, this);
+    ui->verticalLayout->insertWidget(1, dashboard);
 
     //qDebug() <<QCoreApplication::applicationDirPath();
     //获取可用ip地址
@@ -45,6 +66,7 @@ Widget::Widget(QWidget *parent)
     }
 
     QObject::connect(ui->btnListenState, &QPushButton::clicked, this ,&Widget::while_btnListengingState_clicked);
+    QObject::connect(ui->chkCapture, &QCheckBox::toggled, this, &Widget::while_chkCapture_toggled);
     QObject::connect(server, &JsonTcpServer::jsonDocumentReceived, this, &Widget::addNewRequestInQueue);
 }
 
@@ -67,15 +89,43 @@ void Widget::while_btnListengingState_clicked()
         ui->cbxListeningIP->setEnabled(!listeningState);
         ui->lineEditPort->setEnabled(!listeningState);
     }
+    ui->chkWebSocket->setEnabled(!listeningState);
+    ui->lineEditWsOrigins->setEnabled(!listeningState);
+    ui->spinIdleTimeout->setEnabled(!listeningState);
+    ui->spinAcceptThreads->setEnabled(!listeningState);
     ui->btnListenState->setText(listeningState?"Listening:":"listen");
 }
 
-void Widget::addNewRequestInQueue(QTcpSocket *clientSocket, const QJsonDocument &document)
+void Widget::while_chkCapture_toggled(bool checked)
 {
-    JsonHandle *requestHandle = new JsonHandle(document, clientSocket, database, this);
+    if(!checked){
+        server->stopCapture();
+        return;
+    }
+
+    //录制文件放在程序目录的 captures 下，按开始时间命名
+    QDir dir(QCoreApplication::applicationDirPath());
+    dir.mkpath("captures");
+    const QString path = dir.filePath(QString("captures/capture_%1.s0cap")
+                                      .arg(QDateTime::currentDateTime().toString("yyyyMMdd_hhmmss")));
+    QString error;
+    if(!server->startCapture(path, &error)){
+        QMessageBox::warning(this, "失败", "无法开始录制：" + error);
+        ui->chkCapture->blockSignals(true);
+        ui->chkCapture->setChecked(false);
+        ui->chkCapture->blockSignals(false);
+    }
+}
+
+void Widget::addNewRequestInQueue(ConnectionId client, const QJsonDocument &document,
+                                  const RequestTracePtr &trace)
+{
+    JsonHandle *requestHandle = new JsonHandle(document, client, database, this);
+    requestHandle->setTrace(trace);
 
     //连接新建请求处理类相关信号
     QObject::connect(requestHandle, &JsonHandle::responseReady, server, &JsonTcpServer::whileJsonNeedSend);
+    QObject::connect(requestHandle, &JsonHandle::frameReady, server, &JsonTcpServer::whileFrameNeedSend);
     QObject::connect(requestHandle, &JsonHandle::log, log, &LogOut::log);
     QObject::connect(requestHandle, &JsonHandle::wrnLog, log, &LogOut::warning);
 
@@ -94,6 +144,12 @@ bool Widget::serverListen(QHostAddress hostAddr,qint16 port)
 {
     qDebug() << hostAddr << port;
 
+    //应用层空闲检测默认关闭；设了秒数后静默一半时发 ping，到时仍无数据断开
+    const int idleTimeout = ui->spinIdleTimeout->value();
+    server->setIdleTimeout(idleTimeout / 2, idleTimeout);
+    //默认 1 个监听者；多开时每个监听者的连接在自己的 I/O 线程里处理
+    server->setAcceptThreads(ui->spinAcceptThreads->value());
+
     if(!server->start(hostAddr, port)){
         QMessageBox msgBox;
         msgBox.setWindowTitle("失败");
@@ -102,6 +158,19 @@ bool Widget::serverListen(QHostAddress hostAddr,qint16 port)
         return false;
     }
 
+    //同机的反向代理、报表任务走本地套接字，省掉 TCP 回环；开不了只记警告
+    server->listenLocal(QString("sever0-%1").arg(static_cast<quint16>(port)));
+    //网页前台走 WebSocket 网关，勾选后才开；端口为 TCP 端口加一（TCP 端口为 0 时同样由系统分配），
+    //只接受白名单里的网页来源
+    if(ui->chkWebSocket->isChecked()){
+        QStringList origins;
+        for(const QString &origin : ui->lineEditWsOrigins->text().split(',')){
+            if(!origin.trimmed().isEmpty()) origins << origin.trimmed();
+        }
+        server->setWebSocketAllowedOrigins(origins);
+        server->listenWebSocket(hostAddr, port ? static_cast<quint16>(port + 1) : 0);
+    }
+
     //writeLog("listening"+hostAddr.toString()+":"+QString::number(port));
     return true;
 }
@@ -13,6 +13,8 @@
 #include "jsonhandlequeue.h"
 #include "sqldatabase.h"
 #include "logout.h"
+#include "metricsserver.h"
+#include "dashboardpanel.h"
 QT_BEGIN_NAMESPACE
 namespace Ui { class Widget; }
 QT_END_NAMESPACE
@@ -28,8 +30,10 @@ public:
 
 private slots:
     void while_btnListengingState_clicked();
+    void while_chkCapture_toggled(bool checked);
 
-    void addNewRequestInQueue(QTcpSocket *clientSocket, const QJsonDocument &document);
+    void addNewRequestInQueue(ConnectionId client, const QJsonDocument &document,
+                              const RequestTracePtr &trace);
     //void handleJsonDocument(QTcpSocket *clientSocket, const QJsonDocument &document);
 private:
     Ui::Widget *ui;
@@ -37,6 +41,8 @@ private:
     JsonHandleQueue *jsonHandlerQueue;
     SqlDataBase *database;
     LogOut * log;
+    MetricsServer *metrics;
+    DashboardPanel *dashboard;
     bool listeningState;
     bool serverListen(QHostAddress, qint16);
     bool serverClose();